@@ -56,6 +56,7 @@ enum class EInferStatus {
     EIS_InferFailedShapeParameterError = 9,
     EIS_InferFailedChannelParameterError = 10,
     EIS_InferFailedOutputEmpty = 11,
+    EIS_InferCancelled = 12,
 
 };
 
@@ -8,6 +8,12 @@
 #include "Common.hpp"
 #include "runtime/RuntimeOperator.hpp"
 
+// 按NumPy规则计算两个形状{channels, rows, cols}广播后的形状，某一维不相等时其中一方须为1
+std::vector<uint32_t> tensor_broadcast_shapes(const std::vector<uint32_t> &shapes1,
+                                              const std::vector<uint32_t> &shapes2);
+
+// 将两个张量展开到广播后的形状，会为需要展开的张量分配新的空间
+// tensor_add和tensor_multiply直接按步长0读取广播维度，不再经过这里
 std::tuple<std::shared_ptr<Tensor>, std::shared_ptr<Tensor>>
 tensor_broadcast(const std::shared_ptr<Tensor> &tensor1, const std::shared_ptr<Tensor> &tensor2);
 
@@ -46,12 +52,20 @@ std::string shape_str(const std::vector<int> &shapes);
 
 /// 如果图是第一次运行，则根据节点输入operand的形状准备好后续Layer计算中所需要的Tensor
 /// 如果图是第二次及以后运行，则检查输入operand的形状和operand中张量的形状是否匹配
-void init_operator_input(const std::vector<std::shared_ptr<RuntimeOperator>> &operators);
+/// max_batch_size大于0时batch维度统一使用max_batch_size，模型中的batch维度可以是动态的
+void init_operator_input(const std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                         uint32_t max_batch_size = 0);
 
 /// 如果图是第一次运行，则根据节点输出operand的形状准备好后续Layer计算中所需要的Tensor
 /// 如果图是第二次及以后运行，则检查输出operand的形状和operand中张量的形状是否匹配
-
+/// max_batch_size大于0时batch维度统一使用max_batch_size，模型中的batch维度可以是动态的
 void init_operator_output(const std::vector<pnnx::Operator *> &pnnx_operators,
-                          const std::vector<std::shared_ptr<RuntimeOperator>> &operators);
+                          const std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                          uint32_t max_batch_size = 0);
+
+/// 算子已经记录了输出操作数的形状时(例如从原生格式加载的模型)，根据记录的形状准备输出Tensor
+/// max_batch_size大于0时batch维度统一使用max_batch_size
+void init_operator_output(const std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                          uint32_t max_batch_size = 0);
 
 #endif //INFERFRAMEWORK_UTILS_HPP
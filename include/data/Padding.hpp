@@ -0,0 +1,48 @@
+//
+// Created by xyzzzh on 2024/4/22.
+//
+
+#ifndef INFERFRAMEWORK_PADDING_HPP
+#define INFERFRAMEWORK_PADDING_HPP
+
+#include <cstdint>
+#include <algorithm>
+
+// 虚拟填充的描述符，只记录四个方向的填充大小和填充值，不生成填充后的张量
+// 卷积和池化按输出位置把计算分为内部区域和边界区域，边界区域中的填充值在计算时直接生成
+struct PaddingDesc {
+    uint32_t top = 0;
+    uint32_t bottom = 0;
+    uint32_t left = 0;
+    uint32_t right = 0;
+    float value = 0.f;
+
+    bool empty() const {
+        return top == 0 && bottom == 0 && left == 0 && right == 0;
+    }
+
+    // 叠加另一个描述符的填充大小，填充值保持不变
+    PaddingDesc &operator+=(const PaddingDesc &other) {
+        top += other.top;
+        bottom += other.bottom;
+        left += other.left;
+        right += other.right;
+        return *this;
+    }
+};
+
+// 一维上窗口完全落在输入内部的输出下标范围[begin, end)
+// input_len为未填充的输入长度，pad_begin为起始方向的填充大小，output_len为输出长度
+inline void padding_interior_range(uint32_t input_len, uint32_t pad_begin, uint32_t kernel,
+                                   uint32_t stride, uint32_t output_len,
+                                   uint32_t &begin, uint32_t &end) {
+    begin = std::min(output_len, (pad_begin + stride - 1) / stride);
+    if (input_len + pad_begin < kernel) {
+        end = begin;
+        return;
+    }
+    end = std::min(output_len, (input_len + pad_begin - kernel) / stride + 1);
+    end = std::max(begin, end);
+}
+
+#endif //INFERFRAMEWORK_PADDING_HPP
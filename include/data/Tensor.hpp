@@ -8,6 +8,7 @@
 #include <armadillo>
 #include <vector>
 #include <memory>
+#include <numeric>
 #include <glog/logging.h>
 
 // 默认为float
@@ -22,8 +23,13 @@ public:
 
     explicit Tensor(uint32_t channels, uint32_t rows, uint32_t cols);
 
+    // shapes的维度大于3时，最后两维作为rows和cols，之前的维度合并到channels中，raw_shapes保留完整形状
     explicit Tensor(const std::vector<uint32_t> &shapes);
 
+    // 使用外部内存raw_ptr作为存储，不拷贝也不释放，调用者需要保证内存的生命周期
+    // 元素数量不变的reshape仍使用外部内存，改变元素数量时会重新分配自己的存储
+    explicit Tensor(float *raw_ptr, uint32_t channels, uint32_t rows, uint32_t cols);
+
     // 拷贝构造
     Tensor(const Tensor &other);
 
@@ -68,7 +74,7 @@ public:
     // 获取m_data
     arma::fcube &data();
 
-    const arma::fcube data() const;
+    const arma::fcube &data() const;
 
     // 返回张量第channel通道中的数据
     arma::fmat &slice(uint32_t channel);
@@ -103,7 +109,7 @@ public:
     // 打印张量shapes
     void show_shapes();
 
-    // 张量的实际尺寸大小的reshape
+    // 张量的实际尺寸大小的reshape，shapes的维度大于3时前面的维度合并到通道中
     void reshape(const std::vector<uint32_t> &shapes, bool row_major = false);
 
     // 对m_data进行压平
@@ -129,8 +135,7 @@ private:
     // shapes: 一个包含目标形状的数组，预期为[target_channels, target_rows, target_cols]。
     void review(const std::vector<uint32_t> &shapes);
 
-    // 张量数据的实际尺寸大小
-    // {rows, cols, channels}
+    // 张量数据的实际尺寸大小，按行主序排列，例如{channels, rows, cols}
     std::vector<uint32_t> m_raw_shapes;
 
     // 张量数据
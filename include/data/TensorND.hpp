@@ -0,0 +1,115 @@
+//
+// Created by xyzzzh on 2024/4/20.
+//
+
+#ifndef INFERFRAMEWORK_TENSORND_HPP
+#define INFERFRAMEWORK_TENSORND_HPP
+
+#include <vector>
+#include <memory>
+#include <glog/logging.h>
+#include "data/Tensor.hpp"
+
+// 任意维度的float张量，显式记录形状和步长(以元素为单位)
+// 由构造函数创建的张量拥有连续的行主序存储，view/permute/slice等操作只修改形状和步长，与原张量共享数据
+// from_blob和from_tensor得到的是不拥有数据的视图，调用者需要保证底层数据的生命周期
+class TensorND {
+public:
+    explicit TensorND() = default;
+
+    // 分配shapes大小的连续行主序存储
+    explicit TensorND(const std::vector<uint32_t> &shapes);
+
+    // 在外部内存上创建视图，strides为空时按连续行主序计算
+    static TensorND from_blob(float *data, const std::vector<uint32_t> &shapes,
+                              const std::vector<uint32_t> &strides = {});
+
+    // 在Tensor的存储上创建视图
+    // 逻辑形状为tensor的raw_shapes，Tensor每个通道按列主序存放，因此最后两维的步长为{1, rows}
+    // dims大于raw_shapes的维度时，在前面补大小为1的维度
+    static TensorND from_tensor(Tensor &tensor, uint32_t dims = 0);
+
+    // 拷贝为一个新的Tensor，维度大于3时前面的维度合并到通道中，raw_shapes保留完整形状
+    std::shared_ptr<Tensor> to_tensor() const;
+
+    // 张量的维度数
+    uint32_t dims() const;
+
+    // 元素总数
+    uint32_t size() const;
+
+    bool empty() const;
+
+    // 是否为连续的行主序排布
+    bool is_contiguous() const;
+
+    // 是否拥有(共享)底层存储
+    bool is_owner() const;
+
+    const std::vector<uint32_t> &shapes() const;
+
+    const std::vector<uint32_t> &strides() const;
+
+    // 第dim维的大小
+    uint32_t shape(uint32_t dim) const;
+
+    // 第一个元素的地址
+    float *raw_ptr();
+
+    const float *raw_ptr() const;
+
+    // 获取indices位置的元素
+    float at(const std::vector<uint32_t> &indices) const;
+
+    float &at(const std::vector<uint32_t> &indices);
+
+    // 改变形状，要求张量连续，shapes中至多一个-1由其余维度推出
+    TensorND view(const std::vector<int32_t> &shapes) const;
+
+    // 按dims重新排列维度
+    TensorND permute(const std::vector<uint32_t> &dims) const;
+
+    // 交换两个维度
+    TensorND transpose(uint32_t dim0, uint32_t dim1) const;
+
+    // 在dim维上截取[start, end)，间隔为step
+    TensorND slice(uint32_t dim, uint32_t start, uint32_t end, uint32_t step = 1) const;
+
+    // 取dim维上的第index个，结果少一维
+    TensorND select(uint32_t dim, uint32_t index) const;
+
+    // 在dim处插入大小为1的维度
+    TensorND unsqueeze(uint32_t dim) const;
+
+    // 删除dim处大小为1的维度
+    TensorND squeeze(uint32_t dim) const;
+
+    // 将大小为1的维度广播到shapes，广播维度的步长为0
+    TensorND expand(const std::vector<uint32_t> &shapes) const;
+
+    // 返回连续排布的张量，已经连续时直接返回自身的视图
+    TensorND contiguous() const;
+
+    // 从形状相同的src拷贝数据，两者都可以是任意步长的视图
+    void copy_from(const TensorND &src);
+
+    // 用value填充张量
+    void fill(float value);
+
+    // 按行主序返回所有元素
+    std::vector<float> values() const;
+
+private:
+    // 计算shapes的连续行主序步长
+    static std::vector<uint32_t> contiguous_strides(const std::vector<uint32_t> &shapes);
+
+    std::vector<uint32_t> m_shapes;
+    std::vector<uint32_t> m_strides;
+    float *m_data = nullptr;
+    std::shared_ptr<float> m_storage;
+};
+
+// 沿dim维拼接inputs，结果直接写入output对应的切片中，不产生中间张量
+void tensor_concat(const std::vector<TensorND> &inputs, uint32_t dim, TensorND &output);
+
+#endif //INFERFRAMEWORK_TENSORND_HPP
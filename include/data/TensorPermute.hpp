@@ -0,0 +1,25 @@
+//
+// Created by xyzzzh on 2024/4/21.
+//
+
+#ifndef INFERFRAMEWORK_TENSORPERMUTE_HPP
+#define INFERFRAMEWORK_TENSORPERMUTE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 按shapes把src拷贝到dst，dst和src的步长(以元素为单位)可以是任意排列
+// 拷贝前先合并连续的维度，然后按以下三种情况处理：
+// 1. dst和src的最内层维度都连续：逐行memcpy
+// 2. dst最内层连续，src在另一维上连续：分块转置，块内使用8x8的转置微内核
+// 3. 其他情况：逐元素按步长拷贝
+void permute_copy(float *dst, const std::vector<uint32_t> &dst_strides,
+                  const float *src, const std::vector<uint32_t> &src_strides,
+                  const std::vector<uint32_t> &shapes);
+
+// 二维转置：dst[c * dst_ld + r] = src[r * src_ld + c]，r < rows，c < cols
+void transpose_2d(const float *src, size_t src_ld, float *dst, size_t dst_ld,
+                  uint32_t rows, uint32_t cols);
+
+#endif //INFERFRAMEWORK_TENSORPERMUTE_HPP
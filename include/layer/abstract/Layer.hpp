@@ -6,6 +6,7 @@
 #define INFERFRAMEWORK_LAYER_HPP
 
 #include "Common.hpp"
+#include "data/Padding.hpp"
 #include "runtime/RuntimeOperator.hpp"
 
 class Layer {
@@ -35,11 +36,45 @@ public:
 
     virtual void set_weights(const std::vector<float> &weights);
 
+    // 从只读的权重视图(按行主序)直接写入层的执行布局，不产生中间拷贝
+    virtual void set_weights(const WeightSpan &weights);
+
     // 设置Layer的偏移量
     virtual void set_bias(const std::vector<std::shared_ptr<Tensor>> &bias);
 
     virtual void set_bias(const std::vector<float> &bias);
 
+    virtual void set_bias(const WeightSpan &bias);
+
+    // 延迟加载权重的层在第一次forward之前调用，分配权重的存储并写入计算时的布局，已经写入时直接返回
+    virtual void materialize_weights();
+
+    // 层的权重是否已经写入计算时的布局，没有权重或者不延迟加载的层总是返回true
+    virtual bool weights_materialized() const;
+
+    // 提示操作系统在后台预读尚未写入的权重所在的模型文件页，不等待读取完成
+    virtual void prefetch_weights();
+
+    // 将前驱填充算子的填充合并到当前层，由当前层在计算时生成填充值，成功时返回true
+    virtual bool fuse_padding(const PaddingDesc &padding);
+
+    // 当前层为纯填充算子时，尝试把填充折叠到后继层next中，折叠后当前层只传递输入
+    virtual bool fold_padding_into(Layer &next);
+
+    // 层是否支持把输出直接写入输入的存储中，要求逐元素计算且输出与输入形状相同
+    virtual bool support_inplace() const;
+
+    // 设置输出复用第index个输入操作数的存储，index为-1时输出使用独立的存储
+    void set_inplace_input(int32_t index);
+
+    // 输出复用存储的输入操作数序号，-1表示输出使用独立的存储，内存规划时两者共享同一块内存
+    virtual int32_t aliased_input() const;
+
+    // 根据每个输入操作数的形状推导输出的形状，形状都不包含batch维度
+    // 无法推导时返回false，此时层只能在build时记录的输入形状上执行
+    virtual bool infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                                     std::vector<uint32_t> &output_shapes) const;
+
     // 返回层的名称
     virtual const std::string layer_name() const { return this->m_layer_name; }
 
@@ -48,6 +83,9 @@ public:
             const std::shared_ptr<RuntimeOperator> &runtime_operator
     ) { this->m_runtime_operator = runtime_operator; }
 
+protected:
+    int32_t m_inplace_input = -1;
+
 private:
     std::weak_ptr<RuntimeOperator> m_runtime_operator;
     std::string m_layer_name;
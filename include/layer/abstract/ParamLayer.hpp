@@ -5,12 +5,16 @@
 #ifndef INFERFRAMEWORK_PARAMLAYER_HPP
 #define INFERFRAMEWORK_PARAMLAYER_HPP
 
+#include <atomic>
+#include <mutex>
 #include "Common.hpp"
 #include "layer/abstract/Layer.hpp"
 
 class ParamLayer : public Layer{
 public:
-    explicit ParamLayer(const std::string &layer_name) : Layer(layer_name){}
+    // lazy_weights为true时构造时只记录权重和偏移的形状，第一次forward之前再分配存储
+    explicit ParamLayer(const std::string &layer_name, bool lazy_weights = false)
+            : Layer(layer_name), m_lazy_weights(lazy_weights) {}
 
     // 初始化权重空间
     void init_weight_param(const uint32_t param_count, const uint32_t param_channel,
@@ -31,14 +35,43 @@ public:
 
     void set_weights(const std::vector<float> &weights) override;
 
+    // 按行主序的权重视图依次写入每个权重张量，每个元素只写一次
+    void set_weights(const WeightSpan &weights) override;
+
     // 设置Layer的偏移量
     void set_bias(const std::vector<std::shared_ptr<Tensor>> &bias) override;
 
     void set_bias(const std::vector<float> &bias) override;
 
+    void set_bias(const WeightSpan &bias) override;
+
+    // 延迟加载时记录权重和偏移所在的属性，写入之前属性一直持有模型文件的映射，没有偏移时bias为空
+    void defer_weights(std::shared_ptr<RuntimeAttribute> weight, std::shared_ptr<RuntimeAttribute> bias);
+
+    // 分配存储并从记录的属性写入权重和偏移，之后释放属性，多个线程同时调用时只写入一次
+    void materialize_weights() override;
+
+    bool weights_materialized() const override;
+
+    // 预读记录的属性在模型文件映射中的数据，其他线程正在写入时跳过
+    void prefetch_weights() override;
+
 protected:
+    // 按构造时记录的形状分配权重和偏移中还没有分配的存储
+    virtual void allocate_weights();
+
     std::vector<std::shared_ptr<Tensor>> m_weights;
     std::vector<std::shared_ptr<Tensor>> m_bias;
+
+    bool m_lazy_weights = false;        // 是否延迟分配和写入权重
+    std::vector<uint32_t> m_weight_shape; // 权重张量的数量和每个张量的通道数、行数、列数
+    std::vector<uint32_t> m_bias_shape;   // 偏移张量的数量和每个张量的通道数、行数、列数
+
+private:
+    std::shared_ptr<RuntimeAttribute> m_pending_weight; // 尚未写入的权重所在的属性
+    std::shared_ptr<RuntimeAttribute> m_pending_bias;   // 尚未写入的偏移所在的属性
+    std::atomic<bool> m_materialized = false;           // 延迟加载的权重是否已经写入
+    std::mutex m_materialize_mutex;                     // 保证只写入一次，并保护尚未写入的属性
 };
 
 
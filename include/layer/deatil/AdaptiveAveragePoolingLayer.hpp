@@ -18,6 +18,10 @@ public:
             const std::vector<std::shared_ptr<Tensor>> &inputs,
             std::vector<std::shared_ptr<Tensor>> &outputs) override;
 
+    // 输出的高和宽固定，通道数与输入相同
+    bool infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                             std::vector<uint32_t> &output_shapes) const override;
+
     static EParseParameterAttrStatus create_instance(
             const std::shared_ptr<RuntimeOperator> &op,
             std::shared_ptr<Layer> &avg_layer);
@@ -0,0 +1,36 @@
+//
+// Created by xyzzzh on 2024/5/2.
+//
+
+#ifndef INFERFRAMEWORK_ATTRIBUTELAYER_HPP
+#define INFERFRAMEWORK_ATTRIBUTELAYER_HPP
+
+#include "Common.hpp"
+#include "layer/abstract/LayerRegisterer.hpp"
+#include "layer/abstract/NonParamLayer.hpp"
+
+// 常量算子，没有输入，每个batch的输出都是同一份常量数据
+// 模型中的pnnx.Attribute和build时折叠得到的常量子图都使用该层
+class AttributeLayer : public NonParamLayer {
+public:
+    explicit AttributeLayer(std::vector<float> values);
+
+    // 从权重视图直接拷贝常量数据，不经过中间的数组
+    explicit AttributeLayer(const WeightSpan &values);
+
+    // 激活内存在算子之间复用，每次forward都把常量写入输出
+    EInferStatus forward(const std::vector<std::shared_ptr<Tensor>> &inputs,
+                         std::vector<std::shared_ptr<Tensor>> &outputs) override;
+
+    // 按行主序存储的常量数据
+    const std::vector<float> &values() const;
+
+    static EParseParameterAttrStatus
+    get_instance(const std::shared_ptr<RuntimeOperator> &op, std::shared_ptr<Layer> &attribute_layer);
+
+private:
+    std::vector<float> m_values; /// 按行主序存储的常量数据
+};
+
+
+#endif //INFERFRAMEWORK_ATTRIBUTELAYER_HPP
@@ -16,7 +16,7 @@ public:
                        uint32_t kernel_h, uint32_t kernel_w,
                        uint32_t padding_h, uint32_t padding_w,
                        uint32_t stride_h, uint32_t stride_w,
-                       uint32_t groups, bool use_bias = true);
+                       uint32_t groups, bool use_bias = true, bool lazy_weights = false);
 
     static EParseParameterAttrStatus get_instance(
             const std::shared_ptr<RuntimeOperator> &op,
@@ -26,10 +26,35 @@ public:
             const std::vector<std::shared_ptr<Tensor>> &inputs,
             std::vector<std::shared_ptr<Tensor>> &outputs) override;
 
-    // 初始化kernel的IM2COL排布
+    using ParamLayer::set_weights;
+
+    // 使用外部的权重张量，并拷贝为IM2COL排布
+    void set_weights(const std::vector<std::shared_ptr<Tensor>> &weights) override;
+
+    // 根据当前的权重张量重新生成kernel的IM2COL排布
     void init_IM2COL_weight();
 
+    // 合并前驱填充算子的填充，只支持填充值为0或者自身没有填充的情况
+    bool fuse_padding(const PaddingDesc &padding) override;
+
+    // 根据卷积核大小、填充和步长推导输出的高和宽，输出通道数为卷积核数量
+    bool infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                             std::vector<uint32_t> &output_shapes) const override;
+
+protected:
+    // 先分配IM2COL排布的kernel矩阵并绑定权重张量，再分配偏移
+    void allocate_weights() override;
+
 private:
+    // 记录卷积核的形状，不延迟加载时分配IM2COL排布的kernel矩阵
+    void init_kernel_matrix(uint32_t kernel_count, uint32_t kernel_c, uint32_t kernel_h, uint32_t kernel_w);
+
+    // 按记录的卷积核形状分配kernel矩阵，权重张量直接引用其中的行向量，按权重写入时不需要再次重排
+    void allocate_kernel_matrix();
+
+    // 把权重张量绑定到对应的IM2COL行向量上
+    void bind_kernel_weights(uint32_t kernel_c, uint32_t kernel_h, uint32_t kernel_w);
+
     void conv_GEMM_bias(const arma::fmat &input_matrix, std::shared_ptr<Tensor> output_tensor,
                       uint32_t group, uint32_t kernel_index,
                       uint32_t kernel_count_group, const arma::frowvec &kernel,
@@ -42,8 +67,7 @@ private:
 private:
     bool m_use_bias = false;
     uint32_t m_groups = 1;
-    uint32_t m_padding_h = 0;
-    uint32_t m_padding_w = 0;
+    PaddingDesc m_padding;
     uint32_t m_stride_h = 1;
     uint32_t m_stride_w = 1;
     std::vector<arma::frowvec> m_kernel_matrix_arr;
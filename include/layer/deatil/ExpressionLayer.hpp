@@ -18,12 +18,20 @@ public:
     EInferStatus forward(const std::vector<std::shared_ptr<Tensor>> &inputs,
                          std::vector<std::shared_ptr<Tensor>> &outputs) override;
 
+    // 表达式的最后一步运算直接写入输出，输出可以复用形状相同的输入
+    bool support_inplace() const override;
+
+    // 输出形状为所有操作数按广播规则得到的形状
+    bool infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                             std::vector<uint32_t> &output_shapes) const override;
+
     static EParseParameterAttrStatus get_instance(const std::shared_ptr<RuntimeOperator> &op,
                                                   std::shared_ptr<Layer> &expression_layer);
 
 private:
     std::string m_statement;
     std::unique_ptr<ExpressionParser> m_parser;
+    std::vector<std::shared_ptr<TokenNode>> m_token_nodes; /// 表达式的逆波兰式
 };
 
 
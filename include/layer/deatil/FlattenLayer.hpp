@@ -19,6 +19,10 @@ public:
             const std::vector<std::shared_ptr<Tensor>> &inputs,
             std::vector<std::shared_ptr<Tensor>> &outputs) override;
 
+    // 把start_dim到end_dim之间的维度合并为一维
+    bool infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                             std::vector<uint32_t> &output_shapes) const override;
+
     static EParseParameterAttrStatus create_instance(
             const std::shared_ptr<RuntimeOperator> &op,
             std::shared_ptr<Layer> &flatten_layer);
@@ -12,11 +12,15 @@
 
 class LinearLayer : public ParamLayer {
 public:
-    explicit LinearLayer(int32_t in_features, int32_t out_features, bool use_bias);
+    explicit LinearLayer(int32_t in_features, int32_t out_features, bool use_bias, bool lazy_weights = false);
 
     EInferStatus forward(const std::vector<std::shared_ptr<Tensor>> &inputs,
                          std::vector<std::shared_ptr<Tensor>> &outputs) override;
 
+    // 最后一维从in_features变为out_features
+    bool infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                             std::vector<uint32_t> &output_shapes) const override;
+
     static EParseParameterAttrStatus get_instance(const std::shared_ptr<RuntimeOperator> &op,
                                                  std::shared_ptr<Layer> &linear_layer);
 
@@ -21,9 +21,15 @@ public:
     static EParseParameterAttrStatus
     get_instance(const std::shared_ptr<RuntimeOperator> &op, std::shared_ptr<Layer> &max_layer);
 
+    // 合并前驱填充算子的填充，自身有填充时只能合并同样不参与取最大值的填充
+    bool fuse_padding(const PaddingDesc &padding) override;
+
+    // 根据池化窗口、填充和步长推导输出的高和宽
+    bool infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                             std::vector<uint32_t> &output_shapes) const override;
+
 private:
-    uint32_t m_padding_h = 0;
-    uint32_t m_padding_w = 0;
+    PaddingDesc m_padding;
     uint32_t m_pooling_size_h = 0;
     uint32_t m_pooling_size_w = 0;
     uint32_t m_stride_h = 0;
@@ -0,0 +1,42 @@
+//
+// Created by xyzzzh on 2024/4/22.
+//
+
+#ifndef INFERFRAMEWORK_PADLAYER_HPP
+#define INFERFRAMEWORK_PADLAYER_HPP
+
+#include "Common.hpp"
+#include "Utils.hpp"
+#include "data/Padding.hpp"
+#include "layer/abstract/LayerRegisterer.hpp"
+#include "layer/abstract/NonParamLayer.hpp"
+
+// nn.ZeroPad2d、nn.ConstantPad2d和F.pad的常数填充
+// 构建计算图时如果填充能折叠到唯一的后继卷积或池化层中，本层只传递输入，不生成填充后的张量
+class PadLayer : public NonParamLayer {
+public:
+    explicit PadLayer(const PaddingDesc &padding);
+
+    EInferStatus forward(
+            const std::vector<std::shared_ptr<Tensor>> &inputs,
+            std::vector<std::shared_ptr<Tensor>> &outputs) override;
+
+    bool fold_padding_into(Layer &next) override;
+
+    // 折叠后输出即为第0个输入
+    int32_t aliased_input() const override;
+
+    // 折叠后输出形状与输入相同，否则在最后两维上加上填充大小
+    bool infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                             std::vector<uint32_t> &output_shapes) const override;
+
+    static EParseParameterAttrStatus get_instance(
+            const std::shared_ptr<RuntimeOperator> &op,
+            std::shared_ptr<Layer> &pad_layer);
+
+private:
+    PaddingDesc m_padding;
+    bool m_folded = false;
+};
+
+#endif //INFERFRAMEWORK_PADLAYER_HPP
@@ -0,0 +1,61 @@
+//
+// Created by xyzzzh on 2024/4/21.
+//
+
+#ifndef INFERFRAMEWORK_PERMUTELAYER_HPP
+#define INFERFRAMEWORK_PERMUTELAYER_HPP
+
+#include "Common.hpp"
+#include "Utils.hpp"
+#include "data/TensorND.hpp"
+#include "layer/abstract/LayerRegisterer.hpp"
+#include "layer/abstract/NonParamLayer.hpp"
+
+// torch.permute和torch.transpose，dims不包含batch维度
+// 计算时在输入和输出的存储上建立视图，由分块转置的permute_copy完成重排
+class PermuteLayer : public NonParamLayer {
+public:
+    explicit PermuteLayer(std::vector<uint32_t> dims);
+
+    EInferStatus forward(
+            const std::vector<std::shared_ptr<Tensor>> &inputs,
+            std::vector<std::shared_ptr<Tensor>> &outputs) override;
+
+    // 按dims重新排列输入的各个维度
+    bool infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                             std::vector<uint32_t> &output_shapes) const override;
+
+    static EParseParameterAttrStatus get_instance(
+            const std::shared_ptr<RuntimeOperator> &op,
+            std::shared_ptr<Layer> &permute_layer);
+
+    static EParseParameterAttrStatus get_transpose_instance(
+            const std::shared_ptr<RuntimeOperator> &op,
+            std::shared_ptr<Layer> &permute_layer);
+
+private:
+    std::vector<uint32_t> m_dims;
+};
+
+// Tensor.view和Tensor.reshape，shapes不包含batch维度，元素按行主序重新排列
+class ViewLayer : public NonParamLayer {
+public:
+    explicit ViewLayer(std::vector<int32_t> shapes);
+
+    EInferStatus forward(
+            const std::vector<std::shared_ptr<Tensor>> &inputs,
+            std::vector<std::shared_ptr<Tensor>> &outputs) override;
+
+    // 解析shapes中的-1，元素数量必须与输入相同
+    bool infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                             std::vector<uint32_t> &output_shapes) const override;
+
+    static EParseParameterAttrStatus get_instance(
+            const std::shared_ptr<RuntimeOperator> &op,
+            std::shared_ptr<Layer> &view_layer);
+
+private:
+    std::vector<int32_t> m_shapes;
+};
+
+#endif //INFERFRAMEWORK_PERMUTELAYER_HPP
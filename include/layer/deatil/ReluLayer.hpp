@@ -15,6 +15,13 @@ public:
     EInferStatus forward(const std::vector<std::shared_ptr<Tensor>> &inputs,
                          std::vector<std::shared_ptr<Tensor>> &outputs) override;
 
+    // 逐元素计算，输出可以直接写入输入
+    bool support_inplace() const override;
+
+    // 输出形状与输入相同
+    bool infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                             std::vector<uint32_t> &output_shapes) const override;
+
     // Relu初始化
     static EParseParameterAttrStatus
     get_instance(const std::shared_ptr<RuntimeOperator> &op, std::shared_ptr<Layer> &relu_layer);
@@ -0,0 +1,32 @@
+//
+// Created by xyzzzh on 2024/4/24.
+//
+
+#ifndef INFERFRAMEWORK_SIGMOIDLAYER_HPP
+#define INFERFRAMEWORK_SIGMOIDLAYER_HPP
+
+#include "Common.hpp"
+#include "layer/abstract/NonParamLayer.hpp"
+
+class SigmoidLayer : public NonParamLayer {
+public:
+    SigmoidLayer() : NonParamLayer("Sigmoid") {}
+
+    EInferStatus forward(const std::vector<std::shared_ptr<Tensor>> &inputs,
+                         std::vector<std::shared_ptr<Tensor>> &outputs) override;
+
+    // 逐元素计算，输出可以直接写入输入
+    bool support_inplace() const override;
+
+    // 输出形状与输入相同
+    bool infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                             std::vector<uint32_t> &output_shapes) const override;
+
+    // Sigmoid初始化
+    static EParseParameterAttrStatus
+    get_instance(const std::shared_ptr<RuntimeOperator> &op, std::shared_ptr<Layer> &sigmoid_layer);
+
+};
+
+
+#endif //INFERFRAMEWORK_SIGMOIDLAYER_HPP
@@ -0,0 +1,26 @@
+//
+// Created by xyzzzh on 2024/4/30.
+//
+
+#ifndef INFERFRAMEWORK_CANCELLATIONTOKEN_HPP
+#define INFERFRAMEWORK_CANCELLATIONTOKEN_HPP
+
+#include <atomic>
+
+// 异步forward的取消标记，可以在任意线程中调用cancel
+// 任务开始执行前和执行过程中的步骤之间检查标记，已经取消的任务不再继续计算
+class CancellationToken {
+public:
+    void cancel() {
+        this->m_cancelled.store(true, std::memory_order_release);
+    }
+
+    bool cancelled() const {
+        return this->m_cancelled.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<bool> m_cancelled{false};
+};
+
+#endif //INFERFRAMEWORK_CANCELLATIONTOKEN_HPP
@@ -0,0 +1,84 @@
+//
+// Created by xyzzzh on 2024/4/29.
+//
+
+#ifndef INFERFRAMEWORK_DYNAMICBATCHER_HPP
+#define INFERFRAMEWORK_DYNAMICBATCHER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include "runtime/RuntimeGraph.hpp"
+
+// 动态batch的配置，每个模型的批处理器使用自己的配置
+struct BatcherConfig {
+    uint32_t max_batch_size = 0; /// 一个batch中的最大请求数，为0时使用计算图的最大batch
+    std::chrono::microseconds max_delay{1000}; /// 第一个请求在队列中等待凑齐batch的最长时间
+    uint32_t num_workers = 1;    /// 执行forward的工作线程数，每个工作线程使用自己的执行上下文
+};
+
+// 批处理器的运行统计
+struct BatcherMetrics {
+    uint64_t request_count = 0;   /// 已经完成的请求数量
+    uint64_t batch_count = 0;     /// 已经执行的batch数量
+    uint32_t queue_depth = 0;     /// 当前在队列中等待的请求数量
+    uint32_t max_queue_depth = 0; /// 队列中曾经等待的最大请求数量
+    uint64_t total_queue_time_us = 0; /// 所有已完成请求在队列中等待的总时间，以微秒为单位
+
+    // 平均每个batch包含的请求数量
+    double average_batch_size() const;
+
+    // 平均每个请求在队列中等待的时间，以微秒为单位
+    double average_queue_time_us() const;
+};
+
+// 把多个线程提交的单个输入合并成batch后调用一次forward，再把每个输出分发给对应的请求
+// 队列中的请求达到最大batch，或者最早的请求等待超过max_delay时开始执行
+// 同一个batch中的输入形状必须相同，形状不同的请求分到不同的batch中
+class DynamicBatcher {
+public:
+    // graph需要已经build，并且在批处理器析构之前保持有效
+    DynamicBatcher(const RuntimeGraph &graph, const BatcherConfig &config);
+
+    // 等待队列中剩余的请求执行完毕后退出
+    ~DynamicBatcher();
+
+    DynamicBatcher(const DynamicBatcher &) = delete;
+
+    DynamicBatcher &operator=(const DynamicBatcher &) = delete;
+
+    // 提交单个输入，返回的future在所在batch执行完毕后得到对应的输出
+    std::future<std::shared_ptr<Tensor>> submit(const std::shared_ptr<Tensor> &input);
+
+    // 获取运行统计
+    BatcherMetrics metrics() const;
+
+    // 获取批处理器的配置
+    const BatcherConfig &config() const;
+
+private:
+    struct Request {
+        std::shared_ptr<Tensor> input;
+        std::promise<std::shared_ptr<Tensor>> promise;
+        std::chrono::steady_clock::time_point arrival;
+    };
+
+    void worker_loop();
+
+    const RuntimeGraph &m_graph;
+    BatcherConfig m_config;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Request> m_queue;
+    bool m_stop = false;
+
+    BatcherMetrics m_metrics; // queue_depth以外的统计，由m_mutex保护
+
+    std::vector<std::thread> m_workers;
+};
+
+#endif //INFERFRAMEWORK_DYNAMICBATCHER_HPP
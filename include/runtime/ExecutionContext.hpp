@@ -0,0 +1,45 @@
+//
+// Created by xyzzzh on 2024/4/27.
+//
+
+#ifndef INFERFRAMEWORK_EXECUTIONCONTEXT_HPP
+#define INFERFRAMEWORK_EXECUTIONCONTEXT_HPP
+
+#include "Common.hpp"
+#include "data/Tensor.hpp"
+#include "runtime/ExecutionStep.hpp"
+#include "runtime/CancellationToken.hpp"
+
+class RuntimeGraph;
+
+// 一次推理请求的执行状态，包括激活内存池和每个执行步骤的输入输出张量
+// 层、权重和执行计划由RuntimeGraph持有并在所有上下文之间共享，
+// 每个线程使用自己的上下文时可以同时对同一个计算图调用forward
+class ExecutionContext {
+public:
+    // 激活内存池的大小，以字节为单位
+    size_t activation_memory_size() const;
+
+    // 最近一次forward使用的batch大小
+    uint32_t batch_size() const;
+
+private:
+    friend class RuntimeGraph;
+
+    ExecutionContext() = default;
+
+    std::shared_ptr<const ExecutionPlan> m_plan; // 当前输入形状对应的执行计划
+    std::shared_ptr<float> m_arena; // 激活内存池，输入形状变化后只在容量不足时重新分配
+    size_t m_arena_size = 0;        // 激活内存池的大小，以元素为单位
+
+    // 每个步骤按当前计划的形状和最大batch创建的输出张量，实际batch较小时只使用前面的部分
+    std::vector<std::vector<std::shared_ptr<Tensor>>> m_tensors;
+
+    uint32_t m_batch_size = 0; // m_inputs和m_outputs当前对应的batch大小
+    std::vector<std::vector<std::shared_ptr<Tensor>>> m_inputs;  // 每个步骤按输入操作数顺序拼接的输入
+    std::vector<std::vector<std::shared_ptr<Tensor>>> m_outputs; // 每个步骤的输出
+
+    const CancellationToken *m_cancel_token = nullptr; // 异步forward执行期间的取消标记
+};
+
+#endif //INFERFRAMEWORK_EXECUTIONCONTEXT_HPP
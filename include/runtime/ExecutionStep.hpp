@@ -0,0 +1,54 @@
+//
+// Created by xyzzzh on 2024/4/26.
+//
+
+#ifndef INFERFRAMEWORK_EXECUTIONSTEP_HPP
+#define INFERFRAMEWORK_EXECUTIONSTEP_HPP
+
+#include "Common.hpp"
+#include "data/Tensor.hpp"
+#include "runtime/RuntimeOperator.hpp"
+
+class Layer;
+
+enum class EExecutionStepType {
+    EEST_Input = 0,  /// 把计算图的输入传给后继步骤
+    EEST_Output = 1, /// 计算图的输出，只接收前驱的结果
+    EEST_Layer = 2,  /// 执行一个层的计算
+};
+
+// 步骤输入中的一个位置：第step个步骤的第operand个输入操作数
+// 输入按操作数顺序拼接，batch为n时第operand个操作数从operand * n开始
+struct ExecutionTensorRef {
+    uint32_t step = 0;
+    uint32_t operand = 0;
+};
+
+// build时把计算图展开成按拓扑序排列的步骤数组，每个步骤的输入数量和后继位置都预先解析好
+// forward只按下标访问步骤，不再查找算子名称或比较算子类型
+// 步骤本身在build之后不再改变，输入输出张量保存在每个请求自己的ExecutionContext中
+struct ExecutionStep {
+    EExecutionStepType type = EExecutionStepType::EEST_Layer;
+    std::shared_ptr<RuntimeOperator> op;
+    Layer *layer = nullptr;
+
+    uint32_t batch_size = 0;      /// 输出的最大batch数量，实际执行时只使用前n个
+    uint32_t operand_count = 0;   /// 输入操作数的数量
+    int32_t inplace_operand = -1; /// 原地计算时被复用的输入操作数
+
+    std::vector<uint32_t> output_shapes; /// build时记录的单个batch的输出形状，不包含batch维度
+    std::vector<uint32_t> producers;     /// 每个输入操作数来自的步骤
+    std::vector<ExecutionTensorRef> consumers; /// 输出在后继步骤输入中的位置
+};
+
+// 一种输入形状下每个步骤的输出形状和激活内存的布局
+// 输入形状变化时重新推导形状并规划内存，规划结果按输入形状缓存，在使用同一形状的上下文之间共享
+struct ExecutionPlan {
+    std::vector<uint32_t> input_shapes;              /// 单个batch的计算图输入形状
+    std::vector<std::vector<uint32_t>> output_shapes; /// 每个步骤单个batch的输出形状
+    std::vector<int32_t> inplace_operands;           /// 每个步骤原地计算时复用的输入操作数，-1表示不复用
+    std::vector<int64_t> offsets;                    /// 每个步骤的输出在内存池中的偏移，-1表示单独分配
+    size_t arena_size = 0;                           /// 内存池的大小，以元素为单位
+};
+
+#endif //INFERFRAMEWORK_EXECUTIONSTEP_HPP
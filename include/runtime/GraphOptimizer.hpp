@@ -0,0 +1,36 @@
+//
+// Created by xyzzzh on 2024/5/2.
+//
+
+#ifndef INFERFRAMEWORK_GRAPHOPTIMIZER_HPP
+#define INFERFRAMEWORK_GRAPHOPTIMIZER_HPP
+
+#include "Common.hpp"
+#include "runtime/RuntimeOperator.hpp"
+
+// 一次计算图优化的统计
+struct GraphOptimizeStats {
+    uint32_t folded_operators = 0;     /// 折叠为常量的算子数量
+    uint32_t eliminated_operators = 0; /// 删除的无用算子数量
+    uint32_t merged_operators = 0;     /// 合并到相同算子上的算子数量
+};
+
+// 以下优化都在创建层之前执行，要求算子的输入输出操作数已经初始化，算子之间的关系由
+// 输入操作数的名称(前驱算子名)和m_output_names(后继算子名)表示，删除算子后保持其余算子的相对顺序
+
+// 依次执行常量折叠、无用算子删除和相同算子合并
+GraphOptimizeStats optimize_graph(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                  const std::string &output_name);
+
+// 没有输入的非输入算子和输入全部为常量的算子是常量，被非常量算子使用的常量在此计算一次，
+// 替换为pnnx.Attribute算子，只被常量使用的算子不再有后继，留给无用算子删除，返回折叠的算子数量
+uint32_t fold_constant_operators(const std::vector<std::shared_ptr<RuntimeOperator>> &operators);
+
+// 删除输出不能到达output_name的算子，计算图的输入始终保留，返回删除的算子数量
+uint32_t eliminate_dead_operators(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                  const std::string &output_name);
+
+// 类型、参数、属性和输入都相同的算子只保留拓扑序中的第一个，其余算子的后继改为使用保留的算子，返回合并的算子数量
+uint32_t merge_identical_operators(std::vector<std::shared_ptr<RuntimeOperator>> &operators);
+
+#endif //INFERFRAMEWORK_GRAPHOPTIMIZER_HPP
@@ -0,0 +1,32 @@
+//
+// Created by xyzzzh on 2024/4/23.
+//
+
+#ifndef INFERFRAMEWORK_MEMORYPLANNER_HPP
+#define INFERFRAMEWORK_MEMORYPLANNER_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+// 需要在内存池中分配的一块激活内存
+// [first_use, last_use]为拓扑序中的存活区间，两端都包含
+struct MemoryBlock {
+    size_t size = 0;        /// 块的大小，以元素为单位
+    uint32_t first_use = 0; /// 产生该块的算子在拓扑序中的位置
+    uint32_t last_use = 0;  /// 最后一个使用该块的算子在拓扑序中的位置
+    size_t offset = 0;      /// 规划得到的偏移量，以元素为单位
+};
+
+// 按大小从大到小的贪心区间着色：依次为每个块在存活区间重叠的已分配块之间寻找最合适的空隙
+// offset按alignment对齐，返回内存池需要的总大小
+size_t plan_memory_blocks(std::vector<MemoryBlock> &blocks, size_t alignment = 16);
+
+// 由conflict(i, j)判断第i块和第j块是否同时存活，用于算子并行执行时存活关系不能用区间表示的情况
+// first_use和last_use只用于决定放置顺序
+size_t plan_memory_blocks(std::vector<MemoryBlock> &blocks,
+                          const std::function<bool(uint32_t, uint32_t)> &conflict,
+                          size_t alignment = 16);
+
+#endif //INFERFRAMEWORK_MEMORYPLANNER_HPP
@@ -0,0 +1,37 @@
+//
+// Created by xyzzzh on 2024/5/5.
+//
+
+#ifndef INFERFRAMEWORK_MODELFORMAT_HPP
+#define INFERFRAMEWORK_MODELFORMAT_HPP
+
+#include "Common.hpp"
+#include "runtime/RuntimeOperator.hpp"
+#include "runtime/ExecutionStep.hpp"
+
+// 原生模型格式依次由文件头、算子表、参数等定长记录以及按64字节对齐的权重块组成，整数按本机字节序存储
+// 文件中保存的是build之后(计算图优化之后)的算子，带参数的层的权重按计算时的布局保存
+// 加载时只映射一次文件，按记录中的偏移读取，不需要解析文本，创建层时权重只需连续拷贝
+
+// 原生格式的版本号，格式变化时递增，版本不同的文件不能加载
+constexpr uint32_t kNativeModelVersion = 1;
+
+// 可以与模型一起保存的build结果，加载后跳过拓扑排序和内存规划
+struct NativeBuildPlan {
+    std::vector<uint32_t> topo_order;                    /// 拓扑序中每个算子在算子数组中的位置
+    std::shared_ptr<const ExecutionPlan> execution_plan; /// 模型中记录的输入形状对应的执行计划
+};
+
+// 判断文件是否为原生格式的模型
+bool is_native_model(const std::string &path);
+
+// 把已经创建层的算子保存为原生格式，输入输出操作数只保存形状，plan不为空时一起保存build结果
+bool save_native_model(const std::vector<std::shared_ptr<RuntimeOperator>> &operators, const std::string &path,
+                       const NativeBuildPlan *plan = nullptr);
+
+// 映射原生格式的模型并创建运行时算子，属性引用映射中的权重数据，输出操作数只记录形状
+// plan不为空时读取保存的build结果，文件中没有时plan保持为空
+bool load_native_model(const std::string &path, std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                       NativeBuildPlan *plan = nullptr);
+
+#endif //INFERFRAMEWORK_MODELFORMAT_HPP
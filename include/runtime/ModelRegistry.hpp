@@ -0,0 +1,138 @@
+//
+// Created by xyzzzh on 2024/5/7.
+//
+
+#ifndef INFERFRAMEWORK_MODELREGISTRY_HPP
+#define INFERFRAMEWORK_MODELREGISTRY_HPP
+
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include "runtime/RuntimeGraph.hpp"
+#include "runtime/ThreadPool.hpp"
+
+// 模型的一个版本，计算图build之后只读，层和权重在所有实例之间共享
+// forward期间持有当前版本，重新加载后旧版本在最后一个使用者释放时回收
+struct ModelVersion {
+    uint64_t version = 0;   /// 版本号，从1开始，每次重新加载递增
+    std::string key;        /// 由模型内容和build选项决定的键
+    std::string param_path; /// 计算图的结构文件路径
+    std::string bin_path;   /// 计算图的权重文件路径
+    std::shared_ptr<const RuntimeGraph> graph; /// build完成的计算图
+
+    // 被新版本替换之后由重新加载的线程设置，旧版本的计算图释放之后调用
+    mutable std::function<void()> on_drained;
+
+    ~ModelVersion();
+};
+
+// 注册表中的一个模型，重新加载时只替换当前版本，已经分发的实例在下一次forward时使用新版本
+struct RegisteredModel {
+    std::string input_name;      /// build时的输入节点名称，重新加载时使用相同的选项
+    std::string output_name;     /// build时的输出节点名称
+    uint32_t max_batch_size = 0; /// build时的最大batch大小
+    std::shared_ptr<const ModelVersion> current; /// 当前版本，ready就绪之后通过std::atomic_load读取
+    std::shared_future<void> ready;               /// 第一个获取模型的线程build完成时就绪
+};
+
+// 一次重新加载的结果，旧版本上的forward全部结束并释放之后才得到
+struct ReloadResult {
+    bool success = false;  /// 新版本是否加载成功并已经替换旧版本
+    uint64_t version = 0;  /// 重新加载之后的版本号
+    std::string key;       /// 新版本的键
+    double build_ms = 0.;  /// 在后台加载和build新版本的时间，以毫秒为单位
+    double swap_us = 0.;   /// 替换当前版本的时间，以微秒为单位
+    double drain_ms = 0.;  /// 替换之后等待旧版本上的forward结束并释放的时间，以毫秒为单位
+};
+
+// 注册表分发的模型实例，与同一模型的其他实例共享计算图，激活内存属于实例自己的执行上下文
+class ModelInstance {
+public:
+    // 使用实例自己的执行上下文在模型的当前版本上进行前向传播，不能在多个线程中同时调用同一个实例。
+    // 返回的输出张量属于该实例，下一次forward时会被覆盖。模型重新加载之后为新版本创建执行上下文。
+    std::vector<std::shared_ptr<Tensor>> forward(const std::vector<std::shared_ptr<Tensor>> &inputs);
+
+    // 获取当前版本共享的计算图，持有期间该版本不会被释放。
+    std::shared_ptr<const RuntimeGraph> graph() const;
+
+    // 获取当前版本在注册表中的键。
+    std::string key() const;
+
+    // 获取当前版本的版本号。
+    uint64_t version() const;
+
+    // 获取实例自己的激活内存大小，以字节为单位。
+    size_t activation_memory_size() const;
+
+private:
+    friend class ModelRegistry;
+
+    explicit ModelInstance(std::shared_ptr<const RegisteredModel> model);
+
+    std::shared_ptr<const RegisteredModel> m_model; // 实例存在期间模型不会被释放，版本只在forward期间持有
+    uint64_t m_version = 0;                         // 执行上下文所属的版本
+    std::shared_ptr<ExecutionContext> m_context;    // 实例自己的激活内存和输入输出张量
+};
+
+// 进程内的模型注册表，按模型文件的内容和build选项合并相同的模型
+// 相同的模型只加载和build一次，所有实例共享只读的层和权重，卸载之后已经分发的实例仍然可以使用
+class ModelRegistry {
+public:
+    ModelRegistry() = default;
+
+    ModelRegistry(const ModelRegistry &) = delete;
+
+    ModelRegistry &operator=(const ModelRegistry &) = delete;
+
+    // 获取进程内共享的注册表。
+    static ModelRegistry &global();
+
+    // 获取模型的一个实例，注册表中没有相同的模型时加载并build，其他线程同时获取时等待build完成。
+    // param_path为空时bin_path为原生格式的模型，文件无法读取时返回空指针。
+    std::shared_ptr<ModelInstance> acquire(const std::string &param_path, const std::string &bin_path,
+                                           const std::string &input_name, const std::string &output_name,
+                                           uint32_t max_batch_size = 0);
+
+    // 在后台加载并build模型的新版本，使用与原来相同的build选项，完成后原子地替换当前版本。
+    // 替换期间forward不会停顿：已经开始的forward继续使用旧版本，之后的forward使用新版本，
+    // 旧版本在最后一个使用者释放后回收，此时返回的future得到本次重新加载的结果和耗时。
+    // 模型之后按新版本的键索引，key不在注册表中或者新版本加载失败时结果的success为false。
+    std::future<ReloadResult> reload(const std::string &key, const std::string &param_path,
+                                     const std::string &bin_path);
+
+    // 从注册表中移除模型，之后再获取时重新加载；已经分发的实例在释放之前仍然持有原来的计算图。
+    bool unload(const std::string &key);
+
+    // 移除没有实例在使用的模型，返回移除的数量。
+    uint32_t unload_unused();
+
+    // 获取注册表中的模型数量。
+    uint32_t model_count() const;
+
+    // 获取模型正在使用的实例数量，模型不在注册表中时返回0。
+    uint32_t references(const std::string &key) const;
+
+private:
+    // 文件的大小和修改时间没有变化时复用上一次计算的键，不再重新读取文件内容
+    struct FileStamp {
+        std::vector<std::pair<uintmax_t, int64_t>> files;
+        std::string key;
+    };
+
+    // 计算模型的键，文件无法读取时返回空字符串。
+    std::string model_key(const std::string &param_path, const std::string &bin_path,
+                          const std::string &options);
+
+    // 在重新加载的线程中build新版本并替换模型的当前版本。
+    void reload_model(const std::shared_ptr<RegisteredModel> &model, const std::string &param_path,
+                      const std::string &bin_path, const std::shared_ptr<std::promise<ReloadResult>> &promise);
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<RegisteredModel>> m_models; // 按键索引的模型
+    std::unordered_map<std::string, FileStamp> m_file_stamps;                   // 按规范路径和选项缓存的键
+
+    // 重新加载使用的后台线程，最后声明以保证析构时先等待重新加载完成
+    std::unique_ptr<ThreadPool> m_reload_pool;
+};
+
+#endif //INFERFRAMEWORK_MODELREGISTRY_HPP
@@ -0,0 +1,98 @@
+//
+// Created by xyzzzh on 2024/5/1.
+//
+
+#ifndef INFERFRAMEWORK_PIPELINEEXECUTOR_HPP
+#define INFERFRAMEWORK_PIPELINEEXECUTOR_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "runtime/RuntimeGraph.hpp"
+#include "runtime/SPSCQueue.hpp"
+
+// 流水线执行的配置
+struct PipelineConfig {
+    uint32_t num_stages = 2;     /// 流水线的段数，超过步骤数量时按步骤数量
+    uint32_t queue_capacity = 2; /// 相邻两段之间队列的容量
+    uint32_t profile_rounds = 3; /// 构造时测量每个步骤耗时的forward次数
+    std::vector<std::vector<uint32_t>> core_groups; /// 每段绑定的CPU核，为空时不绑定
+};
+
+// 按拓扑序把执行步骤分成耗时接近的若干段，每段在自己的线程中执行
+// 连续的输入依次流过各段，相邻两段之间通过单生产者单消费者的无锁队列传递
+// 每个在流水线中的输入使用自己的执行上下文，执行完毕后上下文回到空闲队列
+// push和pop分别只能在一个线程中调用，pop按push的顺序返回结果
+class PipelineExecutor {
+public:
+    // graph需要已经build，并且在流水线析构之前保持有效
+    // sample_inputs用于测量每个步骤的耗时，形状与之后的输入相同时分段最均衡
+    PipelineExecutor(const RuntimeGraph &graph, const PipelineConfig &config,
+                     const std::vector<std::shared_ptr<Tensor>> &sample_inputs);
+
+    // 停止所有段的线程，流水线中尚未取出的结果被丢弃
+    ~PipelineExecutor();
+
+    PipelineExecutor(const PipelineExecutor &) = delete;
+
+    PipelineExecutor &operator=(const PipelineExecutor &) = delete;
+
+    // 把一组输入送入流水线，没有空闲的执行上下文时等待
+    void push(const std::vector<std::shared_ptr<Tensor>> &inputs);
+
+    // 取出最早送入的输入的结果，结果尚未完成时等待
+    std::vector<std::shared_ptr<Tensor>> pop();
+
+    // 流水线的段数
+    uint32_t stage_count() const;
+
+    // 每段在拓扑序中的步骤范围[first, second)
+    const std::vector<std::pair<uint32_t, uint32_t>> &stage_ranges() const;
+
+    // 每段测量得到的耗时，以微秒为单位
+    const std::vector<double> &stage_costs() const;
+
+private:
+    struct Item {
+        std::shared_ptr<ExecutionContext> context;
+        std::vector<std::shared_ptr<Tensor>> inputs;
+    };
+
+    // 多次执行sample_inputs，统计每个步骤的平均耗时
+    std::vector<double> profile(const std::vector<std::shared_ptr<Tensor>> &sample_inputs) const;
+
+    // 把步骤分成连续的若干段，使耗时最大的一段尽量小
+    void partition(const std::vector<double> &step_costs);
+
+    void stage_loop(uint32_t stage);
+
+    // 反复尝试func直到成功，先自旋，再让出CPU，仍然没有进展时阻塞到任意队列发生变化，停止时返回false
+    // func成功后唤醒阻塞中的线程
+    template<typename Func>
+    bool wait_for(Func func);
+
+    // 队列发生变化后递增序号，有线程阻塞时唤醒它们
+    void notify_waiters();
+
+    const RuntimeGraph &m_graph;
+    PipelineConfig m_config;
+    std::vector<std::pair<uint32_t, uint32_t>> m_stage_ranges;
+    std::vector<double> m_stage_costs;
+
+    // 第0个为输入队列，第i个为第i-1段到第i段的队列，最后一个为输出队列
+    std::vector<std::unique_ptr<SPSCQueue<Item>>> m_queues;
+    // pop的线程归还、push的线程取出的空闲上下文
+    std::unique_ptr<SPSCQueue<std::shared_ptr<ExecutionContext>>> m_free_contexts;
+
+    std::atomic<bool> m_stop{false};
+    std::vector<std::thread> m_threads;
+
+    // 空闲的段和等待结果的调用者阻塞在条件变量上，避免一直占用CPU核
+    std::mutex m_wait_mutex;
+    std::condition_variable m_wait_condition;
+    std::atomic<uint64_t> m_sequence{0}; // 每次推入或者取出队列后递增
+    std::atomic<uint32_t> m_waiters{0};  // 阻塞中的线程数量，为0时推入和取出不需要加锁通知
+};
+
+#endif //INFERFRAMEWORK_PIPELINEEXECUTOR_HPP
@@ -0,0 +1,23 @@
+//
+// Created by xyzzzh on 2024/5/6.
+//
+
+#ifndef INFERFRAMEWORK_PLANCACHE_HPP
+#define INFERFRAMEWORK_PLANCACHE_HPP
+
+#include "Common.hpp"
+
+// build的结果以原生格式保存在缓存目录中，文件名由模型内容、运行时版本、CPU特性和build选项决定
+// 再次启动时如果找到对应的文件，直接加载已经优化的算子、拓扑序和激活内存的规划，不再解析pnnx模型
+
+// 运行时的版本，层的权重布局、计算图优化或者内存规划的方式变化时递增，使旧的缓存失效
+constexpr uint32_t kRuntimeVersion = 1;
+
+// 获取当前CPU支持的、会影响计算结果或者权重布局的指令集特性
+std::string cpu_features();
+
+// 计算结构文件和权重文件内容的哈希，连同运行时版本、CPU特性和build选项生成缓存的键
+// options描述影响build结果的选项，param_path为空时只计算权重文件(原生格式的模型)，文件无法读取时返回空字符串
+std::string plan_cache_key(const std::string &param_path, const std::string &bin_path, const std::string &options);
+
+#endif //INFERFRAMEWORK_PLANCACHE_HPP
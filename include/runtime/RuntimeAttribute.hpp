@@ -5,25 +5,62 @@
 #ifndef INFERFRAMEWORK_RUNTIMEATTRIBUTE_HPP
 #define INFERFRAMEWORK_RUNTIMEATTRIBUTE_HPP
 
+#include <cstring>
 #include "Common.hpp"
 
+// 权重数据的只读视图，数据可能直接位于映射的模型文件中，起始地址不保证按元素类型对齐。
+struct WeightSpan {
+    const char *data = nullptr; /// 权重数据的起始地址
+    size_t size = 0;            /// 权重数据的字节数
+    bool packed = false;        /// 数据已经是层计算时的布局，每个张量按列主序依次排列
+
+    bool empty() const { return this->data == nullptr || this->size == 0; }
+
+    // 按类型T解释时的元素数量
+    template<typename T>
+    size_t count() const { return this->size / sizeof(T); }
+
+    // 读取第index个类型为T的元素，逐个拷贝以避免未对齐的访问
+    template<typename T>
+    T at(size_t index) const {
+        T value;
+        std::memcpy(&value, this->data + index * sizeof(T), sizeof(T));
+        return value;
+    }
+};
+
 // 计算图节点的属性信息结构体。
 struct RuntimeAttribute {
-    // 节点中的权重参数，以char形式存储。
+    // 节点自己持有的权重参数，以char形式存储，常量折叠等运行时生成的属性使用。
     std::vector<char> m_weight_data;
 
+    // 引用的模型文件映射，m_mapped_data指向其中的权重数据，不为空时不再拷贝到m_weight_data。
+    std::shared_ptr<const char> m_mapping;
+    const char *m_mapped_data = nullptr;
+    size_t m_mapped_size = 0;
+    bool m_packed = false; /// 映射的数据已经是层计算时的布局(来自原生格式的模型)
+
     // 节点的形状信息，存储为一个无符号整数向量。
     std::vector<uint32_t> m_shapes;
 
     // 节点中的数据类型，使用枚举ERuntimeDataType表示，默认为ERDT_Unknown。
     ERuntimeDataType m_type = ERuntimeDataType::ERDT_Unknown;
 
+    // 获取权重数据的只读视图，优先使用映射的数据，层可以从视图直接写入最终的执行布局。
+    WeightSpan weight_span() const {
+        if (this->m_mapped_data != nullptr) {
+            return WeightSpan{this->m_mapped_data, this->m_mapped_size, this->m_packed};
+        }
+        return WeightSpan{this->m_weight_data.data(), this->m_weight_data.size()};
+    }
+
     // 从节点的权重数据中提取权重，并将其转换为指定的数据类型T的向量。
     // 如果need_clear_weight为true，则在提取权重数据后清除原始的权重数据。
     template<typename T>
     std::vector<T> get_weight_data(bool need_clear_weight = true) {
+        const WeightSpan span = this->weight_span();
         // 确保权重数据不为空。
-        CHECK(!this->m_weight_data.empty());
+        CHECK(!span.empty());
 
         // 确保数据类型不是未知的。
         CHECK(this->m_type != ERuntimeDataType::ERDT_Unknown);
@@ -38,14 +75,11 @@ struct RuntimeAttribute {
                 CHECK(is_float);
 
                 // 确保权重数据大小能整除float的大小。
-                const uint32_t float_size = sizeof(float);
-                const uint32_t weight_size = this->m_weight_data.size();
-                CHECK(weight_size % float_size == 0);
-
-                // 将权重数据从char数组转换为float数组。
-                auto *start_ptr = reinterpret_cast<const float *>(this->m_weight_data.data());
-                auto *end_ptr = start_ptr + weight_size / float_size;
-                weight.insert(weight.end(), start_ptr, end_ptr);
+                CHECK(span.size % sizeof(float) == 0);
+
+                // 映射的数据不保证对齐，按字节拷贝到float数组中。
+                weight.resize(span.count<T>());
+                std::memcpy(weight.data(), span.data, span.size);
                 break;
             }
             default: { // 如果数据类型未知。
@@ -60,11 +94,15 @@ struct RuntimeAttribute {
         return weight;
     }
 
-    // 清除权重数据。
+    // 清除权重数据，同时释放对模型文件映射的引用。
     void clear_weight() {
         if (!this->m_weight_data.empty()) {
             m_weight_data.clear();
         }
+        this->m_mapping.reset();
+        this->m_mapped_data = nullptr;
+        this->m_mapped_size = 0;
+        this->m_packed = false;
     }
 };
 
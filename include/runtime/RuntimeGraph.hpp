@@ -5,18 +5,43 @@
 #ifndef INFERFRAMEWORK_RUNTIMEGRAPH_HPP
 #define INFERFRAMEWORK_RUNTIMEGRAPH_HPP
 
+#include <condition_variable>
+#include <future>
+#include <mutex>
 #include "Common.hpp"
 #include "Utils.hpp"
 #include "runtime/RuntimeOperator.hpp"
 #include "runtime/RuntimeOperand.hpp"
 #include "runtime/RuntimeAttribute.hpp"
 #include "runtime/RuntimeParameter.hpp"
+#include "runtime/ThreadPool.hpp"
+#include "runtime/ExecutionStep.hpp"
+#include "runtime/ExecutionContext.hpp"
+#include "runtime/CancellationToken.hpp"
+#include "runtime/GraphOptimizer.hpp"
+#include "runtime/ModelFormat.hpp"
+
+// 异步forward完成时的回调，取消时status为EIS_InferCancelled，outputs为空
+using ForwardCallback = std::function<void(EInferStatus status, std::vector<std::shared_ptr<Tensor>> outputs)>;
+
+// 异步forward的结果，status不为EIS_InferSuccess时outputs为空
+struct ForwardResult {
+    EInferStatus status = EInferStatus::EIS_InferCancelled;
+    std::vector<std::shared_ptr<Tensor>> outputs;
+};
 
 class RuntimeGraph {
+    // 流水线按拓扑序把步骤分段，在不同的线程中执行各段
+    friend class PipelineExecutor;
+
 public:
     // 使用指定的结构文件和权重文件初始化计算图。
+    // 权重文件为原生格式的模型(见ModelFormat.hpp)时不需要结构文件，param_path可以为空。
     RuntimeGraph(std::string param_path, std::string bin_path);
 
+    // 等待所有异步forward执行完毕。
+    ~RuntimeGraph();
+
     // 根据输入和输出节点的名称构建计算图。
     void build(const std::string &input_name, const std::string &output_name);
 
@@ -35,21 +60,112 @@ public:
     // 获取计算图的当前状态。
     const EGraphState &state() const;
 
-    // 初始化计算图，加载结构和权重文件。
+    // 设置算子间并行执行使用的线程数，需要在build之前调用。小于等于1时按拓扑序串行执行。
+    void set_num_threads(uint32_t num_threads);
+
+    // 获取算子间并行执行使用的线程数。
+    uint32_t num_threads() const;
+
+    // 设置forward能接受的最大batch大小，需要在build之前调用。
+    // 为0时使用模型中记录的batch大小；大于0时激活内存按最大batch分配，forward可以接受1到最大值之间的任意batch。
+    void set_max_batch_size(uint32_t max_batch_size);
+
+    // 获取forward能接受的最大batch大小。
+    uint32_t max_batch_size() const;
+
+    // 设置build时是否在创建层之前优化计算图，默认开启。需要在build之前调用。
+    // 优化包括常量折叠、删除不能到达输出的算子以及合并相同的算子。
+    void set_graph_optimization(bool enabled);
+
+    // 获取build时是否优化计算图。
+    bool graph_optimization() const;
+
+    // 获取build时计算图优化的统计。
+    const GraphOptimizeStats &optimize_stats() const;
+
+    // 设置init和build时并行创建运行时算子和层使用的线程数，为0时使用硬件线程数，为1时串行加载。
+    // 每个算子的结果写入自己的位置，加载结果与线程数无关。
+    void set_load_threads(uint32_t load_threads);
+
+    // 获取加载模型使用的线程数。
+    uint32_t load_threads() const;
+
+    // 设置是否延迟加载权重，默认关闭，需要在build之前调用。
+    // 开启时build只创建层并记录权重所在的属性，每个层在第一次forward执行到时才分配存储并把权重写入计算时的布局，
+    // 启动时间和常驻内存只与实际执行到的层有关，模型文件中没有执行到的权重不会被读取。
+    void set_lazy_weights(bool lazy_weights);
+
+    // 获取是否延迟加载权重。
+    bool lazy_weights() const;
+
+    // 设置延迟加载时预读的层数，默认为2。某个层写入权重时，提示操作系统在后台读取拓扑序中之后
+    // 尚未写入的prefetch_layers个层的权重，为0时不预读。
+    void set_weight_prefetch(uint32_t prefetch_layers);
+
+    // 获取延迟加载时预读的层数。
+    uint32_t weight_prefetch() const;
+
+    // 设置build结果的缓存目录，为空时不使用缓存，需要在build之前调用。
+    // build时按模型内容、运行时版本、CPU特性和build选项查找缓存，找到时直接加载优化后的算子、拓扑序和内存规划，
+    // 没有找到时正常构建，完成后把结果写入缓存目录。
+    void set_plan_cache_dir(const std::string &plan_cache_dir);
+
+    // 获取build结果的缓存目录。
+    const std::string &plan_cache_dir() const;
+
+    // 获取最近一次build是否从缓存中加载。
+    bool plan_cache_hit() const;
+
+    // 初始化计算图，加载结构和权重文件，或者加载原生格式的模型。
     bool init();
 
+    // 将build之后的计算图保存为原生格式的模型，带参数的层按计算时的布局保存权重，延迟加载的权重先全部写入。
+    bool export_model(const std::string &path) const;
+
     // 获取计算图中的所有操作符节点。
     const std::vector<std::shared_ptr<RuntimeOperator>> &operators() const;
 
     // 获取计算图中经过拓扑排序的操作符队列。
     const std::vector<std::shared_ptr<RuntimeOperator>> &get_topo_queues() const;
 
+    // 获取内存规划后激活内存池的大小，以字节为单位。
+    size_t activation_memory_size() const;
+
+    // 获取已经缓存的执行计划数量，每种输入形状对应一个执行计划。
+    uint32_t cached_plan_count() const;
+
     // 根据计算图中的操作节点创建相应的Layer。
     static std::shared_ptr<Layer> create_layer(const std::shared_ptr<RuntimeOperator> &op);
 
-    // 对计算图进行前向传播，返回输出Tensor。
+    // 对计算图进行前向传播，返回输出Tensor。使用计算图内部的上下文，不能在多个线程中同时调用。
+    // 输入的形状可以与模型中记录的不同，形状变化时根据各层推导的输出形状重新规划激活内存。
     std::vector<std::shared_ptr<Tensor>> forward(const std::vector<std::shared_ptr<Tensor>> &inputs, bool debug);
 
+    // 创建一个新的执行上下文，拥有独立的激活内存，层和权重与计算图共享。
+    std::shared_ptr<ExecutionContext> create_context() const;
+
+    // 使用指定的执行上下文进行前向传播。不同线程使用不同的上下文时可以同时调用。
+    // 返回的输出张量属于该上下文，下一次使用同一个上下文forward时会被覆盖。
+    std::vector<std::shared_ptr<Tensor>> forward(ExecutionContext &context,
+                                                 const std::vector<std::shared_ptr<Tensor>> &inputs) const;
+
+    // 在请求线程池中异步执行forward，返回的future在执行完毕后得到状态和输出的副本，被取消时状态为EIS_InferCancelled。
+    // 等待中的请求达到上限时阻塞调用者，直到有请求执行完毕。
+    std::future<ForwardResult> forward_async(
+            const std::vector<std::shared_ptr<Tensor>> &inputs,
+            const std::shared_ptr<CancellationToken> &token = nullptr);
+
+    // 在请求线程池中异步执行forward，执行完毕或者被取消后在请求线程中调用callback。
+    // 调用callback之前请求已经释放占用的名额，callback中可以再次提交请求。
+    void forward_async(const std::vector<std::shared_ptr<Tensor>> &inputs, ForwardCallback callback,
+                       const std::shared_ptr<CancellationToken> &token = nullptr);
+
+    // 设置异步forward中提交后尚未完成的最大请求数量，为0时不限制。
+    void set_max_pending_requests(uint32_t max_pending_requests);
+
+    // 获取异步forward中提交后尚未得到结果的请求数量，开始调用callback时即不再计入。
+    uint32_t pending_requests() const;
+
 private:
     // 初始化计算图节点中的输入操作数。
     static void init_graph_operators_input(
@@ -71,13 +187,83 @@ private:
     init_graph_params(const std::map<std::string, pnnx::Parameter> &params,
                       const std::shared_ptr<RuntimeOperator> &runtime_operator);
 
+    // 加载原生格式的模型，算子已经是优化之后的结果。
+    bool init_native();
+
+    // 使用加载的原生格式算子替换计算图中的算子。
+    void set_native_operators(std::vector<std::shared_ptr<RuntimeOperator>> operators);
+
+    // 获取当前模型和build选项对应的缓存文件路径，不使用缓存时返回空字符串。
+    std::string plan_cache_path(const std::string &input_name, const std::string &output_name) const;
+
+    // 从缓存文件中加载优化后的算子和build结果，缓存不存在或者损坏时返回false。
+    bool init_from_plan_cache();
+
+    // 把build之后的算子、拓扑序和执行计划写入缓存文件。
+    void save_plan_cache() const;
+
+    // 根据pnnx中的节点创建运行时算子，初始化输入输出、属性和参数。
+    static std::shared_ptr<RuntimeOperator> create_operator(const pnnx::Operator *op);
+
+    // 使用加载线程对[0, count)中的每个下标调用func。
+    void parallel_load(uint32_t count, const std::function<void(uint32_t)> &func) const;
+
+    // 在创建层之前优化计算图，并更新操作节点的映射表。
+    void optimize_operators(const std::string &output_name);
+
+    // 将填充算子折叠到唯一的后继层中，使填充只作为元数据存在。
+    void fold_padding_operators();
+
+    // 为支持原地计算的算子选择一个没有其他使用者的输入，使输出直接复用该输入的存储。
+    void inplace_operators();
+
+    // 根据每个步骤的输出形状规划激活内存，为存活区间不重叠的输出分配内存池中的同一段内存。
+    std::shared_ptr<ExecutionPlan> plan_memory(const std::vector<std::vector<uint32_t>> &shapes) const;
+
+    // 从计算图的输入形状开始按拓扑序推导每个步骤的输出形状。
+    void infer_shapes(const std::vector<uint32_t> &input_shapes, std::vector<std::vector<uint32_t>> &shapes) const;
+
+    // 获取输入形状对应的执行计划，缓存中没有时推导形状并重新规划内存。
+    std::shared_ptr<const ExecutionPlan> get_plan(const std::vector<uint32_t> &input_shapes) const;
+
+    // 按执行计划为上下文创建输出张量，内存池容量不足时重新分配。
+    void allocate_context(ExecutionContext &context, const std::shared_ptr<const ExecutionPlan> &plan) const;
+
+    // 获取输入张量对应的单个batch的输入形状，维度数与模型中记录的输入形状相同。
+    std::vector<uint32_t> input_shapes(const std::vector<std::shared_ptr<Tensor>> &inputs) const;
+
+    // 根据拓扑序记录每个算子的前驱数量和后继算子，供并行执行时按依赖计数调度。
+    void build_dependencies();
+
+    // 将拓扑序中的算子展开为执行步骤，预先解析每个步骤的输入、输出和后继位置。
+    void build_execution_plan();
+
+    // 按输入的形状和batch大小准备上下文中的张量，形状或batch变化时重新创建或绑定。
+    void prepare_context(ExecutionContext &context, const std::vector<std::shared_ptr<Tensor>> &inputs) const;
+
+    // 获取上下文中计算图的最终输出。
+    const std::vector<std::shared_ptr<Tensor>> &context_outputs(const ExecutionContext &context) const;
+
+    // 把上下文中每个步骤的输入输出绑定为前batch_size个张量。
+    void bind_context(ExecutionContext &context, uint32_t batch_size) const;
+
+    // 写入第index个步骤延迟加载的权重，并预读拓扑序中之后几个层的权重。
+    void materialize_step(uint32_t index) const;
+
+    // 在上下文中执行第index个步骤，并将输出写入后继步骤的输入。
+    void execute_step(ExecutionContext &context, uint32_t index,
+                      const std::vector<std::shared_ptr<Tensor>> &inputs) const;
+
+    // 前驱全部完成的算子提交到线程池中执行，直到所有算子执行完毕。
+    void forward_parallel(ExecutionContext &context, const std::vector<std::shared_ptr<Tensor>> &inputs) const;
+
+    // 执行一个异步forward请求，使用空闲的执行上下文。
+    void run_async(const std::vector<std::shared_ptr<Tensor>> &inputs, const ForwardCallback &callback,
+                   const CancellationToken *token);
+
     // 对计算图进行拓扑排序。
     void ReverseTopo(const std::shared_ptr<RuntimeOperator> &root_op);
 
-    // 探查并处理下一层的计算节点。
-    static void probe_next_layer(const std::shared_ptr<RuntimeOperator> &current_op,
-                                 const std::vector<std::shared_ptr<Tensor>> &layer_output_data);
-
     // 成员变量
     std::string m_input_name;  // 计算图输入节点的名称。
     std::string m_output_name; // 计算图输出节点的名称。
@@ -90,7 +276,46 @@ private:
 
     std::unique_ptr<pnnx::Graph> m_graph; // 使用pnnx库的Graph对象来管理计算图。
 
+    std::shared_ptr<float> m_arena; // 算子输出共享的激活内存池，按模型中记录的形状规划。
+    std::shared_ptr<ExecutionContext> m_context; // forward(inputs, debug)使用的上下文。
+
+    std::shared_ptr<const ExecutionPlan> m_plan; // 模型中记录的输入形状对应的执行计划。
+    mutable std::mutex m_plan_mutex;             // 保护执行计划的缓存。
+    mutable std::map<std::vector<uint32_t>, std::shared_ptr<const ExecutionPlan>> m_plans; // 按输入形状缓存的执行计划。
+
+    std::vector<ExecutionStep> m_steps; // 按拓扑序排列的执行步骤。
+    int32_t m_output_step = -1;         // 计算图输出所在的步骤。
+
+    uint32_t m_max_batch_size = 0;      // forward能接受的最大batch大小。
+
+    bool m_graph_optimization = true;     // build时是否优化计算图。
+    bool m_operators_optimized = false;   // 算子已经是优化之后的结果(原生格式的模型)，build时不再优化。
+    GraphOptimizeStats m_optimize_stats;  // build时计算图优化的统计。
+
+    std::string m_plan_cache_dir;   // build结果的缓存目录，为空时不使用缓存。
+    std::string m_plan_cache_path;  // 当前模型和build选项对应的缓存文件。
+    bool m_plan_cache_hit = false;  // 最近一次build是否从缓存中加载。
+    NativeBuildPlan m_cached_plan;  // 缓存中的拓扑序和执行计划，build之后清空。
+
+    bool m_lazy_weights = false;    // 是否在第一次forward时才加载每个层的权重。
+    uint32_t m_weight_prefetch = 2; // 延迟加载时预读之后几个层的权重。
+
+    uint32_t m_load_threads = 0;                          // 加载模型时使用的线程数，为0时使用硬件线程数。
+    uint32_t m_num_threads = 1;                           // 算子间并行执行使用的线程数。
+    std::unique_ptr<ThreadPool> m_thread_pool;            // 算子间并行执行的线程池。
+    std::vector<uint32_t> m_predecessor_counts;           // 拓扑序中每个算子的前驱数量。
+    std::vector<std::vector<uint32_t>> m_successors;      // 拓扑序中每个算子的后继算子在拓扑序中的位置。
+
     EGraphState m_state = EGraphState::EGS_NeedInit; // 计算图的当前状态。
+
+    mutable std::mutex m_async_mutex;              // 保护异步forward的状态。
+    std::condition_variable m_async_condition;     // 请求完成时通知等待提交或者析构的线程。
+    uint32_t m_max_pending_requests = 0;           // 尚未得到结果的最大请求数量，为0时不限制。
+    uint32_t m_pending_requests = 0;               // 提交后尚未得到结果的请求数量，调用回调之前释放。
+    uint32_t m_running_requests = 0;               // 提交后run_async尚未返回的请求数量，析构时等待其归零。
+    // 执行整个异步请求的线程池，与只执行算子任务的m_thread_pool分开，请求之间不会互相嵌套。
+    std::unique_ptr<ThreadPool> m_async_pool;
+    std::vector<std::shared_ptr<ExecutionContext>> m_free_contexts; // 异步forward中空闲的执行上下文。
 };
 
 #endif //INFERFRAMEWORK_RUNTIMEGRAPH_HPP
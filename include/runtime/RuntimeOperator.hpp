@@ -16,6 +16,7 @@ class Layer;
 struct RuntimeOperator {
 
     bool m_has_forward = false;
+    bool m_lazy_weights = false;  /// 创建层时只记录权重所在的属性，第一次forward时再加载
     std::string m_name;      /// 计算节点的名称
     std::string m_type;      /// 计算节点的类型
     std::shared_ptr<Layer> m_layer;  /// 节点对应的计算Layer
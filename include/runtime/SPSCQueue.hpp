@@ -0,0 +1,63 @@
+//
+// Created by xyzzzh on 2024/5/1.
+//
+
+#ifndef INFERFRAMEWORK_SPSCQUEUE_HPP
+#define INFERFRAMEWORK_SPSCQUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// 单生产者单消费者的无锁环形队列，只能有一个线程调用try_push，一个线程调用try_pop
+// 生产者写入元素后以release语义发布尾指针，消费者以acquire语义读取，元素的内容对消费者可见
+template<typename T>
+class SPSCQueue {
+public:
+    explicit SPSCQueue(size_t capacity) : m_buffer(capacity + 1) {}
+
+    SPSCQueue(const SPSCQueue &) = delete;
+
+    SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+    // 队列已满时返回false，value保持不变
+    bool try_push(T &value) {
+        const size_t tail = this->m_tail.load(std::memory_order_relaxed);
+        const size_t next = this->next_index(tail);
+        if (next == this->m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        this->m_buffer[tail] = std::move(value);
+        this->m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // 队列为空时返回false
+    bool try_pop(T &value) {
+        const size_t head = this->m_head.load(std::memory_order_relaxed);
+        if (head == this->m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(this->m_buffer[head]);
+        this->m_buffer[head] = T();
+        this->m_head.store(this->next_index(head), std::memory_order_release);
+        return true;
+    }
+
+    // 队列的容量
+    size_t capacity() const {
+        return this->m_buffer.size() - 1;
+    }
+
+private:
+    size_t next_index(size_t index) const {
+        return index + 1 == this->m_buffer.size() ? 0 : index + 1;
+    }
+
+    std::vector<T> m_buffer;
+    // 头尾指针分别只由消费者和生产者写入，放在不同的缓存行中避免伪共享
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+};
+
+#endif //INFERFRAMEWORK_SPSCQUEUE_HPP
@@ -0,0 +1,68 @@
+//
+// Created by xyzzzh on 2024/4/25.
+//
+
+#ifndef INFERFRAMEWORK_THREADPOOL_HPP
+#define INFERFRAMEWORK_THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 工作窃取线程池
+// 每个工作线程有自己的任务队列，工作线程提交的任务放入自己队列的尾部并从尾部取出执行，
+// 自己的队列为空时从其他队列的头部窃取任务；外部线程提交的任务放入共享的注入队列
+class ThreadPool {
+public:
+    // 创建num_threads个工作线程，num_threads为0时使用硬件线程数
+    explicit ThreadPool(uint32_t num_threads = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // 提交一个任务
+    void submit(std::function<void()> task);
+
+    // 调用线程也参与执行任务，直到done返回true
+    // done的状态改变后需要调用notify_all唤醒等待中的线程
+    void run_until(const std::function<bool()> &done);
+
+    // 唤醒所有等待任务的线程
+    void notify_all();
+
+    // 对[0, count)中的每个下标调用一次func，调用线程也参与执行，全部完成后返回
+    // 下标由各线程动态领取，func需要把结果写到下标对应的位置以保证结果与执行顺序无关
+    void parallel_for(uint32_t count, const std::function<void(uint32_t)> &func);
+
+    // 工作线程的数量
+    uint32_t size() const;
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    // 依次尝试当前线程的队列、注入队列和其他线程的队列
+    bool try_get_task(int32_t index, std::function<void()> &task);
+
+    void worker_loop(uint32_t index);
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues; // 前size()个为工作线程的队列，最后一个为注入队列
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::atomic<uint32_t> m_pending{0}; // 尚未被取出的任务数量
+    bool m_stop = false;
+};
+
+#endif //INFERFRAMEWORK_THREADPOOL_HPP
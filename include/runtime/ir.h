@@ -17,6 +17,7 @@
 
 #include <initializer_list>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -160,6 +161,22 @@ public:
     std::vector<int> shape;
 
     std::vector<char> data;
+
+    // attributes loaded from a stored zip reference the mapped archive instead of owning data
+    std::shared_ptr<const char> mapping;
+    const char* mapped_data = 0;
+    size_t mapped_size = 0;
+
+    // weight bytes, either mapped or owned
+    const char* bytes() const
+    {
+        return mapped_data ? mapped_data : data.data();
+    }
+
+    size_t byte_size() const
+    {
+        return mapped_data ? mapped_size : data.size();
+    }
 };
 
 bool operator==(const Attribute& lhs, const Attribute& rhs);
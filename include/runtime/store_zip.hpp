@@ -16,11 +16,38 @@
 #define PNNX_STOREZIP_H
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace pnnx {
 
+// a read-only view of one stored file inside the mapped archive
+struct StoreZipSpan
+{
+  const char* data = 0;
+  size_t size = 0;
+};
+
+// map the whole file read-only, fall back to reading it into memory where mmap is unavailable
+// returns null on failure, the mapping is released with the last reference
+std::shared_ptr<const char> map_file(const std::string& path, size_t& size);
+
+// ask the kernel to start reading the pages of a range inside a mapping in the background
+// returns immediately, a no-op where madvise is unavailable
+void prefetch_mapping(const char* data, size_t size);
+
+// zip compression methods
+enum
+{
+  STORE_ZIP_STORED = 0,
+  STORE_ZIP_DEFLATE = 8,
+  STORE_ZIP_ZSTD = 93
+};
+
+// the whole archive is memory mapped on open, stored files are exposed as spans
+// into the mapping without copying, the mapping is shared with whoever keeps mapping()
+// deflate and zstd entries are decompressed from the mapping straight into the caller's buffer
 class StoreZipReader
 {
  public:
@@ -29,19 +56,37 @@ class StoreZipReader
 
   int open(const std::string& path);
 
+  // uncompressed size of the file
   size_t get_file_size(const std::string& name);
 
-  int read_file(const std::string& name, char* data);
+  // whether the file needs decompression, compressed files have no span
+  bool is_compressed(const std::string& name) const;
+
+  int read_file(const std::string& name, char* data) const;
+
+  // read several files into their buffers, compressed files are decompressed in parallel
+  // num_threads 0 uses the hardware concurrency, returns -1 if any file fails
+  int read_files(const std::vector<std::string>& names, const std::vector<char*>& datas, int num_threads = 0) const;
+
+  // span of the stored file, valid as long as the mapping is alive
+  int get_file_span(const std::string& name, StoreZipSpan& span) const;
+
+  // shared ownership of the mapped archive, keeps the spans valid after close()
+  const std::shared_ptr<const char>& mapping() const;
 
   int close();
 
  private:
-  FILE* fp;
+  std::shared_ptr<const char> mapped;
+  size_t mapped_size;
 
   struct StoreZipMeta
   {
     size_t offset;
     size_t size;
+    size_t compressed_size;
+    uint16_t compression;
+    uint32_t crc32;
   };
 
   std::map<std::string, StoreZipMeta> filemetas;
@@ -55,7 +100,8 @@ class StoreZipWriter
 
   int open(const std::string& path);
 
-  int write_file(const std::string& name, const char* data, size_t size);
+  // compression is STORE_ZIP_STORED or STORE_ZIP_DEFLATE
+  int write_file(const std::string& name, const char* data, size_t size, int compression = STORE_ZIP_STORED);
 
   int close();
 
@@ -68,6 +114,8 @@ class StoreZipWriter
     size_t lfh_offset;
     uint32_t crc32;
     uint32_t size;
+    uint32_t compressed_size;
+    uint16_t compression;
   };
 
   std::vector<StoreZipMeta> filemetas;
@@ -17,8 +17,97 @@ std::shared_ptr<Tensor> tensor_create(uint32_t size) {
 }
 
 std::shared_ptr<Tensor> tensor_create(const std::vector<uint32_t> &shapes) {
-    CHECK_EQ(shapes.size(), 3);
-    return std::make_shared<Tensor>(shapes[0], shapes[1], shapes[2]);
+    CHECK_GE(shapes.size(), 3);
+    if (shapes.size() == 3) {
+        return std::make_shared<Tensor>(shapes[0], shapes[1], shapes[2]);
+    }
+    return std::make_shared<Tensor>(shapes);
+}
+
+std::vector<uint32_t> tensor_broadcast_shapes(const std::vector<uint32_t> &shapes1,
+                                              const std::vector<uint32_t> &shapes2) {
+    CHECK(shapes1.size() == 3 && shapes2.size() == 3);
+    std::vector<uint32_t> shapes(3);
+    for (uint32_t i = 0; i < 3; ++i) {
+        // 每一维要么相等，要么其中一方为1
+        CHECK(shapes1[i] == shapes2[i] || shapes1[i] == 1 || shapes2[i] == 1)
+                        << "Broadcast shape is not adapting: " << shape_str(shapes1) << " and " << shape_str(shapes2);
+        shapes[i] = std::max(shapes1[i], shapes2[i]);
+    }
+    return shapes;
+}
+
+// 张量在广播后形状下的步长，长度为1的维度步长为0
+// 元素(c, r, w)的偏移为 c * channel_stride + w * col_stride + r * row_stride
+struct BroadcastStrides {
+    uint32_t channel_stride = 0;
+    uint32_t col_stride = 0;
+    uint32_t row_stride = 0;
+};
+
+static BroadcastStrides get_broadcast_strides(const Tensor &tensor) {
+    const uint32_t rows = tensor.rows();
+    const uint32_t cols = tensor.cols();
+    BroadcastStrides strides;
+    strides.channel_stride = tensor.channels() == 1 ? 0 : rows * cols;
+    strides.col_stride = cols == 1 ? 0 : rows;
+    strides.row_stride = rows == 1 ? 0 : 1;
+    return strides;
+}
+
+// 按广播规则逐元素计算output = op(tensor1, tensor2)，广播维度按步长0原地读取，不展开成完整张量
+// output的形状必须等于两个输入广播后的形状，output可以与形状相同的输入是同一个张量
+template<typename BinaryOp>
+static void tensor_broadcast_binary(const Tensor &tensor1, const Tensor &tensor2, Tensor &output, BinaryOp op) {
+    const std::vector<uint32_t> &shapes = tensor_broadcast_shapes(tensor1.shapes(), tensor2.shapes());
+    CHECK(output.shapes() == shapes) << "The output shape " << shape_str(output.shapes())
+                                     << " do not match the broadcast shape " << shape_str(shapes);
+
+    const uint32_t channels = shapes[0];
+    const uint32_t rows = shapes[1];
+    const uint32_t cols = shapes[2];
+    const BroadcastStrides strides1 = get_broadcast_strides(tensor1);
+    const BroadcastStrides strides2 = get_broadcast_strides(tensor2);
+
+    const float *input_ptr1 = tensor1.data().memptr();
+    const float *input_ptr2 = tensor2.data().memptr();
+    float *output_ptr = output.data().memptr();
+    for (uint32_t c = 0; c < channels; ++c) {
+        for (uint32_t w = 0; w < cols; ++w) {
+            const float *col_ptr1 = input_ptr1 + c * strides1.channel_stride + w * strides1.col_stride;
+            const float *col_ptr2 = input_ptr2 + c * strides2.channel_stride + w * strides2.col_stride;
+            float *output_col_ptr = output_ptr + (c * cols + w) * rows;
+            // 按行方向的步长分情况展开，使内层循环保持连续访存
+            if (strides1.row_stride == 1 && strides2.row_stride == 1) {
+                for (uint32_t r = 0; r < rows; ++r) {
+                    output_col_ptr[r] = op(col_ptr1[r], col_ptr2[r]);
+                }
+            } else if (strides1.row_stride == 1) {
+                const float value2 = *col_ptr2;
+                for (uint32_t r = 0; r < rows; ++r) {
+                    output_col_ptr[r] = op(col_ptr1[r], value2);
+                }
+            } else if (strides2.row_stride == 1) {
+                const float value1 = *col_ptr1;
+                for (uint32_t r = 0; r < rows; ++r) {
+                    output_col_ptr[r] = op(value1, col_ptr2[r]);
+                }
+            } else {
+                const float value = op(*col_ptr1, *col_ptr2);
+                std::fill(output_col_ptr, output_col_ptr + rows, value);
+            }
+        }
+    }
+}
+
+// 将张量按广播规则展开到shapes
+static std::shared_ptr<Tensor> tensor_expand(const std::shared_ptr<Tensor> &tensor, const std::vector<uint32_t> &shapes) {
+    if (tensor->shapes() == shapes) {
+        return tensor;
+    }
+    std::shared_ptr<Tensor> new_tensor = tensor_create(shapes);
+    tensor_broadcast_binary(*tensor, *new_tensor, *new_tensor, [](float value, float) { return value; });
+    return new_tensor;
 }
 
 std::tuple<std::shared_ptr<Tensor>, std::shared_ptr<Tensor>>
@@ -26,29 +115,9 @@ tensor_broadcast(const std::shared_ptr<Tensor> &tensor1, const std::shared_ptr<T
     CHECK(tensor1 != nullptr && tensor2 != nullptr);
     if (tensor1->shapes() == tensor2->shapes()) {
         return {tensor1, tensor2};
-    } else {
-        CHECK(tensor1->channels() == tensor2->channels());
-        if (tensor2->rows() == 1 && tensor2->cols() == 1) {
-            std::shared_ptr<Tensor> new_tensor =
-                    tensor_create(tensor2->channels(), tensor1->rows(), tensor1->cols());
-            CHECK(tensor2->size() == tensor2->channels());
-            for (uint32_t c = 0; c < tensor2->channels(); ++c) {
-                new_tensor->slice(c).fill(tensor2->index(c));
-            }
-            return {tensor1, new_tensor};
-        } else if (tensor1->rows() == 1 && tensor1->cols() == 1) {
-            std::shared_ptr<Tensor> new_tensor =
-                    tensor_create(tensor1->channels(), tensor2->rows(), tensor2->cols());
-            CHECK(tensor1->size() == tensor1->channels());
-            for (uint32_t c = 0; c < tensor1->channels(); ++c) {
-                new_tensor->slice(c).fill(tensor1->index(c));
-            }
-            return {new_tensor, tensor2};
-        } else {
-            LOG(FATAL) << "Broadcast shape is not adapting!";
-            return {tensor1, tensor2};
-        }
     }
+    const std::vector<uint32_t> &shapes = tensor_broadcast_shapes(tensor1->shapes(), tensor2->shapes());
+    return {tensor_expand(tensor1, shapes), tensor_expand(tensor2, shapes)};
 }
 
 std::shared_ptr<Tensor>
@@ -96,68 +165,31 @@ bool tensor_is_same(const std::shared_ptr<Tensor> &tensor1, const std::shared_pt
 std::shared_ptr<Tensor>
 tensor_add(const std::shared_ptr<Tensor> &tensor1, const std::shared_ptr<Tensor> &tensor2) {
     CHECK(tensor1 != nullptr && tensor2 != nullptr);
-    CHECK(tensor1 != nullptr && tensor2 != nullptr);
-    if (tensor1->shapes() == tensor2->shapes()) {
-        std::shared_ptr<Tensor> output_tensor = tensor_create(tensor1->shapes());
-        output_tensor->set_data(tensor1->data() + tensor2->data());
-        return output_tensor;
-    } else {
-        // broadcast
-        CHECK(tensor1->channels() == tensor2->channels())
-                        << "Tensors shape are not adapting";
-        const auto &[input_tensor1, input_tensor2] =
-                tensor_broadcast(tensor1, tensor2);
-        CHECK(input_tensor1->shapes() == input_tensor2->shapes());
-        std::shared_ptr<Tensor> output_tensor = tensor_create(input_tensor1->shapes());
-        output_tensor->set_data(input_tensor1->data() + input_tensor2->data());
-        return output_tensor;
-    }
+    std::shared_ptr<Tensor> output_tensor =
+            tensor_create(tensor_broadcast_shapes(tensor1->shapes(), tensor2->shapes()));
+    tensor_broadcast_binary(*tensor1, *tensor2, *output_tensor, std::plus<float>());
+    return output_tensor;
 }
 
 void tensor_add(const std::shared_ptr<Tensor> &tensor1, const std::shared_ptr<Tensor> &tensor2,
                 const std::shared_ptr<Tensor> &output_tensor) {
     CHECK(tensor1 != nullptr && tensor2 != nullptr && output_tensor != nullptr);
-    if (tensor1->shapes() == tensor2->shapes()) {
-        output_tensor->set_data(tensor1->data() + tensor2->data());
-    } else {
-        // broadcast
-        CHECK(tensor1->channels() == tensor2->channels()) << "Tensors shape are not adapting";
-        const auto &[input_tensor1, input_tensor2] = tensor_broadcast(tensor1, tensor2);
-        CHECK(input_tensor1->shapes() == input_tensor2->shapes() && output_tensor->shapes() == input_tensor1->shapes());
-        output_tensor->set_data(input_tensor1->data() + input_tensor2->data());
-    }
+    tensor_broadcast_binary(*tensor1, *tensor2, *output_tensor, std::plus<float>());
 }
 
 std::shared_ptr<Tensor>
 tensor_multiply(const std::shared_ptr<Tensor> &tensor1, const std::shared_ptr<Tensor> &tensor2) {
     CHECK(tensor1 != nullptr && tensor2 != nullptr);
-    if (tensor1->shapes() == tensor2->shapes()) {
-        std::shared_ptr<Tensor> output_tensor = tensor_create(tensor1->shapes());
-        output_tensor->set_data(tensor1->data() % tensor2->data());
-        return output_tensor;
-    } else {
-        // broadcast
-        CHECK(tensor1->channels() == tensor2->channels()) << "Tensors shape are not adapting";
-        const auto &[input_tensor1, input_tensor2] = tensor_broadcast(tensor1, tensor2);
-        CHECK(input_tensor1->shapes() == input_tensor2->shapes());
-        std::shared_ptr<Tensor> output_tensor = tensor_create(input_tensor1->shapes());
-        output_tensor->set_data(input_tensor1->data() % input_tensor2->data());
-        return output_tensor;
-    }
+    std::shared_ptr<Tensor> output_tensor =
+            tensor_create(tensor_broadcast_shapes(tensor1->shapes(), tensor2->shapes()));
+    tensor_broadcast_binary(*tensor1, *tensor2, *output_tensor, std::multiplies<float>());
+    return output_tensor;
 }
 
 void tensor_multiply(const std::shared_ptr<Tensor> &tensor1, const std::shared_ptr<Tensor> &tensor2,
                      const std::shared_ptr<Tensor> &output_tensor) {
     CHECK(tensor1 != nullptr && tensor2 != nullptr && output_tensor != nullptr);
-    if (tensor1->shapes() == tensor2->shapes()) {
-        output_tensor->set_data(tensor1->data() % tensor2->data());
-    } else {
-        // broadcast
-        CHECK(tensor1->channels() == tensor2->channels()) << "Tensors shape are not adapting";
-        const auto &[input_tensor1, input_tensor2] = tensor_broadcast(tensor1, tensor2);
-        CHECK(input_tensor1->shapes() == input_tensor2->shapes() && output_tensor->shapes() == input_tensor1->shapes());
-        output_tensor->set_data(input_tensor1->data() % input_tensor2->data());
-    }
+    tensor_broadcast_binary(*tensor1, *tensor2, *output_tensor, std::multiplies<float>());
 }
 
 std::pair<size_t, size_t> get_mat_size(std::ifstream &file, char split_char) {
@@ -271,7 +303,8 @@ std::string shape_str(const std::vector<int> &shapes) {
 
 /// 如果图是第一次运行，则根据节点输入operand的形状准备好后续Layer计算中所需要的Tensor
 /// 如果图是第二次及以后运行，则检查输入operand的形状和operand中张量的形状是否匹配
-void init_operator_input(const std::vector<std::shared_ptr<RuntimeOperator>> &operators) {
+void init_operator_input(const std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                         uint32_t max_batch_size) {
     // 如果传入的operators为空，则记录错误信息并返回
     if (operators.empty()) {
         LOG(ERROR) << "Operators for init input shapes is empty!";
@@ -293,20 +326,21 @@ void init_operator_input(const std::vector<std::shared_ptr<RuntimeOperator>> &op
                 // 检查数据类型是否为float32，如果不是则记录错误信息
                 CHECK(type == ERuntimeDataType::ERDT_Float32) << "The graph only support float32 yet!";
                 // 获取当前输入operand的形状
-                const auto &input_operand_shape = input_operand->m_shapes;
+                auto &input_operand_shape = input_operand->m_shapes;
                 // 获取需要初始化的空间
                 auto &input_data = input_operand->m_data;
 
                 // 检查输入形状是否为空
                 CHECK(!input_operand_shape.empty());
-                // 获取batch大小
+                // 设置了最大batch时batch维度使用最大batch，否则使用模型中的batch大小
+                if (max_batch_size > 0) {
+                    input_operand_shape[0] = max_batch_size;
+                }
                 const int32_t batch = input_operand_shape[0];
-                // 检查batch大小是否大于等于0，不支持动态batch大小
-                CHECK(batch >= 0) << "Dynamic batch size is not supported!";
-                // 检查输入形状的维度是否为2, 3, 或4，不支持其他维度
-                CHECK(input_operand_shape.size() == 2 ||
-                      input_operand_shape.size() == 4 ||
-                      input_operand_shape.size() == 3)
+                // 模型中的batch维度为动态时必须设置最大batch
+                CHECK(batch >= 0) << "Dynamic batch size needs a max batch size!";
+                // 检查输入形状的维度至少为2，即batch加上至少一维数据
+                CHECK(input_operand_shape.size() >= 2)
                                 << "Unsupported tensor shape sizes: " << input_operand_shape.size();
                 // 如果输入数据不为空，则检查输入数据的大小是否与batch大小相匹配
                 if (!input_data.empty()) {
@@ -320,10 +354,36 @@ void init_operator_input(const std::vector<std::shared_ptr<RuntimeOperator>> &op
     }
 }
 
+/// 根据输出操作数的形状为每个batch创建输出张量，形状的第一维为batch大小
+static void create_output_tensors(RuntimeOperand &output_operand) {
+    const std::vector<uint32_t> &operand_shapes = output_operand.m_shapes;
+    const uint32_t batch = operand_shapes[0];
+    for (uint32_t j = 0; j < batch; ++j) {
+        if (operand_shapes.size() > 4) {
+            std::shared_ptr<Tensor> output_tensor = tensor_create(
+                    std::vector<uint32_t>(operand_shapes.begin() + 1, operand_shapes.end()));
+            output_operand.m_data.push_back(output_tensor);
+        } else if (operand_shapes.size() == 4) {
+            std::shared_ptr<Tensor> output_tensor = tensor_create(
+                    operand_shapes[1], operand_shapes[2], operand_shapes[3]);
+            output_operand.m_data.push_back(output_tensor);
+        } else if (operand_shapes.size() == 2) {
+            std::shared_ptr<Tensor> output_tensor = tensor_create(operand_shapes[1]);
+            output_operand.m_data.push_back(output_tensor);
+        } else {
+            // 当形状为3时
+            std::shared_ptr<Tensor> output_tensor = tensor_create((uint32_t) operand_shapes[1],
+                                                                  (uint32_t) operand_shapes[2]);
+            output_operand.m_data.push_back(output_tensor);
+        }
+    }
+}
+
 /// 如果图是第一次运行，则根据节点输出operand的形状准备好后续Layer计算中所需要的Tensor
 /// 如果图是第二次及以后运行，则检查输出operand的形状和operand中张量的形状是否匹配
 void init_operator_output(const std::vector<pnnx::Operator *> &pnnx_operators,
-                          const std::vector<std::shared_ptr<RuntimeOperator>> &operators) {
+                          const std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                          uint32_t max_batch_size) {
     // 检查传入的pnnx_operators和operators是否为空，并且大小是否一致
     CHECK(!pnnx_operators.empty() && !operators.empty());
     CHECK(pnnx_operators.size() == operators.size());
@@ -341,19 +401,22 @@ void init_operator_output(const std::vector<pnnx::Operator *> &pnnx_operators,
         const auto &runtime_op = operators[i];
         // 检查operand是否为空
         CHECK(operand != nullptr) << "Operand output is null";
-        // 将operand形状转换为uint32_t向量
-        const std::vector<uint32_t> operand_shapes = std::vector<uint32_t>(operand->shape.begin(),
-                                                                           operand->shape.end());
+        // 将operand形状转换为uint32_t向量，设置了最大batch时batch维度使用最大batch
+        CHECK(!operand->shape.empty()) << "The output operand shape is empty";
+        CHECK(max_batch_size > 0 || operand->shape.front() >= 0) << "Dynamic batch size needs a max batch size!";
+        std::vector<uint32_t> operand_shapes = std::vector<uint32_t>(operand->shape.begin(),
+                                                                     operand->shape.end());
+        if (max_batch_size > 0) {
+            operand_shapes[0] = max_batch_size;
+        }
 
         // 获取需要初始化的输出空间
         const auto &output_tensors = runtime_op->m_output_operands;
 
-        // 获取batch大小，目前不支持动态batch大小
+        // 获取batch大小
         const uint32_t batch = operand_shapes[0];
-        CHECK(batch >= 0) << "Dynamic batch size is not supported!";
-        // 检查支持的形状大小：2、3或4
-        CHECK(operand_shapes.size() == 2 || operand_shapes.size() == 4 ||
-              operand_shapes.size() == 3)
+        // 检查支持的形状大小：至少为2，大于4时前面的维度合并到通道中
+        CHECK(operand_shapes.size() >= 2)
                         << "Unsupported shape sizes: " << operand_shapes.size();
 
         // 如果输出空间未初始化
@@ -366,21 +429,7 @@ void init_operator_output(const std::vector<pnnx::Operator *> &pnnx_operators,
             output_operand->m_type = ERuntimeDataType::ERDT_Float32;
             output_operand->m_name = operand->name + "_output";
             // 根据batch和形状初始化输出张量
-            for (int j = 0; j < batch; ++j) {
-                if (operand_shapes.size() == 4) {
-                    std::shared_ptr<Tensor> output_tensor = tensor_create(
-                            operand_shapes[1], operand_shapes[2], operand_shapes[3]);
-                    output_operand->m_data.push_back(output_tensor);
-                } else if (operand_shapes.size() == 2) {
-                    std::shared_ptr<Tensor> output_tensor = tensor_create(operand_shapes[1]);
-                    output_operand->m_data.push_back(output_tensor);
-                } else {
-                    // 当形状为3时
-                    std::shared_ptr<Tensor> output_tensor = tensor_create((uint32_t) operand_shapes[1],
-                                                                          (uint32_t) operand_shapes[2]);
-                    output_operand->m_data.push_back(output_tensor);
-                }
-            }
+            create_output_tensors(*output_operand);
             runtime_op->m_output_operands = std::move(output_operand);
         } else {
             // 如果输出空间已存在，则进行校验
@@ -392,7 +441,14 @@ void init_operator_output(const std::vector<pnnx::Operator *> &pnnx_operators,
                 std::shared_ptr<Tensor> output_tensor = output_tensors->m_data.at(b);
                 const std::vector<uint32_t> &tensor_shapes = output_tensor->shapes();
                 // 根据形状大小进行相应的校验和重塑
-                if (operand_shapes.size() == 4) {
+                if (operand_shapes.size() > 4) {
+                    // 形状大于4时按完整的raw_shapes校验和重塑
+                    const std::vector<uint32_t> target_shapes(operand_shapes.begin() + 1, operand_shapes.end());
+                    if (output_tensor->raw_shapes() != target_shapes) {
+                        LOG(WARNING) << "The shape of tensor do not adapting with output operand";
+                        output_tensor->reshape(target_shapes);
+                    }
+                } else if (operand_shapes.size() == 4) {
                     // 形状为4时的校验和重塑
                     if (tensor_shapes.at(0) != operand_shapes.at(1) ||
                         tensor_shapes.at(1) != operand_shapes.at(2) ||
@@ -429,6 +485,28 @@ void init_operator_output(const std::vector<pnnx::Operator *> &pnnx_operators,
     }
 }
 
+/// 不经过pnnx加载的算子在加载时已经记录了输出操作数的形状，在此创建输出张量
+void init_operator_output(const std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                          uint32_t max_batch_size) {
+    CHECK(!operators.empty());
+    for (const auto &runtime_op: operators) {
+        const auto &output_operand = runtime_op->m_output_operands;
+        if (output_operand == nullptr) {
+            continue;
+        }
+        CHECK(output_operand->m_shapes.size() >= 2)
+                        << "Unsupported shape sizes: " << output_operand->m_shapes.size();
+        if (max_batch_size > 0) {
+            output_operand->m_shapes[0] = max_batch_size;
+        }
+        if (output_operand->m_data.empty()) {
+            create_output_tensors(*output_operand);
+        } else {
+            CHECK(output_operand->m_data.size() == output_operand->m_shapes[0]);
+        }
+    }
+}
+
 std::shared_ptr<Tensor> tensor_clone(std::shared_ptr<Tensor> tensor) {
     return std::make_shared<Tensor>(*tensor);
 }
@@ -3,6 +3,7 @@
 //
 
 #include "data/Tensor.hpp"
+#include "data/TensorPermute.hpp"
 
 Tensor::Tensor(uint32_t channels, uint32_t rows, uint32_t cols) {
     m_data = arma::fcube(rows, cols, channels);
@@ -11,24 +12,39 @@ Tensor::Tensor(uint32_t channels, uint32_t rows, uint32_t cols) {
     } else if (channels == 1) {
         m_raw_shapes = std::vector<uint32_t>{rows, cols};
     } else {
-        m_raw_shapes = std::vector<uint32_t>{rows, cols, channels};
+        m_raw_shapes = std::vector<uint32_t>{channels, rows, cols};
+    }
+}
+
+Tensor::Tensor(float *raw_ptr, uint32_t channels, uint32_t rows, uint32_t cols)
+        : m_data(raw_ptr, rows, cols, channels, false, false) {
+    CHECK(raw_ptr != nullptr);
+    if (channels == 1 && rows == 1) {
+        m_raw_shapes = std::vector<uint32_t>{cols};
+    } else if (channels == 1) {
+        m_raw_shapes = std::vector<uint32_t>{rows, cols};
+    } else {
+        m_raw_shapes = std::vector<uint32_t>{channels, rows, cols};
     }
 }
 
 Tensor::Tensor(const std::vector<uint32_t> &shapes) {
-    CHECK(shapes.size() == 3);
-    uint32_t _channels = shapes[0];
-    uint32_t _rows = shapes[1];
-    uint32_t _cols = shapes[2];
+    CHECK(shapes.size() >= 3);
+    // 维度大于3时，最后两维之前的维度按行主序合并到通道中
+    const uint32_t _channels = std::accumulate(shapes.begin(), shapes.end() - 2, 1u, std::multiplies());
+    const uint32_t _rows = shapes[shapes.size() - 2];
+    const uint32_t _cols = shapes.back();
 
     m_data = arma::fcube(_rows, _cols, _channels);
 
-    if (_channels == 1 && _rows == 1) {
+    if (shapes.size() > 3) {
+        m_raw_shapes = shapes;
+    } else if (_channels == 1 && _rows == 1) {
         m_raw_shapes = std::vector<uint32_t>{_cols};
     } else if (_channels == 1) {
         m_raw_shapes = std::vector<uint32_t>{_rows, _cols};
     } else {
-        m_raw_shapes = std::vector<uint32_t>{_rows, _cols, _channels};
+        m_raw_shapes = std::vector<uint32_t>{_channels, _rows, _cols};
     }
 }
 
@@ -118,7 +134,7 @@ arma::fcube &Tensor::data() {
     return m_data;
 }
 
-const arma::fcube Tensor::data() const {
+const arma::fcube &Tensor::data() const {
     return m_data;
 }
 
@@ -178,16 +194,13 @@ void Tensor::fill(const std::vector<float> &values, bool row_major) {
     CHECK_EQ(values.size(), total_elements);
 
     if (row_major) {
+        // values按{channels, rows, cols}行主序排列，每个通道转置后写入列主序的存储
         const uint32_t _rows = rows();
         const uint32_t _cols = cols();
         const uint32_t _planes = _rows * _cols;
-        const uint32_t _channels = channels();
-
-        for (uint32_t i = 0; i < _channels; i++) {
-            auto &channel_data = m_data.slice(i);
-            const arma::fmat &_channel_data = arma::fmat(values.data() + i * _planes, _cols, _rows);
-            channel_data = _channel_data.t();   // 注意转置
-        }
+        permute_copy(this->m_data.memptr(), {_planes, 1, _rows},
+                     values.data(), {_planes, _cols, 1},
+                     {channels(), _rows, _cols});
     } else {
         std::copy(values.begin(), values.end(), this->m_data.memptr());
     }
@@ -225,14 +238,18 @@ void Tensor::reshape(const std::vector<uint32_t> &shapes, bool row_major) {
     const uint32_t origin_size = this->size();
     const uint32_t current_size =
             std::accumulate(shapes.begin(), shapes.end(), 1, std::multiplies());
-    CHECK(shapes.size() <= 3);
     CHECK(current_size == origin_size);
 
     std::vector<float> values;
     if (row_major) {
         values = this->values(true);
     }
-    if (shapes.size() == 3) {
+    if (shapes.size() > 3) {
+        // 最后两维之前的维度合并到通道中
+        const uint32_t channels = std::accumulate(shapes.begin(), shapes.end() - 2, 1u, std::multiplies());
+        this->m_data.reshape(shapes.at(shapes.size() - 2), shapes.back(), channels);
+        this->m_raw_shapes = shapes;
+    } else if (shapes.size() == 3) {
         this->m_data.reshape(shapes.at(1), shapes.at(2), shapes.at(0));
         this->m_raw_shapes = {shapes.at(0), shapes.at(1), shapes.at(2)};
     } else if (shapes.size() == 2) {
@@ -283,29 +300,12 @@ void Tensor::review(const std::vector<uint32_t> &shapes) {
     const uint32_t target_cols = shapes[2];
 
     CHECK_EQ(m_data.size(), target_rows * target_cols * target_channels);
-    arma::fcube new_data(target_rows, target_cols, target_channels);
-
-    const uint32_t plane_size = target_rows * target_cols;
-    for (uint32_t c = 0; c < channels(); c++) {
-        const arma::fmat &_channel_data = m_data.slice(c);
-        for (uint32_t c_ = 0; c_ < m_data.n_cols; ++c_) {
-            const float *col_ptr = _channel_data.colptr(c_);
-            for (uint32_t r = 0; r < m_data.n_rows; ++r) {
-                const uint32_t pos_index =
-                        c * m_data.n_rows * m_data.n_cols + r * m_data.n_cols + c_;
-                const uint32_t _ch = pos_index / plane_size;
-                const uint32_t _row = (pos_index - _ch * plane_size) / target_cols;
-                const uint32_t _col = (pos_index - _ch * plane_size - _row * target_cols);
-                CHECK(_ch < new_data.n_slices && _col < new_data.n_cols &&
-                      _row < new_data.n_rows);
-                new_data.at(_row, _col, _ch) = *(col_ptr + r);
-            }
-        }
-    }
-    m_data = std::move(new_data);
+    // 先按行主序取出所有元素，再按新的形状以行主序写回
+    const std::vector<float> values = this->values(true);
+    m_data = arma::fcube(target_rows, target_cols, target_channels);
+    this->fill(values, true);
 }
 
-
 std::vector<float> Tensor::values(bool row_major) {
     CHECK_EQ(this->m_data.empty(), false);
     std::vector<float> values(this->m_data.size());
@@ -314,13 +314,12 @@ std::vector<float> Tensor::values(bool row_major) {
         std::copy(this->m_data.mem, this->m_data.mem + this->m_data.size(),
                   values.begin());
     } else {
-        uint32_t index = 0;
-        for (uint32_t c = 0; c < this->m_data.n_slices; ++c) {
-            const arma::fmat &channel = this->m_data.slice(c).t();
-            std::copy(channel.begin(), channel.end(), values.begin() + index);
-            index += channel.size();
-        }
-        CHECK_EQ(index, values.size());
+        const uint32_t _rows = rows();
+        const uint32_t _cols = cols();
+        const uint32_t _planes = _rows * _cols;
+        permute_copy(values.data(), {_planes, _cols, 1},
+                     this->m_data.memptr(), {_planes, 1, _rows},
+                     {channels(), _rows, _cols});
     }
     return values;
 }
@@ -0,0 +1,367 @@
+//
+// Created by xyzzzh on 2024/4/20.
+//
+
+#include "data/TensorND.hpp"
+#include "data/TensorPermute.hpp"
+#include <numeric>
+
+// 按shapes遍历dst和src两个步长不同的视图，对每对元素执行func(dst, src)
+// 最后一维作为内层循环，其余维度用计数器展开，避免逐元素的除法和取模
+template<typename Func>
+static void strided_apply(float *dst, const std::vector<uint32_t> &dst_strides,
+                          const float *src, const std::vector<uint32_t> &src_strides,
+                          const std::vector<uint32_t> &shapes, Func func) {
+    const uint32_t dims = shapes.size();
+    if (dims == 0) {
+        func(*dst, *src);
+        return;
+    }
+    for (uint32_t shape: shapes) {
+        if (shape == 0) {
+            return;
+        }
+    }
+
+    const uint32_t inner_size = shapes.back();
+    const uint32_t inner_dst_stride = dst_strides.back();
+    const uint32_t inner_src_stride = src_strides.back();
+    std::vector<uint32_t> indices(dims, 0);
+    while (true) {
+        if (inner_dst_stride == 1 && inner_src_stride == 1) {
+            for (uint32_t i = 0; i < inner_size; ++i) {
+                func(dst[i], src[i]);
+            }
+        } else {
+            for (uint32_t i = 0; i < inner_size; ++i) {
+                func(dst[i * inner_dst_stride], src[i * inner_src_stride]);
+            }
+        }
+
+        // 外层维度的计数器进位
+        int32_t d = int32_t(dims) - 2;
+        for (; d >= 0; --d) {
+            indices[d] += 1;
+            dst += dst_strides[d];
+            src += src_strides[d];
+            if (indices[d] < shapes[d]) {
+                break;
+            }
+            dst -= size_t(dst_strides[d]) * shapes[d];
+            src -= size_t(src_strides[d]) * shapes[d];
+            indices[d] = 0;
+        }
+        if (d < 0) {
+            break;
+        }
+    }
+}
+
+TensorND::TensorND(const std::vector<uint32_t> &shapes) {
+    CHECK(!shapes.empty());
+    const size_t size = std::accumulate(shapes.begin(), shapes.end(), size_t(1), std::multiplies());
+    CHECK(size > 0) << "The size of tensor should be greater than zero";
+    m_shapes = shapes;
+    m_strides = contiguous_strides(shapes);
+    m_storage = std::shared_ptr<float>(new float[size](), std::default_delete<float[]>());
+    m_data = m_storage.get();
+}
+
+TensorND TensorND::from_blob(float *data, const std::vector<uint32_t> &shapes,
+                             const std::vector<uint32_t> &strides) {
+    CHECK(data != nullptr);
+    CHECK(!shapes.empty());
+    CHECK(strides.empty() || strides.size() == shapes.size());
+    TensorND tensor;
+    tensor.m_shapes = shapes;
+    tensor.m_strides = strides.empty() ? contiguous_strides(shapes) : strides;
+    tensor.m_data = data;
+    return tensor;
+}
+
+// Tensor的存储中逻辑形状为shapes的步长，shapes的最后两维对应rows和cols，更前面的维度合并在通道中
+static std::vector<uint32_t> tensor_storage_strides(const std::vector<uint32_t> &shapes, uint32_t rows) {
+    const uint32_t dims = shapes.size();
+    std::vector<uint32_t> strides(dims);
+    if (dims == 1) {
+        strides[0] = 1;
+        return strides;
+    }
+    strides[dims - 1] = rows;
+    strides[dims - 2] = 1;
+    uint32_t stride = rows * shapes[dims - 1];
+    for (int32_t d = int32_t(dims) - 3; d >= 0; --d) {
+        strides[d] = stride;
+        stride *= shapes[d];
+    }
+    return strides;
+}
+
+TensorND TensorND::from_tensor(Tensor &tensor, uint32_t dims) {
+    CHECK(!tensor.empty());
+    const uint32_t rows = tensor.rows();
+    const uint32_t cols = tensor.cols();
+
+    // raw_shapes与存储不一致时(例如按列主序reshape之后)退化为{channels, rows, cols}
+    std::vector<uint32_t> shapes = tensor.raw_shapes();
+    const uint32_t raw_size = std::accumulate(shapes.begin(), shapes.end(), 1u, std::multiplies());
+    const bool raw_adapting = raw_size == tensor.size() &&
+                              (shapes.size() == 1 ? rows == 1 && cols == shapes[0]
+                                                  : shapes[shapes.size() - 2] == rows && shapes.back() == cols);
+    if (!raw_adapting) {
+        shapes = tensor.shapes();
+    }
+    TensorND view = from_blob(tensor.raw_ptr(), shapes, tensor_storage_strides(shapes, rows));
+    while (view.dims() < dims) {
+        view = view.unsqueeze(0);
+    }
+    return view;
+}
+
+std::shared_ptr<Tensor> TensorND::to_tensor() const {
+    CHECK(!this->empty());
+    std::vector<uint32_t> shapes = m_shapes;
+    while (shapes.size() < 3) {
+        shapes.insert(shapes.begin(), 1);
+    }
+    std::shared_ptr<Tensor> tensor = std::make_shared<Tensor>(shapes);
+    const uint32_t rows = m_shapes.size() == 1 ? 1 : m_shapes[m_shapes.size() - 2];
+    from_blob(tensor->raw_ptr(), m_shapes, tensor_storage_strides(m_shapes, rows)).copy_from(*this);
+    return tensor;
+}
+
+uint32_t TensorND::dims() const {
+    return m_shapes.size();
+}
+
+uint32_t TensorND::size() const {
+    if (m_shapes.empty()) {
+        return 0;
+    }
+    return std::accumulate(m_shapes.begin(), m_shapes.end(), 1u, std::multiplies());
+}
+
+bool TensorND::empty() const {
+    return m_data == nullptr || this->size() == 0;
+}
+
+bool TensorND::is_contiguous() const {
+    uint32_t stride = 1;
+    for (int32_t d = int32_t(m_shapes.size()) - 1; d >= 0; --d) {
+        if (m_shapes[d] != 1 && m_strides[d] != stride) {
+            return false;
+        }
+        stride *= m_shapes[d];
+    }
+    return true;
+}
+
+bool TensorND::is_owner() const {
+    return m_storage != nullptr;
+}
+
+const std::vector<uint32_t> &TensorND::shapes() const {
+    return m_shapes;
+}
+
+const std::vector<uint32_t> &TensorND::strides() const {
+    return m_strides;
+}
+
+uint32_t TensorND::shape(uint32_t dim) const {
+    CHECK_LT(dim, m_shapes.size());
+    return m_shapes[dim];
+}
+
+float *TensorND::raw_ptr() {
+    CHECK(m_data != nullptr);
+    return m_data;
+}
+
+const float *TensorND::raw_ptr() const {
+    CHECK(m_data != nullptr);
+    return m_data;
+}
+
+float TensorND::at(const std::vector<uint32_t> &indices) const {
+    CHECK_EQ(indices.size(), m_shapes.size());
+    size_t offset = 0;
+    for (uint32_t d = 0; d < indices.size(); ++d) {
+        CHECK_LT(indices[d], m_shapes[d]);
+        offset += size_t(indices[d]) * m_strides[d];
+    }
+    return m_data[offset];
+}
+
+float &TensorND::at(const std::vector<uint32_t> &indices) {
+    CHECK_EQ(indices.size(), m_shapes.size());
+    size_t offset = 0;
+    for (uint32_t d = 0; d < indices.size(); ++d) {
+        CHECK_LT(indices[d], m_shapes[d]);
+        offset += size_t(indices[d]) * m_strides[d];
+    }
+    return m_data[offset];
+}
+
+TensorND TensorND::view(const std::vector<int32_t> &shapes) const {
+    CHECK(!shapes.empty());
+    CHECK(this->is_contiguous()) << "View need a contiguous tensor, call contiguous() first";
+    const uint32_t origin_size = this->size();
+
+    int32_t infer_dim = -1;
+    uint32_t known_size = 1;
+    std::vector<uint32_t> new_shapes(shapes.size());
+    for (uint32_t d = 0; d < shapes.size(); ++d) {
+        if (shapes[d] == -1) {
+            CHECK(infer_dim == -1) << "Only one dimension can be inferred";
+            infer_dim = int32_t(d);
+        } else {
+            CHECK(shapes[d] > 0);
+            new_shapes[d] = uint32_t(shapes[d]);
+            known_size *= new_shapes[d];
+        }
+    }
+    if (infer_dim >= 0) {
+        CHECK(known_size > 0 && origin_size % known_size == 0);
+        new_shapes[infer_dim] = origin_size / known_size;
+        known_size *= new_shapes[infer_dim];
+    }
+    CHECK_EQ(known_size, origin_size) << "View shape " << known_size << " do not match tensor size " << origin_size;
+
+    TensorND tensor = *this;
+    tensor.m_shapes = new_shapes;
+    tensor.m_strides = contiguous_strides(new_shapes);
+    return tensor;
+}
+
+TensorND TensorND::permute(const std::vector<uint32_t> &dims) const {
+    CHECK_EQ(dims.size(), m_shapes.size());
+    std::vector<bool> visited(dims.size(), false);
+    TensorND tensor = *this;
+    for (uint32_t d = 0; d < dims.size(); ++d) {
+        CHECK(dims[d] < dims.size() && !visited[dims[d]]) << "Permute dims is not a permutation";
+        visited[dims[d]] = true;
+        tensor.m_shapes[d] = m_shapes[dims[d]];
+        tensor.m_strides[d] = m_strides[dims[d]];
+    }
+    return tensor;
+}
+
+TensorND TensorND::transpose(uint32_t dim0, uint32_t dim1) const {
+    CHECK(dim0 < m_shapes.size() && dim1 < m_shapes.size());
+    TensorND tensor = *this;
+    std::swap(tensor.m_shapes[dim0], tensor.m_shapes[dim1]);
+    std::swap(tensor.m_strides[dim0], tensor.m_strides[dim1]);
+    return tensor;
+}
+
+TensorND TensorND::slice(uint32_t dim, uint32_t start, uint32_t end, uint32_t step) const {
+    CHECK_LT(dim, m_shapes.size());
+    CHECK(step > 0);
+    end = std::min(end, m_shapes[dim]);
+    CHECK(start < end) << "Slice range [" << start << ", " << end << ") is empty";
+    TensorND tensor = *this;
+    tensor.m_data = m_data + size_t(start) * m_strides[dim];
+    tensor.m_shapes[dim] = (end - start + step - 1) / step;
+    tensor.m_strides[dim] = m_strides[dim] * step;
+    return tensor;
+}
+
+TensorND TensorND::select(uint32_t dim, uint32_t index) const {
+    CHECK_LT(dim, m_shapes.size());
+    CHECK_LT(index, m_shapes[dim]);
+    CHECK(m_shapes.size() > 1) << "Can not select on a one dimension tensor";
+    TensorND tensor = *this;
+    tensor.m_data = m_data + size_t(index) * m_strides[dim];
+    tensor.m_shapes.erase(tensor.m_shapes.begin() + dim);
+    tensor.m_strides.erase(tensor.m_strides.begin() + dim);
+    return tensor;
+}
+
+TensorND TensorND::unsqueeze(uint32_t dim) const {
+    CHECK_LE(dim, m_shapes.size());
+    TensorND tensor = *this;
+    const uint32_t stride = dim < m_shapes.size() ? m_strides[dim] * m_shapes[dim] : 1;
+    tensor.m_shapes.insert(tensor.m_shapes.begin() + dim, 1);
+    tensor.m_strides.insert(tensor.m_strides.begin() + dim, stride);
+    return tensor;
+}
+
+TensorND TensorND::squeeze(uint32_t dim) const {
+    CHECK_LT(dim, m_shapes.size());
+    CHECK_EQ(m_shapes[dim], 1) << "Only dimension of size one can be squeezed";
+    CHECK(m_shapes.size() > 1);
+    TensorND tensor = *this;
+    tensor.m_shapes.erase(tensor.m_shapes.begin() + dim);
+    tensor.m_strides.erase(tensor.m_strides.begin() + dim);
+    return tensor;
+}
+
+TensorND TensorND::expand(const std::vector<uint32_t> &shapes) const {
+    CHECK_GE(shapes.size(), m_shapes.size());
+    TensorND tensor = *this;
+    const uint32_t lead_dims = shapes.size() - m_shapes.size();
+    tensor.m_shapes = shapes;
+    tensor.m_strides.assign(shapes.size(), 0);
+    for (uint32_t d = 0; d < m_shapes.size(); ++d) {
+        const uint32_t target = shapes[d + lead_dims];
+        if (m_shapes[d] == target) {
+            tensor.m_strides[d + lead_dims] = m_strides[d];
+        } else {
+            CHECK_EQ(m_shapes[d], 1) << "Expand shape is not adapting at dim " << d;
+        }
+    }
+    return tensor;
+}
+
+TensorND TensorND::contiguous() const {
+    if (this->is_contiguous()) {
+        return *this;
+    }
+    TensorND tensor(m_shapes);
+    tensor.copy_from(*this);
+    return tensor;
+}
+
+void TensorND::copy_from(const TensorND &src) {
+    CHECK(!this->empty() && !src.empty());
+    CHECK(m_shapes == src.m_shapes) << "The shapes of copy source and destination do not match";
+    permute_copy(m_data, m_strides, src.m_data, src.m_strides, m_shapes);
+}
+
+void TensorND::fill(float value) {
+    CHECK(!this->empty());
+    strided_apply(m_data, m_strides, m_data, m_strides, m_shapes,
+                  [value](float &dst, const float &) { dst = value; });
+}
+
+std::vector<float> TensorND::values() const {
+    CHECK(!this->empty());
+    std::vector<float> values(this->size());
+    from_blob(values.data(), m_shapes).copy_from(*this);
+    return values;
+}
+
+std::vector<uint32_t> TensorND::contiguous_strides(const std::vector<uint32_t> &shapes) {
+    std::vector<uint32_t> strides(shapes.size());
+    uint32_t stride = 1;
+    for (int32_t d = int32_t(shapes.size()) - 1; d >= 0; --d) {
+        strides[d] = stride;
+        stride *= shapes[d];
+    }
+    return strides;
+}
+
+void tensor_concat(const std::vector<TensorND> &inputs, uint32_t dim, TensorND &output) {
+    CHECK(!inputs.empty());
+    CHECK_LT(dim, output.dims());
+    uint32_t offset = 0;
+    for (const auto &input: inputs) {
+        CHECK_EQ(input.dims(), output.dims());
+        const uint32_t length = input.shape(dim);
+        TensorND destination = output.slice(dim, offset, offset + length);
+        destination.copy_from(input);
+        offset += length;
+    }
+    CHECK_EQ(offset, output.shape(dim)) << "The concat inputs do not fill the output";
+}
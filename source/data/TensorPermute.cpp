@@ -0,0 +1,219 @@
+//
+// Created by xyzzzh on 2024/4/21.
+//
+
+#include "data/TensorPermute.hpp"
+#include <algorithm>
+#include <cstring>
+#include <glog/logging.h>
+
+#if defined(__AVX__) || defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+// 分块转置的块大小，两个32x32的float块共8KB，可以放进L1缓存
+static constexpr uint32_t kTransposeBlock = 32;
+
+// 8x8的转置微内核：dst的第c行为src的第c列
+static inline void transpose_8x8(const float *src, size_t src_ld, float *dst, size_t dst_ld) {
+#if defined(__AVX__)
+    __m256 r0 = _mm256_loadu_ps(src + 0 * src_ld);
+    __m256 r1 = _mm256_loadu_ps(src + 1 * src_ld);
+    __m256 r2 = _mm256_loadu_ps(src + 2 * src_ld);
+    __m256 r3 = _mm256_loadu_ps(src + 3 * src_ld);
+    __m256 r4 = _mm256_loadu_ps(src + 4 * src_ld);
+    __m256 r5 = _mm256_loadu_ps(src + 5 * src_ld);
+    __m256 r6 = _mm256_loadu_ps(src + 6 * src_ld);
+    __m256 r7 = _mm256_loadu_ps(src + 7 * src_ld);
+
+    const __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+    const __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+    const __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+    const __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+    const __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+    const __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+    const __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+    const __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+
+    const __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    const __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    const __m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+    _mm256_storeu_ps(dst + 0 * dst_ld, _mm256_permute2f128_ps(u0, u4, 0x20));
+    _mm256_storeu_ps(dst + 1 * dst_ld, _mm256_permute2f128_ps(u1, u5, 0x20));
+    _mm256_storeu_ps(dst + 2 * dst_ld, _mm256_permute2f128_ps(u2, u6, 0x20));
+    _mm256_storeu_ps(dst + 3 * dst_ld, _mm256_permute2f128_ps(u3, u7, 0x20));
+    _mm256_storeu_ps(dst + 4 * dst_ld, _mm256_permute2f128_ps(u0, u4, 0x31));
+    _mm256_storeu_ps(dst + 5 * dst_ld, _mm256_permute2f128_ps(u1, u5, 0x31));
+    _mm256_storeu_ps(dst + 6 * dst_ld, _mm256_permute2f128_ps(u2, u6, 0x31));
+    _mm256_storeu_ps(dst + 7 * dst_ld, _mm256_permute2f128_ps(u3, u7, 0x31));
+#elif defined(__SSE__)
+    // 拆成四个4x4的块，src中(i, j)块转置后写到dst中(j, i)块
+    for (uint32_t i = 0; i < 8; i += 4) {
+        for (uint32_t j = 0; j < 8; j += 4) {
+            const float *s = src + i * src_ld + j;
+            __m128 r0 = _mm_loadu_ps(s + 0 * src_ld);
+            __m128 r1 = _mm_loadu_ps(s + 1 * src_ld);
+            __m128 r2 = _mm_loadu_ps(s + 2 * src_ld);
+            __m128 r3 = _mm_loadu_ps(s + 3 * src_ld);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            float *d = dst + j * dst_ld + i;
+            _mm_storeu_ps(d + 0 * dst_ld, r0);
+            _mm_storeu_ps(d + 1 * dst_ld, r1);
+            _mm_storeu_ps(d + 2 * dst_ld, r2);
+            _mm_storeu_ps(d + 3 * dst_ld, r3);
+        }
+    }
+#else
+    for (uint32_t r = 0; r < 8; ++r) {
+        for (uint32_t c = 0; c < 8; ++c) {
+            dst[c * dst_ld + r] = src[r * src_ld + c];
+        }
+    }
+#endif
+}
+
+void transpose_2d(const float *src, size_t src_ld, float *dst, size_t dst_ld,
+                  uint32_t rows, uint32_t cols) {
+    for (uint32_t rb = 0; rb < rows; rb += kTransposeBlock) {
+        const uint32_t row_end = std::min(rows, rb + kTransposeBlock);
+        for (uint32_t cb = 0; cb < cols; cb += kTransposeBlock) {
+            const uint32_t col_end = std::min(cols, cb + kTransposeBlock);
+
+            // 块内先处理8x8对齐的部分
+            uint32_t r = rb;
+            for (; r + 8 <= row_end; r += 8) {
+                uint32_t c = cb;
+                for (; c + 8 <= col_end; c += 8) {
+                    transpose_8x8(src + r * src_ld + c, src_ld, dst + c * dst_ld + r, dst_ld);
+                }
+                for (; c < col_end; ++c) {
+                    for (uint32_t i = r; i < r + 8; ++i) {
+                        dst[c * dst_ld + i] = src[i * src_ld + c];
+                    }
+                }
+            }
+            // 剩余不足8行的部分
+            for (; r < row_end; ++r) {
+                for (uint32_t c = cb; c < col_end; ++c) {
+                    dst[c * dst_ld + r] = src[r * src_ld + c];
+                }
+            }
+        }
+    }
+}
+
+namespace {
+struct PermuteDim {
+    uint32_t shape = 0;
+    size_t dst_stride = 0;
+    size_t src_stride = 0;
+};
+
+// 遍历outer中所有维度的下标组合，对每个组合调用func(dst偏移, src偏移)
+template<typename Func>
+void for_each_outer(const std::vector<PermuteDim> &outer, Func func) {
+    const int32_t dims = int32_t(outer.size());
+    std::vector<uint32_t> indices(dims, 0);
+    size_t dst_offset = 0;
+    size_t src_offset = 0;
+    while (true) {
+        func(dst_offset, src_offset);
+        int32_t d = dims - 1;
+        for (; d >= 0; --d) {
+            indices[d] += 1;
+            dst_offset += outer[d].dst_stride;
+            src_offset += outer[d].src_stride;
+            if (indices[d] < outer[d].shape) {
+                break;
+            }
+            dst_offset -= outer[d].dst_stride * outer[d].shape;
+            src_offset -= outer[d].src_stride * outer[d].shape;
+            indices[d] = 0;
+        }
+        if (d < 0) {
+            break;
+        }
+    }
+}
+}
+
+void permute_copy(float *dst, const std::vector<uint32_t> &dst_strides,
+                  const float *src, const std::vector<uint32_t> &src_strides,
+                  const std::vector<uint32_t> &shapes) {
+    CHECK(dst != nullptr && src != nullptr);
+    CHECK(dst_strides.size() == shapes.size() && src_strides.size() == shapes.size());
+
+    // 去掉大小为1的维度，按dst的步长从大到小排列，使dst按内存顺序写入
+    std::vector<PermuteDim> dims;
+    for (uint32_t d = 0; d < shapes.size(); ++d) {
+        if (shapes[d] == 0) {
+            return;
+        }
+        if (shapes[d] != 1) {
+            dims.push_back({shapes[d], dst_strides[d], src_strides[d]});
+        }
+    }
+    std::stable_sort(dims.begin(), dims.end(), [](const PermuteDim &a, const PermuteDim &b) {
+        return a.dst_stride > b.dst_stride;
+    });
+
+    // 合并在dst和src中都连续的相邻维度
+    std::vector<PermuteDim> merged;
+    for (const PermuteDim &dim: dims) {
+        if (!merged.empty()) {
+            PermuteDim &prev = merged.back();
+            if (prev.dst_stride == dim.dst_stride * dim.shape &&
+                prev.src_stride == dim.src_stride * dim.shape) {
+                prev.shape *= dim.shape;
+                prev.dst_stride = dim.dst_stride;
+                prev.src_stride = dim.src_stride;
+                continue;
+            }
+        }
+        merged.push_back(dim);
+    }
+    if (merged.empty()) {
+        *dst = *src;
+        return;
+    }
+
+    const PermuteDim inner = merged.back();
+    merged.pop_back();
+
+    if (inner.dst_stride == 1 && inner.src_stride == 1) {
+        const size_t bytes = inner.shape * sizeof(float);
+        for_each_outer(merged, [&](size_t dst_offset, size_t src_offset) {
+            std::memcpy(dst + dst_offset, src + src_offset, bytes);
+        });
+        return;
+    }
+
+    if (inner.dst_stride == 1) {
+        // 查找src中连续的维度，与dst的最内层维度组成二维转置
+        auto iter = std::find_if(merged.begin(), merged.end(),
+                                 [](const PermuteDim &dim) { return dim.src_stride == 1; });
+        if (iter != merged.end()) {
+            const PermuteDim transposed = *iter;
+            merged.erase(iter);
+            for_each_outer(merged, [&](size_t dst_offset, size_t src_offset) {
+                transpose_2d(src + src_offset, inner.src_stride, dst + dst_offset, transposed.dst_stride,
+                             inner.shape, transposed.shape);
+            });
+            return;
+        }
+    }
+
+    for_each_outer(merged, [&](size_t dst_offset, size_t src_offset) {
+        float *d = dst + dst_offset;
+        const float *s = src + src_offset;
+        for (uint32_t i = 0; i < inner.shape; ++i) {
+            d[i * inner.dst_stride] = s[i * inner.src_stride];
+        }
+    });
+}
@@ -30,6 +30,16 @@ EInferStatus Layer::forward() {
     CHECK(!layer_input_datas.empty()) << runtime_operator->m_name << " Layer input data is empty";
     CHECK(output_operand_datas != nullptr && !output_operand_datas->m_data.empty()) << "Layer output data is empty";
 
+    // 原地计算时输出直接指向被复用的输入
+    if (this->m_inplace_input >= 0) {
+        CHECK(this->m_inplace_input < input_operand_datas.size());
+        const auto &inplace_datas = input_operand_datas.at(this->m_inplace_input)->m_data;
+        CHECK(inplace_datas.size() == output_operand_datas->m_data.size());
+        for (uint32_t i = 0; i < inplace_datas.size(); ++i) {
+            output_operand_datas->m_data.at(i) = inplace_datas.at(i);
+        }
+    }
+
     // 执行operator当中的layer计算过程
     // layer的计算结果存放在current_op->output_operands->m_data中
     EInferStatus status = runtime_operator->m_layer->forward(layer_input_datas, output_operand_datas->m_data);
@@ -49,6 +59,44 @@ void Layer::set_weights(const std::vector<std::shared_ptr<Tensor>> &weights) {}
 
 void Layer::set_weights(const std::vector<float> &weights) {}
 
+void Layer::set_weights(const WeightSpan &weights) {}
+
 void Layer::set_bias(const std::vector<std::shared_ptr<Tensor>> &bias) {}
 
 void Layer::set_bias(const std::vector<float> &bias) {}
+
+void Layer::set_bias(const WeightSpan &bias) {}
+
+void Layer::materialize_weights() {}
+
+bool Layer::weights_materialized() const {
+    return true;
+}
+
+void Layer::prefetch_weights() {}
+
+bool Layer::fuse_padding(const PaddingDesc &padding) {
+    return false;
+}
+
+bool Layer::fold_padding_into(Layer &next) {
+    return false;
+}
+
+bool Layer::support_inplace() const {
+    return false;
+}
+
+void Layer::set_inplace_input(int32_t index) {
+    CHECK(index < 0 || this->support_inplace()) << this->m_layer_name << " layer do not support inplace";
+    this->m_inplace_input = index < 0 ? -1 : index;
+}
+
+int32_t Layer::aliased_input() const {
+    return this->m_inplace_input;
+}
+
+bool Layer::infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                                std::vector<uint32_t> &output_shapes) const {
+    return false;
+}
@@ -3,21 +3,65 @@
 //
 
 #include "layer/abstract/ParamLayer.hpp"
+#include "runtime/store_zip.hpp"
+
+// 把按行主序排列的视图数据依次写入张量的列主序存储，视图中的元素数量需要与张量的总大小相同
+// 视图已经是计算时的布局时每个张量只需一次连续拷贝
+static void fill_from_span(const std::vector<std::shared_ptr<Tensor>> &tensors, const WeightSpan &span) {
+    size_t elem_size = 0;
+    for (const auto &tensor: tensors) {
+        CHECK(tensor != nullptr);
+        elem_size += tensor->size();
+    }
+    CHECK(span.size % sizeof(float) == 0);
+    CHECK(span.count<float>() == elem_size);
+
+    size_t offset = 0;
+    if (span.packed) {
+        for (const auto &tensor: tensors) {
+            std::memcpy(tensor->raw_ptr(), span.data + offset * sizeof(float), tensor->size() * sizeof(float));
+            offset += tensor->size();
+        }
+        return;
+    }
+    for (const auto &tensor: tensors) {
+        const uint32_t rows = tensor->rows();
+        const uint32_t cols = tensor->cols();
+        for (uint32_t c = 0; c < tensor->channels(); ++c) {
+            float *matrix = tensor->matrix_raw_ptr(c);
+            for (uint32_t r = 0; r < rows; ++r) {
+                for (uint32_t col = 0; col < cols; ++col) {
+                    matrix[col * rows + r] = span.at<float>(offset++);
+                }
+            }
+        }
+    }
+}
+
+// 按形状(数量、通道数、行数、列数)分配一组张量
+static std::vector<std::shared_ptr<Tensor>> create_params(const std::vector<uint32_t> &shape) {
+    CHECK(shape.size() == 4);
+    std::vector<std::shared_ptr<Tensor>> params(shape.at(0));
+    for (uint32_t i = 0; i < params.size(); i++) {
+        params[i] = std::make_shared<Tensor>(shape.at(1), shape.at(2), shape.at(3));
+    }
+    return params;
+}
 
 void
 ParamLayer::init_weight_param(const uint32_t param_count, const uint32_t param_channel,
                               const uint32_t param_height, const uint32_t param_width) {
-    this->m_weights = std::vector<std::shared_ptr<Tensor>>(param_count);
-    for (uint32_t i = 0; i < param_count; i++) {
-        this->m_weights[i] = std::make_shared<Tensor>(param_channel, param_height, param_width);
+    this->m_weight_shape = {param_count, param_channel, param_height, param_width};
+    if (!this->m_lazy_weights) {
+        this->m_weights = create_params(this->m_weight_shape);
     }
 }
 
 void ParamLayer::init_bias_param(const uint32_t param_count, const uint32_t param_channel,
                                  const uint32_t param_height, const uint32_t param_width) {
-    this->m_bias = std::vector<std::shared_ptr<Tensor>>(param_count);
-    for (uint32_t i = 0; i < param_count; i++) {
-        this->m_bias[i] = std::make_shared<Tensor>(param_channel, param_height, param_width);
+    this->m_bias_shape = {param_count, param_channel, param_height, param_width};
+    if (!this->m_lazy_weights) {
+        this->m_bias = create_params(this->m_bias_shape);
     }
 }
 
@@ -60,6 +104,10 @@ void ParamLayer::set_weights(const std::vector<float> &weights) {
     }
 }
 
+void ParamLayer::set_weights(const WeightSpan &weights) {
+    fill_from_span(this->m_weights, weights);
+}
+
 void ParamLayer::set_bias(const std::vector<std::shared_ptr<Tensor>> &bias) {
     CHECK(bias.size() == this->m_bias.size());
     for (uint32_t i = 0; i < bias.size(); ++i) {
@@ -90,3 +138,68 @@ void ParamLayer::set_bias(const std::vector<float> &bias) {
         this->m_bias[i]->fill(sub_value);
     }
 }
+
+void ParamLayer::set_bias(const WeightSpan &bias) {
+    fill_from_span(this->m_bias, bias);
+}
+
+void ParamLayer::defer_weights(std::shared_ptr<RuntimeAttribute> weight, std::shared_ptr<RuntimeAttribute> bias) {
+    CHECK(this->m_lazy_weights) << this->layer_name() << " layer do not load weights lazily";
+    CHECK(weight != nullptr) << "The weight attribute of " << this->layer_name() << " layer is empty";
+    std::lock_guard<std::mutex> lock(this->m_materialize_mutex);
+    this->m_pending_weight = std::move(weight);
+    this->m_pending_bias = std::move(bias);
+    this->m_materialized.store(false, std::memory_order_release);
+}
+
+void ParamLayer::materialize_weights() {
+    if (this->weights_materialized()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(this->m_materialize_mutex);
+    if (this->m_materialized.load(std::memory_order_relaxed)) {
+        return;
+    }
+    this->allocate_weights();
+    // 与立即加载时相同，从视图直接写入计算时的布局，写入后属性不再持有模型文件的映射
+    if (this->m_pending_bias != nullptr) {
+        this->set_bias(this->m_pending_bias->weight_span());
+        this->m_pending_bias->clear_weight();
+        this->m_pending_bias.reset();
+    }
+    if (this->m_pending_weight != nullptr) {
+        this->set_weights(this->m_pending_weight->weight_span());
+        this->m_pending_weight->clear_weight();
+        this->m_pending_weight.reset();
+    }
+    this->m_materialized.store(true, std::memory_order_release);
+}
+
+bool ParamLayer::weights_materialized() const {
+    return !this->m_lazy_weights || this->m_materialized.load(std::memory_order_acquire);
+}
+
+void ParamLayer::prefetch_weights() {
+    if (this->weights_materialized()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(this->m_materialize_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return;
+    }
+    for (const auto &attribute: {this->m_pending_weight, this->m_pending_bias}) {
+        // 只有映射的数据需要从文件中读取，已经在内存中的属性不需要预读
+        if (attribute != nullptr && attribute->m_mapped_data != nullptr) {
+            pnnx::prefetch_mapping(attribute->m_mapped_data, attribute->m_mapped_size);
+        }
+    }
+}
+
+void ParamLayer::allocate_weights() {
+    if (this->m_weights.empty() && !this->m_weight_shape.empty()) {
+        this->m_weights = create_params(this->m_weight_shape);
+    }
+    if (this->m_bias.empty() && !this->m_bias_shape.empty()) {
+        this->m_bias = create_params(this->m_bias_shape);
+    }
+}
@@ -114,6 +114,15 @@ EInferStatus AdaptiveAveragePoolingLayer::forward(const std::vector<std::shared_
     return EInferStatus::EIS_InferSuccess;
 }
 
+bool AdaptiveAveragePoolingLayer::infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                                                      std::vector<uint32_t> &output_shapes) const {
+    if (input_shapes.size() != 1 || input_shapes.front().size() != 3) {
+        return false;
+    }
+    output_shapes = {input_shapes.front().at(0), this->m_output_h, this->m_output_w};
+    return true;
+}
+
 EParseParameterAttrStatus AdaptiveAveragePoolingLayer::create_instance(const std::shared_ptr<RuntimeOperator> &op,
                                                                        std::shared_ptr<Layer> &avg_layer) {
     CHECK(op != nullptr) << "Adaptive pooling operator is nullptr";
@@ -0,0 +1,58 @@
+//
+// Created by xyzzzh on 2024/5/2.
+//
+
+#include "layer/deatil/AttributeLayer.hpp"
+
+AttributeLayer::AttributeLayer(std::vector<float> values) :
+        NonParamLayer("Attribute"), m_values(std::move(values)) {}
+
+AttributeLayer::AttributeLayer(const WeightSpan &values) :
+        NonParamLayer("Attribute"), m_values(values.count<float>()) {
+    CHECK(values.size % sizeof(float) == 0) << "The constant size of the attribute layer is wrong";
+    std::memcpy(this->m_values.data(), values.data, values.size);
+}
+
+EInferStatus AttributeLayer::forward(const std::vector<std::shared_ptr<Tensor>> &inputs,
+                                     std::vector<std::shared_ptr<Tensor>> &outputs) {
+    if (outputs.empty()) {
+        LOG(ERROR) << "The output tensor array in the attribute layer is empty";
+        return EInferStatus::EIS_InferFailedOutputEmpty;
+    }
+
+    for (uint32_t i = 0; i < outputs.size(); ++i) {
+        const std::shared_ptr<Tensor> &output = outputs.at(i);
+        if (output == nullptr || output->empty()) {
+            LOG(ERROR) << "The output tensor array in the attribute layer has an empty tensor " << i << " th";
+            return EInferStatus::EIS_InferFailedOutputEmpty;
+        }
+        if (output->size() != this->m_values.size()) {
+            LOG(ERROR) << "The output tensor size of the attribute layer do not match the constant " << i << " th";
+            return EInferStatus::EIS_InferFailedOutputSizeError;
+        }
+        output->fill(this->m_values, true);
+    }
+    return EInferStatus::EIS_InferSuccess;
+}
+
+const std::vector<float> &AttributeLayer::values() const {
+    return this->m_values;
+}
+
+EParseParameterAttrStatus
+AttributeLayer::get_instance(const std::shared_ptr<RuntimeOperator> &op, std::shared_ptr<Layer> &attribute_layer) {
+    CHECK(op != nullptr) << "Attribute operator is nullptr";
+    // pnnx.Attribute只有一个属性，属性名由导出时的权重名决定
+    if (op->m_attribute.size() != 1 || op->m_attribute.begin()->second == nullptr ||
+        op->m_attribute.begin()->second->weight_span().empty()) {
+        LOG(ERROR) << "Can not find the constant data in the attribute operator " << op->m_name;
+        return EParseParameterAttrStatus::EPPAS_AttrMissingWeight;
+    }
+    const std::shared_ptr<RuntimeAttribute> &attribute = op->m_attribute.begin()->second;
+    attribute_layer = std::make_shared<AttributeLayer>(attribute->weight_span());
+    attribute->clear_weight();
+    return EParseParameterAttrStatus::EPPAS_ParameterAttrParseSuccess;
+}
+
+// 使用工具类注册算子
+LayerRegistererWrapper attribute_get_instance("pnnx.Attribute", AttributeLayer::get_instance);
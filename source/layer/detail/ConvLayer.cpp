@@ -8,18 +8,17 @@ ConvLayer::ConvLayer(uint32_t output_channel, uint32_t in_channel,
                      uint32_t kernel_h, uint32_t kernel_w,
                      uint32_t padding_h, uint32_t padding_w,
                      uint32_t stride_h, uint32_t stride_w,
-                     uint32_t groups, bool use_bias)
-        : ParamLayer("Convolution"),
+                     uint32_t groups, bool use_bias, bool lazy_weights)
+        : ParamLayer("Convolution", lazy_weights),
           m_use_bias(use_bias),
           m_groups(groups),
-          m_padding_h(padding_h),
-          m_padding_w(padding_w),
+          m_padding{padding_h, padding_h, padding_w, padding_w, 0.f},
           m_stride_h(stride_h),
           m_stride_w(stride_w) {
     if (groups != 1) {
         in_channel /= groups;
     }
-    this->init_weight_param(output_channel, in_channel, kernel_h, kernel_w);
+    this->init_kernel_matrix(output_channel, in_channel, kernel_h, kernel_w);
     if (m_use_bias) {
         this->init_bias_param(output_channel, 1, 1, 1);
     }
@@ -74,18 +73,15 @@ EInferStatus ConvLayer::forward(
     const uint32_t kernel_count_group = kernel_count / this->m_groups;
     const uint32_t batch_size = inputs.size();
 
-    if (this->m_kernel_matrix_arr.empty()) {
-        this->init_IM2COL_weight();
-    }
+    // kernel矩阵在构造或者写入延迟加载的权重时分配，forward期间不修改层的状态，可以被多个上下文同时调用
+    CHECK(!this->m_kernel_matrix_arr.empty()) << "The kernel matrix of the convolution layer is not initialized";
 
-    if (!this->m_kernel_matrix_arr.empty()) {
-        if (this->m_groups == 1) {
-            CHECK(this->m_kernel_matrix_arr.size() == kernel_count_group)
-                            << "The number of kernel matrix and kernel_count_group do not match";
-        } else {
-            CHECK(this->m_kernel_matrix_arr.size() == kernel_count)
-                            << "The number of kernel matrix and kernel_count do not match";
-        }
+    if (this->m_groups == 1) {
+        CHECK(this->m_kernel_matrix_arr.size() == kernel_count_group)
+                        << "The number of kernel matrix and kernel_count_group do not match";
+    } else {
+        CHECK(this->m_kernel_matrix_arr.size() == kernel_count)
+                        << "The number of kernel matrix and kernel_count do not match";
     }
 
     for (uint32_t i = 0; i < batch_size; ++i) {
@@ -96,8 +92,8 @@ EInferStatus ConvLayer::forward(
                         << i << " th";
 
         const uint32_t input_c = input->channels();
-        const uint32_t input_padded_h = input->rows() + 2 * this->m_padding_h;
-        const uint32_t input_padded_w = input->cols() + 2 * this->m_padding_w;
+        const uint32_t input_padded_h = input->rows() + this->m_padding.top + this->m_padding.bottom;
+        const uint32_t input_padded_w = input->cols() + this->m_padding.left + this->m_padding.right;
 
         const uint32_t output_h =
                 std::floor((int(input_padded_h) - int(kernel_h)) / this->m_stride_h + 1);
@@ -161,30 +157,52 @@ arma::fmat ConvLayer::IM2COL(std::shared_ptr<Tensor> input, uint32_t kernel_w,
                              uint32_t group, uint32_t row_len,
                              uint32_t col_len) const {
     arma::fmat input_matrix(input_c_group * row_len, col_len);
-    const uint32_t input_padded_h = input_h + 2 * this->m_padding_h;
-    const uint32_t input_padded_w = input_w + 2 * this->m_padding_w;
-    const float padding_value = 0.f;
+    const PaddingDesc &padding = this->m_padding;
+    const uint32_t input_padded_h = input_h + padding.top + padding.bottom;
+    const uint32_t input_padded_w = input_w + padding.left + padding.right;
+    const uint32_t output_h = (input_padded_h - kernel_h) / this->m_stride_h + 1;
+    const uint32_t output_w = (input_padded_w - kernel_w) / this->m_stride_w + 1;
+
+    // 窗口完全落在输入内部的输出范围，内部区域直接按列拷贝，不需要逐元素判断边界
+    uint32_t interior_h_begin = 0, interior_h_end = 0;
+    uint32_t interior_w_begin = 0, interior_w_end = 0;
+    padding_interior_range(input_h, padding.top, kernel_h, this->m_stride_h, output_h,
+                           interior_h_begin, interior_h_end);
+    padding_interior_range(input_w, padding.left, kernel_w, this->m_stride_w, output_w,
+                           interior_w_begin, interior_w_end);
+
     for (uint32_t ic = 0; ic < input_c_group; ++ic) {
-        float *input_channel_ptr =
+        const float *input_channel_ptr =
                 input->matrix_raw_ptr(ic + group * input_c_group);
         uint32_t current_col = 0;
         uint32_t channel_row = ic * row_len;
-        for (uint32_t w = 0; w < input_padded_w - kernel_w + 1; w += this->m_stride_w) {
-            for (uint32_t r = 0; r < input_padded_h - kernel_h + 1; r += this->m_stride_h) {
+        for (uint32_t ow = 0; ow < output_w; ++ow) {
+            const uint32_t w = ow * this->m_stride_w;
+            const bool interior_w = ow >= interior_w_begin && ow < interior_w_end;
+            for (uint32_t oh = 0; oh < output_h; ++oh) {
+                const uint32_t r = oh * this->m_stride_h;
                 float *input_matrix_ptr =
                         input_matrix.colptr(current_col) + channel_row;
                 current_col += 1;
+                if (interior_w && oh >= interior_h_begin && oh < interior_h_end) {
+                    // 内部区域：kernel的每一列在输入中连续
+                    for (uint32_t kw = 0; kw < kernel_w; ++kw) {
+                        const float *region_ptr = input_channel_ptr +
+                                                  input_h * (w + kw - padding.left) + (r - padding.top);
+                        std::memcpy(input_matrix_ptr, region_ptr, kernel_h * sizeof(float));
+                        input_matrix_ptr += kernel_h;
+                    }
+                    continue;
+                }
+                // 边界区域：落在填充中的位置直接写入填充值
                 for (uint32_t kw = 0; kw < kernel_w; ++kw) {
-                    const uint32_t region_w = input_h * (w + kw - this->m_padding_w);
+                    const bool valid_w = kw + w >= padding.left && kw + w < input_w + padding.left;
+                    const uint32_t region_w = input_h * (w + kw - padding.left);
                     for (uint32_t kh = 0; kh < kernel_h; ++kh) {
-                        if ((kh + r >= this->m_padding_h && kw + w >= this->m_padding_w) &&
-                            (kh + r < input_h + this->m_padding_h &&
-                             kw + w < input_w + this->m_padding_w)) {
-                            float *region_ptr =
-                                    input_channel_ptr + region_w + (r + kh - this->m_padding_h);
-                            *input_matrix_ptr = *region_ptr;
+                        if (valid_w && kh + r >= padding.top && kh + r < input_h + padding.top) {
+                            *input_matrix_ptr = *(input_channel_ptr + region_w + (r + kh - padding.top));
                         } else {
-                            *input_matrix_ptr = padding_value;  // only support zero mode
+                            *input_matrix_ptr = padding.value;
                         }
                         input_matrix_ptr += 1;
                     }
@@ -221,6 +239,39 @@ void ConvLayer::conv_GEMM_bias(
     }
 }
 
+void ConvLayer::init_kernel_matrix(uint32_t kernel_count, uint32_t kernel_c,
+                                   uint32_t kernel_h, uint32_t kernel_w) {
+    this->m_weight_shape = {kernel_count, kernel_c, kernel_h, kernel_w};
+    if (!this->m_lazy_weights) {
+        this->allocate_kernel_matrix();
+    }
+}
+
+void ConvLayer::allocate_kernel_matrix() {
+    const uint32_t kernel_count = this->m_weight_shape.at(0);
+    const uint32_t kernel_c = this->m_weight_shape.at(1);
+    const uint32_t kernel_h = this->m_weight_shape.at(2);
+    const uint32_t kernel_w = this->m_weight_shape.at(3);
+    arma::frowvec kernel_matrix_c(kernel_h * kernel_w * kernel_c);
+    kernel_matrix_c.zeros();
+    this->m_kernel_matrix_arr.assign(kernel_count, kernel_matrix_c);
+    this->bind_kernel_weights(kernel_c, kernel_h, kernel_w);
+}
+
+void ConvLayer::bind_kernel_weights(uint32_t kernel_c, uint32_t kernel_h, uint32_t kernel_w) {
+    // 第k个卷积核的各通道按列主序依次排列，与第k个IM2COL行向量的布局相同
+    this->m_weights.resize(this->m_kernel_matrix_arr.size());
+    for (uint32_t k = 0; k < this->m_kernel_matrix_arr.size(); ++k) {
+        this->m_weights.at(k) = std::make_shared<Tensor>(this->m_kernel_matrix_arr.at(k).memptr(),
+                                                         kernel_c, kernel_h, kernel_w);
+    }
+}
+
+void ConvLayer::set_weights(const std::vector<std::shared_ptr<Tensor>> &weights) {
+    ParamLayer::set_weights(weights);
+    this->init_IM2COL_weight();
+}
+
 void ConvLayer::init_IM2COL_weight() {
     const uint32_t kernel_count = this->m_weights.size();
     CHECK(kernel_count > 0) << "kernel count must greater than zero";
@@ -270,6 +321,51 @@ void ConvLayer::init_IM2COL_weight() {
         CHECK(kernel_matrix_arr.size() == kernel_count);
         this->m_kernel_matrix_arr = std::move(kernel_matrix_arr);
     }
+    // 权重张量改为引用新的IM2COL行向量，不再保留单独的存储
+    this->bind_kernel_weights(kernel_c, kernel_h, kernel_w);
+}
+
+void ConvLayer::allocate_weights() {
+    // 权重张量引用IM2COL行向量，先分配kernel矩阵，偏移按记录的形状分配
+    if (this->m_weights.empty()) {
+        this->allocate_kernel_matrix();
+    }
+    ParamLayer::allocate_weights();
+}
+
+bool ConvLayer::fuse_padding(const PaddingDesc &padding) {
+    // 卷积自身的填充值为0，两者填充值不同时无法合并
+    if (!this->m_padding.empty() && padding.value != this->m_padding.value) {
+        return false;
+    }
+    this->m_padding += padding;
+    this->m_padding.value = padding.value;
+    return true;
+}
+
+bool ConvLayer::infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                                    std::vector<uint32_t> &output_shapes) const {
+    // 使用构造时记录的卷积核形状，延迟加载的层在分配权重之前也能推导
+    if (input_shapes.size() != 1 || input_shapes.front().size() != 3 || this->m_weight_shape.empty()) {
+        return false;
+    }
+    const std::vector<uint32_t> &input_shape = input_shapes.front();
+    const uint32_t kernel_count = this->m_weight_shape.at(0);
+    const uint32_t kernel_c = this->m_weight_shape.at(1);
+    const uint32_t kernel_h = this->m_weight_shape.at(2);
+    const uint32_t kernel_w = this->m_weight_shape.at(3);
+    if (kernel_count == 0 || input_shape.at(0) != kernel_c * this->m_groups) {
+        return false;
+    }
+    const uint32_t input_padded_h = input_shape.at(1) + this->m_padding.top + this->m_padding.bottom;
+    const uint32_t input_padded_w = input_shape.at(2) + this->m_padding.left + this->m_padding.right;
+    if (input_padded_h < kernel_h || input_padded_w < kernel_w) {
+        return false;
+    }
+    output_shapes = {kernel_count,
+                     (input_padded_h - kernel_h) / this->m_stride_h + 1,
+                     (input_padded_w - kernel_w) / this->m_stride_w + 1};
+    return true;
 }
 
 EParseParameterAttrStatus ConvLayer::get_instance(
@@ -411,7 +507,7 @@ EParseParameterAttrStatus ConvLayer::get_instance(
     conv_layer = std::make_shared<ConvLayer>(
             out_channel->value, in_channel->value, kernels.at(0), kernels.at(1),
             paddings.at(0), paddings.at(1), strides.at(0), strides.at(1),
-            groups->value, use_bias->value);
+            groups->value, use_bias->value, op->m_lazy_weights);
 
     // load weights
     const std::map<std::string, std::shared_ptr<RuntimeAttribute>> &attrs =
@@ -428,8 +524,10 @@ EParseParameterAttrStatus ConvLayer::get_instance(
             return EParseParameterAttrStatus::EPPAS_AttrMissingBias;
         }
 
-        const std::vector<float> &bias_values = bias->get_weight_data<float>();
-        conv_layer->set_bias(bias_values);
+        if (!op->m_lazy_weights) {
+            conv_layer->set_bias(bias->weight_span());
+            bias->clear_weight();
+        }
     }
 
     if (attrs.find("weight") == attrs.end()) {
@@ -444,13 +542,16 @@ EParseParameterAttrStatus ConvLayer::get_instance(
         return EParseParameterAttrStatus::EPPAS_AttrMissingWeight;
     }
 
-    const std::vector<float> &weight_values = weight->get_weight_data<float>();
-    conv_layer->set_weights(weight_values);
+    if (op->m_lazy_weights) {
+        // 延迟加载时只记录权重和偏移所在的属性，第一次forward之前再写入
+        std::static_pointer_cast<ConvLayer>(conv_layer)->defer_weights(
+                weight, use_bias->value ? attrs.at("bias") : nullptr);
+        return EParseParameterAttrStatus::EPPAS_ParameterAttrParseSuccess;
+    }
 
-    auto conv_layer_derived =
-            std::dynamic_pointer_cast<ConvLayer>(conv_layer);
-    CHECK(conv_layer_derived != nullptr);
-    conv_layer_derived->init_IM2COL_weight();
+    // 权重张量引用IM2COL行向量，从视图写入一次即得到计算时的排布
+    conv_layer->set_weights(weight->weight_span());
+    weight->clear_weight();
     return EParseParameterAttrStatus::EPPAS_ParameterAttrParseSuccess;
 }
 
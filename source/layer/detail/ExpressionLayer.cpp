@@ -7,7 +7,11 @@
 ExpressionLayer::ExpressionLayer(std::string statement) : NonParamLayer("Expression"),
                                                           m_statement(std::move(statement)) {
     this->m_parser = std::make_unique<ExpressionParser>(m_statement);
-
+    // 构造时完成解析，forward只读取逆波兰式，多个线程可以同时调用
+    this->m_parser->tokenizer(false);
+    CHECK(!this->m_parser->tokens().empty())
+                    << "The expression parser failed to parse " << this->m_statement;
+    this->m_token_nodes = this->m_parser->generate();
 }
 
 EInferStatus ExpressionLayer::forward(const std::vector<std::shared_ptr<Tensor>> &inputs,
@@ -22,11 +26,7 @@ EInferStatus ExpressionLayer::forward(const std::vector<std::shared_ptr<Tensor>>
         return EInferStatus::EIS_InferFailedOutputEmpty;
     }
 
-    CHECK(this->m_parser != nullptr)
-                    << "The parser in the expression layer is null!";
-    this->m_parser->tokenizer(false);
-    const auto &expressions = this->m_parser->tokens();
-    CHECK(!expressions.empty())
+    CHECK(!this->m_token_nodes.empty())
                     << "The expression parser failed to parse " << this->m_statement;
 
     for (uint32_t i = 0; i < inputs.size(); ++i) {
@@ -47,13 +47,12 @@ EInferStatus ExpressionLayer::forward(const std::vector<std::shared_ptr<Tensor>>
                         << i << "th";
             return EInferStatus::EIS_InferFailedOutputEmpty;
         }
-        outputs.at(i)->fill(0.f);
     }
 
     std::stack<std::vector<std::shared_ptr<Tensor>>> op_stack;
-    const std::vector<std::shared_ptr<TokenNode>> &token_nodes =
-            this->m_parser->generate();
-    for (const auto &token_node: token_nodes) {
+    const std::vector<std::shared_ptr<TokenNode>> &token_nodes = this->m_token_nodes;
+    for (uint32_t t = 0; t < token_nodes.size(); ++t) {
+        const auto &token_node = token_nodes.at(t);
         if (token_node->num_index >= 0) {
             // process operator
             uint32_t start_pos = token_node->num_index * batch_size;
@@ -87,11 +86,20 @@ EInferStatus ExpressionLayer::forward(const std::vector<std::shared_ptr<Tensor>>
                             << batch_size;
             op_stack.pop();
 
+            // 最后一步运算直接写入输出，原地计算时输出与某个输入是同一个张量
+            const bool is_root = t + 1 == token_nodes.size();
             std::vector<std::shared_ptr<Tensor>> output_token_nodes(
                     batch_size);
             for (uint32_t i = 0; i < batch_size; ++i) {
                 // do execution
-                if (op == int(ETokenType::ETT_TokenAdd)) {
+                if (is_root) {
+                    output_token_nodes.at(i) = outputs.at(i);
+                    if (op == int(ETokenType::ETT_TokenAdd)) {
+                        tensor_add(input_node1.at(i), input_node2.at(i), outputs.at(i));
+                    } else {
+                        tensor_multiply(input_node1.at(i), input_node2.at(i), outputs.at(i));
+                    }
+                } else if (op == int(ETokenType::ETT_TokenAdd)) {
                     output_token_nodes.at(i) =
                             tensor_add(input_node1.at(i), input_node2.at(i));
                 } else if (op == int(ETokenType::ETT_TokenMul)) {
@@ -117,6 +125,33 @@ EInferStatus ExpressionLayer::forward(const std::vector<std::shared_ptr<Tensor>>
     return EInferStatus::EIS_InferSuccess;
 }
 
+bool ExpressionLayer::support_inplace() const {
+    return true;
+}
+
+// 操作数的形状按最后一维对齐后逐维广播，与Tensor按通道、行、列广播的结果一致
+bool ExpressionLayer::infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                                          std::vector<uint32_t> &output_shapes) const {
+    if (input_shapes.empty()) {
+        return false;
+    }
+    output_shapes.clear();
+    for (const std::vector<uint32_t> &input_shape: input_shapes) {
+        if (input_shape.size() > output_shapes.size()) {
+            output_shapes.insert(output_shapes.begin(), input_shape.size() - output_shapes.size(), 1);
+        }
+        const uint32_t offset = output_shapes.size() - input_shape.size();
+        for (uint32_t i = 0; i < input_shape.size(); ++i) {
+            uint32_t &shape = output_shapes.at(offset + i);
+            if (shape != input_shape.at(i) && shape != 1 && input_shape.at(i) != 1) {
+                return false;
+            }
+            shape = std::max(shape, input_shape.at(i));
+        }
+    }
+    return true;
+}
+
 EParseParameterAttrStatus
 ExpressionLayer::get_instance(const std::shared_ptr<RuntimeOperator> &op, std::shared_ptr<Layer> &expression_layer) {
     CHECK(op != nullptr) << "Expression operator is nullptr";
@@ -71,6 +71,26 @@ EInferStatus FlattenLayer::forward(
     return EInferStatus::EIS_InferSuccess;
 }
 
+bool FlattenLayer::infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                                       std::vector<uint32_t> &output_shapes) const {
+    // 与forward相同，输入加上batch维度后为NCHW
+    if (input_shapes.size() != 1 || input_shapes.front().size() != 3) {
+        return false;
+    }
+    const int total_dim = 4;
+    const int start_dim = this->m_start_dim < 0 ? total_dim + this->m_start_dim : this->m_start_dim;
+    const int end_dim = this->m_end_dim < 0 ? total_dim + this->m_end_dim : this->m_end_dim;
+    if (start_dim < 1 || end_dim > 3 || end_dim <= start_dim) {
+        return false;
+    }
+    const std::vector<uint32_t> &input_shape = input_shapes.front();
+    output_shapes.assign(input_shape.begin(), input_shape.begin() + start_dim - 1);
+    output_shapes.push_back(std::accumulate(input_shape.begin() + start_dim - 1, input_shape.begin() + end_dim,
+                                            1u, std::multiplies()));
+    output_shapes.insert(output_shapes.end(), input_shape.begin() + end_dim, input_shape.end());
+    return true;
+}
+
 EParseParameterAttrStatus FlattenLayer::create_instance(
         const std::shared_ptr<RuntimeOperator> &op,
         std::shared_ptr<Layer> &flatten_layer) {
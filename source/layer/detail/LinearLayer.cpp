@@ -4,8 +4,8 @@
 
 #include "layer/deatil/LinearLayer.hpp"
 
-LinearLayer::LinearLayer(int32_t in_features, int32_t out_features, bool use_bias) :
-        ParamLayer("Linear"),
+LinearLayer::LinearLayer(int32_t in_features, int32_t out_features, bool use_bias, bool lazy_weights) :
+        ParamLayer("Linear", lazy_weights),
         m_use_bias(use_bias),
         m_in_features(in_features),
         m_out_features(out_features) {
@@ -111,6 +111,20 @@ EInferStatus LinearLayer::forward(const std::vector<std::shared_ptr<Tensor>> &in
     return EInferStatus::EIS_InferSuccess;
 }
 
+bool LinearLayer::infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                                      std::vector<uint32_t> &output_shapes) const {
+    // forward只支持一维或二维的输入，最后一维为in_features
+    if (input_shapes.size() != 1 || input_shapes.front().empty() || input_shapes.front().size() > 2) {
+        return false;
+    }
+    if (input_shapes.front().back() != uint32_t(this->m_in_features)) {
+        return false;
+    }
+    output_shapes = input_shapes.front();
+    output_shapes.back() = this->m_out_features;
+    return true;
+}
+
 EParseParameterAttrStatus LinearLayer::get_instance(const std::shared_ptr<RuntimeOperator> &op,
                                                     std::shared_ptr<Layer> &linear_layer) {
     CHECK(op != nullptr) << "Linear operator is nullptr";
@@ -154,13 +168,20 @@ EParseParameterAttrStatus LinearLayer::get_instance(const std::shared_ptr<Runtim
     const bool use_bias = use_bias_param->value;
 
     linear_layer =
-            std::make_shared<LinearLayer>(in_features, out_features, use_bias);
+            std::make_shared<LinearLayer>(in_features, out_features, use_bias, op->m_lazy_weights);
+    if (op->m_lazy_weights) {
+        // 延迟加载时只记录权重和偏移所在的属性，第一次forward之前再写入
+        std::static_pointer_cast<LinearLayer>(linear_layer)->defer_weights(weight, use_bias ? bias : nullptr);
+        return EParseParameterAttrStatus::EPPAS_ParameterAttrParseSuccess;
+    }
     if (use_bias) {
-        linear_layer->set_bias(bias->get_weight_data<float>());
+        linear_layer->set_bias(bias->weight_span());
+        bias->clear_weight();
     }
 
-    // load weights
-    linear_layer->set_weights(weight->get_weight_data<float>());
+    // load weights，从视图直接转置写入列主序的权重矩阵
+    linear_layer->set_weights(weight->weight_span());
+    weight->clear_weight();
     return EParseParameterAttrStatus::EPPAS_ParameterAttrParseSuccess;
 }
 
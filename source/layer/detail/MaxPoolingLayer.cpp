@@ -7,8 +7,7 @@
 MaxPoolingLayer::MaxPoolingLayer(uint32_t padding_h, uint32_t padding_w, uint32_t pooling_size_h,
                                  uint32_t pooling_size_w, uint32_t stride_h, uint32_t stride_w) :
         NonParamLayer("MaxPooling"),
-        m_padding_h(padding_h),
-        m_padding_w(padding_w),
+        m_padding{padding_h, padding_h, padding_w, padding_w, std::numeric_limits<float>::lowest()},
         m_pooling_size_h(pooling_size_h),
         m_pooling_size_w(pooling_size_w),
         m_stride_h(stride_h),
@@ -47,10 +46,12 @@ EInferStatus MaxPoolingLayer::forward(const std::vector<std::shared_ptr<Tensor>>
         uint32_t input_h = input_data->rows();
         uint32_t input_w = input_data->cols();
         uint32_t output_h = uint32_t(std::floor(
-                ((int(input_h) - int(pooling_h) + 2 * this->m_padding_h) / (m_stride_h)) + 1
+                ((int(input_h) - int(pooling_h) + int(this->m_padding.top + this->m_padding.bottom)) /
+                 (m_stride_h)) + 1
         ));
         uint32_t output_w = uint32_t(std::floor(
-                ((int(input_w) - int(pooling_w) + 2 * this->m_padding_w) / (m_stride_w)) + 1
+                ((int(input_w) - int(pooling_w) + int(this->m_padding.left + this->m_padding.right)) /
+                 (m_stride_w)) + 1
         ));
 
         if (output_w == 0 || output_h == 0) {
@@ -77,8 +78,9 @@ EInferStatus MaxPoolingLayer::forward(const std::vector<std::shared_ptr<Tensor>>
 
         const uint32_t input_h = input_data->rows();
         const uint32_t input_w = input_data->cols();
-        const uint32_t input_padded_h = input_data->rows() + 2 * this->m_padding_h;
-        const uint32_t input_padded_w = input_data->cols() + 2 * this->m_padding_w;
+        const PaddingDesc &padding = this->m_padding;
+        const uint32_t input_padded_h = input_data->rows() + padding.top + padding.bottom;
+        const uint32_t input_padded_w = input_data->cols() + padding.left + padding.right;
 
         const uint32_t input_ch = input_data->channels();
         const uint32_t output_h = uint32_t(std::floor((int(input_padded_h) - int(pooling_h)) / this->m_stride_h + 1));
@@ -95,28 +97,43 @@ EInferStatus MaxPoolingLayer::forward(const std::vector<std::shared_ptr<Tensor>>
                         << "The output tensor array in the max pooling layer has an incorrectly sized tensor " << i
                         << "th";
 
+        // 窗口完全落在输入内部的输出范围，内部区域不需要逐元素判断边界
+        uint32_t interior_h_begin = 0, interior_h_end = 0;
+        uint32_t interior_w_begin = 0, interior_w_end = 0;
+        padding_interior_range(input_h, padding.top, pooling_h, this->m_stride_h, output_h,
+                               interior_h_begin, interior_h_end);
+        padding_interior_range(input_w, padding.left, pooling_w, this->m_stride_w, output_w,
+                               interior_w_begin, interior_w_end);
+
         for (uint32_t ic = 0; ic < input_ch; ic++) {
             const arma::fmat &input_channel = input_data->slice(ic);
             arma::fmat &output_channel = output_data->slice(ic);
-            for (uint32_t c = 0; c < input_padded_w - pooling_w + 1; c += this->m_stride_w) {
-                int output_col = int(c / this->m_stride_w);
-                for (uint32_t r = 0; r < input_padded_h - pooling_h + 1;
-                     r += this->m_stride_h) {
-                    int output_row = int(r / this->m_stride_h);
-                    float *output_channel_ptr = output_channel.colptr(output_col);
+            for (uint32_t output_col = 0; output_col < output_w; ++output_col) {
+                const uint32_t c = output_col * this->m_stride_w;
+                const bool interior_w = output_col >= interior_w_begin && output_col < interior_w_end;
+                float *output_channel_ptr = output_channel.colptr(output_col);
+                for (uint32_t output_row = 0; output_row < output_h; ++output_row) {
+                    const uint32_t r = output_row * this->m_stride_h;
                     float max_value = std::numeric_limits<float>::lowest();
-                    for (uint32_t w = 0; w < pooling_w; ++w) {
-                        const float *col_ptr = input_channel.colptr(c + w - this->m_padding_w);
-                        for (uint32_t h = 0; h < pooling_h; ++h) {
-                            float current_value = 0.f;
-                            if ((h + r >= this->m_padding_h && w + c >= this->m_padding_w) &&
-                                (h + r < input_h + this->m_padding_h &&
-                                 w + c < input_w + this->m_padding_w)) {
-                                current_value = *(col_ptr + r + h - this->m_padding_h);
-                            } else {
-                                current_value = std::numeric_limits<float>::lowest();
+                    if (interior_w && output_row >= interior_h_begin && output_row < interior_h_end) {
+                        for (uint32_t w = 0; w < pooling_w; ++w) {
+                            const float *col_ptr = input_channel.colptr(c + w - padding.left) + r - padding.top;
+                            for (uint32_t h = 0; h < pooling_h; ++h) {
+                                max_value = max_value > col_ptr[h] ? max_value : col_ptr[h];
+                            }
+                        }
+                    } else {
+                        // 边界区域：落在填充中的位置取填充值
+                        for (uint32_t w = 0; w < pooling_w; ++w) {
+                            const bool valid_w = w + c >= padding.left && w + c < input_w + padding.left;
+                            for (uint32_t h = 0; h < pooling_h; ++h) {
+                                float current_value = padding.value;
+                                if (valid_w && h + r >= padding.top && h + r < input_h + padding.top) {
+                                    current_value = *(input_channel.colptr(c + w - padding.left) +
+                                                      r + h - padding.top);
+                                }
+                                max_value = max_value > current_value ? max_value : current_value;
                             }
-                            max_value = max_value > current_value ? max_value : current_value;
                         }
                     }
                     *(output_channel_ptr + output_row) = max_value;
@@ -127,6 +144,33 @@ EInferStatus MaxPoolingLayer::forward(const std::vector<std::shared_ptr<Tensor>>
     return EInferStatus::EIS_InferSuccess;
 }
 
+bool MaxPoolingLayer::fuse_padding(const PaddingDesc &padding) {
+    // 自身的填充不参与取最大值，与填充值不同的显式填充无法合并
+    if (!this->m_padding.empty() && padding.value != this->m_padding.value) {
+        return false;
+    }
+    this->m_padding += padding;
+    this->m_padding.value = padding.value;
+    return true;
+}
+
+bool MaxPoolingLayer::infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                                          std::vector<uint32_t> &output_shapes) const {
+    if (input_shapes.size() != 1 || input_shapes.front().size() != 3) {
+        return false;
+    }
+    const std::vector<uint32_t> &input_shape = input_shapes.front();
+    const uint32_t input_padded_h = input_shape.at(1) + this->m_padding.top + this->m_padding.bottom;
+    const uint32_t input_padded_w = input_shape.at(2) + this->m_padding.left + this->m_padding.right;
+    if (input_padded_h < this->m_pooling_size_h || input_padded_w < this->m_pooling_size_w) {
+        return false;
+    }
+    output_shapes = {input_shape.at(0),
+                     (input_padded_h - this->m_pooling_size_h) / this->m_stride_h + 1,
+                     (input_padded_w - this->m_pooling_size_w) / this->m_stride_w + 1};
+    return true;
+}
+
 EParseParameterAttrStatus
 MaxPoolingLayer::get_instance(const std::shared_ptr<RuntimeOperator> &op, std::shared_ptr<Layer> &max_layer) {
     CHECK(op != nullptr) << "MaxPooling get instance failed, operator is nullptr";
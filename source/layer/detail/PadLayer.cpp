@@ -0,0 +1,150 @@
+//
+// Created by xyzzzh on 2024/4/22.
+//
+
+#include "layer/deatil/PadLayer.hpp"
+
+PadLayer::PadLayer(const PaddingDesc &padding) :
+        NonParamLayer("Pad"), m_padding(padding) {}
+
+EInferStatus PadLayer::forward(
+        const std::vector<std::shared_ptr<Tensor>> &inputs,
+        std::vector<std::shared_ptr<Tensor>> &outputs) {
+    if (inputs.empty()) {
+        LOG(ERROR) << "The input tensor array in the pad layer is empty";
+        return EInferStatus::EIS_InferFailedInputEmpty;
+    }
+
+    if (inputs.size() != outputs.size()) {
+        LOG(ERROR) << "The input and output tensor array size of the pad layer "
+                      "do not match";
+        return EInferStatus::EIS_InferFailedInputOutSizeMatchError;
+    }
+
+    const PaddingDesc &padding = this->m_padding;
+    for (uint32_t i = 0; i < inputs.size(); ++i) {
+        const std::shared_ptr<Tensor> &input = inputs.at(i);
+        if (input == nullptr || input->empty()) {
+            LOG(ERROR) << "The input tensor array in the pad layer has an empty tensor " << i << " th";
+            return EInferStatus::EIS_InferFailedInputEmpty;
+        }
+
+        // 填充已经折叠到后继层，由后继层在计算时生成填充值
+        if (this->m_folded) {
+            outputs.at(i) = input;
+            continue;
+        }
+
+        const uint32_t output_h = input->rows() + padding.top + padding.bottom;
+        const uint32_t output_w = input->cols() + padding.left + padding.right;
+        std::shared_ptr<Tensor> output = outputs.at(i);
+        if (output == nullptr || output->empty() || output == input) {
+            output = std::make_shared<Tensor>(input->channels(), output_h, output_w);
+            outputs.at(i) = output;
+        }
+        if (output->channels() != input->channels() || output->rows() != output_h ||
+            output->cols() != output_w) {
+            LOG(ERROR) << "The output tensor array in the pad layer has an incorrectly sized tensor " << i << " th";
+            return EInferStatus::EIS_InferFailedOutputSizeError;
+        }
+
+        output->fill(padding.value);
+        const uint32_t input_h = input->rows();
+        for (uint32_t c = 0; c < input->channels(); ++c) {
+            const float *input_ptr = input->matrix_raw_ptr(c);
+            float *output_ptr = output->matrix_raw_ptr(c);
+            for (uint32_t w = 0; w < input->cols(); ++w) {
+                std::memcpy(output_ptr + (w + padding.left) * output_h + padding.top,
+                            input_ptr + w * input_h, input_h * sizeof(float));
+            }
+        }
+    }
+    return EInferStatus::EIS_InferSuccess;
+}
+
+bool PadLayer::fold_padding_into(Layer &next) {
+    if (this->m_folded) {
+        return true;
+    }
+    if (next.fuse_padding(this->m_padding)) {
+        this->m_folded = true;
+    }
+    return this->m_folded;
+}
+
+int32_t PadLayer::aliased_input() const {
+    return this->m_folded ? 0 : -1;
+}
+
+bool PadLayer::infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                                   std::vector<uint32_t> &output_shapes) const {
+    if (input_shapes.size() != 1 || input_shapes.front().size() < 2) {
+        return false;
+    }
+    output_shapes = input_shapes.front();
+    if (!this->m_folded) {
+        const uint32_t rank = output_shapes.size();
+        output_shapes.at(rank - 2) += this->m_padding.top + this->m_padding.bottom;
+        output_shapes.at(rank - 1) += this->m_padding.left + this->m_padding.right;
+    }
+    return true;
+}
+
+EParseParameterAttrStatus PadLayer::get_instance(
+        const std::shared_ptr<RuntimeOperator> &op,
+        std::shared_ptr<Layer> &pad_layer) {
+    CHECK(op != nullptr) << "Pad operator is nullptr";
+    const auto &params = op->m_params;
+
+    // nn.ZeroPad2d和nn.ConstantPad2d的参数名为padding，F.pad的参数名为pad
+    const std::string pad_name = params.find("padding") != params.end() ? "padding" : "pad";
+    if (params.find(pad_name) == params.end()) {
+        LOG(ERROR) << "Can not find the padding parameter";
+        return EParseParameterAttrStatus::EPPAS_ParameterMissingPadding;
+    }
+
+    auto pads = std::dynamic_pointer_cast<RuntimeParameterIntArray>(params.at(pad_name));
+    // 顺序为{left, right, top, bottom}，只有两个值时只填充最后一维
+    if (pads == nullptr || (pads->value.size() != 2 && pads->value.size() != 4)) {
+        LOG(ERROR) << "Can not find the right padding parameter";
+        return EParseParameterAttrStatus::EPPAS_ParameterMissingPadding;
+    }
+    for (int pad: pads->value) {
+        if (pad < 0) {
+            LOG(ERROR) << "Negative padding is not supported";
+            return EParseParameterAttrStatus::EPPAS_ParameterMissingPadding;
+        }
+    }
+
+    if (params.find("mode") != params.end()) {
+        auto mode = std::dynamic_pointer_cast<RuntimeParameterString>(params.at("mode"));
+        if (mode == nullptr || mode->value != "constant") {
+            LOG(ERROR) << "Padding mode unsupported";
+            return EParseParameterAttrStatus::EPPAS_ParameterMissingPaddingMode;
+        }
+    }
+
+    PaddingDesc padding;
+    padding.left = pads->value.at(0);
+    padding.right = pads->value.at(1);
+    if (pads->value.size() == 4) {
+        padding.top = pads->value.at(2);
+        padding.bottom = pads->value.at(3);
+    }
+    // nn.ZeroPad2d没有value参数，F.pad的value可能为None
+    if (params.find("value") != params.end()) {
+        auto value = std::dynamic_pointer_cast<RuntimeParameterFloat>(params.at("value"));
+        if (value != nullptr) {
+            padding.value = value->value;
+        }
+    }
+
+    pad_layer = std::make_shared<PadLayer>(padding);
+    return EParseParameterAttrStatus::EPPAS_ParameterAttrParseSuccess;
+}
+
+LayerRegistererWrapper zero_pad_create_instance("nn.ZeroPad2d", PadLayer::get_instance);
+
+LayerRegistererWrapper constant_pad_create_instance("nn.ConstantPad2d", PadLayer::get_instance);
+
+LayerRegistererWrapper functional_pad_create_instance("F.pad", PadLayer::get_instance);
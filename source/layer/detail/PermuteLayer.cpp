@@ -0,0 +1,254 @@
+//
+// Created by xyzzzh on 2024/4/21.
+//
+
+#include "layer/deatil/PermuteLayer.hpp"
+
+// 把source写入output，output为空、与input共享或者大小不匹配时重新创建
+static EInferStatus write_output(const TensorND &source, const std::shared_ptr<Tensor> &input,
+                                 std::shared_ptr<Tensor> &output) {
+    if (output == nullptr || output->empty() || output == input) {
+        output = source.to_tensor();
+        return EInferStatus::EIS_InferSuccess;
+    }
+    if (output->size() != source.size()) {
+        LOG(ERROR) << "The output size of the permute layer do not match the input size";
+        return EInferStatus::EIS_InferFailedOutputSizeError;
+    }
+
+    const uint32_t dims = source.dims();
+    TensorND destination = TensorND::from_tensor(*output, dims);
+    if (destination.shapes() != source.shapes()) {
+        output->reshape(source.shapes());
+        destination = TensorND::from_tensor(*output, dims);
+    }
+    destination.copy_from(source);
+    return EInferStatus::EIS_InferSuccess;
+}
+
+PermuteLayer::PermuteLayer(std::vector<uint32_t> dims) :
+        NonParamLayer("Permute"), m_dims(std::move(dims)) {}
+
+EInferStatus PermuteLayer::forward(
+        const std::vector<std::shared_ptr<Tensor>> &inputs,
+        std::vector<std::shared_ptr<Tensor>> &outputs) {
+    if (inputs.empty()) {
+        LOG(ERROR) << "The input tensor array in the permute layer is empty";
+        return EInferStatus::EIS_InferFailedInputEmpty;
+    }
+
+    if (inputs.size() != outputs.size()) {
+        LOG(ERROR) << "The input and output tensor array size of the permute layer "
+                      "do not match";
+        return EInferStatus::EIS_InferFailedInputOutSizeMatchError;
+    }
+
+    const uint32_t rank = m_dims.size();
+    for (uint32_t i = 0; i < inputs.size(); ++i) {
+        const std::shared_ptr<Tensor> &input = inputs.at(i);
+        if (input == nullptr || input->empty()) {
+            LOG(ERROR) << "The input tensor array in the permute layer has an empty tensor " << i << " th";
+            return EInferStatus::EIS_InferFailedInputEmpty;
+        }
+
+        const TensorND source = TensorND::from_tensor(*input, rank);
+        if (source.dims() != rank) {
+            LOG(ERROR) << "The dimension of input tensor do not match the permute dims";
+            return EInferStatus::EIS_InferFailedDimensionParameterError;
+        }
+
+        const EInferStatus status = write_output(source.permute(m_dims), input, outputs.at(i));
+        if (status != EInferStatus::EIS_InferSuccess) {
+            return status;
+        }
+    }
+    return EInferStatus::EIS_InferSuccess;
+}
+
+bool PermuteLayer::infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                                       std::vector<uint32_t> &output_shapes) const {
+    if (input_shapes.size() != 1 || input_shapes.front().size() != this->m_dims.size()) {
+        return false;
+    }
+    output_shapes.clear();
+    for (uint32_t dim: this->m_dims) {
+        output_shapes.push_back(input_shapes.front().at(dim));
+    }
+    return true;
+}
+
+// 将包含batch维度的dims转换为不包含batch维度的排列，batch维度必须保持在第0维
+static bool parse_permute_dims(std::vector<int> dims, std::vector<uint32_t> &permute_dims) {
+    const int total_dims = int(dims.size());
+    if (total_dims < 2) {
+        return false;
+    }
+    for (int &dim: dims) {
+        dim = dim < 0 ? dim + total_dims : dim;
+        if (dim < 0 || dim >= total_dims) {
+            return false;
+        }
+    }
+    if (dims.front() != 0) {
+        LOG(ERROR) << "The batch dimension can not be permuted";
+        return false;
+    }
+    permute_dims.clear();
+    for (int i = 1; i < total_dims; ++i) {
+        permute_dims.push_back(uint32_t(dims.at(i) - 1));
+    }
+    return true;
+}
+
+EParseParameterAttrStatus PermuteLayer::get_instance(
+        const std::shared_ptr<RuntimeOperator> &op,
+        std::shared_ptr<Layer> &permute_layer) {
+    CHECK(op != nullptr) << "Permute operator is nullptr";
+    const auto &params = op->m_params;
+    if (params.find("dims") == params.end()) {
+        LOG(ERROR) << "Can not find the dims parameter";
+        return EParseParameterAttrStatus::EPPAS_ParameterMissingDim;
+    }
+
+    auto dims = std::dynamic_pointer_cast<RuntimeParameterIntArray>(params.at("dims"));
+    std::vector<uint32_t> permute_dims;
+    if (dims == nullptr || !parse_permute_dims(dims->value, permute_dims)) {
+        LOG(ERROR) << "Wrong permute dims parameter";
+        return EParseParameterAttrStatus::EPPAS_ParameterMissingDim;
+    }
+
+    permute_layer = std::make_shared<PermuteLayer>(permute_dims);
+    return EParseParameterAttrStatus::EPPAS_ParameterAttrParseSuccess;
+}
+
+EParseParameterAttrStatus PermuteLayer::get_transpose_instance(
+        const std::shared_ptr<RuntimeOperator> &op,
+        std::shared_ptr<Layer> &permute_layer) {
+    CHECK(op != nullptr) << "Transpose operator is nullptr";
+    const auto &params = op->m_params;
+    if (params.find("dim0") == params.end() || params.find("dim1") == params.end()) {
+        LOG(ERROR) << "Can not find the dimension parameter";
+        return EParseParameterAttrStatus::EPPAS_ParameterMissingDim;
+    }
+
+    auto dim0 = std::dynamic_pointer_cast<RuntimeParameterInt>(params.at("dim0"));
+    auto dim1 = std::dynamic_pointer_cast<RuntimeParameterInt>(params.at("dim1"));
+    if (dim0 == nullptr || dim1 == nullptr) {
+        return EParseParameterAttrStatus::EPPAS_ParameterMissingDim;
+    }
+
+    // 转置的维度数由输入操作数的形状决定
+    if (op->m_input_operands_seq.empty()) {
+        LOG(ERROR) << "The transpose operator has no input operand";
+        return EParseParameterAttrStatus::EPPAS_ParameterMissingDim;
+    }
+    const uint32_t total_dims = op->m_input_operands_seq.front()->m_shapes.size();
+    std::vector<int> dims(total_dims);
+    std::iota(dims.begin(), dims.end(), 0);
+    const int d0 = dim0->value < 0 ? dim0->value + int(total_dims) : dim0->value;
+    const int d1 = dim1->value < 0 ? dim1->value + int(total_dims) : dim1->value;
+    if (d0 < 0 || d1 < 0 || d0 >= int(total_dims) || d1 >= int(total_dims)) {
+        LOG(ERROR) << "Wrong transpose dims parameter";
+        return EParseParameterAttrStatus::EPPAS_ParameterMissingDim;
+    }
+    std::swap(dims.at(d0), dims.at(d1));
+
+    std::vector<uint32_t> permute_dims;
+    if (!parse_permute_dims(dims, permute_dims)) {
+        return EParseParameterAttrStatus::EPPAS_ParameterMissingDim;
+    }
+    permute_layer = std::make_shared<PermuteLayer>(permute_dims);
+    return EParseParameterAttrStatus::EPPAS_ParameterAttrParseSuccess;
+}
+
+ViewLayer::ViewLayer(std::vector<int32_t> shapes) :
+        NonParamLayer("View"), m_shapes(std::move(shapes)) {}
+
+EInferStatus ViewLayer::forward(
+        const std::vector<std::shared_ptr<Tensor>> &inputs,
+        std::vector<std::shared_ptr<Tensor>> &outputs) {
+    if (inputs.empty()) {
+        LOG(ERROR) << "The input tensor array in the view layer is empty";
+        return EInferStatus::EIS_InferFailedInputEmpty;
+    }
+
+    if (inputs.size() != outputs.size()) {
+        LOG(ERROR) << "The input and output tensor array size of the view layer "
+                      "do not match";
+        return EInferStatus::EIS_InferFailedInputOutSizeMatchError;
+    }
+
+    for (uint32_t i = 0; i < inputs.size(); ++i) {
+        const std::shared_ptr<Tensor> &input = inputs.at(i);
+        if (input == nullptr || input->empty()) {
+            LOG(ERROR) << "The input tensor array in the view layer has an empty tensor " << i << " th";
+            return EInferStatus::EIS_InferFailedInputEmpty;
+        }
+
+        // Tensor的存储按通道列主序排列，先转为行主序连续的张量再改变形状
+        const TensorND source = TensorND::from_tensor(*input).contiguous().view(m_shapes);
+        const EInferStatus status = write_output(source, input, outputs.at(i));
+        if (status != EInferStatus::EIS_InferSuccess) {
+            return status;
+        }
+    }
+    return EInferStatus::EIS_InferSuccess;
+}
+
+bool ViewLayer::infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                                    std::vector<uint32_t> &output_shapes) const {
+    if (input_shapes.size() != 1) {
+        return false;
+    }
+    const uint32_t size = std::accumulate(input_shapes.front().begin(), input_shapes.front().end(), 1u,
+                                          std::multiplies());
+    uint32_t known_size = 1;
+    int32_t inferred_dim = -1;
+    for (uint32_t i = 0; i < this->m_shapes.size(); ++i) {
+        const int32_t shape = this->m_shapes.at(i);
+        if (shape == -1 && inferred_dim < 0) {
+            inferred_dim = int32_t(i);
+        } else if (shape > 0) {
+            known_size *= uint32_t(shape);
+        } else {
+            return false;
+        }
+    }
+    if (known_size == 0 || size % known_size != 0 || (inferred_dim < 0 && known_size != size)) {
+        return false;
+    }
+    output_shapes.assign(this->m_shapes.begin(), this->m_shapes.end());
+    if (inferred_dim >= 0) {
+        output_shapes.at(inferred_dim) = size / known_size;
+    }
+    return true;
+}
+
+EParseParameterAttrStatus ViewLayer::get_instance(
+        const std::shared_ptr<RuntimeOperator> &op,
+        std::shared_ptr<Layer> &view_layer) {
+    CHECK(op != nullptr) << "View operator is nullptr";
+    const auto &params = op->m_params;
+    if (params.find("shape") == params.end()) {
+        LOG(ERROR) << "Can not find the shape parameter";
+        return EParseParameterAttrStatus::EPPAS_ParameterMissingShape;
+    }
+
+    auto shape = std::dynamic_pointer_cast<RuntimeParameterIntArray>(params.at("shape"));
+    if (shape == nullptr || shape->value.size() < 2) {
+        LOG(ERROR) << "Wrong view shape parameter";
+        return EParseParameterAttrStatus::EPPAS_ParameterMissingShape;
+    }
+
+    // 第0维为batch，每个batch单独改变形状
+    view_layer = std::make_shared<ViewLayer>(std::vector<int32_t>(shape->value.begin() + 1, shape->value.end()));
+    return EParseParameterAttrStatus::EPPAS_ParameterAttrParseSuccess;
+}
+
+LayerRegistererWrapper permute_create_instance("torch.permute", PermuteLayer::get_instance);
+
+LayerRegistererWrapper transpose_create_instance("torch.transpose", PermuteLayer::get_transpose_instance);
+
+LayerRegistererWrapper view_create_instance("Tensor.view", ViewLayer::get_instance);
+
+LayerRegistererWrapper reshape_create_instance("Tensor.reshape", ViewLayer::get_instance);
@@ -58,6 +58,19 @@ ReluLayer::forward(const std::vector<std::shared_ptr<Tensor>> &inputs, std::vect
     return EInferStatus::EIS_InferSuccess;
 }
 
+bool ReluLayer::support_inplace() const {
+    return true;
+}
+
+bool ReluLayer::infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                                    std::vector<uint32_t> &output_shapes) const {
+    if (input_shapes.size() != 1) {
+        return false;
+    }
+    output_shapes = input_shapes.front();
+    return true;
+}
+
 EParseParameterAttrStatus
 ReluLayer::get_instance(const std::shared_ptr<RuntimeOperator> &op, std::shared_ptr<Layer> &relu_layer) {
     CHECK(op != nullptr) << "ReLU operator is nullptr";
@@ -0,0 +1,75 @@
+//
+// Created by xyzzzh on 2024/4/24.
+//
+
+#include "layer/abstract/LayerRegisterer.hpp"
+#include "layer/deatil/SigmoidLayer.hpp"
+#include "fmath.hpp"
+
+EInferStatus
+SigmoidLayer::forward(const std::vector<std::shared_ptr<Tensor>> &inputs,
+                      std::vector<std::shared_ptr<Tensor>> &outputs) {
+    if (inputs.empty()) {
+        LOG(ERROR) << "The input tensor array in the sigmoid layer is empty";
+        return EInferStatus::EIS_InferFailedInputEmpty;
+    }
+
+    if (inputs.size() != outputs.size()) {
+        LOG(ERROR) << "The input and output tensor array size of the sigmoid layer do "
+                      "not match";
+        return EInferStatus::EIS_InferFailedInputOutSizeMatchError;
+    }
+
+    const uint32_t batch_size = inputs.size();
+    for (uint32_t i = 0; i < batch_size; i++) {
+        const std::shared_ptr<Tensor> &input = inputs.at(i);
+        if (input == nullptr || input->empty()) {
+            LOG(ERROR) << "The input tensor array in the sigmoid layer has an empty tensor " << i << " th";
+            return EInferStatus::EIS_InferFailedInputEmpty;
+        }
+
+        std::shared_ptr<Tensor> output = outputs.at(i);
+        if (output == nullptr || output->empty()) {
+            output = std::make_shared<Tensor>(input->shapes());
+            outputs.at(i) = output;
+        }
+        if (output->shapes() != input->shapes()) {
+            LOG(ERROR) << "The input and output tensor shapes of the sigmoid layer do not match " << i << " th";
+            return EInferStatus::EIS_InferFailedInputOutSizeMatchError;
+        }
+
+        // 原地计算时input和output是同一个张量，逐元素先读后写
+        const float *input_ptr = input->raw_ptr();
+        float *output_ptr = output->raw_ptr();
+        const uint32_t size = input->size();
+        for (uint32_t j = 0; j < size; ++j) {
+            output_ptr[j] = 1.f / (1.f + fmath::exp(-input_ptr[j]));
+        }
+    }
+    return EInferStatus::EIS_InferSuccess;
+}
+
+bool SigmoidLayer::support_inplace() const {
+    return true;
+}
+
+bool SigmoidLayer::infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                                       std::vector<uint32_t> &output_shapes) const {
+    if (input_shapes.size() != 1) {
+        return false;
+    }
+    output_shapes = input_shapes.front();
+    return true;
+}
+
+EParseParameterAttrStatus
+SigmoidLayer::get_instance(const std::shared_ptr<RuntimeOperator> &op, std::shared_ptr<Layer> &sigmoid_layer) {
+    CHECK(op != nullptr) << "Sigmoid operator is nullptr";
+    sigmoid_layer = std::make_shared<SigmoidLayer>();
+    return EParseParameterAttrStatus::EPPAS_ParameterAttrParseSuccess;
+}
+
+// 使用工具类注册算子
+LayerRegistererWrapper sigmoid_get_instance("nn.Sigmoid", SigmoidLayer::get_instance);
+
+LayerRegistererWrapper sigmoid_function_get_instance("F.sigmoid", SigmoidLayer::get_instance);
@@ -112,6 +112,15 @@ EInferStatus SoftmaxLayer::forward(
     return EInferStatus::EIS_InferSuccess;
 }
 
+bool SoftmaxLayer::infer_output_shapes(const std::vector<std::vector<uint32_t>> &input_shapes,
+                                       std::vector<uint32_t> &output_shapes) const {
+    if (input_shapes.size() != 1) {
+        return false;
+    }
+    output_shapes = input_shapes.front();
+    return true;
+}
+
 EParseParameterAttrStatus SoftmaxLayer::create_instance(
         const std::shared_ptr<RuntimeOperator> &op,
         std::shared_ptr<Layer> &softmax_layer) {
@@ -0,0 +1,131 @@
+//
+// Created by xyzzzh on 2024/4/29.
+//
+
+#include "runtime/DynamicBatcher.hpp"
+
+double BatcherMetrics::average_batch_size() const {
+    return this->batch_count == 0 ? 0. : double(this->request_count) / double(this->batch_count);
+}
+
+double BatcherMetrics::average_queue_time_us() const {
+    return this->request_count == 0 ? 0. : double(this->total_queue_time_us) / double(this->request_count);
+}
+
+DynamicBatcher::DynamicBatcher(const RuntimeGraph &graph, const BatcherConfig &config) :
+        m_graph(graph), m_config(config) {
+    CHECK(graph.state() == EGraphState::EGS_Completed) << "Graph need be build!";
+    if (this->m_config.max_batch_size == 0) {
+        this->m_config.max_batch_size = graph.max_batch_size();
+    }
+    CHECK(this->m_config.max_batch_size > 0 && this->m_config.max_batch_size <= graph.max_batch_size())
+                    << "The max batch size of the batcher " << this->m_config.max_batch_size
+                    << " exceeds the max batch size of the graph " << graph.max_batch_size();
+    CHECK(this->m_config.num_workers > 0) << "The batcher needs at least one worker";
+    for (uint32_t i = 0; i < this->m_config.num_workers; ++i) {
+        this->m_workers.emplace_back([this]() { this->worker_loop(); });
+    }
+}
+
+DynamicBatcher::~DynamicBatcher() {
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        this->m_stop = true;
+    }
+    this->m_condition.notify_all();
+    for (auto &worker: this->m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+std::future<std::shared_ptr<Tensor>> DynamicBatcher::submit(const std::shared_ptr<Tensor> &input) {
+    CHECK(input != nullptr && !input->empty()) << "The submitted input is empty";
+    Request request;
+    request.input = input;
+    request.arrival = std::chrono::steady_clock::now();
+    std::future<std::shared_ptr<Tensor>> future = request.promise.get_future();
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        CHECK(!this->m_stop) << "The batcher has been stopped";
+        this->m_queue.push_back(std::move(request));
+        this->m_metrics.max_queue_depth = std::max(this->m_metrics.max_queue_depth, uint32_t(this->m_queue.size()));
+    }
+    this->m_condition.notify_one();
+    return future;
+}
+
+BatcherMetrics DynamicBatcher::metrics() const {
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    BatcherMetrics metrics = this->m_metrics;
+    metrics.queue_depth = this->m_queue.size();
+    return metrics;
+}
+
+const BatcherConfig &DynamicBatcher::config() const {
+    return this->m_config;
+}
+
+void DynamicBatcher::worker_loop() {
+    std::shared_ptr<ExecutionContext> context = this->m_graph.create_context();
+    const uint32_t max_batch_size = this->m_config.max_batch_size;
+    std::vector<Request> batch;
+    std::vector<std::shared_ptr<Tensor>> inputs;
+    while (true) {
+        bool has_remaining = false;
+        {
+            std::unique_lock<std::mutex> lock(this->m_mutex);
+            this->m_condition.wait(lock, [this]() { return this->m_stop || !this->m_queue.empty(); });
+            if (this->m_queue.empty()) {
+                break;
+            }
+            // 从最早的请求到达开始计时，凑齐batch或者超时后执行，停止时不再等待
+            const auto deadline = this->m_queue.front().arrival + this->m_config.max_delay;
+            this->m_condition.wait_until(lock, deadline, [this, max_batch_size]() {
+                return this->m_stop || this->m_queue.size() >= max_batch_size;
+            });
+            if (this->m_queue.empty()) {
+                // 其他工作线程已经取走了请求
+                continue;
+            }
+
+            // 只取与队首形状相同的连续请求
+            const std::vector<uint32_t> shapes = this->m_queue.front().input->shapes();
+            while (!this->m_queue.empty() && batch.size() < max_batch_size &&
+                   this->m_queue.front().input->shapes() == shapes) {
+                batch.push_back(std::move(this->m_queue.front()));
+                this->m_queue.pop_front();
+            }
+            has_remaining = !this->m_queue.empty();
+        }
+        // 剩余的请求交给其他空闲的工作线程
+        if (has_remaining) {
+            this->m_condition.notify_one();
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        inputs.clear();
+        for (const Request &request: batch) {
+            inputs.push_back(request.input);
+        }
+        const std::vector<std::shared_ptr<Tensor>> outputs = this->m_graph.forward(*context, inputs);
+        CHECK(outputs.size() == batch.size()) << "The output size of the graph do not match the batch size";
+        // 先更新统计，请求方拿到结果时统计中已经包含这个batch
+        uint64_t queue_time_us = 0;
+        for (const Request &request: batch) {
+            queue_time_us += std::chrono::duration_cast<std::chrono::microseconds>(start - request.arrival).count();
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->m_mutex);
+            this->m_metrics.request_count += batch.size();
+            this->m_metrics.batch_count += 1;
+            this->m_metrics.total_queue_time_us += queue_time_us;
+        }
+        // 上下文中的输出会被下一个batch覆盖，分发给请求前先复制
+        for (uint32_t i = 0; i < batch.size(); ++i) {
+            batch.at(i).promise.set_value(outputs.at(i)->clone());
+        }
+        batch.clear();
+    }
+}
@@ -0,0 +1,13 @@
+//
+// Created by xyzzzh on 2024/4/27.
+//
+
+#include "runtime/ExecutionContext.hpp"
+
+size_t ExecutionContext::activation_memory_size() const {
+    return this->m_arena_size * sizeof(float);
+}
+
+uint32_t ExecutionContext::batch_size() const {
+    return this->m_batch_size;
+}
@@ -0,0 +1,331 @@
+//
+// Created by xyzzzh on 2024/5/2.
+//
+
+#include "runtime/GraphOptimizer.hpp"
+#include "layer/abstract/Layer.hpp"
+#include "layer/abstract/LayerRegisterer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+using OperatorMap = std::unordered_map<std::string, std::shared_ptr<RuntimeOperator>>;
+
+static const std::string kInputType = "pnnx.Input";
+static const std::string kOutputType = "pnnx.Output";
+static const std::string kAttributeType = "pnnx.Attribute";
+
+static OperatorMap operator_map(const std::vector<std::shared_ptr<RuntimeOperator>> &operators) {
+    OperatorMap operators_map;
+    for (const auto &op: operators) {
+        operators_map.insert({op->m_name, op});
+    }
+    return operators_map;
+}
+
+static const std::shared_ptr<RuntimeOperator> &find_producer(const OperatorMap &operators_map,
+                                                             const std::shared_ptr<RuntimeOperand> &operand) {
+    const auto iter = operators_map.find(operand->m_name);
+    CHECK(iter != operators_map.end()) << "Can not find the producer of operand " << operand->m_name;
+    return iter->second;
+}
+
+// 从前驱的后继列表中删除consumer_name
+static void remove_consumer(RuntimeOperator &producer, const std::string &consumer_name) {
+    auto &names = producer.m_output_names;
+    names.erase(std::remove(names.begin(), names.end(), consumer_name), names.end());
+}
+
+// 前驱先于后继，其余按模型中的顺序排列
+static void visit_operator(const std::shared_ptr<RuntimeOperator> &op, const OperatorMap &operators_map,
+                           std::unordered_set<std::string> &visited,
+                           std::vector<std::shared_ptr<RuntimeOperator>> &order) {
+    if (!visited.insert(op->m_name).second) {
+        return;
+    }
+    for (const auto &operand: op->m_input_operands_seq) {
+        visit_operator(find_producer(operators_map, operand), operators_map, visited, order);
+    }
+    order.push_back(op);
+}
+
+static std::vector<std::shared_ptr<RuntimeOperator>>
+topological_order(const std::vector<std::shared_ptr<RuntimeOperator>> &operators, const OperatorMap &operators_map) {
+    std::unordered_set<std::string> visited;
+    std::vector<std::shared_ptr<RuntimeOperator>> order;
+    for (const auto &op: operators) {
+        visit_operator(op, operators_map, visited, order);
+    }
+    return order;
+}
+
+// 计算常量算子的输出，batch维度为1
+static std::shared_ptr<Tensor> evaluate_constant(const std::shared_ptr<RuntimeOperator> &op,
+                                                 const OperatorMap &operators_map,
+                                                 std::unordered_map<std::string, std::shared_ptr<Tensor>> &values) {
+    const auto iter = values.find(op->m_name);
+    if (iter != values.end()) {
+        return iter->second;
+    }
+
+    const auto &output_operand = op->m_output_operands;
+    CHECK(output_operand != nullptr && !output_operand->m_data.empty())
+                    << "The output operand of constant operator " << op->m_name << " is empty";
+    std::shared_ptr<Tensor> output = output_operand->m_data.front()->clone();
+    if (op->m_type == kAttributeType) {
+        CHECK(op->m_attribute.size() == 1) << "Wrong attribute operator " << op->m_name;
+        const std::vector<float> &data = op->m_attribute.begin()->second->get_weight_data<float>(false);
+        CHECK(data.size() == output->size()) << "The constant size of operator " << op->m_name
+                                             << " do not match the output shape";
+        output->fill(data, true);
+    } else {
+        // 按操作数顺序排列输入，与执行时的输入布局相同
+        std::vector<std::shared_ptr<Tensor>> inputs;
+        for (const auto &operand: op->m_input_operands_seq) {
+            inputs.push_back(evaluate_constant(find_producer(operators_map, operand), operators_map, values));
+        }
+        std::shared_ptr<Layer> layer = LayerRegisterer::create_layer(op);
+        layer->set_runtime_operator(op);
+        std::vector<std::shared_ptr<Tensor>> outputs{output};
+        const EInferStatus status = layer->forward(inputs, outputs);
+        CHECK(status == EInferStatus::EIS_InferSuccess)
+                        << "Fold the constant operator " << op->m_name << " failed, error code: " << int(status);
+        output = outputs.front();
+    }
+    values.insert({op->m_name, output});
+    return output;
+}
+
+// 把算子替换为输出value的常量算子，并断开与前驱的连接
+static void replace_with_constant(const std::shared_ptr<RuntimeOperator> &op, const std::shared_ptr<Tensor> &value,
+                                  const OperatorMap &operators_map) {
+    for (const auto &operand: op->m_input_operands_seq) {
+        remove_consumer(*find_producer(operators_map, operand), op->m_name);
+    }
+    op->m_input_operands.clear();
+    op->m_input_operands_seq.clear();
+    op->m_params.clear();
+
+    const std::vector<float> values = value->values(true);
+    std::shared_ptr<RuntimeAttribute> attribute = std::make_shared<RuntimeAttribute>();
+    attribute->m_type = ERuntimeDataType::ERDT_Float32;
+    attribute->m_shapes = op->m_output_operands->m_shapes;
+    attribute->m_shapes.front() = 1;
+    attribute->m_weight_data.resize(values.size() * sizeof(float));
+    std::memcpy(attribute->m_weight_data.data(), values.data(), attribute->m_weight_data.size());
+    op->m_attribute.clear();
+    op->m_attribute.insert({"data", attribute});
+    op->m_type = kAttributeType;
+}
+
+uint32_t fold_constant_operators(const std::vector<std::shared_ptr<RuntimeOperator>> &operators) {
+    const OperatorMap operators_map = operator_map(operators);
+    const std::vector<std::shared_ptr<RuntimeOperator>> order = topological_order(operators, operators_map);
+
+    std::unordered_set<std::string> constants;
+    for (const auto &op: order) {
+        if (op->m_type == kInputType || op->m_type == kOutputType) {
+            continue;
+        }
+        const bool is_constant = std::all_of(op->m_input_operands_seq.begin(), op->m_input_operands_seq.end(),
+                                             [&constants](const std::shared_ptr<RuntimeOperand> &operand) {
+                                                 return constants.count(operand->m_name) > 0;
+                                             });
+        if (is_constant) {
+            constants.insert(op->m_name);
+        }
+    }
+
+    uint32_t folded_count = 0;
+    std::unordered_map<std::string, std::shared_ptr<Tensor>> values;
+    for (const auto &op: order) {
+        if (op->m_type == kAttributeType || constants.count(op->m_name) == 0) {
+            continue;
+        }
+        const bool used = std::any_of(op->m_output_names.begin(), op->m_output_names.end(),
+                                      [&constants](const std::string &name) { return constants.count(name) == 0; });
+        if (!used) {
+            continue;
+        }
+        const std::shared_ptr<Tensor> value = evaluate_constant(op, operators_map, values);
+        replace_with_constant(op, value, operators_map);
+        folded_count += 1;
+    }
+    return folded_count;
+}
+
+uint32_t eliminate_dead_operators(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                  const std::string &output_name) {
+    const OperatorMap operators_map = operator_map(operators);
+    const auto output = operators_map.find(output_name);
+    if (output == operators_map.end()) {
+        LOG(WARNING) << "Can not find the output operator " << output_name << ", skip the dead operator elimination";
+        return 0;
+    }
+
+    // 从输出沿前驱反向遍历
+    std::unordered_set<std::string> alive{output_name};
+    std::vector<std::shared_ptr<RuntimeOperator>> stack{output->second};
+    while (!stack.empty()) {
+        const std::shared_ptr<RuntimeOperator> op = stack.back();
+        stack.pop_back();
+        for (const auto &operand: op->m_input_operands_seq) {
+            if (alive.insert(operand->m_name).second) {
+                stack.push_back(find_producer(operators_map, operand));
+            }
+        }
+    }
+    for (const auto &op: operators) {
+        if (op->m_type == kInputType) {
+            alive.insert(op->m_name);
+        }
+    }
+
+    for (const auto &op: operators) {
+        if (alive.count(op->m_name) > 0) {
+            continue;
+        }
+        for (const auto &operand: op->m_input_operands_seq) {
+            remove_consumer(*find_producer(operators_map, operand), op->m_name);
+        }
+    }
+    const uint32_t operator_count = operators.size();
+    operators.erase(std::remove_if(operators.begin(), operators.end(),
+                                   [&alive](const std::shared_ptr<RuntimeOperator> &op) {
+                                       return alive.count(op->m_name) == 0;
+                                   }), operators.end());
+    return operator_count - operators.size();
+}
+
+static bool parameter_equal(const RuntimeParameter &lhs, const RuntimeParameter &rhs) {
+    if (lhs.type != rhs.type) {
+        return false;
+    }
+    switch (lhs.type) {
+        case ERuntimeParameterType::ERPT_ParameterBool:
+            return static_cast<const RuntimeParameterBool &>(lhs).value ==
+                   static_cast<const RuntimeParameterBool &>(rhs).value;
+        case ERuntimeParameterType::ERPT_ParameterInt:
+            return static_cast<const RuntimeParameterInt &>(lhs).value ==
+                   static_cast<const RuntimeParameterInt &>(rhs).value;
+        case ERuntimeParameterType::ERPT_ParameterFloat:
+            return static_cast<const RuntimeParameterFloat &>(lhs).value ==
+                   static_cast<const RuntimeParameterFloat &>(rhs).value;
+        case ERuntimeParameterType::ERPT_ParameterString:
+            return static_cast<const RuntimeParameterString &>(lhs).value ==
+                   static_cast<const RuntimeParameterString &>(rhs).value;
+        case ERuntimeParameterType::ERPT_ParameterIntArray:
+            return static_cast<const RuntimeParameterIntArray &>(lhs).value ==
+                   static_cast<const RuntimeParameterIntArray &>(rhs).value;
+        case ERuntimeParameterType::ERPT_ParameterFloatArray:
+            return static_cast<const RuntimeParameterFloatArray &>(lhs).value ==
+                   static_cast<const RuntimeParameterFloatArray &>(rhs).value;
+        case ERuntimeParameterType::ERPT_ParameterStringArray:
+            return static_cast<const RuntimeParameterStringArray &>(lhs).value ==
+                   static_cast<const RuntimeParameterStringArray &>(rhs).value;
+        default:
+            return true;
+    }
+}
+
+// 属性数据可能位于模型文件的映射中，也可能由常量折叠生成，按字节比较
+static bool weight_equal(const WeightSpan &lhs, const WeightSpan &rhs) {
+    return lhs.size == rhs.size && (lhs.size == 0 || std::memcmp(lhs.data, rhs.data, lhs.size) == 0);
+}
+
+static bool operator_equal(const RuntimeOperator &lhs, const RuntimeOperator &rhs) {
+    if (lhs.m_type != rhs.m_type || lhs.m_input_operands_seq.size() != rhs.m_input_operands_seq.size() ||
+        lhs.m_params.size() != rhs.m_params.size() || lhs.m_attribute.size() != rhs.m_attribute.size()) {
+        return false;
+    }
+    for (uint32_t i = 0; i < lhs.m_input_operands_seq.size(); ++i) {
+        if (lhs.m_input_operands_seq.at(i)->m_name != rhs.m_input_operands_seq.at(i)->m_name) {
+            return false;
+        }
+    }
+    if (lhs.m_output_operands == nullptr || rhs.m_output_operands == nullptr ||
+        lhs.m_output_operands->m_shapes != rhs.m_output_operands->m_shapes) {
+        return false;
+    }
+    for (auto l = lhs.m_params.begin(), r = rhs.m_params.begin(); l != lhs.m_params.end(); ++l, ++r) {
+        if (l->first != r->first || !parameter_equal(*l->second, *r->second)) {
+            return false;
+        }
+    }
+    for (auto l = lhs.m_attribute.begin(), r = rhs.m_attribute.begin(); l != lhs.m_attribute.end(); ++l, ++r) {
+        if (l->first != r->first || l->second->m_type != r->second->m_type ||
+            l->second->m_shapes != r->second->m_shapes || !weight_equal(l->second->weight_span(), r->second->weight_span())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 把from的后继改为使用to的输出，并断开from与前驱的连接
+static void redirect_consumers(const std::shared_ptr<RuntimeOperator> &from, const std::shared_ptr<RuntimeOperator> &to,
+                               const OperatorMap &operators_map) {
+    for (const auto &operand: from->m_input_operands_seq) {
+        remove_consumer(*find_producer(operators_map, operand), from->m_name);
+    }
+    for (const std::string &consumer_name: from->m_output_names) {
+        const auto consumer = operators_map.find(consumer_name);
+        CHECK(consumer != operators_map.end()) << "Can not find the consumer " << consumer_name;
+        RuntimeOperator &consumer_op = *consumer->second;
+        for (const auto &operand: consumer_op.m_input_operands_seq) {
+            if (operand->m_name == from->m_name) {
+                operand->m_name = to->m_name;
+            }
+        }
+        const auto operand = consumer_op.m_input_operands.find(from->m_name);
+        if (operand != consumer_op.m_input_operands.end()) {
+            const std::shared_ptr<RuntimeOperand> runtime_operand = operand->second;
+            consumer_op.m_input_operands.erase(operand);
+            consumer_op.m_input_operands.insert({to->m_name, runtime_operand});
+        }
+        to->m_output_names.push_back(consumer_name);
+    }
+    from->m_output_names.clear();
+}
+
+uint32_t merge_identical_operators(std::vector<std::shared_ptr<RuntimeOperator>> &operators) {
+    const OperatorMap operators_map = operator_map(operators);
+    // 按拓扑序处理，前驱合并后后继的输入名称随之更新，相同的后继可以继续合并
+    std::unordered_map<std::string, std::vector<std::shared_ptr<RuntimeOperator>>> candidates;
+    std::unordered_set<std::string> merged;
+    for (const auto &op: topological_order(operators, operators_map)) {
+        if (op->m_type == kInputType || op->m_type == kOutputType) {
+            continue;
+        }
+        std::string key = op->m_type;
+        for (const auto &operand: op->m_input_operands_seq) {
+            key += "\n" + operand->m_name;
+        }
+        auto &same_inputs = candidates[key];
+        const auto kept = std::find_if(same_inputs.begin(), same_inputs.end(),
+                                       [&op](const std::shared_ptr<RuntimeOperator> &other) {
+                                           return operator_equal(*op, *other);
+                                       });
+        if (kept == same_inputs.end()) {
+            same_inputs.push_back(op);
+            continue;
+        }
+        redirect_consumers(op, *kept, operators_map);
+        merged.insert(op->m_name);
+    }
+
+    operators.erase(std::remove_if(operators.begin(), operators.end(),
+                                   [&merged](const std::shared_ptr<RuntimeOperator> &op) {
+                                       return merged.count(op->m_name) > 0;
+                                   }), operators.end());
+    return merged.size();
+}
+
+GraphOptimizeStats optimize_graph(std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                                  const std::string &output_name) {
+    GraphOptimizeStats stats;
+    stats.folded_operators = fold_constant_operators(operators);
+    stats.eliminated_operators = eliminate_dead_operators(operators, output_name);
+    stats.merged_operators = merge_identical_operators(operators);
+    return stats;
+}
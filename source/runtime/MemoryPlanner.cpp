@@ -0,0 +1,77 @@
+//
+// Created by xyzzzh on 2024/4/23.
+//
+
+#include "runtime/MemoryPlanner.hpp"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <glog/logging.h>
+
+static size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+size_t plan_memory_blocks(std::vector<MemoryBlock> &blocks, size_t alignment) {
+    return plan_memory_blocks(blocks, [&blocks](uint32_t i, uint32_t j) {
+        return blocks[i].first_use <= blocks[j].last_use && blocks[j].first_use <= blocks[i].last_use;
+    }, alignment);
+}
+
+size_t plan_memory_blocks(std::vector<MemoryBlock> &blocks,
+                          const std::function<bool(uint32_t, uint32_t)> &conflict,
+                          size_t alignment) {
+    CHECK(alignment > 0);
+    // 大块优先放置，大小相同时先放置存活时间更长的块
+    std::vector<uint32_t> order(blocks.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&blocks](uint32_t a, uint32_t b) {
+        if (blocks[a].size != blocks[b].size) {
+            return blocks[a].size > blocks[b].size;
+        }
+        return blocks[a].last_use - blocks[a].first_use > blocks[b].last_use - blocks[b].first_use;
+    });
+
+    size_t arena_size = 0;
+    std::vector<uint32_t> placed;
+    std::vector<const MemoryBlock *> conflicts;
+    for (uint32_t index: order) {
+        MemoryBlock &block = blocks[index];
+        CHECK(block.first_use <= block.last_use);
+        const size_t block_size = align_up(block.size, alignment);
+
+        // 收集与当前块同时存活的已分配块，按偏移量排序
+        conflicts.clear();
+        for (uint32_t other_index: placed) {
+            if (conflict(index, other_index)) {
+                conflicts.push_back(&blocks[other_index]);
+            }
+        }
+        std::sort(conflicts.begin(), conflicts.end(), [](const MemoryBlock *a, const MemoryBlock *b) {
+            return a->offset < b->offset;
+        });
+
+        // 在冲突块之间选择能容纳当前块的最小空隙，没有合适的空隙时放在最后
+        size_t best_offset = std::numeric_limits<size_t>::max();
+        size_t best_gap = std::numeric_limits<size_t>::max();
+        size_t current = 0;
+        for (const MemoryBlock *other: conflicts) {
+            if (other->offset > current) {
+                const size_t gap = other->offset - current;
+                if (gap >= block_size && gap < best_gap) {
+                    best_gap = gap;
+                    best_offset = current;
+                }
+            }
+            current = std::max(current, other->offset + align_up(other->size, alignment));
+        }
+        if (best_offset == std::numeric_limits<size_t>::max()) {
+            best_offset = current;
+        }
+
+        block.offset = best_offset;
+        arena_size = std::max(arena_size, best_offset + block_size);
+        placed.push_back(index);
+    }
+    return arena_size;
+}
@@ -0,0 +1,478 @@
+//
+// Created by xyzzzh on 2024/5/5.
+//
+
+#include "runtime/ModelFormat.hpp"
+#include <cstring>
+#include <type_traits>
+#include "layer/abstract/ParamLayer.hpp"
+#include "layer/deatil/AttributeLayer.hpp"
+
+// 文件中的记录都是定长结构，字符串和数组通过文件内的偏移引用
+namespace {
+constexpr char kNativeMagic[8] = {'I', 'N', 'F', 'E', 'R', 'M', 'D', 'L'};
+constexpr size_t kRecordAlignment = 8;  // 记录和数组的对齐
+constexpr size_t kWeightAlignment = 64; // 权重块的对齐
+
+struct StringRef {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+struct ArrayRef {
+    uint64_t offset = 0;
+    uint64_t count = 0;
+};
+
+struct NativeHeader {
+    char magic[8] = {0};
+    uint32_t version = 0;
+    uint32_t operator_count = 0;
+    uint64_t operator_offset = 0; // OperatorRecord数组的位置
+    uint64_t file_size = 0;
+    uint64_t plan_offset = 0; // PlanRecord的位置，为0时没有保存build结果
+    uint64_t reserved[3] = {0, 0, 0};
+};
+
+// 操作数只保存名称、类型和形状，输入操作数的名称为前驱算子的名称
+struct OperandRecord {
+    StringRef name;
+    uint32_t type = 0;
+    uint32_t reserved = 0;
+    ArrayRef shapes; // uint32_t
+};
+
+// 标量参数保存为只有一个元素的数组，bool和int保存为int32_t，字符串保存为StringRef
+struct ParamRecord {
+    StringRef name;
+    uint32_t type = 0;
+    uint32_t reserved = 0;
+    ArrayRef values;
+};
+
+struct AttributeRecord {
+    StringRef name;
+    uint32_t type = 0;
+    uint32_t packed = 0; // 权重是否已经是层计算时的布局
+    ArrayRef shapes;     // uint32_t
+    ArrayRef data;       // 按字节计数，起始位置按kWeightAlignment对齐
+};
+
+struct OperatorRecord {
+    StringRef name;
+    StringRef type;
+    ArrayRef params;     // ParamRecord
+    ArrayRef attributes; // AttributeRecord
+    ArrayRef inputs;     // OperandRecord，按输入顺序排列
+    ArrayRef consumers;  // StringRef，后继算子的名称
+    uint32_t has_output = 0;
+    uint32_t reserved = 0;
+    OperandRecord output;
+};
+
+// 执行计划中每个步骤的输出形状保存为ArrayRef的数组
+struct PlanRecord {
+    ArrayRef topo_order;       // uint32_t
+    ArrayRef input_shapes;     // uint32_t
+    ArrayRef output_shapes;    // ArrayRef，每个元素为uint32_t的数组
+    ArrayRef inplace_operands; // int32_t
+    ArrayRef offsets;          // int64_t
+    uint64_t arena_size = 0;
+};
+
+static_assert(sizeof(NativeHeader) == 64, "The native header should be 64 bytes");
+static_assert(std::is_trivially_copyable_v<OperatorRecord>, "Records should be trivially copyable");
+
+// 在内存中依次追加记录和数据，最后一次写入文件
+class NativeModelWriter {
+public:
+    NativeModelWriter() : m_buffer(sizeof(NativeHeader), 0) {}
+
+    // 按alignment对齐后追加size字节，data为空时只预留空间
+    uint64_t append(const void *data, size_t size, size_t alignment) {
+        const size_t offset = (this->m_buffer.size() + alignment - 1) / alignment * alignment;
+        this->m_buffer.resize(offset + size, 0);
+        if (data != nullptr && size > 0) {
+            std::memcpy(this->m_buffer.data() + offset, data, size);
+        }
+        return offset;
+    }
+
+    StringRef string(const std::string &value) {
+        return StringRef{this->append(value.data(), value.size(), 1), value.size()};
+    }
+
+    template<typename T>
+    ArrayRef array(const std::vector<T> &values) {
+        return ArrayRef{this->append(values.data(), values.size() * sizeof(T), kRecordAlignment), values.size()};
+    }
+
+    ArrayRef strings(const std::vector<std::string> &values) {
+        std::vector<StringRef> refs;
+        for (const auto &value: values) {
+            refs.push_back(this->string(value));
+        }
+        return this->array(refs);
+    }
+
+    char *data() { return this->m_buffer.data(); }
+
+    size_t size() const { return this->m_buffer.size(); }
+
+private:
+    std::vector<char> m_buffer;
+};
+
+// 按记录中的偏移读取映射的文件，所有访问都检查是否越界
+class NativeModelReader {
+public:
+    NativeModelReader(const char *data, size_t size) : m_data(data), m_size(size) {}
+
+    bool contains(uint64_t offset, uint64_t size) const {
+        return offset <= this->m_size && size <= this->m_size - offset;
+    }
+
+    template<typename T>
+    const T *array(const ArrayRef &ref) const {
+        if (ref.count == 0) {
+            return nullptr;
+        }
+        if (ref.offset % alignof(T) != 0 || ref.count > this->m_size / sizeof(T) ||
+            !this->contains(ref.offset, ref.count * sizeof(T))) {
+            this->m_valid = false;
+            return nullptr;
+        }
+        return reinterpret_cast<const T *>(this->m_data + ref.offset);
+    }
+
+    template<typename T>
+    std::vector<T> values(const ArrayRef &ref) const {
+        const T *begin = this->array<T>(ref);
+        return begin == nullptr ? std::vector<T>() : std::vector<T>(begin, begin + ref.count);
+    }
+
+    std::string string(const StringRef &ref) const {
+        if (!this->contains(ref.offset, ref.size)) {
+            this->m_valid = false;
+            return {};
+        }
+        return std::string(this->m_data + ref.offset, ref.size);
+    }
+
+    std::vector<std::string> strings(const ArrayRef &ref) const {
+        std::vector<std::string> values;
+        const StringRef *refs = this->array<StringRef>(ref);
+        for (uint64_t i = 0; refs != nullptr && i < ref.count; ++i) {
+            values.push_back(this->string(refs[i]));
+        }
+        return values;
+    }
+
+    bool valid() const { return this->m_valid; }
+
+private:
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+    mutable bool m_valid = true;
+};
+} // namespace
+
+static OperandRecord write_operand(NativeModelWriter &writer, const RuntimeOperand &operand) {
+    OperandRecord record;
+    record.name = writer.string(operand.m_name);
+    record.type = uint32_t(operand.m_type);
+    record.shapes = writer.array(operand.m_shapes);
+    return record;
+}
+
+static ParamRecord write_param(NativeModelWriter &writer, const std::string &name, const RuntimeParameter &param) {
+    ParamRecord record;
+    record.name = writer.string(name);
+    record.type = uint32_t(param.type);
+    switch (param.type) {
+        case ERuntimeParameterType::ERPT_ParameterBool:
+            record.values = writer.array(std::vector<int32_t>{static_cast<const RuntimeParameterBool &>(param).value});
+            break;
+        case ERuntimeParameterType::ERPT_ParameterInt:
+            record.values = writer.array(std::vector<int32_t>{static_cast<const RuntimeParameterInt &>(param).value});
+            break;
+        case ERuntimeParameterType::ERPT_ParameterFloat:
+            record.values = writer.array(std::vector<float>{static_cast<const RuntimeParameterFloat &>(param).value});
+            break;
+        case ERuntimeParameterType::ERPT_ParameterString:
+            record.values = writer.strings({static_cast<const RuntimeParameterString &>(param).value});
+            break;
+        case ERuntimeParameterType::ERPT_ParameterIntArray:
+            record.values = writer.array(static_cast<const RuntimeParameterIntArray &>(param).value);
+            break;
+        case ERuntimeParameterType::ERPT_ParameterFloatArray:
+            record.values = writer.array(static_cast<const RuntimeParameterFloatArray &>(param).value);
+            break;
+        case ERuntimeParameterType::ERPT_ParameterStringArray:
+            record.values = writer.strings(static_cast<const RuntimeParameterStringArray &>(param).value);
+            break;
+        default:
+            break;
+    }
+    return record;
+}
+
+// 属性的数据从层中取出：带参数的层保存计算时布局的权重和偏移，常量层保存按行主序的常量
+static bool write_attribute(NativeModelWriter &writer, const RuntimeOperator &op, const std::string &name,
+                            const RuntimeAttribute &attribute, AttributeRecord &record) {
+    record.name = writer.string(name);
+    record.type = uint32_t(attribute.m_type);
+    record.shapes = writer.array(attribute.m_shapes);
+
+    if (const auto param_layer = std::dynamic_pointer_cast<ParamLayer>(op.m_layer)) {
+        if (name != "weight" && name != "bias") {
+            LOG(ERROR) << "Can not export the attribute " << name << " of operator " << op.m_name;
+            return false;
+        }
+        if (!param_layer->weights_materialized()) {
+            // 延迟加载的层还没有写入权重，保存属性中原来的数据，加载时按记录的布局写入
+            const WeightSpan span = attribute.weight_span();
+            CHECK(!span.empty()) << "The attribute " << name << " of operator " << op.m_name << " is empty";
+            record.packed = span.packed ? 1 : 0;
+            record.data = ArrayRef{writer.append(span.data, span.size, kWeightAlignment), span.size};
+            return true;
+        }
+        const auto &tensors = name == "weight" ? param_layer->weights() : param_layer->bias();
+        size_t size = 0;
+        for (const auto &tensor: tensors) {
+            size += tensor->size() * sizeof(float);
+        }
+        const uint64_t offset = writer.append(nullptr, size, kWeightAlignment);
+        char *data = writer.data() + offset;
+        for (const auto &tensor: tensors) {
+            std::memcpy(data, tensor->raw_ptr(), tensor->size() * sizeof(float));
+            data += tensor->size() * sizeof(float);
+        }
+        record.packed = 1;
+        record.data = ArrayRef{offset, size};
+    } else if (const auto attribute_layer = std::dynamic_pointer_cast<AttributeLayer>(op.m_layer)) {
+        const std::vector<float> &values = attribute_layer->values();
+        const size_t size = values.size() * sizeof(float);
+        record.data = ArrayRef{writer.append(values.data(), size, kWeightAlignment), size};
+    } else {
+        LOG(ERROR) << "Can not export the attribute " << name << " of operator " << op.m_name;
+        return false;
+    }
+    return true;
+}
+
+bool is_native_model(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(kNativeMagic)] = {0};
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, kNativeMagic, sizeof(magic)) == 0;
+}
+
+static uint64_t write_plan(NativeModelWriter &writer, const NativeBuildPlan &plan) {
+    CHECK(plan.execution_plan != nullptr);
+    const ExecutionPlan &execution_plan = *plan.execution_plan;
+    PlanRecord record;
+    record.topo_order = writer.array(plan.topo_order);
+    record.input_shapes = writer.array(execution_plan.input_shapes);
+    std::vector<ArrayRef> output_shapes;
+    for (const auto &shapes: execution_plan.output_shapes) {
+        output_shapes.push_back(writer.array(shapes));
+    }
+    record.output_shapes = writer.array(output_shapes);
+    record.inplace_operands = writer.array(execution_plan.inplace_operands);
+    record.offsets = writer.array(execution_plan.offsets);
+    record.arena_size = execution_plan.arena_size;
+    return writer.array(std::vector<PlanRecord>{record}).offset;
+}
+
+static void read_plan(const NativeModelReader &reader, uint64_t offset, NativeBuildPlan &plan) {
+    const PlanRecord *record = reader.array<PlanRecord>(ArrayRef{offset, 1});
+    if (record == nullptr) {
+        return;
+    }
+    plan.topo_order = reader.values<uint32_t>(record->topo_order);
+    std::shared_ptr<ExecutionPlan> execution_plan = std::make_shared<ExecutionPlan>();
+    execution_plan->input_shapes = reader.values<uint32_t>(record->input_shapes);
+    for (const ArrayRef &shapes: reader.values<ArrayRef>(record->output_shapes)) {
+        execution_plan->output_shapes.push_back(reader.values<uint32_t>(shapes));
+    }
+    execution_plan->inplace_operands = reader.values<int32_t>(record->inplace_operands);
+    execution_plan->offsets = reader.values<int64_t>(record->offsets);
+    execution_plan->arena_size = record->arena_size;
+    plan.execution_plan = execution_plan;
+}
+
+bool save_native_model(const std::vector<std::shared_ptr<RuntimeOperator>> &operators, const std::string &path,
+                       const NativeBuildPlan *plan) {
+    NativeModelWriter writer;
+    std::vector<OperatorRecord> operator_records;
+    for (const auto &op: operators) {
+        CHECK(op != nullptr);
+        OperatorRecord record;
+        record.name = writer.string(op->m_name);
+        record.type = writer.string(op->m_type);
+
+        std::vector<ParamRecord> params;
+        for (const auto &[name, param]: op->m_params) {
+            params.push_back(write_param(writer, name, *param));
+        }
+        record.params = writer.array(params);
+
+        std::vector<AttributeRecord> attributes;
+        for (const auto &[name, attribute]: op->m_attribute) {
+            AttributeRecord attribute_record;
+            if (!write_attribute(writer, *op, name, *attribute, attribute_record)) {
+                return false;
+            }
+            attributes.push_back(attribute_record);
+        }
+        record.attributes = writer.array(attributes);
+
+        std::vector<OperandRecord> inputs;
+        for (const auto &operand: op->m_input_operands_seq) {
+            inputs.push_back(write_operand(writer, *operand));
+        }
+        record.inputs = writer.array(inputs);
+        record.consumers = writer.strings(op->m_output_names);
+        if (op->m_output_operands != nullptr) {
+            record.has_output = 1;
+            record.output = write_operand(writer, *op->m_output_operands);
+        }
+        operator_records.push_back(record);
+    }
+
+    NativeHeader header;
+    std::memcpy(header.magic, kNativeMagic, sizeof(kNativeMagic));
+    header.version = kNativeModelVersion;
+    header.operator_count = operator_records.size();
+    header.operator_offset = writer.array(operator_records).offset;
+    if (plan != nullptr) {
+        header.plan_offset = write_plan(writer, *plan);
+    }
+    header.file_size = writer.size();
+    std::memcpy(writer.data(), &header, sizeof(header));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.write(writer.data(), std::streamsize(writer.size()))) {
+        LOG(ERROR) << "Can not write the native model: " << path;
+        return false;
+    }
+    return true;
+}
+
+static std::shared_ptr<RuntimeParameter> read_param(const NativeModelReader &reader, const ParamRecord &record) {
+    switch (ERuntimeParameterType(record.type)) {
+        case ERuntimeParameterType::ERPT_ParameterBool: {
+            const std::vector<int32_t> values = reader.values<int32_t>(record.values);
+            return values.size() == 1 ? std::make_shared<RuntimeParameterBool>(values.front() != 0) : nullptr;
+        }
+        case ERuntimeParameterType::ERPT_ParameterInt: {
+            const std::vector<int32_t> values = reader.values<int32_t>(record.values);
+            return values.size() == 1 ? std::make_shared<RuntimeParameterInt>(values.front()) : nullptr;
+        }
+        case ERuntimeParameterType::ERPT_ParameterFloat: {
+            const std::vector<float> values = reader.values<float>(record.values);
+            return values.size() == 1 ? std::make_shared<RuntimeParameterFloat>(values.front()) : nullptr;
+        }
+        case ERuntimeParameterType::ERPT_ParameterString: {
+            const std::vector<std::string> values = reader.strings(record.values);
+            return values.size() == 1 ? std::make_shared<RuntimeParameterString>(values.front()) : nullptr;
+        }
+        case ERuntimeParameterType::ERPT_ParameterIntArray:
+            return std::make_shared<RuntimeParameterIntArray>(reader.values<int32_t>(record.values));
+        case ERuntimeParameterType::ERPT_ParameterFloatArray:
+            return std::make_shared<RuntimeParameterFloatArray>(reader.values<float>(record.values));
+        case ERuntimeParameterType::ERPT_ParameterStringArray:
+            return std::make_shared<RuntimeParameterStringArray>(reader.strings(record.values));
+        default:
+            return std::make_shared<RuntimeParameter>();
+    }
+}
+
+static std::shared_ptr<RuntimeOperand> read_operand(const NativeModelReader &reader, const OperandRecord &record) {
+    std::shared_ptr<RuntimeOperand> operand = std::make_shared<RuntimeOperand>();
+    operand->m_name = reader.string(record.name);
+    operand->m_type = ERuntimeDataType(record.type);
+    operand->m_shapes = reader.values<uint32_t>(record.shapes);
+    return operand;
+}
+
+bool load_native_model(const std::string &path, std::vector<std::shared_ptr<RuntimeOperator>> &operators,
+                       NativeBuildPlan *plan) {
+    size_t size = 0;
+    std::shared_ptr<const char> mapping = pnnx::map_file(path, size);
+    if (mapping == nullptr || size < sizeof(NativeHeader)) {
+        LOG(ERROR) << "Can not map the native model: " << path;
+        return false;
+    }
+    const NativeHeader &header = *reinterpret_cast<const NativeHeader *>(mapping.get());
+    if (std::memcmp(header.magic, kNativeMagic, sizeof(kNativeMagic)) != 0 ||
+        header.version != kNativeModelVersion || header.file_size != size) {
+        LOG(ERROR) << "The native model " << path << " is broken or has a different version: " << header.version;
+        return false;
+    }
+
+    const NativeModelReader reader(mapping.get(), size);
+    const OperatorRecord *records = reader.array<OperatorRecord>(ArrayRef{header.operator_offset,
+                                                                          header.operator_count});
+    operators.clear();
+    for (uint32_t i = 0; records != nullptr && i < header.operator_count; ++i) {
+        const OperatorRecord &record = records[i];
+        std::shared_ptr<RuntimeOperator> op = std::make_shared<RuntimeOperator>();
+        op->m_name = reader.string(record.name);
+        op->m_type = reader.string(record.type);
+
+        const ParamRecord *params = reader.array<ParamRecord>(record.params);
+        for (uint64_t j = 0; params != nullptr && j < record.params.count; ++j) {
+            const std::shared_ptr<RuntimeParameter> param = read_param(reader, params[j]);
+            if (param == nullptr) {
+                LOG(ERROR) << "Wrong parameter record in operator " << op->m_name;
+                return false;
+            }
+            op->m_params.insert({reader.string(params[j].name), param});
+        }
+
+        // 属性只记录权重在映射中的位置，并持有映射直到层创建完毕
+        const AttributeRecord *attributes = reader.array<AttributeRecord>(record.attributes);
+        for (uint64_t j = 0; attributes != nullptr && j < record.attributes.count; ++j) {
+            const AttributeRecord &attribute_record = attributes[j];
+            if (!reader.contains(attribute_record.data.offset, attribute_record.data.count)) {
+                LOG(ERROR) << "Wrong attribute record in operator " << op->m_name;
+                return false;
+            }
+            std::shared_ptr<RuntimeAttribute> attribute = std::make_shared<RuntimeAttribute>();
+            attribute->m_type = ERuntimeDataType(attribute_record.type);
+            attribute->m_shapes = reader.values<uint32_t>(attribute_record.shapes);
+            attribute->m_mapping = mapping;
+            attribute->m_mapped_data = mapping.get() + attribute_record.data.offset;
+            attribute->m_mapped_size = attribute_record.data.count;
+            attribute->m_packed = attribute_record.packed != 0;
+            op->m_attribute.insert({reader.string(attribute_record.name), attribute});
+        }
+
+        const OperandRecord *inputs = reader.array<OperandRecord>(record.inputs);
+        for (uint64_t j = 0; inputs != nullptr && j < record.inputs.count; ++j) {
+            const std::shared_ptr<RuntimeOperand> operand = read_operand(reader, inputs[j]);
+            op->m_input_operands.insert({operand->m_name, operand});
+            op->m_input_operands_seq.push_back(operand);
+        }
+        op->m_output_names = reader.strings(record.consumers);
+        if (record.has_output) {
+            op->m_output_operands = read_operand(reader, record.output);
+        }
+        operators.push_back(op);
+    }
+
+    if (plan != nullptr) {
+        *plan = NativeBuildPlan();
+        if (header.plan_offset != 0) {
+            read_plan(reader, header.plan_offset, *plan);
+        }
+    }
+
+    if (!reader.valid() || operators.size() != header.operator_count) {
+        LOG(ERROR) << "The native model " << path << " is broken";
+        operators.clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,277 @@
+//
+// Created by xyzzzh on 2024/5/7.
+//
+
+#include "runtime/ModelRegistry.hpp"
+#include "runtime/PlanCache.hpp"
+#include <chrono>
+#include <filesystem>
+
+// 输入输出和最大batch不同时build的结果不同，不能共享
+static std::string build_options(const std::string &input_name, const std::string &output_name,
+                                 uint32_t max_batch_size) {
+    return "input=" + input_name + ";output=" + output_name + ";max_batch_size=" + std::to_string(max_batch_size);
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+ModelVersion::~ModelVersion() {
+    // 先释放计算图，再通知重新加载的调用者旧版本已经回收
+    this->graph.reset();
+    if (this->on_drained) {
+        this->on_drained();
+    }
+}
+
+ModelInstance::ModelInstance(std::shared_ptr<const RegisteredModel> model) : m_model(std::move(model)) {
+    CHECK(this->m_model != nullptr);
+    const std::shared_ptr<const ModelVersion> current = std::atomic_load(&this->m_model->current);
+    CHECK(current != nullptr && current->graph != nullptr);
+    this->m_version = current->version;
+    this->m_context = current->graph->create_context();
+}
+
+std::vector<std::shared_ptr<Tensor>> ModelInstance::forward(const std::vector<std::shared_ptr<Tensor>> &inputs) {
+    // forward期间持有当前版本，重新加载替换版本之后旧版本在这里释放
+    const std::shared_ptr<const ModelVersion> current = std::atomic_load(&this->m_model->current);
+    if (current->version != this->m_version) {
+        // 执行上下文按计算图的执行计划分配，版本变化时重新创建
+        this->m_context = current->graph->create_context();
+        this->m_version = current->version;
+    }
+    return current->graph->forward(*this->m_context, inputs);
+}
+
+std::shared_ptr<const RuntimeGraph> ModelInstance::graph() const {
+    const std::shared_ptr<const ModelVersion> current = std::atomic_load(&this->m_model->current);
+    return std::shared_ptr<const RuntimeGraph>(current, current->graph.get());
+}
+
+std::string ModelInstance::key() const {
+    return std::atomic_load(&this->m_model->current)->key;
+}
+
+uint64_t ModelInstance::version() const {
+    return std::atomic_load(&this->m_model->current)->version;
+}
+
+size_t ModelInstance::activation_memory_size() const {
+    return this->m_context->activation_memory_size();
+}
+
+ModelRegistry &ModelRegistry::global() {
+    static ModelRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<ModelInstance> ModelRegistry::acquire(const std::string &param_path, const std::string &bin_path,
+                                                      const std::string &input_name, const std::string &output_name,
+                                                      uint32_t max_batch_size) {
+    const std::string options = build_options(input_name, output_name, max_batch_size);
+    const std::string key = this->model_key(param_path, bin_path, options);
+    if (key.empty()) {
+        LOG(ERROR) << "Can not read the model: " << param_path << " " << bin_path;
+        return nullptr;
+    }
+
+    std::shared_ptr<RegisteredModel> model;
+    std::promise<void> built;
+    bool need_build = false;
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        auto iter = this->m_models.find(key);
+        if (iter == this->m_models.end()) {
+            model = std::make_shared<RegisteredModel>();
+            model->input_name = input_name;
+            model->output_name = output_name;
+            model->max_batch_size = max_batch_size;
+            model->ready = built.get_future().share();
+            this->m_models.insert({key, model});
+            need_build = true;
+        } else {
+            model = iter->second;
+        }
+    }
+
+    // build在锁外进行，获取其他模型的线程不需要等待
+    if (need_build) {
+        std::shared_ptr<RuntimeGraph> graph = std::make_shared<RuntimeGraph>(param_path, bin_path);
+        graph->set_max_batch_size(max_batch_size);
+        graph->build(input_name, output_name);
+        std::shared_ptr<ModelVersion> version = std::make_shared<ModelVersion>();
+        version->version = 1;
+        version->key = key;
+        version->param_path = param_path;
+        version->bin_path = bin_path;
+        version->graph = graph;
+        std::atomic_store(&model->current, std::shared_ptr<const ModelVersion>(version));
+        built.set_value();
+        LOG(INFO) << "Model registered: " << key << " " << bin_path;
+    } else {
+        model->ready.wait();
+    }
+    return std::shared_ptr<ModelInstance>(new ModelInstance(model));
+}
+
+std::future<ReloadResult> ModelRegistry::reload(const std::string &key, const std::string &param_path,
+                                                const std::string &bin_path) {
+    std::shared_ptr<std::promise<ReloadResult>> promise = std::make_shared<std::promise<ReloadResult>>();
+    std::future<ReloadResult> future = promise->get_future();
+    std::shared_ptr<RegisteredModel> model;
+    ThreadPool *pool = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        auto iter = this->m_models.find(key);
+        if (iter != this->m_models.end()) {
+            model = iter->second;
+            if (this->m_reload_pool == nullptr) {
+                this->m_reload_pool = std::make_unique<ThreadPool>(1);
+            }
+            pool = this->m_reload_pool.get();
+        }
+    }
+    if (model == nullptr) {
+        LOG(ERROR) << "Can not find the model to reload: " << key;
+        promise->set_value(ReloadResult());
+        return future;
+    }
+    // 同一个注册表的重新加载在后台线程中依次执行
+    pool->submit([this, model, param_path, bin_path, promise]() {
+        this->reload_model(model, param_path, bin_path, promise);
+    });
+    return future;
+}
+
+void ModelRegistry::reload_model(const std::shared_ptr<RegisteredModel> &model, const std::string &param_path,
+                                 const std::string &bin_path,
+                                 const std::shared_ptr<std::promise<ReloadResult>> &promise) {
+    model->ready.wait();
+    ReloadResult result;
+    const std::string key = this->model_key(param_path, bin_path, build_options(
+            model->input_name, model->output_name, model->max_batch_size));
+    if (key.empty()) {
+        LOG(ERROR) << "Can not read the model to reload: " << param_path << " " << bin_path;
+        promise->set_value(result);
+        return;
+    }
+
+    // 新版本在后台完整build，旧版本在此期间继续处理请求
+    const auto build_start = std::chrono::steady_clock::now();
+    std::shared_ptr<RuntimeGraph> graph = std::make_shared<RuntimeGraph>(param_path, bin_path);
+    graph->set_max_batch_size(model->max_batch_size);
+    if (!graph->init()) {
+        LOG(ERROR) << "Can not load the model to reload: " << param_path << " " << bin_path;
+        promise->set_value(result);
+        return;
+    }
+    graph->build(model->input_name, model->output_name);
+    result.build_ms = elapsed_ms(build_start);
+
+    std::shared_ptr<ModelVersion> version = std::make_shared<ModelVersion>();
+    version->key = key;
+    version->param_path = param_path;
+    version->bin_path = bin_path;
+    version->graph = graph;
+
+    std::shared_ptr<const ModelVersion> previous;
+    const auto swap_start = std::chrono::steady_clock::now();
+    {
+        // 更新索引和替换版本在同一个锁中完成，之后按新的键获取时得到新版本
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        previous = std::atomic_load(&model->current);
+        version->version = previous->version + 1;
+        // 已经卸载的模型不再加入索引；新的内容已经注册为另一个模型时保留原来的索引，
+        // 这两种情况下本模型只能通过已经分发的实例使用
+        auto iter = this->m_models.find(previous->key);
+        if (iter != this->m_models.end() && iter->second == model) {
+            this->m_models.erase(iter);
+            this->m_models.insert({key, model});
+        }
+        std::atomic_store(&model->current, std::shared_ptr<const ModelVersion>(version));
+    }
+    result.swap_us = elapsed_ms(swap_start) * 1000.;
+    result.success = true;
+    result.version = version->version;
+    result.key = key;
+    LOG(INFO) << "Model reloaded: " << previous->key << " -> " << key << ", version " << result.version
+              << ", build " << result.build_ms << " ms, swap " << result.swap_us << " us";
+
+    // 旧版本由正在执行的forward持有，最后一个使用者释放时得到结果
+    const auto drain_start = std::chrono::steady_clock::now();
+    previous->on_drained = [promise, result, drain_start]() mutable {
+        result.drain_ms = elapsed_ms(drain_start);
+        promise->set_value(result);
+    };
+    previous.reset();
+}
+
+bool ModelRegistry::unload(const std::string &key) {
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    return this->m_models.erase(key) > 0;
+}
+
+uint32_t ModelRegistry::unload_unused() {
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    uint32_t count = 0;
+    for (auto iter = this->m_models.begin(); iter != this->m_models.end();) {
+        // 注册表自己持有一个引用，正在build的模型也被build的线程持有
+        if (iter->second.use_count() == 1) {
+            iter = this->m_models.erase(iter);
+            count += 1;
+        } else {
+            ++iter;
+        }
+    }
+    return count;
+}
+
+uint32_t ModelRegistry::model_count() const {
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    return this->m_models.size();
+}
+
+uint32_t ModelRegistry::references(const std::string &key) const {
+    std::lock_guard<std::mutex> lock(this->m_mutex);
+    auto iter = this->m_models.find(key);
+    return iter == this->m_models.end() ? 0 : uint32_t(iter->second.use_count() - 1);
+}
+
+std::string ModelRegistry::model_key(const std::string &param_path, const std::string &bin_path,
+                                     const std::string &options) {
+    // 不同路径指向同一个文件时使用同一个键，内容相同的不同文件通过内容哈希合并
+    std::string path_key;
+    FileStamp stamp;
+    for (const std::string &path: {param_path, bin_path}) {
+        if (path.empty()) {
+            continue;
+        }
+        std::error_code error;
+        const std::filesystem::path canonical_path = std::filesystem::canonical(path, error);
+        const uintmax_t size = error ? 0 : std::filesystem::file_size(canonical_path, error);
+        const auto write_time = error ? std::filesystem::file_time_type() :
+                                std::filesystem::last_write_time(canonical_path, error);
+        if (error) {
+            return {};
+        }
+        path_key += canonical_path.string() + "|";
+        stamp.files.emplace_back(size, int64_t(write_time.time_since_epoch().count()));
+    }
+    path_key += options;
+
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        auto iter = this->m_file_stamps.find(path_key);
+        if (iter != this->m_file_stamps.end() && iter->second.files == stamp.files) {
+            return iter->second.key;
+        }
+    }
+
+    stamp.key = plan_cache_key(param_path, bin_path, options);
+    if (!stamp.key.empty()) {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        this->m_file_stamps[path_key] = stamp;
+    }
+    return stamp.key;
+}
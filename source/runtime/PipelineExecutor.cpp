@@ -0,0 +1,220 @@
+//
+// Created by xyzzzh on 2024/5/1.
+//
+
+#include "runtime/PipelineExecutor.hpp"
+#include <chrono>
+#include <limits>
+#include <numeric>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// 等待时先自旋kSpinCount次，再让出CPU直到kYieldCount次，之后阻塞
+static constexpr uint32_t kSpinCount = 64;
+static constexpr uint32_t kYieldCount = 1024;
+
+// 把当前线程绑定到指定的CPU核上
+static void pin_current_thread(const std::vector<uint32_t> &cores) {
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (uint32_t core: cores) {
+        CPU_SET(core, &cpu_set);
+    }
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) != 0) {
+        LOG(WARNING) << "Can not pin the pipeline stage to the cores";
+    }
+#else
+    LOG(WARNING) << "Pinning the pipeline stage is not supported on this platform";
+#endif
+}
+
+PipelineExecutor::PipelineExecutor(const RuntimeGraph &graph, const PipelineConfig &config,
+                                   const std::vector<std::shared_ptr<Tensor>> &sample_inputs) :
+        m_graph(graph), m_config(config) {
+    CHECK(graph.state() == EGraphState::EGS_Completed) << "Graph need be build!";
+    CHECK(config.num_stages > 0 && config.queue_capacity > 0) << "Wrong pipeline config";
+    this->partition(this->profile(sample_inputs));
+    const uint32_t stage_count = this->m_stage_ranges.size();
+    CHECK(this->m_config.core_groups.empty() || this->m_config.core_groups.size() >= stage_count)
+                    << "The core groups do not cover all the pipeline stages";
+
+    for (uint32_t i = 0; i <= stage_count; ++i) {
+        this->m_queues.push_back(std::make_unique<SPSCQueue<Item>>(this->m_config.queue_capacity));
+    }
+    // 每段正在执行一个输入，每个队列最多缓存queue_capacity个输入
+    const uint32_t context_count = stage_count + (stage_count + 1) * this->m_config.queue_capacity;
+    this->m_free_contexts = std::make_unique<SPSCQueue<std::shared_ptr<ExecutionContext>>>(context_count);
+    for (uint32_t i = 0; i < context_count; ++i) {
+        std::shared_ptr<ExecutionContext> context = graph.create_context();
+        CHECK(this->m_free_contexts->try_push(context));
+    }
+
+    for (uint32_t i = 0; i < stage_count; ++i) {
+        this->m_threads.emplace_back([this, i]() { this->stage_loop(i); });
+    }
+}
+
+PipelineExecutor::~PipelineExecutor() {
+    this->m_stop.store(true, std::memory_order_release);
+    this->notify_waiters();
+    for (auto &thread: this->m_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+std::vector<double> PipelineExecutor::profile(const std::vector<std::shared_ptr<Tensor>> &sample_inputs) const {
+    const uint32_t step_count = this->m_graph.m_steps.size();
+    std::vector<double> step_costs(step_count, 0.);
+    std::shared_ptr<ExecutionContext> context = this->m_graph.create_context();
+    this->m_graph.prepare_context(*context, sample_inputs);
+    // 第一次执行包含缓存和内存分配的开销，不计入耗时
+    const uint32_t rounds = std::max(1u, this->m_config.profile_rounds);
+    for (uint32_t round = 0; round <= rounds; ++round) {
+        for (uint32_t i = 0; i < step_count; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            this->m_graph.execute_step(*context, i, sample_inputs);
+            const auto end = std::chrono::steady_clock::now();
+            if (round > 0) {
+                step_costs.at(i) += std::chrono::duration<double, std::micro>(end - start).count() / rounds;
+            }
+        }
+    }
+    return step_costs;
+}
+
+void PipelineExecutor::partition(const std::vector<double> &step_costs) {
+    const uint32_t step_count = step_costs.size();
+    const uint32_t stage_count = std::min(this->m_config.num_stages, step_count);
+    CHECK(stage_count > 0) << "The graph has no execution step";
+    std::vector<double> prefix(step_count + 1, 0.);
+    std::partial_sum(step_costs.begin(), step_costs.end(), prefix.begin() + 1);
+
+    // best[s][i]为前i个步骤分成s段时耗时最大的一段的最小值，split记录最后一段的起点
+    const double infinity = std::numeric_limits<double>::infinity();
+    std::vector<std::vector<double>> best(stage_count + 1, std::vector<double>(step_count + 1, infinity));
+    std::vector<std::vector<uint32_t>> split(stage_count + 1, std::vector<uint32_t>(step_count + 1, 0));
+    best[0][0] = 0.;
+    for (uint32_t s = 1; s <= stage_count; ++s) {
+        for (uint32_t i = s; i <= step_count; ++i) {
+            for (uint32_t j = s - 1; j < i; ++j) {
+                const double cost = std::max(best[s - 1][j], prefix[i] - prefix[j]);
+                if (cost < best[s][i]) {
+                    best[s][i] = cost;
+                    split[s][i] = j;
+                }
+            }
+        }
+    }
+
+    this->m_stage_ranges.assign(stage_count, {0, 0});
+    this->m_stage_costs.assign(stage_count, 0.);
+    uint32_t end = step_count;
+    for (uint32_t s = stage_count; s > 0; --s) {
+        const uint32_t begin = split[s][end];
+        this->m_stage_ranges.at(s - 1) = {begin, end};
+        this->m_stage_costs.at(s - 1) = prefix[end] - prefix[begin];
+        end = begin;
+    }
+}
+
+template<typename Func>
+bool PipelineExecutor::wait_for(Func func) {
+    uint32_t spins = 0;
+    while (!func()) {
+        if (this->m_stop.load(std::memory_order_acquire)) {
+            return false;
+        }
+        if (++spins <= kSpinCount) {
+            continue;
+        }
+        if (spins <= kYieldCount) {
+            std::this_thread::yield();
+            continue;
+        }
+        // 先读取序号再检查一次，之后队列的任何变化都会使序号改变，不会错过唤醒
+        const uint64_t sequence = this->m_sequence.load();
+        if (func()) {
+            break;
+        }
+        std::unique_lock<std::mutex> lock(this->m_wait_mutex);
+        this->m_waiters.fetch_add(1);
+        this->m_wait_condition.wait(lock, [this, sequence]() {
+            return this->m_stop.load() || this->m_sequence.load() != sequence;
+        });
+        this->m_waiters.fetch_sub(1);
+        spins = 0;
+    }
+    this->notify_waiters();
+    return true;
+}
+
+void PipelineExecutor::notify_waiters() {
+    this->m_sequence.fetch_add(1);
+    if (this->m_waiters.load() > 0) {
+        {
+            // 加锁保证阻塞的线程在检查序号和进入等待之间不会错过通知
+            std::lock_guard<std::mutex> lock(this->m_wait_mutex);
+        }
+        this->m_wait_condition.notify_all();
+    }
+}
+
+void PipelineExecutor::stage_loop(uint32_t stage) {
+    if (!this->m_config.core_groups.empty()) {
+        pin_current_thread(this->m_config.core_groups.at(stage));
+    }
+    SPSCQueue<Item> &input_queue = *this->m_queues.at(stage);
+    SPSCQueue<Item> &output_queue = *this->m_queues.at(stage + 1);
+    const auto [begin, end] = this->m_stage_ranges.at(stage);
+    Item item;
+    while (this->wait_for([&]() { return input_queue.try_pop(item); })) {
+        for (uint32_t i = begin; i < end; ++i) {
+            this->m_graph.execute_step(*item.context, i, item.inputs);
+        }
+        if (!this->wait_for([&]() { return output_queue.try_push(item); })) {
+            break;
+        }
+    }
+}
+
+void PipelineExecutor::push(const std::vector<std::shared_ptr<Tensor>> &inputs) {
+    Item item;
+    this->wait_for([&]() { return this->m_free_contexts->try_pop(item.context); });
+    CHECK(item.context != nullptr) << "The pipeline has been stopped";
+    this->m_graph.prepare_context(*item.context, inputs);
+    item.inputs = inputs;
+    // 空闲上下文的数量不超过所有队列的总容量，输入队列一定能放下
+    this->wait_for([&]() { return this->m_queues.front()->try_push(item); });
+}
+
+std::vector<std::shared_ptr<Tensor>> PipelineExecutor::pop() {
+    Item item;
+    this->wait_for([&]() { return this->m_queues.back()->try_pop(item); });
+    CHECK(item.context != nullptr) << "The pipeline has been stopped";
+    // 上下文会被之后的输入复用，返回输出的副本
+    std::vector<std::shared_ptr<Tensor>> outputs;
+    for (const auto &output: this->m_graph.context_outputs(*item.context)) {
+        outputs.push_back(output->clone());
+    }
+    CHECK(this->m_free_contexts->try_push(item.context));
+    this->notify_waiters();
+    return outputs;
+}
+
+uint32_t PipelineExecutor::stage_count() const {
+    return this->m_stage_ranges.size();
+}
+
+const std::vector<std::pair<uint32_t, uint32_t>> &PipelineExecutor::stage_ranges() const {
+    return this->m_stage_ranges;
+}
+
+const std::vector<double> &PipelineExecutor::stage_costs() const {
+    return this->m_stage_costs;
+}
@@ -0,0 +1,103 @@
+//
+// Created by xyzzzh on 2024/5/6.
+//
+
+#include "runtime/PlanCache.hpp"
+#include "runtime/store_zip.hpp"
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+// 两路独立的64位哈希组成128位的键，每次处理8个字节，避免不同模型的缓存发生冲突
+class ContentHasher {
+public:
+    void update(const char *data, size_t size) {
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(uint64_t));
+            this->mix(word);
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, data + i, size - i);
+        this->mix(tail ^ (uint64_t(size - i) << 56));
+        this->mix(uint64_t(size));
+    }
+
+    void update(const std::string &value) {
+        this->update(value.data(), value.size());
+    }
+
+    std::string digest() const {
+        std::ostringstream stream;
+        stream << std::hex << std::setfill('0') << std::setw(16) << finalize(this->m_low)
+               << std::setw(16) << finalize(this->m_high);
+        return stream.str();
+    }
+
+private:
+    void mix(uint64_t word) {
+        this->m_low = (this->m_low ^ word) * 0x100000001b3ull;
+        this->m_high = rotate(this->m_high + word * 0x9e3779b97f4a7c15ull, 31) * 0xc2b2ae3d27d4eb4full;
+    }
+
+    static uint64_t rotate(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    static uint64_t finalize(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdull;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ull;
+        value ^= value >> 33;
+        return value;
+    }
+
+    uint64_t m_low = 0xcbf29ce484222325ull;
+    uint64_t m_high = 0x27d4eb2f165667c5ull;
+};
+} // namespace
+
+std::string cpu_features() {
+    std::string features;
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    const std::pair<const char *, bool> supports[] = {
+            {"sse4.2",  bool(__builtin_cpu_supports("sse4.2"))},
+            {"avx",     bool(__builtin_cpu_supports("avx"))},
+            {"avx2",    bool(__builtin_cpu_supports("avx2"))},
+            {"fma",     bool(__builtin_cpu_supports("fma"))},
+            {"avx512f", bool(__builtin_cpu_supports("avx512f"))},
+    };
+    for (const auto &[name, supported]: supports) {
+        if (supported) {
+            features += features.empty() ? name : std::string(",") + name;
+        }
+    }
+#elif defined(__aarch64__)
+    features = "aarch64";
+#endif
+    return features.empty() ? "generic" : features;
+}
+
+std::string plan_cache_key(const std::string &param_path, const std::string &bin_path, const std::string &options) {
+    ContentHasher hasher;
+    std::vector<std::string> paths{bin_path};
+    if (!param_path.empty()) {
+        paths.insert(paths.begin(), param_path);
+    }
+    for (const std::string &path: paths) {
+        size_t size = 0;
+        std::shared_ptr<const char> data = pnnx::map_file(path, size);
+        if (data == nullptr) {
+            return {};
+        }
+        hasher.update(data.get(), size);
+    }
+    hasher.update(std::to_string(kRuntimeVersion));
+    hasher.update(cpu_features());
+    hasher.update(options);
+    return hasher.digest();
+}
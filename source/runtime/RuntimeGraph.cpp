@@ -3,6 +3,13 @@
 #include "runtime/RuntimeGraph.hpp"
 #include "layer/abstract/Layer.hpp"
 #include "layer/abstract/LayerRegisterer.hpp"
+#include "runtime/MemoryPlanner.hpp"
+#include "runtime/PlanCache.hpp"
+#include <filesystem>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <unordered_map>
 
 // 构造函数，初始化参数路径和二进制文件路径
 RuntimeGraph::RuntimeGraph(std::string param_path, std::string bin_path) {
@@ -10,6 +17,12 @@ RuntimeGraph::RuntimeGraph(std::string param_path, std::string bin_path) {
     this->m_bin_path = std::move(bin_path);
 }
 
+RuntimeGraph::~RuntimeGraph() {
+    // 异步请求持有计算图的指针，析构前等待它们全部完成
+    std::unique_lock<std::mutex> lock(this->m_async_mutex);
+    this->m_async_condition.wait(lock, [this]() { return this->m_running_requests == 0; });
+}
+
 // 构建函数，负责根据输入和输出名称构建计算图
 void RuntimeGraph::build(const std::string &input_name, const std::string &output_name) {
     // 如果计算图已经构建完成，则不再重复构建
@@ -18,9 +31,13 @@ void RuntimeGraph::build(const std::string &input_name, const std::string &outpu
         return;
     }
 
+    // 按模型内容和build选项查找缓存，找到时跳过解析pnnx模型和计算图优化
+    this->m_plan_cache_hit = false;
+    this->m_plan_cache_path = this->plan_cache_path(input_name, output_name);
+
     // 如果需要初始化，则先进行初始化操作
     if (this->m_state == EGraphState::EGS_NeedInit) {
-        bool init_graph = this->init();
+        bool init_graph = this->init_from_plan_cache() || this->init();
         // 初始化失败的情况下，记录致命错误
         LOG_IF(FATAL, !init_graph) << "Init graph failed!";
     }
@@ -30,6 +47,20 @@ void RuntimeGraph::build(const std::string &input_name, const std::string &outpu
     // 如果操作符列表为空，则记录致命错误
     LOG_IF(FATAL, this->m_operators.empty()) << "Graph operators is empty, may be no init";
 
+    // 初始化节点的输入和输出空间，此时操作符与pnnx中的节点一一对应
+    init_operator_input(this->m_operators, this->m_max_batch_size);
+    if (this->m_graph != nullptr) {
+        init_operator_output(this->m_graph->ops, this->m_operators, this->m_max_batch_size);
+    } else {
+        // 原生格式的模型在加载时已经记录了输出操作数的形状
+        init_operator_output(this->m_operators, this->m_max_batch_size);
+    }
+
+    // 在创建层之前折叠常量、删除无用的算子并合并相同的算子
+    if (this->m_graph_optimization && !this->m_operators_optimized) {
+        this->optimize_operators(output_name);
+    }
+
     // 构建图关系
     // 遍历所有操作符，构建操作符之间的关系
     for (const auto &curr_op: this->m_operators) {
@@ -46,46 +77,79 @@ void RuntimeGraph::build(const std::string &input_name, const std::string &outpu
     }
 
     // 除了输入和输出节点外，为每个操作符创建对应的层
+    // 创建层时解析参数并把权重重排为计算时的布局，各算子之间互不依赖，可以并行执行
+    // 延迟加载时只解析参数，权重在第一次forward执行到该层时再写入
+    std::vector<std::shared_ptr<RuntimeOperator>> layer_operators;
     for (const auto &op: this->m_operators) {
         if (op->m_type != "pnnx.Input" && op->m_type != "pnnx.Output") {
-            std::shared_ptr<Layer> layer = RuntimeGraph::create_layer(op);
-            // 确保层创建成功
-            CHECK(layer != nullptr) << "Layer " << op->m_name << " create failed!";
-            if (layer) {
-                // 为操作符设置对应的层，并初始化层的运行时操作符
-                op->m_layer = layer;
-                layer->set_runtime_operator(op);
-            }
+            op->m_lazy_weights = this->m_lazy_weights;
+            layer_operators.push_back(op);
         }
     }
+    std::vector<std::shared_ptr<Layer>> layers(layer_operators.size());
+    this->parallel_load(layer_operators.size(), [&](uint32_t i) {
+        layers.at(i) = RuntimeGraph::create_layer(layer_operators.at(i));
+    });
+    for (uint32_t i = 0; i < layer_operators.size(); ++i) {
+        const auto &op = layer_operators.at(i);
+        const std::shared_ptr<Layer> &layer = layers.at(i);
+        // 确保层创建成功
+        CHECK(layer != nullptr) << "Layer " << op->m_name << " create failed!";
+        // 为操作符设置对应的层，并初始化层的运行时操作符
+        op->m_layer = layer;
+        layer->set_runtime_operator(op);
+    }
 
-    // 初始化节点的输入和输出空间
-    init_operator_input(this->m_operators);
-    init_operator_output(this->m_graph->ops, this->m_operators);
+    // 将填充算子折叠到后继层中
+    this->fold_padding_operators();
 
     // 构建拓扑排序
     this->m_topo_operators.clear();
-    for (const auto &[_, op]: this->m_operators_maps) {
-        // 根据输入节点构建拓扑排序
-        if (op->m_type == "pnnx.Input" && !op->m_has_forward) {
-            this->ReverseTopo(op);
+    const std::vector<uint32_t> &topo_order = this->m_cached_plan.topo_order;
+    if (topo_order.size() == this->m_operators.size()) {
+        // 缓存中记录了每个算子在拓扑序中的位置
+        for (uint32_t index: topo_order) {
+            CHECK(index < this->m_operators.size()) << "Wrong topo order in the plan cache";
+            this->m_topo_operators.push_back(this->m_operators.at(index));
         }
+    } else {
+        for (const auto &[_, op]: this->m_operators_maps) {
+            // 从输入节点和常量节点这些没有前驱的节点开始构建拓扑排序
+            if (op->m_input_operands_seq.empty() && !op->m_has_forward) {
+                this->ReverseTopo(op);
+            }
+        }
+
+        // 确保拓扑排序的大小与操作符列表的大小相同
+        CHECK(this->m_topo_operators.size() == this->m_operators.size()) << "Build wrong topo queue";
+        // 将拓扑排序反转以满足执行顺序
+        std::reverse(this->m_topo_operators.begin(), this->m_topo_operators.end());
     }
 
-    // 确保拓扑排序的大小与操作符列表的大小相同
-    CHECK(this->m_topo_operators.size() == this->m_operators.size()) << "Build wrong topo queue";
-    // 将拓扑排序反转以满足执行顺序
-    std::reverse(this->m_topo_operators.begin(), this->m_topo_operators.end());
+    // 记录算子之间的依赖关系
+    this->build_dependencies();
+
+    // 输入没有其他使用者的逐元素算子直接在输入上计算
+    this->inplace_operators();
 
     // 更新计算图状态为已完成，记录输入和输出名称
     this->m_state = EGraphState::EGS_Completed;
     this->m_input_name = input_name;
     this->m_output_name = output_name;
+
+    // 展开为执行步骤，并按模型中记录的形状规划激活内存
+    this->build_execution_plan();
     // 重置图对象
     if (this->m_graph != nullptr) {
         this->m_graph.reset();
         this->m_graph = nullptr;
     }
+
+    // 冷启动时把build的结果写入缓存，下次启动直接加载
+    if (!this->m_plan_cache_path.empty() && !this->m_plan_cache_hit) {
+        this->save_plan_cache();
+    }
+    this->m_cached_plan = NativeBuildPlan();
 }
 
 // 设置参数路径
@@ -113,8 +177,90 @@ const EGraphState &RuntimeGraph::state() const {
     return this->m_state;
 }
 
+void RuntimeGraph::set_num_threads(uint32_t num_threads) {
+    // 并行执行时激活内存的规划方式不同，必须在build之前确定
+    CHECK(this->m_state != EGraphState::EGS_Completed) << "The number of threads must be set before build";
+    this->m_num_threads = std::max(1u, num_threads);
+    if (this->m_num_threads > 1) {
+        this->m_thread_pool = std::make_unique<ThreadPool>(this->m_num_threads - 1);
+    } else {
+        this->m_thread_pool.reset();
+    }
+}
+
+uint32_t RuntimeGraph::num_threads() const {
+    return this->m_num_threads;
+}
+
+void RuntimeGraph::set_load_threads(uint32_t load_threads) {
+    CHECK(this->m_state != EGraphState::EGS_Completed) << "The load threads must be set before build";
+    this->m_load_threads = load_threads;
+}
+
+uint32_t RuntimeGraph::load_threads() const {
+    return this->m_load_threads;
+}
+
+void RuntimeGraph::set_max_batch_size(uint32_t max_batch_size) {
+    // 操作数和激活内存按最大batch分配，必须在build之前确定
+    CHECK(this->m_state != EGraphState::EGS_Completed) << "The max batch size must be set before build";
+    this->m_max_batch_size = max_batch_size;
+}
+
+uint32_t RuntimeGraph::max_batch_size() const {
+    return this->m_max_batch_size;
+}
+
+void RuntimeGraph::set_graph_optimization(bool enabled) {
+    CHECK(this->m_state != EGraphState::EGS_Completed) << "The graph optimization must be set before build";
+    this->m_graph_optimization = enabled;
+}
+
+bool RuntimeGraph::graph_optimization() const {
+    return this->m_graph_optimization;
+}
+
+const GraphOptimizeStats &RuntimeGraph::optimize_stats() const {
+    return this->m_optimize_stats;
+}
+
+void RuntimeGraph::set_lazy_weights(bool lazy_weights) {
+    CHECK(this->m_state != EGraphState::EGS_Completed) << "Lazy weights must be set before build";
+    this->m_lazy_weights = lazy_weights;
+}
+
+bool RuntimeGraph::lazy_weights() const {
+    return this->m_lazy_weights;
+}
+
+void RuntimeGraph::set_weight_prefetch(uint32_t prefetch_layers) {
+    this->m_weight_prefetch = prefetch_layers;
+}
+
+uint32_t RuntimeGraph::weight_prefetch() const {
+    return this->m_weight_prefetch;
+}
+
+void RuntimeGraph::set_plan_cache_dir(const std::string &plan_cache_dir) {
+    CHECK(this->m_state != EGraphState::EGS_Completed) << "The plan cache dir must be set before build";
+    this->m_plan_cache_dir = plan_cache_dir;
+}
+
+const std::string &RuntimeGraph::plan_cache_dir() const {
+    return this->m_plan_cache_dir;
+}
+
+bool RuntimeGraph::plan_cache_hit() const {
+    return this->m_plan_cache_hit;
+}
+
 // 计算图的初始化函数
 bool RuntimeGraph::init() {
+    // 原生格式的模型不需要结构文件
+    if (!this->m_bin_path.empty() && is_native_model(this->m_bin_path)) {
+        return this->init_native();
+    }
+
     // 如果二进制文件路径或参数路径为空，则返回失败
     if (this->m_bin_path.empty() || this->m_param_path.empty()) {
         LOG(ERROR) << "The bin path or param path is empty";
@@ -143,50 +289,169 @@ bool RuntimeGraph::init() {
     // 清空当前的操作符列表和映射
     this->m_operators.clear();
     this->m_operators_maps.clear();
+    this->m_operators_optimized = false;
 
-    // 遍历操作符，为每个操作符创建运行时表示，并初始化其属性
-    for (const auto &op: operators) {
-        if (op == nullptr) {
+    // 并行为每个操作符创建运行时表示，结果按pnnx中的顺序存放
+    std::vector<std::shared_ptr<RuntimeOperator>> runtime_operators(operators.size());
+    this->parallel_load(operators.size(), [&](uint32_t i) {
+        if (operators.at(i) != nullptr) {
+            runtime_operators.at(i) = create_operator(operators.at(i));
+        }
+    });
+
+    // 按原有顺序将操作符添加到列表和映射中
+    for (const auto &runtime_operator: runtime_operators) {
+        if (runtime_operator == nullptr) {
             LOG(ERROR) << "Meet the empty node";
             continue;
-        } else {
-            // 为每个操作符创建运行时表示
-            std::shared_ptr<RuntimeOperator> runtime_operator = std::make_shared<RuntimeOperator>();
-            runtime_operator->m_name = op->name;
-            runtime_operator->m_type = op->type;
+        }
+        this->m_operators.push_back(runtime_operator);
+        this->m_operators_maps.insert({runtime_operator->m_name, runtime_operator});
+    }
+    // 更新计算图的状态为需要构建
+    this->m_state = EGraphState::EGS_NeedBuild;
+    return true;
+}
 
-            // 初始化操作符的输入
-            const auto &inputs = op->inputs;
-            if (!inputs.empty()) {
-                init_graph_operators_input(inputs, runtime_operator);
-            }
+bool RuntimeGraph::init_native() {
+    std::vector<std::shared_ptr<RuntimeOperator>> operators;
+    if (!load_native_model(this->m_bin_path, operators) || operators.empty()) {
+        LOG(ERROR) << "Can not load the native model: " << this->m_bin_path;
+        return false;
+    }
+    this->set_native_operators(std::move(operators));
+    return true;
+}
 
-            // 记录操作符的输出名称
-            const auto &outputs = op->outputs;
-            if (!outputs.empty()) {
-                init_graph_operators_output(outputs, runtime_operator);
-            }
+void RuntimeGraph::set_native_operators(std::vector<std::shared_ptr<RuntimeOperator>> operators) {
+    this->m_graph.reset();
+    this->m_operators = std::move(operators);
+    this->m_operators_maps.clear();
+    for (const auto &op: this->m_operators) {
+        this->m_operators_maps.insert({op->m_name, op});
+    }
+    this->m_operators_optimized = true;
+    this->m_state = EGraphState::EGS_NeedBuild;
+}
 
-            // 初始化操作符的属性
-            const auto &attrs = op->attrs;
-            if (!attrs.empty()) {
-                init_graph_attrs(attrs, runtime_operator);
-            }
+std::string RuntimeGraph::plan_cache_path(const std::string &input_name, const std::string &output_name) const {
+    // 原生格式的模型本身已经不需要解析和优化
+    if (this->m_plan_cache_dir.empty() || this->m_param_path.empty() || this->m_bin_path.empty() ||
+        is_native_model(this->m_bin_path)) {
+        return {};
+    }
+    // 影响优化结果、拓扑序和内存规划的选项都是键的一部分
+    std::ostringstream options;
+    options << "input=" << input_name << ";output=" << output_name
+            << ";max_batch_size=" << this->m_max_batch_size
+            << ";graph_optimization=" << this->m_graph_optimization
+            << ";parallel=" << (this->m_num_threads > 1);
+    const std::string key = plan_cache_key(this->m_param_path, this->m_bin_path, options.str());
+    if (key.empty()) {
+        return {};
+    }
+    return (std::filesystem::path(this->m_plan_cache_dir) / (key + ".infer")).string();
+}
 
-            // 初始化操作符的参数
-            const auto &params = op->params;
-            if (!params.empty()) {
-                init_graph_params(params, runtime_operator);
-            }
+bool RuntimeGraph::init_from_plan_cache() {
+    std::error_code error;
+    if (this->m_plan_cache_path.empty() || !std::filesystem::exists(this->m_plan_cache_path, error)) {
+        return false;
+    }
+    std::vector<std::shared_ptr<RuntimeOperator>> operators;
+    NativeBuildPlan plan;
+    if (!load_native_model(this->m_plan_cache_path, operators, &plan) || operators.empty()) {
+        // 损坏的缓存在这次build之后被覆盖
+        LOG(WARNING) << "Ignore the broken plan cache: " << this->m_plan_cache_path;
+        return false;
+    }
+    this->set_native_operators(std::move(operators));
+    this->m_cached_plan = std::move(plan);
+    this->m_plan_cache_hit = true;
+    return true;
+}
+
+void RuntimeGraph::save_plan_cache() const {
+    std::unordered_map<const RuntimeOperator *, uint32_t> operator_index;
+    for (uint32_t i = 0; i < this->m_operators.size(); ++i) {
+        operator_index.insert({this->m_operators.at(i).get(), i});
+    }
+    NativeBuildPlan plan;
+    for (const auto &op: this->m_topo_operators) {
+        plan.topo_order.push_back(operator_index.at(op.get()));
+    }
+    plan.execution_plan = this->m_plan;
+
+    // 先写入临时文件再重命名，其他进程不会读到写了一半的缓存
+    std::error_code error;
+    std::filesystem::create_directories(this->m_plan_cache_dir, error);
+    const std::string temp_path = this->m_plan_cache_path + ".tmp" + std::to_string(std::random_device()());
+    if (!save_native_model(this->m_operators, temp_path, &plan)) {
+        LOG(WARNING) << "Can not write the plan cache: " << this->m_plan_cache_path;
+        std::filesystem::remove(temp_path, error);
+        return;
+    }
+    std::filesystem::rename(temp_path, this->m_plan_cache_path, error);
+    if (error) {
+        LOG(WARNING) << "Can not write the plan cache: " << this->m_plan_cache_path << " " << error.message();
+        std::filesystem::remove(temp_path, error);
+    }
+}
 
-            // 将操作符添加到列表和映射中
-            this->m_operators.push_back(runtime_operator);
-            this->m_operators_maps.insert({runtime_operator->m_name, runtime_operator});
+bool RuntimeGraph::export_model(const std::string &path) const {
+    CHECK(this->m_state == EGraphState::EGS_Completed) << "Graph need be build before export!";
+    // 导出的模型保存计算时的布局，还没有执行到的层先写入权重
+    for (const auto &op: this->m_operators) {
+        if (op->m_layer != nullptr) {
+            op->m_layer->materialize_weights();
         }
     }
-    // 更新计算图的状态为需要构建
-    this->m_state = EGraphState::EGS_NeedBuild;
-    return true;
+    return save_native_model(this->m_operators, path);
+}
+
+std::shared_ptr<RuntimeOperator> RuntimeGraph::create_operator(const pnnx::Operator *op) {
+    std::shared_ptr<RuntimeOperator> runtime_operator = std::make_shared<RuntimeOperator>();
+    runtime_operator->m_name = op->name;
+    runtime_operator->m_type = op->type;
+
+    // 初始化操作符的输入
+    const auto &inputs = op->inputs;
+    if (!inputs.empty()) {
+        init_graph_operators_input(inputs, runtime_operator);
+    }
+
+    // 记录操作符的输出名称
+    const auto &outputs = op->outputs;
+    if (!outputs.empty()) {
+        init_graph_operators_output(outputs, runtime_operator);
+    }
+
+    // 初始化操作符的属性
+    const auto &attrs = op->attrs;
+    if (!attrs.empty()) {
+        init_graph_attrs(attrs, runtime_operator);
+    }
+
+    // 初始化操作符的参数
+    const auto &params = op->params;
+    if (!params.empty()) {
+        init_graph_params(params, runtime_operator);
+    }
+    return runtime_operator;
+}
+
+void RuntimeGraph::parallel_load(uint32_t count, const std::function<void(uint32_t)> &func) const {
+    const uint32_t load_threads = this->m_load_threads == 0 ?
+                                  std::max(1u, std::thread::hardware_concurrency()) : this->m_load_threads;
+    if (load_threads <= 1 || count <= 1) {
+        for (uint32_t i = 0; i < count; ++i) {
+            func(i);
+        }
+        return;
+    }
+    // 加载只在init和build时进行一次，线程池用完即释放，调用线程也参与执行
+    ThreadPool pool(std::min(load_threads, count) - 1);
+    pool.parallel_for(count, func);
 }
 
 // 获取操作符列表
@@ -255,7 +520,14 @@ RuntimeGraph::init_graph_attrs(const std::map<std::string, pnnx::Attribute> &att
             case 1: {
                 std::shared_ptr<RuntimeAttribute> runtime_attr = std::make_shared<RuntimeAttribute>();
                 runtime_attr->m_type = ERuntimeDataType::ERDT_Float32;
-                runtime_attr->m_weight_data = attr.data;
+                // 映射的权重只记录位置并持有映射，由层直接读取，不经过中间拷贝
+                if (attr.mapped_data != nullptr) {
+                    runtime_attr->m_mapping = attr.mapping;
+                    runtime_attr->m_mapped_data = attr.mapped_data;
+                    runtime_attr->m_mapped_size = attr.mapped_size;
+                } else {
+                    runtime_attr->m_weight_data = attr.data;
+                }
                 runtime_attr->m_shapes = std::vector<uint32_t>(attr.shape.begin(), attr.shape.end());
                 runtime_operator->m_attribute.insert({name, runtime_attr});
                 break;
@@ -363,6 +635,563 @@ void RuntimeGraph::ReverseTopo(const std::shared_ptr<RuntimeOperator> &root_op)
     this->m_topo_operators.push_back(root_op);
 }
 
+// 不做原地计算却声明了复用输入的层(例如折叠到后继层的填充算子)执行时直接把输入作为输出
+// 这类步骤的输出总是与输入共享存储，与模型中记录的输出形状无关
+static bool step_passes_input(const ExecutionStep &step) {
+    return step.inplace_operand >= 0 && step.layer != nullptr && !step.layer->support_inplace();
+}
+
+static bool plan_matches_steps(const ExecutionPlan &plan, const std::vector<ExecutionStep> &steps,
+                               const std::vector<std::vector<uint32_t>> &shapes) {
+    if (plan.output_shapes != shapes || plan.offsets.size() != steps.size() ||
+        plan.inplace_operands.size() != steps.size()) {
+        return false;
+    }
+    for (uint32_t i = 0; i < steps.size(); ++i) {
+        if (plan.inplace_operands.at(i) >= 0 && plan.inplace_operands.at(i) != steps.at(i).inplace_operand) {
+            return false;
+        }
+        if (step_passes_input(steps.at(i)) && plan.inplace_operands.at(i) != steps.at(i).inplace_operand) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void RuntimeGraph::build_execution_plan() {
+    const uint32_t operator_count = this->m_topo_operators.size();
+    std::unordered_map<std::string, uint32_t> topo_index;
+    for (uint32_t i = 0; i < operator_count; ++i) {
+        topo_index.insert({this->m_topo_operators.at(i)->m_name, i});
+    }
+
+    this->m_steps.assign(operator_count, ExecutionStep());
+    this->m_output_step = -1;
+    for (uint32_t i = 0; i < operator_count; ++i) {
+        const auto &op = this->m_topo_operators.at(i);
+        ExecutionStep &step = this->m_steps.at(i);
+        step.op = op;
+        if (op->m_type == "pnnx.Input") {
+            step.type = EExecutionStepType::EEST_Input;
+        } else if (op->m_type == "pnnx.Output") {
+            step.type = EExecutionStepType::EEST_Output;
+            CHECK(op->m_input_operands_seq.size() == 1);
+        } else {
+            CHECK(op->m_layer != nullptr && op->m_output_operands != nullptr);
+            step.type = EExecutionStepType::EEST_Layer;
+            step.layer = op->m_layer.get();
+            step.batch_size = op->m_output_operands->m_data.size();
+        }
+        if (op->m_name == this->m_output_name) {
+            this->m_output_step = int32_t(i);
+        }
+        // 记录模型中的输出形状，去掉batch维度
+        if (op->m_output_operands != nullptr && !op->m_output_operands->m_shapes.empty()) {
+            const auto &shapes = op->m_output_operands->m_shapes;
+            step.output_shapes.assign(shapes.begin() + 1, shapes.end());
+        }
+
+        // 输入按操作数顺序拼接，记录每个操作数在前驱步骤输出中的来源
+        const int32_t aliased_input = step.layer != nullptr ? step.layer->aliased_input() : -1;
+        step.operand_count = op->m_input_operands_seq.size();
+        for (uint32_t k = 0; k < step.operand_count; ++k) {
+            const auto &operand = op->m_input_operands_seq.at(k);
+            const auto producer = topo_index.find(operand->m_name);
+            CHECK(producer != topo_index.end() && producer->second < i)
+                            << "Can not find the producer of operand " << operand->m_name;
+            ExecutionStep &producer_step = this->m_steps.at(producer->second);
+            if (producer_step.type == EExecutionStepType::EEST_Input) {
+                producer_step.batch_size = operand->m_data.size();
+                // 计算图的输入在每次forward时写入
+                for (auto &tensor: operand->m_data) {
+                    tensor.reset();
+                }
+            }
+            if (step.type == EExecutionStepType::EEST_Output) {
+                step.batch_size = operand->m_data.size();
+                step.output_shapes.assign(operand->m_shapes.begin() + 1, operand->m_shapes.end());
+            }
+            if (int32_t(k) == aliased_input) {
+                step.inplace_operand = int32_t(k);
+            }
+            step.producers.push_back(producer->second);
+            producer_step.consumers.push_back({i, k});
+        }
+    }
+
+    // 所有步骤的batch大小相同，执行时只使用前n个张量
+    uint32_t batch_size = 0;
+    for (const ExecutionStep &step: this->m_steps) {
+        if (step.batch_size == 0) {
+            continue;
+        }
+        CHECK(batch_size == 0 || batch_size == step.batch_size)
+                        << "The batch size of operator " << step.op->m_name << " do not match the graph";
+        batch_size = step.batch_size;
+    }
+    if (this->m_max_batch_size == 0) {
+        this->m_max_batch_size = batch_size;
+    }
+    CHECK(batch_size == this->m_max_batch_size) << "The batch size of operators do not match the max batch size";
+
+    // 按模型中记录的形状规划激活内存，作为默认的执行计划
+    std::vector<std::vector<uint32_t>> shapes;
+    std::vector<uint32_t> input_shapes;
+    for (const ExecutionStep &step: this->m_steps) {
+        shapes.push_back(step.output_shapes);
+        if (step.type == EExecutionStepType::EEST_Input) {
+            CHECK(input_shapes.empty()) << "Only support one input operator yet!";
+            input_shapes = step.output_shapes;
+        }
+    }
+    // 缓存中的执行计划只在形状和原地计算的选择都与当前步骤相同时使用
+    std::shared_ptr<const ExecutionPlan> plan = this->m_cached_plan.execution_plan;
+    if (plan == nullptr || !plan_matches_steps(*plan, this->m_steps, shapes)) {
+        std::shared_ptr<ExecutionPlan> new_plan = this->plan_memory(shapes);
+        new_plan->input_shapes = input_shapes;
+        plan = new_plan;
+    }
+    this->m_plan = plan;
+    {
+        std::lock_guard<std::mutex> lock(this->m_plan_mutex);
+        this->m_plans.clear();
+        this->m_plans.insert({input_shapes, plan});
+    }
+    this->m_arena.reset();
+    if (plan->arena_size > 0) {
+        this->m_arena = std::shared_ptr<float>(new float[plan->arena_size](), std::default_delete<float[]>());
+    }
+
+    // 计算图内部的上下文使用计算图的内存池，算子的输出操作数与上下文共享同一组张量
+    this->m_context = std::shared_ptr<ExecutionContext>(new ExecutionContext());
+    this->m_context->m_arena = this->m_arena;
+    this->m_context->m_arena_size = plan->arena_size;
+    this->allocate_context(*this->m_context, plan);
+    for (uint32_t i = 0; i < operator_count; ++i) {
+        const ExecutionStep &step = this->m_steps.at(i);
+        if (step.type == EExecutionStepType::EEST_Layer) {
+            step.op->m_output_operands->m_data = this->m_context->m_tensors.at(i);
+        }
+    }
+    // 输入直接使用前驱的输出张量，释放预先分配的输入空间
+    for (uint32_t i = 0; i < operator_count; ++i) {
+        const ExecutionStep &step = this->m_steps.at(i);
+        for (uint32_t k = 0; k < step.operand_count; ++k) {
+            const ExecutionStep &producer_step = this->m_steps.at(step.producers.at(k));
+            if (producer_step.type == EExecutionStepType::EEST_Layer) {
+                step.op->m_input_operands_seq.at(k)->m_data = producer_step.op->m_output_operands->m_data;
+            }
+        }
+    }
+    this->bind_context(*this->m_context, this->m_max_batch_size);
+}
+
+// 激活内存池中每个张量的起始位置按16个元素对齐
+static constexpr size_t kArenaAlignment = 16;
+
+static size_t arena_align_up(size_t value) {
+    return (value + kArenaAlignment - 1) / kArenaAlignment * kArenaAlignment;
+}
+
+// 按不包含batch维度的形状创建张量，维度与通道、行、列的对应关系和init_operator_output相同
+// raw_ptr不为空时张量使用内存池中的存储
+static std::shared_ptr<Tensor> tensor_with_shapes(const std::vector<uint32_t> &shapes, float *raw_ptr) {
+    CHECK(!shapes.empty()) << "The shape of tensor is empty";
+    uint32_t channels = 1;
+    uint32_t rows = 1;
+    const uint32_t cols = shapes.back();
+    if (shapes.size() >= 2) {
+        rows = shapes.at(shapes.size() - 2);
+        channels = std::accumulate(shapes.begin(), shapes.end() - 2, 1u, std::multiplies());
+    }
+    std::shared_ptr<Tensor> tensor = raw_ptr != nullptr ? std::make_shared<Tensor>(raw_ptr, channels, rows, cols)
+                                                        : std::make_shared<Tensor>(channels, rows, cols);
+    if (shapes.size() > 3) {
+        tensor->reshape(shapes);
+    }
+    return tensor;
+}
+
+void RuntimeGraph::allocate_context(ExecutionContext &context, const std::shared_ptr<const ExecutionPlan> &plan) const {
+    CHECK(plan != nullptr);
+    // 内存池只增不减，在不同输入形状之间来回切换时不会反复分配
+    if (plan->arena_size > context.m_arena_size || context.m_arena == nullptr) {
+        context.m_arena_size = std::max(context.m_arena_size, plan->arena_size);
+        context.m_arena.reset();
+        if (context.m_arena_size > 0) {
+            context.m_arena = std::shared_ptr<float>(new float[context.m_arena_size](),
+                                                     std::default_delete<float[]>());
+        }
+    }
+
+    const uint32_t step_count = this->m_steps.size();
+    context.m_tensors.assign(step_count, {});
+    for (uint32_t i = 0; i < step_count; ++i) {
+        const ExecutionStep &step = this->m_steps.at(i);
+        if (step.type != EExecutionStepType::EEST_Layer) {
+            continue;
+        }
+        auto &tensors = context.m_tensors.at(i);
+        // 原地计算的输出在执行时指向被复用的输入
+        if (plan->inplace_operands.at(i) >= 0) {
+            tensors.assign(step.batch_size, nullptr);
+            continue;
+        }
+        const std::vector<uint32_t> &shapes = plan->output_shapes.at(i);
+        const size_t tensor_size = std::accumulate(shapes.begin(), shapes.end(), size_t(1), std::multiplies());
+        const int64_t offset = plan->offsets.at(i);
+        for (uint32_t b = 0; b < step.batch_size; ++b) {
+            float *raw_ptr = offset < 0 ? nullptr : context.m_arena.get() + offset + b * arena_align_up(tensor_size);
+            tensors.push_back(tensor_with_shapes(shapes, raw_ptr));
+        }
+    }
+    context.m_plan = plan;
+    // 张量已经重新创建，下一次forward时重新绑定输入输出
+    context.m_batch_size = 0;
+}
+
+std::shared_ptr<ExecutionContext> RuntimeGraph::create_context() const {
+    CHECK(this->m_state == EGraphState::EGS_Completed) << "Graph need be build!";
+    CHECK(this->m_plan != nullptr);
+    std::shared_ptr<ExecutionContext> context(new ExecutionContext());
+    this->allocate_context(*context, this->m_plan);
+    this->bind_context(*context, this->m_max_batch_size);
+    return context;
+}
+
+// 每个batch的张量在内存池中占用独立的区域，取前batch_size个张量就是实际batch的视图
+// batch大小不变时不需要重新绑定，层替换过的输出张量在重新绑定时恢复为预先分配的张量
+void RuntimeGraph::bind_context(ExecutionContext &context, uint32_t batch_size) const {
+    CHECK(batch_size > 0 && batch_size <= this->m_max_batch_size)
+                    << "The batch size " << batch_size << " exceeds the max batch size " << this->m_max_batch_size;
+    const uint32_t step_count = this->m_steps.size();
+    context.m_inputs.resize(step_count);
+    context.m_outputs.resize(step_count);
+    for (uint32_t i = 0; i < step_count; ++i) {
+        const ExecutionStep &step = this->m_steps.at(i);
+        context.m_inputs.at(i).assign(step.operand_count * batch_size, nullptr);
+        const auto &tensors = context.m_tensors.at(i);
+        if (tensors.empty()) {
+            context.m_outputs.at(i).clear();
+        } else {
+            context.m_outputs.at(i).assign(tensors.begin(), tensors.begin() + batch_size);
+        }
+    }
+    for (uint32_t i = 0; i < step_count; ++i) {
+        const auto &outputs = context.m_outputs.at(i);
+        if (outputs.empty()) {
+            continue;
+        }
+        for (const ExecutionTensorRef &consumer: this->m_steps.at(i).consumers) {
+            auto &next_inputs = context.m_inputs.at(consumer.step);
+            std::copy(outputs.begin(), outputs.end(), next_inputs.begin() + consumer.operand * batch_size);
+        }
+    }
+    context.m_batch_size = batch_size;
+}
+
+void RuntimeGraph::build_dependencies() {
+    const uint32_t operator_count = this->m_topo_operators.size();
+    std::unordered_map<const RuntimeOperator *, uint32_t> topo_index;
+    for (uint32_t i = 0; i < operator_count; ++i) {
+        topo_index.insert({this->m_topo_operators.at(i).get(), i});
+    }
+
+    this->m_predecessor_counts.assign(operator_count, 0);
+    this->m_successors.assign(operator_count, {});
+    for (uint32_t i = 0; i < operator_count; ++i) {
+        for (const auto &[_, next_op]: this->m_topo_operators.at(i)->m_output_operators) {
+            const uint32_t next = topo_index.at(next_op.get());
+            CHECK(next > i) << "Build wrong topo queue";
+            this->m_successors.at(i).push_back(next);
+            this->m_predecessor_counts.at(next) += 1;
+        }
+    }
+}
+
+void RuntimeGraph::optimize_operators(const std::string &output_name) {
+    this->m_optimize_stats = optimize_graph(this->m_operators, output_name);
+    this->m_operators_maps.clear();
+    for (const auto &op: this->m_operators) {
+        this->m_operators_maps.insert({op->m_name, op});
+    }
+    LOG(INFO) << "Graph optimization folded " << this->m_optimize_stats.folded_operators
+              << " constant operators, eliminated " << this->m_optimize_stats.eliminated_operators
+              << " dead operators and merged " << this->m_optimize_stats.merged_operators << " identical operators";
+}
+
+// 填充算子只有一个后继层且后继层能在计算时生成填充值时，把填充折叠到后继层中
+// 折叠后填充算子只传递输入，预先分配的输出空间也不再需要
+void RuntimeGraph::fold_padding_operators() {
+    for (const auto &op: this->m_operators) {
+        if (op->m_layer == nullptr || op->m_output_operators.size() != 1) {
+            continue;
+        }
+        const auto &next_op = op->m_output_operators.begin()->second;
+        if (next_op == nullptr || next_op->m_layer == nullptr || next_op->m_input_operands_seq.size() != 1) {
+            continue;
+        }
+        if (op->m_layer->fold_padding_into(*next_op->m_layer)) {
+            if (op->m_output_operands != nullptr) {
+                for (auto &output: op->m_output_operands->m_data) {
+                    output.reset();
+                }
+            }
+        }
+    }
+}
+
+// 算子支持原地计算，并且某个输入只有它一个使用者、形状与输出相同时，输出直接复用这个输入的存储
+// 输入本身可能复用了更上游算子的存储，沿着复用链检查每一级的存储都只被当前这一条链使用
+// 计算图的输入由调用者持有，不能被原地改写
+void RuntimeGraph::inplace_operators() {
+    const auto can_overwrite = [this](const std::shared_ptr<RuntimeOperand> &operand) {
+        std::shared_ptr<RuntimeOperand> current = operand;
+        while (current != nullptr) {
+            const auto iter = this->m_operators_maps.find(current->m_name);
+            if (iter == this->m_operators_maps.end()) {
+                return false;
+            }
+            const auto &producer = iter->second;
+            if (producer->m_type == "pnnx.Input" || producer->m_layer == nullptr ||
+                producer->m_output_operators.size() != 1) {
+                return false;
+            }
+            const int32_t aliased_input = producer->m_layer->aliased_input();
+            if (aliased_input < 0) {
+                return true;
+            }
+            if (aliased_input >= producer->m_input_operands_seq.size()) {
+                return false;
+            }
+            current = producer->m_input_operands_seq.at(aliased_input);
+        }
+        return false;
+    };
+
+    uint32_t inplace_count = 0;
+    for (const auto &op: this->m_topo_operators) {
+        if (op->m_layer == nullptr || !op->m_layer->support_inplace() || op->m_output_operands == nullptr) {
+            continue;
+        }
+        const auto &output_operand = op->m_output_operands;
+        for (uint32_t k = 0; k < op->m_input_operands_seq.size(); ++k) {
+            const auto &input_operand = op->m_input_operands_seq.at(k);
+            if (input_operand->m_shapes != output_operand->m_shapes ||
+                input_operand->m_data.size() != output_operand->m_data.size()) {
+                continue;
+            }
+            if (!can_overwrite(input_operand)) {
+                continue;
+            }
+            op->m_layer->set_inplace_input(int32_t(k));
+            for (auto &output: output_operand->m_data) {
+                output.reset();
+            }
+            inplace_count += 1;
+            break;
+        }
+    }
+    if (inplace_count > 0) {
+        LOG(INFO) << "Inplace operators: " << inplace_count;
+    }
+}
+
+// 每个步骤的输出从产生它的步骤开始存活，到最后一个使用它的步骤结束
+// 存活区间不重叠的输出可以共享内存池中的同一段内存
+// 计算图的输出会在forward之后返回给调用者，不参与规划
+std::shared_ptr<ExecutionPlan> RuntimeGraph::plan_memory(const std::vector<std::vector<uint32_t>> &shapes) const {
+    const uint32_t step_count = this->m_steps.size();
+    CHECK(shapes.size() == step_count);
+    std::shared_ptr<ExecutionPlan> plan = std::make_shared<ExecutionPlan>();
+    plan->output_shapes = shapes;
+    plan->inplace_operands.assign(step_count, -1);
+    plan->offsets.assign(step_count, -1);
+
+    std::vector<MemoryBlock> blocks;
+    std::vector<bool> pinned;
+    std::vector<std::vector<uint32_t>> block_owners; // 使用每个块作为输出的步骤
+    std::vector<std::vector<uint32_t>> block_users;  // 读写每个块的步骤
+    // 每个步骤的输出所在的块，-1表示不参与规划
+    std::vector<int32_t> step_blocks(step_count, -1);
+    for (uint32_t i = 0; i < step_count; ++i) {
+        const ExecutionStep &step = this->m_steps.at(i);
+        if (step.type != EExecutionStepType::EEST_Layer) {
+            continue;
+        }
+
+        int32_t block_id = -1;
+        const int32_t inplace_operand = step.inplace_operand;
+        // 输入形状变化后被复用的输入可能与输出形状不同，此时输出使用独立的存储
+        // 直接传递输入的步骤在执行时总是输出输入本身，必须复用输入所在的块
+        if (inplace_operand >= 0 &&
+            (step_passes_input(step) || shapes.at(step.producers.at(inplace_operand)) == shapes.at(i))) {
+            // 输出直接使用输入的存储，延长输入所在块的存活区间
+            plan->inplace_operands.at(i) = inplace_operand;
+            block_id = step_blocks.at(step.producers.at(inplace_operand));
+        } else {
+            const std::vector<uint32_t> &step_shapes = shapes.at(i);
+            const size_t tensor_size = std::accumulate(step_shapes.begin(), step_shapes.end(), size_t(1),
+                                                       std::multiplies());
+            if (!step_shapes.empty() && tensor_size > 0 && step.batch_size > 0) {
+                block_id = int32_t(blocks.size());
+                blocks.push_back({arena_align_up(tensor_size) * step.batch_size, i, i, 0});
+                pinned.push_back(false);
+                block_owners.push_back({});
+                block_users.push_back({i});
+            }
+        }
+        step_blocks.at(i) = block_id;
+        if (block_id < 0) {
+            continue;
+        }
+
+        MemoryBlock &block = blocks.at(block_id);
+        block_owners.at(block_id).push_back(i);
+        for (const ExecutionTensorRef &consumer: step.consumers) {
+            if (this->m_steps.at(consumer.step).type == EExecutionStepType::EEST_Output) {
+                pinned.at(block_id) = true;
+            } else {
+                block.last_use = std::max(block.last_use, consumer.step);
+                block_users.at(block_id).push_back(consumer.step);
+            }
+        }
+    }
+
+    std::vector<MemoryBlock> planned_blocks;
+    std::vector<uint32_t> planned_ids;
+    std::vector<std::vector<uint32_t>> planned_users;
+    size_t total_size = 0;
+    for (uint32_t i = 0; i < blocks.size(); ++i) {
+        if (!pinned.at(i)) {
+            planned_blocks.push_back(blocks.at(i));
+            planned_ids.push_back(i);
+            planned_users.push_back(block_users.at(i));
+            total_size += blocks.at(i).size;
+        }
+    }
+
+    if (this->m_thread_pool == nullptr) {
+        plan->arena_size = plan_memory_blocks(planned_blocks, kArenaAlignment);
+    } else {
+        // 并行执行时拓扑序中不相邻的步骤也可能同时运行，存活区间不再能表示块之间的先后关系
+        // 只有一个块的所有使用者都是另一个块的产生者的祖先时，两个块才不会同时存活
+        const uint32_t words = (step_count + 63) / 64;
+        std::vector<std::vector<uint64_t>> ancestors(step_count, std::vector<uint64_t>(words, 0));
+        for (uint32_t i = 0; i < step_count; ++i) {
+            for (uint32_t next: this->m_successors.at(i)) {
+                for (uint32_t w = 0; w < words; ++w) {
+                    ancestors.at(next).at(w) |= ancestors.at(i).at(w);
+                }
+                ancestors.at(next).at(i / 64) |= uint64_t(1) << (i % 64);
+            }
+        }
+        const auto used_before = [&](uint32_t a, uint32_t b) {
+            const auto &producer_ancestors = ancestors.at(planned_blocks.at(b).first_use);
+            for (uint32_t user: planned_users.at(a)) {
+                if (!(producer_ancestors.at(user / 64) >> (user % 64) & 1)) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        plan->arena_size = plan_memory_blocks(planned_blocks, [&](uint32_t a, uint32_t b) {
+            return !used_before(a, b) && !used_before(b, a);
+        }, kArenaAlignment);
+    }
+
+    // 同一个输出的各个batch在块中依次排列，原地计算的步骤不单独分配
+    for (uint32_t i = 0; i < planned_blocks.size(); ++i) {
+        for (uint32_t owner: block_owners.at(planned_ids.at(i))) {
+            if (plan->inplace_operands.at(owner) < 0) {
+                plan->offsets.at(owner) = int64_t(planned_blocks.at(i).offset);
+            }
+        }
+    }
+    LOG(INFO) << "Activation memory planned: " << plan->arena_size * sizeof(float) << " bytes, "
+              << "without planning: " << total_size * sizeof(float) << " bytes";
+    return plan;
+}
+
+void RuntimeGraph::infer_shapes(const std::vector<uint32_t> &input_shapes,
+                                std::vector<std::vector<uint32_t>> &shapes) const {
+    const uint32_t step_count = this->m_steps.size();
+    shapes.assign(step_count, {});
+    std::vector<std::vector<uint32_t>> step_input_shapes;
+    for (uint32_t i = 0; i < step_count; ++i) {
+        const ExecutionStep &step = this->m_steps.at(i);
+        if (step.type == EExecutionStepType::EEST_Input) {
+            shapes.at(i) = input_shapes;
+            continue;
+        }
+        step_input_shapes.clear();
+        bool unchanged = true;
+        for (uint32_t producer: step.producers) {
+            step_input_shapes.push_back(shapes.at(producer));
+            unchanged = unchanged && shapes.at(producer) == this->m_steps.at(producer).output_shapes;
+        }
+        if (step.type == EExecutionStepType::EEST_Output) {
+            shapes.at(i) = step_input_shapes.front();
+            continue;
+        }
+        if (step.layer->infer_output_shapes(step_input_shapes, shapes.at(i))) {
+            continue;
+        }
+        // 不能推导形状的层只能在模型中记录的输入形状上执行
+        CHECK(unchanged) << "The " << step.layer->layer_name() << " layer " << step.op->m_name
+                         << " can not infer the output shape for input shape "
+                         << shape_str(step_input_shapes.empty() ? std::vector<uint32_t>() : step_input_shapes.front());
+        shapes.at(i) = step.output_shapes;
+    }
+}
+
+std::shared_ptr<const ExecutionPlan> RuntimeGraph::get_plan(const std::vector<uint32_t> &input_shapes) const {
+    std::lock_guard<std::mutex> lock(this->m_plan_mutex);
+    const auto iter = this->m_plans.find(input_shapes);
+    if (iter != this->m_plans.end()) {
+        return iter->second;
+    }
+
+    std::vector<std::vector<uint32_t>> shapes;
+    this->infer_shapes(input_shapes, shapes);
+    std::shared_ptr<ExecutionPlan> plan = this->plan_memory(shapes);
+    plan->input_shapes = input_shapes;
+    this->m_plans.insert({input_shapes, plan});
+    LOG(INFO) << "Create execution plan for input shape " << shape_str(input_shapes);
+    return plan;
+}
+
+std::vector<uint32_t> RuntimeGraph::input_shapes(const std::vector<std::shared_ptr<Tensor>> &inputs) const {
+    CHECK(!inputs.empty()) << "The graph input is empty";
+    const std::shared_ptr<Tensor> &input = inputs.front();
+    CHECK(input != nullptr && !input->empty()) << "The graph input is empty";
+    for (const auto &tensor: inputs) {
+        CHECK(tensor != nullptr && tensor->shapes() == input->shapes())
+                        << "The graph inputs in one batch must have the same shape";
+    }
+
+    // 张量按通道、行、列存储，按模型中记录的输入维度数还原形状
+    const uint32_t rank = this->m_plan->input_shapes.size();
+    if (rank > 3) {
+        CHECK(input->raw_shapes().size() == rank)
+                        << "The graph input shape " << shape_str(input->raw_shapes()) << " do not match the model";
+        return input->raw_shapes();
+    }
+    const std::vector<uint32_t> &shapes = input->shapes();
+    CHECK(rank > 0 && std::all_of(shapes.begin(), shapes.end() - rank, [](uint32_t s) { return s == 1; }))
+                    << "The graph input shape " << shape_str(shapes) << " do not match the model";
+    return std::vector<uint32_t>(shapes.end() - rank, shapes.end());
+}
+
+size_t RuntimeGraph::activation_memory_size() const {
+    return this->m_plan == nullptr ? 0 : this->m_plan->arena_size * sizeof(float);
+}
+
+uint32_t RuntimeGraph::cached_plan_count() const {
+    std::lock_guard<std::mutex> lock(this->m_plan_mutex);
+    return this->m_plans.size();
+}
+
 // 获取拓扑排序的操作符列表
 const std::vector<std::shared_ptr<RuntimeOperator>> &RuntimeGraph::get_topo_queues() const {
     return this->m_topo_operators;
@@ -387,81 +1216,248 @@ RuntimeGraph::forward(const std::vector<std::shared_ptr<Tensor>> &inputs, bool d
     CHECK(this->m_state == EGraphState::EGS_Completed)
                     << "Graph status error, current state is " << int(this->m_state);
 
-    CHECK(this->m_topo_operators.size() == this->m_operators.size())
-                    << "Build wrong topo queue";
+    return this->forward(*this->m_context, inputs);
+}
 
-    // 重置所有操作符的前向标志
-    for (const auto &op: this->m_topo_operators) {
-        op->m_has_forward = false;
-    }
-
-    // 遍历拓扑排序的操作符列表，执行前向传播
-    for (const auto &current_op: this->m_topo_operators) {
-        if (current_op == nullptr) {
-            LOG(INFO) << "current_op== nullptr";
-        }
-        // 如果当前操作符为输入节点，则将输入数据赋值给后继层
-        if (current_op->m_type == "pnnx.Input") {
-            current_op->m_has_forward = true;
-            probe_next_layer(current_op, inputs);
-        } else if (current_op->m_type == "pnnx.Output") {
-            // 如果当前操作符为输出节点，则将前一层的输出作为计算图的输出
-            current_op->m_has_forward = true;
-            CHECK(current_op->m_input_operands_seq.size() == 1);
-            current_op->m_output_operands = current_op->m_input_operands_seq.front();
-        } else {
-            // 对于普通层，执行层的前向传播
-            EInferStatus status = current_op->m_layer->forward();
-            CHECK(status == EInferStatus::EIS_InferSuccess)
-                            << current_op->m_layer->layer_name()
-                            << " layer forward failed, error code: " << int(status);
-            // 标记当前操作符为已执行前向传播
-            current_op->m_has_forward = true;
-            // 将当前层的输出数据赋值给后继层
-            probe_next_layer(current_op, current_op->m_output_operands->m_data);
+std::vector<std::shared_ptr<Tensor>>
+RuntimeGraph::forward(ExecutionContext &context, const std::vector<std::shared_ptr<Tensor>> &inputs) const {
+    this->prepare_context(context, inputs);
+
+    const CancellationToken *token = context.m_cancel_token;
+    if (this->m_thread_pool != nullptr) {
+        // 没有依赖关系的步骤在线程池中并行执行
+        this->forward_parallel(context, inputs);
+    } else {
+        // 按拓扑序依次执行所有步骤
+        for (uint32_t i = 0; i < this->m_steps.size(); ++i) {
+            if (token != nullptr && token->cancelled()) {
+                break;
+            }
+            this->execute_step(context, i, inputs);
         }
     }
+    if (token != nullptr && token->cancelled()) {
+        return {};
+    }
+    return this->context_outputs(context);
+}
 
-    // 检查所有操作符是否都已执行前向传播
-    for (const auto &op: this->m_topo_operators) {
-        LOG_IF(FATAL, !op->m_has_forward)
-                        << "The operator: " << op->m_name << " has not been forward yet!";
+void RuntimeGraph::prepare_context(ExecutionContext &context, const std::vector<std::shared_ptr<Tensor>> &inputs) const {
+    CHECK(this->m_state == EGraphState::EGS_Completed)
+                    << "Graph status error, current state is " << int(this->m_state);
+    CHECK(context.m_tensors.size() == this->m_steps.size() && context.m_plan != nullptr)
+                    << "The execution context do not belong to this graph";
+    // 输入形状变化时切换到对应的执行计划，重新创建输出张量
+    const std::vector<uint32_t> input_shapes = this->input_shapes(inputs);
+    if (input_shapes != context.m_plan->input_shapes) {
+        this->allocate_context(context, this->get_plan(input_shapes));
     }
+    if (inputs.size() != context.m_batch_size) {
+        this->bind_context(context, inputs.size());
+    }
+}
+
+const std::vector<std::shared_ptr<Tensor>> &RuntimeGraph::context_outputs(const ExecutionContext &context) const {
+    // 返回计算图的最终输出
+    LOG_IF(FATAL, this->m_output_step < 0) << "Can not find the output operator " << m_output_name;
+    const ExecutionStep &output_step = this->m_steps.at(this->m_output_step);
+    if (output_step.type == EExecutionStepType::EEST_Layer) {
+        return context.m_outputs.at(this->m_output_step);
+    }
+    return context.m_inputs.at(this->m_output_step);
+}
 
-    // 根据输出名称获取输出操作符，返回计算图的最终输出
-    if (m_operators_maps.find(m_output_name) != m_operators_maps.end()) {
-        const auto &output_op = m_operators_maps.at(m_output_name);
-        CHECK(output_op->m_output_operands != nullptr)
-                        << "Output from" << output_op->m_name << " is empty";
-        const auto &output_operand = output_op->m_output_operands;
-        return output_operand->m_data;
+void RuntimeGraph::materialize_step(uint32_t index) const {
+    // 先提示预读之后几个层的权重，文件的读取与当前层的写入重叠
+    uint32_t prefetched = 0;
+    for (uint32_t i = index + 1; i < this->m_steps.size() && prefetched < this->m_weight_prefetch; ++i) {
+        Layer *layer = this->m_steps[i].layer;
+        if (layer != nullptr && !layer->weights_materialized()) {
+            layer->prefetch_weights();
+            prefetched += 1;
+        }
+    }
+    this->m_steps[index].layer->materialize_weights();
+}
+
+void RuntimeGraph::execute_step(ExecutionContext &context, uint32_t index,
+                                const std::vector<std::shared_ptr<Tensor>> &inputs) const {
+    const ExecutionStep &step = this->m_steps[index];
+    const uint32_t batch_size = context.m_batch_size;
+    const std::vector<std::shared_ptr<Tensor>> *outputs = &inputs;
+    if (step.type == EExecutionStepType::EEST_Layer) {
+        const std::vector<std::shared_ptr<Tensor>> &layer_inputs = context.m_inputs[index];
+        std::vector<std::shared_ptr<Tensor>> &layer_outputs = context.m_outputs[index];
+        // 原地计算时输出直接指向被复用的输入
+        const int32_t inplace_operand = context.m_plan->inplace_operands[index];
+        if (inplace_operand >= 0) {
+            const uint32_t offset = inplace_operand * batch_size;
+            for (uint32_t i = 0; i < batch_size; ++i) {
+                const std::shared_ptr<Tensor> &input = layer_inputs[offset + i];
+                if (layer_outputs[i] != input) {
+                    layer_outputs[i] = input;
+                }
+            }
+        }
+        if (!step.layer->weights_materialized()) {
+            this->materialize_step(index);
+        }
+        const EInferStatus status = step.layer->forward(layer_inputs, layer_outputs);
+        CHECK(status == EInferStatus::EIS_InferSuccess)
+                        << step.layer->layer_name() << " layer forward failed, error code: " << int(status);
+        outputs = &layer_outputs;
+    } else if (step.type == EExecutionStepType::EEST_Input) {
+        CHECK(inputs.size() == batch_size)
+                        << "The graph input size " << inputs.size() << " do not match the batch size " << batch_size;
     } else {
-        // 如果无法找到输出操作符，记录致命错误
-        LOG(FATAL) << "Can not find the output operator " << m_output_name;
-        return std::vector<std::shared_ptr<Tensor>>{};
-    }
-}
-
-// 将当前层的输出数据赋值给后继层
-void RuntimeGraph::probe_next_layer(const std::shared_ptr<RuntimeOperator> &current_op,
-                                    const std::vector<std::shared_ptr<Tensor>> &layer_output_data) {
-    // 获取当前节点的所有后继节点
-    const auto &next_ops = current_op->m_output_operators;
-    // 遍历所有后继节点
-    for (const auto &[_, next_rt_operator]: next_ops) {
-        // 获取后继节点的所有输入操作数
-        const auto &next_input_operands = next_rt_operator->m_input_operands;
-        // 检查后继节点的输入是否来自于当前操作符
-        if (next_input_operands.find(current_op->m_name) !=
-            next_input_operands.end()) {
-            // 获取后继节点关于当前操作符输出的输入数据
-            std::vector<std::shared_ptr<Tensor>> &next_input_datas =
-                    next_input_operands.at(current_op->m_name)->m_data;
-            CHECK(next_input_datas.size() == layer_output_data.size());
-            // 将当前操作符的输出数据赋值给后继节点的输入数据
-            for (int i = 0; i < next_input_datas.size(); ++i) {
-                next_input_datas.at(i) = layer_output_data.at(i);
+        return;
+    }
+
+    // 将输出写入后继步骤的输入，输出张量通常在build之后保持不变，只有层替换了输出张量时才需要写入
+    for (const ExecutionTensorRef &consumer: step.consumers) {
+        std::shared_ptr<Tensor> *next_inputs = context.m_inputs[consumer.step].data() + consumer.operand * batch_size;
+        for (uint32_t i = 0; i < batch_size; ++i) {
+            if (next_inputs[i] != (*outputs)[i]) {
+                next_inputs[i] = (*outputs)[i];
+            }
+        }
+    }
+}
+
+// 每个算子持有一个原子计数器，初始值为前驱数量，前驱完成时减一，减到0的算子提交到线程池
+// 算子只写入自己的输出和后继算子中对应自己的输入操作数，不同线程之间没有写冲突
+// 计数器的递减使用acq_rel语义，保证后继算子能看到前驱写入的输出
+void RuntimeGraph::forward_parallel(ExecutionContext &context,
+                                    const std::vector<std::shared_ptr<Tensor>> &inputs) const {
+    CHECK(this->m_thread_pool != nullptr);
+    const uint32_t operator_count = this->m_topo_operators.size();
+    CHECK(this->m_predecessor_counts.size() == operator_count && this->m_successors.size() == operator_count);
+
+    std::unique_ptr<std::atomic<uint32_t>[]> pending_counts(new std::atomic<uint32_t>[operator_count]);
+    for (uint32_t i = 0; i < operator_count; ++i) {
+        pending_counts[i].store(this->m_predecessor_counts.at(i), std::memory_order_relaxed);
+    }
+    std::atomic<uint32_t> remaining(operator_count);
+
+    ThreadPool &pool = *this->m_thread_pool;
+    const CancellationToken *token = context.m_cancel_token;
+    std::function<void(uint32_t)> run = [&](uint32_t index) {
+        // 取消后剩余的步骤不再计算，只递减计数使forward尽快返回
+        if (token == nullptr || !token->cancelled()) {
+            this->execute_step(context, index, inputs);
+        }
+        for (uint32_t next: this->m_successors.at(index)) {
+            if (pending_counts[next].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                pool.submit([&run, next]() { run(next); });
+            }
+        }
+        // 最后一个算子完成后调用线程可能立即返回并销毁run和计数器，递减之后不能再访问闭包中的任何变量
+        ThreadPool *const notify_pool = &pool;
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            notify_pool->notify_all();
+        }
+    };
+
+    for (uint32_t i = 0; i < operator_count; ++i) {
+        if (this->m_predecessor_counts.at(i) == 0) {
+            pool.submit([&run, i]() { run(i); });
+        }
+    }
+    // 调用线程也参与执行，所有算子完成后返回
+    pool.run_until([&remaining]() { return remaining.load(std::memory_order_acquire) == 0; });
+}
+
+std::future<ForwardResult> RuntimeGraph::forward_async(
+        const std::vector<std::shared_ptr<Tensor>> &inputs, const std::shared_ptr<CancellationToken> &token) {
+    auto promise = std::make_shared<std::promise<ForwardResult>>();
+    std::future<ForwardResult> future = promise->get_future();
+    this->forward_async(inputs, [promise](EInferStatus status, std::vector<std::shared_ptr<Tensor>> outputs) {
+        promise->set_value(ForwardResult{status, std::move(outputs)});
+    }, token);
+    return future;
+}
+
+void RuntimeGraph::forward_async(const std::vector<std::shared_ptr<Tensor>> &inputs, ForwardCallback callback,
+                                 const std::shared_ptr<CancellationToken> &token) {
+    CHECK(this->m_state == EGraphState::EGS_Completed)
+                    << "Graph status error, current state is " << int(this->m_state);
+    CHECK(callback != nullptr) << "The callback of forward is empty";
+    ThreadPool *pool = nullptr;
+    {
+        // 等待中的请求达到上限时阻塞提交的线程，防止请求在队列中无限堆积
+        std::unique_lock<std::mutex> lock(this->m_async_mutex);
+        this->m_async_condition.wait(lock, [this]() {
+            return this->m_max_pending_requests == 0 || this->m_pending_requests < this->m_max_pending_requests;
+        });
+        this->m_pending_requests += 1;
+        this->m_running_requests += 1;
+        // 整个请求在单独的请求线程池中执行，m_thread_pool只执行算子任务，
+        // 避免执行算子的线程在等待时取出另一个请求，使不相关的请求互相嵌套
+        if (this->m_async_pool == nullptr) {
+            this->m_async_pool = std::make_unique<ThreadPool>(std::max(1u, this->m_num_threads));
+        }
+        pool = this->m_async_pool.get();
+    }
+    pool->submit([this, inputs, callback = std::move(callback), token]() {
+        this->run_async(inputs, callback, token.get());
+    });
+}
+
+void RuntimeGraph::run_async(const std::vector<std::shared_ptr<Tensor>> &inputs, const ForwardCallback &callback,
+                             const CancellationToken *token) {
+    EInferStatus status = EInferStatus::EIS_InferCancelled;
+    std::vector<std::shared_ptr<Tensor>> outputs;
+    if (token == nullptr || !token->cancelled()) {
+        std::shared_ptr<ExecutionContext> context;
+        {
+            std::lock_guard<std::mutex> lock(this->m_async_mutex);
+            if (!this->m_free_contexts.empty()) {
+                context = this->m_free_contexts.back();
+                this->m_free_contexts.pop_back();
             }
         }
+        if (context == nullptr) {
+            context = this->create_context();
+        }
+
+        context->m_cancel_token = token;
+        const std::vector<std::shared_ptr<Tensor>> results = this->forward(*context, inputs);
+        context->m_cancel_token = nullptr;
+        if (token == nullptr || !token->cancelled()) {
+            // 上下文会被之后的请求复用，返回输出的副本
+            for (const auto &result: results) {
+                outputs.push_back(result->clone());
+            }
+            status = EInferStatus::EIS_InferSuccess;
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->m_async_mutex);
+            this->m_free_contexts.push_back(context);
+        }
+    }
+    {
+        // 调用回调之前释放名额，回调中再次提交请求时不会等待自己占用的名额
+        std::lock_guard<std::mutex> lock(this->m_async_mutex);
+        this->m_pending_requests -= 1;
+    }
+    this->m_async_condition.notify_all();
+    callback(status, std::move(outputs));
+
+    // 在锁内通知，保证等待析构的线程被唤醒时不再访问计算图的成员
+    std::lock_guard<std::mutex> lock(this->m_async_mutex);
+    this->m_running_requests -= 1;
+    this->m_async_condition.notify_all();
+}
+
+void RuntimeGraph::set_max_pending_requests(uint32_t max_pending_requests) {
+    {
+        std::lock_guard<std::mutex> lock(this->m_async_mutex);
+        this->m_max_pending_requests = max_pending_requests;
     }
+    this->m_async_condition.notify_all();
+}
+
+uint32_t RuntimeGraph::pending_requests() const {
+    std::lock_guard<std::mutex> lock(this->m_async_mutex);
+    return this->m_pending_requests;
 }
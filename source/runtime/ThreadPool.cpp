@@ -0,0 +1,152 @@
+//
+// Created by xyzzzh on 2024/4/25.
+//
+
+#include "runtime/ThreadPool.hpp"
+#include <glog/logging.h>
+
+// 当前线程所属的线程池和在线程池中的队列序号，外部线程的序号为-1
+static thread_local const ThreadPool *t_current_pool = nullptr;
+static thread_local int32_t t_queue_index = -1;
+
+ThreadPool::ThreadPool(uint32_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (uint32_t i = 0; i <= num_threads; ++i) {
+        this->m_queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (uint32_t i = 0; i < num_threads; ++i) {
+        this->m_threads.emplace_back([this, i]() { this->worker_loop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+        this->m_stop = true;
+    }
+    this->m_condition.notify_all();
+    for (auto &thread: this->m_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    CHECK(task != nullptr) << "The submitted task is empty";
+    const int32_t index = t_current_pool == this ? t_queue_index : -1;
+    WorkQueue &queue = index >= 0 ? *this->m_queues.at(index) : *this->m_queues.back();
+    this->m_pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        // 加锁保证等待线程在检查条件和进入等待之间不会错过通知
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+    }
+    this->m_condition.notify_one();
+}
+
+bool ThreadPool::try_get_task(int32_t index, std::function<void()> &task) {
+    if (this->m_pending.load() == 0) {
+        return false;
+    }
+    // 自己的队列从尾部取出，最近提交的任务的输入更可能还在缓存中
+    if (index >= 0) {
+        WorkQueue &queue = *this->m_queues.at(index);
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            this->m_pending.fetch_sub(1);
+            return true;
+        }
+    }
+    // 注入队列和其他线程的队列从头部窃取
+    const uint32_t queue_count = this->m_queues.size();
+    const uint32_t start = queue_count - 1;
+    for (uint32_t i = 0; i < queue_count; ++i) {
+        const uint32_t victim = (start + i) % queue_count;
+        if (int32_t(victim) == index) {
+            continue;
+        }
+        WorkQueue &queue = *this->m_queues.at(victim);
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            this->m_pending.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::worker_loop(uint32_t index) {
+    t_current_pool = this;
+    t_queue_index = int32_t(index);
+    std::function<void()> task;
+    while (true) {
+        if (this->try_get_task(int32_t(index), task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(this->m_mutex);
+        this->m_condition.wait(lock, [this]() { return this->m_stop || this->m_pending.load() > 0; });
+        if (this->m_stop && this->m_pending.load() == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::run_until(const std::function<bool()> &done) {
+    const int32_t index = t_current_pool == this ? t_queue_index : -1;
+    std::function<void()> task;
+    while (!done()) {
+        if (this->try_get_task(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(this->m_mutex);
+        this->m_condition.wait(lock, [this, &done]() { return done() || this->m_pending.load() > 0; });
+    }
+}
+
+void ThreadPool::notify_all() {
+    {
+        std::lock_guard<std::mutex> lock(this->m_mutex);
+    }
+    this->m_condition.notify_all();
+}
+
+void ThreadPool::parallel_for(uint32_t count, const std::function<void(uint32_t)> &func) {
+    if (count == 0) {
+        return;
+    }
+    std::atomic<uint32_t> next_index{0};
+    std::atomic<uint32_t> exited_tasks{0};
+    const uint32_t task_count = std::min(count, this->size() + 1);
+    // 任务引用了局部变量，必须等所有任务退出后才能返回，而不仅是所有下标执行完毕
+    // 最后一个任务计数之后调用者可能已经返回，计数之后只能使用按值捕获的变量
+    const auto run = [&, task_count]() {
+        for (uint32_t index = next_index.fetch_add(1); index < count; index = next_index.fetch_add(1)) {
+            func(index);
+        }
+        if (exited_tasks.fetch_add(1) + 1 == task_count) {
+            this->notify_all();
+        }
+    };
+    for (uint32_t i = 0; i < task_count; ++i) {
+        this->submit(run);
+    }
+    this->run_until([&]() { return exited_tasks.load() == task_count; });
+}
+
+uint32_t ThreadPool::size() const {
+    return this->m_threads.size();
+}
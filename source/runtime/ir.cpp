@@ -18,10 +18,13 @@
 #include <stdint.h>
 #include <string.h>
 #include <algorithm>
+#include <charconv>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <stack>
+#include <unordered_map>
 
 #if BUILD_PNNX
 #include <torch/script.h>
@@ -116,20 +119,20 @@ static size_t type_to_elemsize(int type)
     return 0; // null
 }
 
-static int string_to_type(const char* s)
+static int string_to_type(std::string_view s)
 {
-    if (strcmp(s, "f32") == 0) return 1;
-    if (strcmp(s, "f64") == 0) return 2;
-    if (strcmp(s, "f16") == 0) return 3;
-    if (strcmp(s, "i32") == 0) return 4;
-    if (strcmp(s, "i64") == 0) return 5;
-    if (strcmp(s, "i16") == 0) return 6;
-    if (strcmp(s, "i8") == 0) return 7;
-    if (strcmp(s, "u8") == 0) return 8;
-    if (strcmp(s, "bool") == 0) return 9;
-    if (strcmp(s, "cp64") == 0) return 10;
-    if (strcmp(s, "cp128") == 0) return 11;
-    if (strcmp(s, "cp32") == 0) return 12;
+    if (s == "f32") return 1;
+    if (s == "f64") return 2;
+    if (s == "f16") return 3;
+    if (s == "i32") return 4;
+    if (s == "i64") return 5;
+    if (s == "i16") return 6;
+    if (s == "i8") return 7;
+    if (s == "u8") return 8;
+    if (s == "bool") return 9;
+    if (s == "cp64") return 10;
+    if (s == "cp128") return 11;
+    if (s == "cp32") return 12;
     return 0; // null
 }
 
@@ -421,7 +424,7 @@ bool operator==(const Attribute& lhs, const Attribute& rhs)
     if (lhs.shape != rhs.shape)
         return false;
 
-    if (lhs.data != rhs.data)
+    if (lhs.byte_size() != rhs.byte_size() || memcmp(lhs.bytes(), rhs.bytes(), lhs.byte_size()) != 0)
         return false;
 
     return true;
@@ -456,14 +459,61 @@ Attribute operator+(const Attribute& a, const Attribute& b)
     c.shape = a.shape;
     c.shape[0] += b.shape[0]; // concat the first dim
 
-    c.data.resize(a.data.size() + b.data.size());
-    memcpy(c.data.data(), a.data.data(), a.data.size());
-    memcpy(c.data.data() + a.data.size(), b.data.data(), b.data.size());
+    c.data.resize(a.byte_size() + b.byte_size());
+    memcpy(c.data.data(), a.bytes(), a.byte_size());
+    memcpy(c.data.data() + a.byte_size(), b.bytes(), b.byte_size());
 
     return c;
 }
 
-Parameter Parameter::parse_from_string(const std::string& value)
+// the .param text is parsed in place, tokens and values are views into the text
+// numbers are converted with from_chars, which like stoi/stof reads the longest valid prefix
+static char char_at(std::string_view s, size_t i)
+{
+    return i < s.size() ? s[i] : '\0';
+}
+
+static int parse_int(std::string_view s)
+{
+    int i = 0;
+    std::from_chars(s.data(), s.data() + s.size(), i);
+    return i;
+}
+
+static float parse_float(std::string_view s)
+{
+    float f = 0.f;
+    std::from_chars(s.data(), s.data() + s.size(), f);
+    return f;
+}
+
+// split like repeated std::getline(ss, elem, ','), an empty string gives one empty element
+template<typename Func>
+static void for_each_element(std::string_view s, Func func)
+{
+    while (true)
+    {
+        size_t comma = s.find(',');
+        func(s.substr(0, comma));
+        if (comma == std::string_view::npos)
+            break;
+        s.remove_prefix(comma + 1);
+    }
+}
+
+static bool is_string_value(std::string_view s)
+{
+    const char c0 = char_at(s, 0);
+    const char c1 = char_at(s, 1);
+    return (c0 != '-' && (c0 < '0' || c0 > '9')) || (c0 == '-' && (c1 < '0' || c1 > '9'));
+}
+
+static bool is_float_value(std::string_view s)
+{
+    return s.find('.') != std::string_view::npos || s.find('e') != std::string_view::npos;
+}
+
+static Parameter parse_parameter(std::string_view value)
 {
     Parameter p;
     p.type = 0;
@@ -481,61 +531,59 @@ Parameter Parameter::parse_from_string(const std::string& value)
         return p;
     }
 
-    if (value[0] == '(' || value[0] == '[')
+    if (char_at(value, 0) == '(' || char_at(value, 0) == '[')
     {
         // list
-        std::string lc = value.substr(1, value.size() - 2);
-        std::istringstream lcss(lc);
-
-        while (!lcss.eof())
-        {
-            std::string elem;
-            std::getline(lcss, elem, ',');
-
-            if ((elem[0] != '-' && (elem[0] < '0' || elem[0] > '9')) || (elem[0] == '-' && (elem[1] < '0' || elem[1] > '9')))
+        for_each_element(value.substr(1, value.size() - 2), [&](std::string_view elem) {
+            if (is_string_value(elem))
             {
                 // string
                 p.type = 7;
-                p.as.push_back(elem);
+                p.as.push_back(std::string(elem));
             }
-            else if (elem.find('.') != std::string::npos || elem.find('e') != std::string::npos)
+            else if (is_float_value(elem))
             {
                 // float
                 p.type = 6;
-                p.af.push_back(std::stof(elem));
+                p.af.push_back(parse_float(elem));
             }
             else
             {
                 // integer
                 p.type = 5;
-                p.ai.push_back(std::stoi(elem));
+                p.ai.push_back(parse_int(elem));
             }
-        }
+        });
         return p;
     }
 
-    if ((value[0] != '-' && (value[0] < '0' || value[0] > '9')) || (value[0] == '-' && (value[1] < '0' || value[1] > '9')))
+    if (is_string_value(value))
     {
         // string
         p.type = 4;
-        p.s = value;
+        p.s = std::string(value);
         return p;
     }
 
-    if (value.find('.') != std::string::npos || value.find('e') != std::string::npos)
+    if (is_float_value(value))
     {
         // float
         p.type = 3;
-        p.f = std::stof(value);
+        p.f = parse_float(value);
         return p;
     }
 
     // integer
     p.type = 2;
-    p.i = std::stoi(value);
+    p.i = parse_int(value);
     return p;
 }
 
+Parameter Parameter::parse_from_string(const std::string& value)
+{
+    return parse_parameter(value);
+}
+
 Graph::Graph()
 {
 }
@@ -561,12 +609,12 @@ Graph& Graph::operator=(const Graph& /*rhs*/)
     return *this;
 }
 
-static void load_parameter(Operator* op, const std::string& key, const std::string& value)
+static void load_parameter(Operator* op, std::string_view key, std::string_view value)
 {
-    op->params[key] = Parameter::parse_from_string(value);
+    op->params[std::string(key)] = parse_parameter(value);
 }
 
-static void load_input_key(Operator* op, const std::string& key, const std::string& value)
+static void load_input_key(Operator* op, std::string_view key, std::string_view value)
 {
     op->inputnames.resize(op->inputs.size());
 
@@ -575,13 +623,13 @@ static void load_input_key(Operator* op, const std::string& key, const std::stri
         const Operand* oprand = op->inputs[i];
         if (oprand->name == value)
         {
-            op->inputnames[i] = key;
+            op->inputnames[i] = std::string(key);
             break;
         }
     }
 }
 
-static void load_shape(Operator* op, const std::string& key, const std::string& value)
+static void load_shape(Operator* op, std::string_view key, std::string_view value)
 {
     Operand* operand = 0;
     for (auto r : op->inputs)
@@ -607,59 +655,51 @@ static void load_shape(Operator* op, const std::string& key, const std::string&
 
     if (!operand)
     {
-        fprintf(stderr, "no such operand %s for operator %s\n", key.c_str(), op->name.c_str());
+        fprintf(stderr, "no such operand %.*s for operator %s\n", (int)key.size(), key.data(), op->name.c_str());
         return;
     }
 
     // type
-    std::string typestr = value.substr(value.find_last_of(')') + 1);
-    operand->type = string_to_type(typestr.c_str());
+    operand->type = string_to_type(value.substr(value.find_last_of(')') + 1));
 
     // shape
-    std::string lc = value.substr(1, value.find_last_of(')') - 1);
-    std::istringstream lcss(lc);
+    std::string_view lc = value.substr(1, value.find_last_of(')') - 1);
 
     operand->shape.clear();
-    while (!lcss.eof())
-    {
-        std::string elem;
-        std::getline(lcss, elem, ',');
+    if (lc.empty())
+        return;
 
-        if (elem == "?")
-        {
-            operand->shape.push_back(-1);
-        }
-        else
-        {
-            int i = std::stoi(elem);
-            operand->shape.push_back(i);
-        }
-    }
+    for_each_element(lc, [&](std::string_view elem) {
+        operand->shape.push_back(elem == "?" ? -1 : parse_int(elem));
+    });
 }
 
-static void load_attribute(Operator* op, const std::string& key, const std::string& value, StoreZipReader& szr)
+// compressed files are only recorded here and decompressed after parsing, in parallel across files
+struct PendingFiles
+{
+    std::vector<std::string> names;
+    std::vector<char*> datas;
+};
+
+static void load_attribute(Operator* op, std::string_view key, std::string_view value, StoreZipReader& szr, PendingFiles& pending)
 {
-    Attribute& a = op->attrs[key];
+    Attribute& a = op->attrs[std::string(key)];
 
     // type
-    std::string typestr = value.substr(value.find_last_of(')') + 1);
-    a.type = string_to_type(typestr.c_str());
+    a.type = string_to_type(value.substr(value.find_last_of(')') + 1));
 
     if (a.type == 0)
         return;
 
     // shape
-    std::string lc = value.substr(1, value.find_last_of(')') - 1);
-    std::istringstream lcss(lc);
+    std::string_view lc = value.substr(1, value.find_last_of(')') - 1);
 
     a.shape.clear();
-    while (!lcss.eof())
+    if (!lc.empty())
     {
-        std::string elem;
-        std::getline(lcss, elem, ',');
-
-        int i = std::stoi(elem);
-        a.shape.push_back(i);
+        for_each_element(lc, [&](std::string_view elem) {
+            a.shape.push_back(parse_int(elem));
+        });
     }
 
     if (a.shape.empty())
@@ -674,7 +714,7 @@ static void load_attribute(Operator* op, const std::string& key, const std::stri
 
     size_t bytesize = size * type_to_elemsize(a.type);
 
-    std::string filename = op->name + "." + key;
+    std::string filename = op->name + "." + std::string(key);
 
     size_t filesize = szr.get_file_size(filename);
 
@@ -689,103 +729,162 @@ static void load_attribute(Operator* op, const std::string& key, const std::stri
         fprintf(stderr, "file size not match expect %lu but got %lu\n", bytesize, filesize);
     }
 
-    a.data.resize(bytesize);
-    szr.read_file(filename, (char*)a.data.data());
-}
-
-int Graph::load(const std::string& parampath, const std::string& binpath)
-{
-    std::ifstream is(parampath, std::ios::in | std::ios::binary);
-    if (!is.good())
+    if (filesize < bytesize)
     {
-        fprintf(stderr, "open failed\n");
-        return -1;
+        // keep the expected size, the missing tail stays zero
+        a.data.resize(bytesize);
+        pending.names.push_back(filename);
+        pending.datas.push_back((char*)a.data.data());
+        return;
     }
 
-    StoreZipReader szr;
-    if (szr.open(binpath) != 0)
+    if (szr.is_compressed(filename))
     {
-        fprintf(stderr, "open failed\n");
-        return -1;
+        // decompress into a buffer shared the same way as the mapping, so nothing copies it again
+        std::shared_ptr<char> buffer(new char[filesize], std::default_delete<char[]>());
+        a.data.clear();
+        a.mapping = buffer;
+        a.mapped_data = buffer.get();
+        a.mapped_size = bytesize;
+        pending.names.push_back(filename);
+        pending.datas.push_back(buffer.get());
+        return;
     }
 
-    int magic = 0;
-    {
-        std::string line;
-        std::getline(is, line);
-        std::istringstream iss(line);
+    // reference the mapped archive without copying
+    StoreZipSpan span;
+    szr.get_file_span(filename, span);
+    a.data.clear();
+    a.mapping = szr.mapping();
+    a.mapped_data = span.data;
+    a.mapped_size = bytesize;
+}
+
+static bool is_param_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// take the next line off the text, without the newline
+static bool next_line(std::string_view& text, std::string_view& line)
+{
+    if (text.empty())
+        return false;
+
+    size_t end = text.find('\n');
+    line = text.substr(0, end);
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+    return true;
+}
+
+// take the next whitespace separated token off the line, empty at the end of the line
+static std::string_view next_token(std::string_view& line)
+{
+    size_t begin = 0;
+    while (begin < line.size() && is_param_space(line[begin]))
+        begin++;
+
+    size_t end = begin;
+    while (end < line.size() && !is_param_space(line[end]))
+        end++;
+
+    std::string_view token = line.substr(begin, end - begin);
+    line.remove_prefix(end);
+    return token;
+}
 
-        iss >> magic;
+// single pass over the .param text, attributes and input keys are only loaded with a weight archive
+static int load_param(Graph& graph, std::string_view text, StoreZipReader* szr, PendingFiles* pending)
+{
+    std::string_view line;
+    if (!next_line(text, line))
+    {
+        fprintf(stderr, "empty param\n");
+        return -1;
     }
 
+    int magic = parse_int(next_token(line));
+    (void)magic;
+
     int operator_count = 0;
     int operand_count = 0;
+    if (next_line(text, line))
     {
-        std::string line;
-        std::getline(is, line);
-        std::istringstream iss(line);
+        operator_count = parse_int(next_token(line));
+        operand_count = parse_int(next_token(line));
+    }
 
-        iss >> operator_count >> operand_count;
+    graph.ops.reserve(graph.ops.size() + std::max(operator_count, 0));
+    graph.operands.reserve(graph.operands.size() + std::max(operand_count, 0));
+
+    // operands are looked up by name for every input, the table replaces the linear get_operand
+    // the first operand of a name wins, the same as get_operand
+    std::unordered_map<std::string_view, Operand*> operands;
+    operands.reserve(graph.operands.size() + std::max(operand_count, 0));
+    for (Operand* r : graph.operands)
+    {
+        operands.emplace(r->name, r);
     }
 
     for (int i = 0; i < operator_count; i++)
     {
-        std::string line;
-        std::getline(is, line);
-        std::istringstream iss(line);
-
-        std::string type;
-        std::string name;
-        int input_count = 0;
-        int output_count = 0;
+        if (!next_line(text, line))
+        {
+            fprintf(stderr, "truncated param, expect %d operators but got %d\n", operator_count, i);
+            return -1;
+        }
 
-        iss >> type >> name >> input_count >> output_count;
+        std::string_view type = next_token(line);
+        std::string_view name = next_token(line);
+        int input_count = parse_int(next_token(line));
+        int output_count = parse_int(next_token(line));
 
-        Operator* op = new_operator(type, name);
+        Operator* op = graph.new_operator(std::string(type), std::string(name));
 
         for (int j = 0; j < input_count; j++)
         {
-            std::string operand_name;
-            iss >> operand_name;
+            std::string_view operand_name = next_token(line);
 
-            Operand* r = get_operand(operand_name);
+            auto it = operands.find(operand_name);
+            if (it == operands.end())
+            {
+                fprintf(stderr, "no such operand %.*s for operator %s\n", (int)operand_name.size(), operand_name.data(), op->name.c_str());
+                return -1;
+            }
+
+            Operand* r = it->second;
             r->consumers.push_back(op);
             op->inputs.push_back(r);
         }
 
         for (int j = 0; j < output_count; j++)
         {
-            std::string operand_name;
-            iss >> operand_name;
-
-            Operand* r = new_operand(operand_name);
+            Operand* r = graph.new_operand(std::string(next_token(line)));
+            operands.emplace(r->name, r);
             r->producer = op;
             op->outputs.push_back(r);
         }
 
         // key=value
-        while (!iss.eof())
+        for (std::string_view param = next_token(line); !param.empty(); param = next_token(line))
         {
-            std::string param;
-            iss >> param;
+            size_t eq = param.find('=');
+            std::string_view key = param.substr(0, eq);
+            std::string_view value = eq == std::string_view::npos ? std::string_view() : param.substr(eq + 1);
 
-            std::string key;
-            std::string value;
-            std::istringstream pss(param);
-            std::getline(pss, key, '=');
-            std::getline(pss, value);
-
-            if (key[0] == '@')
+            if (char_at(key, 0) == '@')
             {
                 // attribute
-                load_attribute(op, key.substr(1), value, szr);
+                if (szr)
+                    load_attribute(op, key.substr(1), value, *szr, *pending);
             }
-            else if (key[0] == '$')
+            else if (char_at(key, 0) == '$')
             {
                 // operand input key
-                load_input_key(op, key.substr(1), value);
+                if (szr)
+                    load_input_key(op, key.substr(1), value);
             }
-            else if (key[0] == '#')
+            else if (char_at(key, 0) == '#')
             {
                 // operand shape
                 load_shape(op, key.substr(1), value);
@@ -801,6 +900,36 @@ int Graph::load(const std::string& parampath, const std::string& binpath)
     return 0;
 }
 
+int Graph::load(const std::string& parampath, const std::string& binpath)
+{
+    size_t param_size = 0;
+    std::shared_ptr<const char> param_data = map_file(parampath, param_size);
+    if (!param_data)
+    {
+        fprintf(stderr, "open failed\n");
+        return -1;
+    }
+
+    StoreZipReader szr;
+    if (szr.open(binpath) != 0)
+    {
+        fprintf(stderr, "open failed\n");
+        return -1;
+    }
+
+    PendingFiles pending;
+    if (load_param(*this, std::string_view(param_data.get(), param_size), &szr, &pending) != 0)
+        return -1;
+
+    if (!pending.names.empty() && szr.read_files(pending.names, pending.datas) != 0)
+    {
+        fprintf(stderr, "read attributes failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
 int Graph::save(const std::string& parampath, const std::string& binpath)
 {
     FILE* paramfp = fopen(parampath.c_str(), "wb");
@@ -917,7 +1046,7 @@ int Graph::save(const std::string& parampath, const std::string& binpath)
             fprintf(paramfp, type_to_string(attr.type));
 
             std::string filename = op->name + "." + it.first;
-            szw.write_file(filename, attr.data.data(), attr.data.size());
+            szw.write_file(filename, attr.bytes(), attr.byte_size());
         }
 
         if (op->inputnames.size() == op->inputs.size())
@@ -2305,103 +2434,7 @@ int Graph::python(const std::string& pypath, const std::string& pnnxbinpath)
 
 int Graph::parse(const std::string& param)
 {
-    std::istringstream is(param);
-    if (!is.good())
-    {
-        fprintf(stderr, "open failed\n");
-        return -1;
-    }
-
-    int magic = 0;
-    {
-        std::string line;
-        std::getline(is, line);
-        std::istringstream iss(line);
-
-        iss >> magic;
-    }
-
-    int operator_count = 0;
-    int operand_count = 0;
-    {
-        std::string line;
-        std::getline(is, line);
-        std::istringstream iss(line);
-
-        iss >> operator_count >> operand_count;
-    }
-
-    for (int i = 0; i < operator_count; i++)
-    {
-        std::string line;
-        std::getline(is, line);
-        std::istringstream iss(line);
-
-        std::string type;
-        std::string name;
-        int input_count = 0;
-        int output_count = 0;
-
-        iss >> type >> name >> input_count >> output_count;
-
-        Operator* op = new_operator(type, name);
-
-        for (int j = 0; j < input_count; j++)
-        {
-            std::string operand_name;
-            iss >> operand_name;
-
-            Operand* r = get_operand(operand_name);
-            r->consumers.push_back(op);
-            op->inputs.push_back(r);
-        }
-
-        for (int j = 0; j < output_count; j++)
-        {
-            std::string operand_name;
-            iss >> operand_name;
-
-            Operand* r = new_operand(operand_name);
-            r->producer = op;
-            op->outputs.push_back(r);
-        }
-
-        // key=value
-        while (!iss.eof())
-        {
-            std::string param;
-            iss >> param;
-
-            std::string key;
-            std::string value;
-            std::istringstream pss(param);
-            std::getline(pss, key, '=');
-            std::getline(pss, value);
-
-            if (key[0] == '@')
-            {
-                // attribute
-                //                 load_attribute(op, key.substr(1), value, szr);
-            }
-            else if (key[0] == '$')
-            {
-                // operand input key
-                //                 load_input_key(op, key.substr(1), value);
-            }
-            else if (key[0] == '#')
-            {
-                // operand shape
-                load_shape(op, key.substr(1), value);
-            }
-            else
-            {
-                // parameter
-                load_parameter(op, key, value);
-            }
-        }
-    }
-
-    return 0;
+    return load_param(*this, param, 0, 0);
 }
 
 void Operand::remove_consumer(const Operator* c)
@@ -16,10 +16,26 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <zlib.h>
+#if defined(PNNX_WITH_ZSTD)
+#include <zstd.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace pnnx {
 
 // https://stackoverflow.com/questions/1537964/visual-c-equivalent-of-gccs-attribute-packed
@@ -106,7 +122,7 @@ static uint32_t CRC32_buffer(const unsigned char* data, int len)
 
 StoreZipReader::StoreZipReader()
 {
-  fp = 0;
+  mapped_size = 0;
 }
 
 StoreZipReader::~StoreZipReader()
@@ -114,29 +130,102 @@ StoreZipReader::~StoreZipReader()
   close();
 }
 
+std::shared_ptr<const char> map_file(const std::string& path, size_t& size)
+{
+  size = 0;
+#if defined(__unix__) || defined(__APPLE__)
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return 0;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0)
+  {
+    ::close(fd);
+    return 0;
+  }
+
+  size_t length = st.st_size;
+  void* ptr = mmap(0, length, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  ::close(fd);
+  if (ptr == MAP_FAILED)
+    return 0;
+
+  size = length;
+  return std::shared_ptr<const char>((const char*)ptr, [length](const char* p) { munmap((void*)p, length); });
+#else
+  FILE* fp = fopen(path.c_str(), "rb");
+  if (!fp)
+    return 0;
+
+  fseek(fp, 0, SEEK_END);
+  long length = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  if (length <= 0)
+  {
+    fclose(fp);
+    return 0;
+  }
+
+  char* buffer = new char[length];
+  size_t nread = fread(buffer, length, 1, fp);
+  fclose(fp);
+  if (nread != 1)
+  {
+    delete[] buffer;
+    return 0;
+  }
+
+  size = length;
+  return std::shared_ptr<const char>(buffer, std::default_delete<const char[]>());
+#endif
+}
+
+void prefetch_mapping(const char* data, size_t size)
+{
+#if defined(__unix__) || defined(__APPLE__)
+  if (!data || size == 0)
+    return;
+
+  // madvise wants a page aligned start, widen the range to whole pages
+  const uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+  const uintptr_t begin = (uintptr_t)data & ~(page_size - 1);
+  const uintptr_t end = (uintptr_t)data + size;
+  madvise((void*)begin, end - begin, MADV_WILLNEED);
+#else
+  (void)data;
+  (void)size;
+#endif
+}
+
 int StoreZipReader::open(const std::string& path)
 {
   close();
 
-  fp = fopen(path.c_str(), "rb");
-  if (!fp)
+  mapped = map_file(path, mapped_size);
+  if (!mapped)
   {
     fprintf(stderr, "open failed\n");
     return -1;
   }
 
-  while (!feof(fp))
+  const char* base = mapped.get();
+  size_t pos = 0;
+  while (pos + sizeof(uint32_t) <= mapped_size)
   {
     // peek signature
     uint32_t signature;
-    int nread = fread((char*)&signature, sizeof(signature), 1, fp);
-    if (nread != 1)
-      break;
+    memcpy(&signature, base + pos, sizeof(signature));
+    pos += sizeof(signature);
 
     if (signature == 0x04034b50)
     {
       local_file_header lfh;
-      fread((char*)&lfh, sizeof(lfh), 1, fp);
+      if (pos + sizeof(lfh) > mapped_size)
+        break;
+      memcpy(&lfh, base + pos, sizeof(lfh));
+      pos += sizeof(lfh);
 
       if (lfh.flag & 0x08)
       {
@@ -144,51 +233,55 @@ int StoreZipReader::open(const std::string& path)
         return -1;
       }
 
-      if (lfh.compression != 0 || lfh.compressed_size != lfh.uncompressed_size)
+      bool supported = lfh.compression == STORE_ZIP_DEFLATE;
+#if defined(PNNX_WITH_ZSTD)
+      supported = supported || lfh.compression == STORE_ZIP_ZSTD;
+#endif
+      if (lfh.compression == STORE_ZIP_STORED ? lfh.compressed_size != lfh.uncompressed_size : !supported)
       {
-        fprintf(stderr, "not stored zip file %d %d\n", lfh.compressed_size, lfh.uncompressed_size);
+        fprintf(stderr, "unsupported zip file compression %d %d %d\n", lfh.compression, lfh.compressed_size, lfh.uncompressed_size);
         return -1;
       }
 
-      // file m_name
-      std::string name;
-      name.resize(lfh.file_name_length);
-      fread((char*)name.data(), name.size(), 1, fp);
-
-      // skip extra field
-      fseek(fp, lfh.extra_field_length, SEEK_CUR);
+      // file name, skip extra field
+      if (pos + lfh.file_name_length + lfh.extra_field_length + lfh.compressed_size > mapped_size)
+      {
+        fprintf(stderr, "truncated zip file\n");
+        return -1;
+      }
+      std::string name(base + pos, lfh.file_name_length);
+      pos += lfh.file_name_length + lfh.extra_field_length;
 
       StoreZipMeta fm;
-      fm.offset = ftell(fp);
-      fm.size = lfh.compressed_size;
+      fm.offset = pos;
+      fm.size = lfh.uncompressed_size;
+      fm.compressed_size = lfh.compressed_size;
+      fm.compression = lfh.compression;
+      fm.crc32 = lfh.crc32;
 
       filemetas[name] = fm;
 
-      //             fprintf(stderr, "%s = %d  %d\n", m_name.c_str(), fm.offset, fm.size);
-
-      fseek(fp, lfh.compressed_size, SEEK_CUR);
+      pos += lfh.compressed_size;
     }
     else if (signature == 0x02014b50)
     {
       central_directory_file_header cdfh;
-      fread((char*)&cdfh, sizeof(cdfh), 1, fp);
-
-      // skip file m_name
-      fseek(fp, cdfh.file_name_length, SEEK_CUR);
+      if (pos + sizeof(cdfh) > mapped_size)
+        break;
+      memcpy(&cdfh, base + pos, sizeof(cdfh));
 
-      // skip extra field
-      fseek(fp, cdfh.extra_field_length, SEEK_CUR);
-
-      // skip file comment
-      fseek(fp, cdfh.file_comment_length, SEEK_CUR);
+      // skip file name, extra field and file comment
+      pos += sizeof(cdfh) + cdfh.file_name_length + cdfh.extra_field_length + cdfh.file_comment_length;
     }
     else if (signature == 0x06054b50)
     {
       end_of_central_directory_record eocdr;
-      fread((char*)&eocdr, sizeof(eocdr), 1, fp);
+      if (pos + sizeof(eocdr) > mapped_size)
+        break;
+      memcpy(&eocdr, base + pos, sizeof(eocdr));
 
       // skip comment
-      fseek(fp, eocdr.comment_length, SEEK_CUR);
+      pos += sizeof(eocdr) + eocdr.comment_length;
     }
     else
     {
@@ -211,30 +304,177 @@ size_t StoreZipReader::get_file_size(const std::string& name)
   return filemetas[name].size;
 }
 
-int StoreZipReader::read_file(const std::string& name, char* data)
+bool StoreZipReader::is_compressed(const std::string& name) const
 {
-  if (filemetas.find(name) == filemetas.end())
+  std::map<std::string, StoreZipMeta>::const_iterator it = filemetas.find(name);
+  return it != filemetas.end() && it->second.compression != STORE_ZIP_STORED;
+}
+
+// inflate the raw deflate stream in the mapping directly into the destination
+static int inflate_buffer(const char* src, size_t src_size, char* dst, size_t dst_size)
+{
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  if (inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+    return -1;
+
+  // avail_in and avail_out are 32-bit, feed large entries in chunks
+  const size_t chunk = 1u << 30;
+  int ret = Z_OK;
+  while (ret == Z_OK)
+  {
+    if (zs.avail_in == 0 && src_size > 0)
+    {
+      zs.next_in = (Bytef*)src;
+      zs.avail_in = (uInt)std::min(src_size, chunk);
+      src += zs.avail_in;
+      src_size -= zs.avail_in;
+    }
+    if (zs.avail_out == 0 && dst_size > 0)
+    {
+      zs.next_out = (Bytef*)dst;
+      zs.avail_out = (uInt)std::min(dst_size, chunk);
+      dst += zs.avail_out;
+      dst_size -= zs.avail_out;
+    }
+    ret = inflate(&zs, Z_NO_FLUSH);
+    if (ret == Z_BUF_ERROR && (zs.avail_in > 0 || src_size > 0) && (zs.avail_out > 0 || dst_size > 0))
+      ret = Z_OK;
+  }
+
+  const bool complete = ret == Z_STREAM_END && zs.avail_out == 0 && dst_size == 0;
+  inflateEnd(&zs);
+  return complete ? 0 : -1;
+}
+
+#if defined(PNNX_WITH_ZSTD)
+static int zstd_buffer(const char* src, size_t src_size, char* dst, size_t dst_size)
+{
+  ZSTD_DStream* zds = ZSTD_createDStream();
+  if (!zds)
+    return -1;
+
+  ZSTD_inBuffer in = {src, src_size, 0};
+  ZSTD_outBuffer out = {dst, dst_size, 0};
+  size_t ret = 1;
+  while (ret != 0 && !ZSTD_isError(ret) && (in.pos < in.size || out.pos < out.size))
+  {
+    const size_t out_pos = out.pos;
+    const size_t in_pos = in.pos;
+    ret = ZSTD_decompressStream(zds, &out, &in);
+    if (out.pos == out_pos && in.pos == in_pos)
+      break;
+  }
+
+  ZSTD_freeDStream(zds);
+  return ret == 0 && out.pos == dst_size ? 0 : -1;
+}
+#endif
+
+int StoreZipReader::read_file(const std::string& name, char* data) const
+{
+  std::map<std::string, StoreZipMeta>::const_iterator it = filemetas.find(name);
+  if (it == filemetas.end() || !mapped)
   {
     fprintf(stderr, "no such file %s\n", name.c_str());
     return -1;
   }
 
-  size_t offset = filemetas[name].offset;
-  size_t size = filemetas[name].size;
+  const StoreZipMeta& fm = it->second;
+  const char* src = mapped.get() + fm.offset;
+  if (fm.compression == STORE_ZIP_STORED)
+  {
+    memcpy(data, src, fm.size);
+    return 0;
+  }
+
+  int ret = -1;
+  if (fm.compression == STORE_ZIP_DEFLATE)
+    ret = inflate_buffer(src, fm.compressed_size, data, fm.size);
+#if defined(PNNX_WITH_ZSTD)
+  if (fm.compression == STORE_ZIP_ZSTD)
+    ret = zstd_buffer(src, fm.compressed_size, data, fm.size);
+#endif
 
-  fseek(fp, offset, SEEK_SET);
-  fread(data, size, 1, fp);
+  // decompressed data is checked, a corrupted entry must not become silent garbage weights
+  uLong crc = crc32(0L, Z_NULL, 0);
+  for (size_t i = 0; ret == 0 && i < fm.size; i += 1u << 30)
+    crc = crc32(crc, (const Bytef*)data + i, (uInt)std::min(fm.size - i, (size_t)1u << 30));
+  if (ret != 0 || crc != fm.crc32)
+  {
+    fprintf(stderr, "decompress %s failed\n", name.c_str());
+    return -1;
+  }
 
   return 0;
 }
 
-int StoreZipReader::close()
+int StoreZipReader::read_files(const std::vector<std::string>& names, const std::vector<char*>& datas, int num_threads) const
 {
-  if (!fp)
-    return 0;
+  if (names.size() != datas.size())
+    return -1;
 
-  fclose(fp);
-  fp = 0;
+  if (num_threads <= 0)
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  num_threads = (int)std::min(names.size(), (size_t)num_threads);
+
+  // each thread takes the next entry, the entries write to disjoint buffers
+  std::atomic<size_t> next(0);
+  std::atomic<int> failed(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < names.size(); i = next++)
+    {
+      if (read_file(names[i], datas[i]) != 0)
+        failed = 1;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < num_threads; i++)
+  {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& t : threads)
+  {
+    t.join();
+  }
+
+  return failed ? -1 : 0;
+}
+
+int StoreZipReader::get_file_span(const std::string& name, StoreZipSpan& span) const
+{
+  std::map<std::string, StoreZipMeta>::const_iterator it = filemetas.find(name);
+  if (it == filemetas.end() || !mapped)
+  {
+    fprintf(stderr, "no such file %s\n", name.c_str());
+    return -1;
+  }
+
+  if (it->second.compression != STORE_ZIP_STORED)
+  {
+    fprintf(stderr, "compressed file %s has no span\n", name.c_str());
+    return -1;
+  }
+
+  span.data = mapped.get() + it->second.offset;
+  span.size = it->second.size;
+
+  return 0;
+}
+
+const std::shared_ptr<const char>& StoreZipReader::mapping() const
+{
+  return mapped;
+}
+
+int StoreZipReader::close()
+{
+  // spans handed out earlier stay valid while someone still shares the mapping
+  mapped.reset();
+  mapped_size = 0;
+  filemetas.clear();
 
   return 0;
 }
@@ -265,8 +505,37 @@ int StoreZipWriter::open(const std::string& path)
   return 0;
 }
 
-int StoreZipWriter::write_file(const std::string& name, const char* data, size_t size)
+int StoreZipWriter::write_file(const std::string& name, const char* data, size_t size, int compression)
 {
+  if (compression != STORE_ZIP_STORED && compression != STORE_ZIP_DEFLATE)
+  {
+    fprintf(stderr, "unsupported zip file compression %d\n", compression);
+    return -1;
+  }
+
+  // compress the whole entry first, the local header records the compressed size
+  std::vector<char> compressed;
+  if (compression == STORE_ZIP_DEFLATE)
+  {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      return -1;
+
+    compressed.resize(deflateBound(&zs, size));
+    zs.next_in = (Bytef*)data;
+    zs.avail_in = size;
+    zs.next_out = (Bytef*)compressed.data();
+    zs.avail_out = compressed.size();
+    int ret = deflate(&zs, Z_FINISH);
+    compressed.resize(zs.total_out);
+    deflateEnd(&zs);
+    if (ret != Z_STREAM_END)
+      return -1;
+  }
+  const char* payload = compression == STORE_ZIP_DEFLATE ? compressed.data() : data;
+  const size_t payload_size = compression == STORE_ZIP_DEFLATE ? compressed.size() : size;
+
   int offset = ftell(fp);
 
   uint32_t signature = 0x04034b50;
@@ -277,11 +546,11 @@ int StoreZipWriter::write_file(const std::string& name, const char* data, size_t
   local_file_header lfh;
   lfh.version = 0;
   lfh.flag = 0;
-  lfh.compression = 0;
+  lfh.compression = compression;
   lfh.last_modify_time = 0;
   lfh.last_modify_date = 0;
   lfh.crc32 = crc32;
-  lfh.compressed_size = size;
+  lfh.compressed_size = payload_size;
   lfh.uncompressed_size = size;
   lfh.file_name_length = name.size();
   lfh.extra_field_length = 0;
@@ -290,13 +559,15 @@ int StoreZipWriter::write_file(const std::string& name, const char* data, size_t
 
   fwrite((char*)name.c_str(), name.size(), 1, fp);
 
-  fwrite(data, size, 1, fp);
+  fwrite(payload, payload_size, 1, fp);
 
   StoreZipMeta szm;
   szm.name = name;
   szm.lfh_offset = offset;
   szm.crc32 = crc32;
   szm.size = size;
+  szm.compressed_size = payload_size;
+  szm.compression = compression;
 
   filemetas.push_back(szm);
 
@@ -319,11 +590,11 @@ int StoreZipWriter::close()
     cdfh.version_made = 0;
     cdfh.version = 0;
     cdfh.flag = 0;
-    cdfh.compression = 0;
+    cdfh.compression = szm.compression;
     cdfh.last_modify_time = 0;
     cdfh.last_modify_date = 0;
     cdfh.crc32 = szm.crc32;
-    cdfh.compressed_size = szm.size;
+    cdfh.compressed_size = szm.compressed_size;
     cdfh.uncompressed_size = szm.size;
     cdfh.file_name_length = szm.name.size();
     cdfh.extra_field_length = 0;
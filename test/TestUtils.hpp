@@ -0,0 +1,24 @@
+//
+// Created by xyzzzh on 2024/5/9.
+//
+
+#ifndef INFERFRAMEWORK_TESTUTILS_HPP
+#define INFERFRAMEWORK_TESTUTILS_HPP
+
+#include <memory>
+#include <vector>
+#include "data/Tensor.hpp"
+
+// 生成batch_size个形状为channels * rows * cols的输入，值服从标准正态分布
+inline std::vector<std::shared_ptr<Tensor>> random_inputs(uint32_t batch_size, uint32_t channels = 3,
+                                                          uint32_t rows = 16, uint32_t cols = 16) {
+    std::vector<std::shared_ptr<Tensor>> inputs;
+    for (uint32_t i = 0; i < batch_size; ++i) {
+        std::shared_ptr<Tensor> input = std::make_shared<Tensor>(channels, rows, cols);
+        input->rand();
+        inputs.push_back(input);
+    }
+    return inputs;
+}
+
+#endif //INFERFRAMEWORK_TESTUTILS_HPP
@@ -0,0 +1,124 @@
+//
+// Created by xyzzzh on 2024/4/30.
+//
+
+#include <atomic>
+#include <thread>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "runtime/RuntimeGraph.hpp"
+#include "TestUtils.hpp"
+
+TEST(test_async_forward, future) {
+    for (uint32_t num_threads: {1u, 3u}) {
+        RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+        graph.set_num_threads(num_threads);
+        graph.build("pnnx_input_0", "pnnx_output_0");
+
+        std::vector<std::vector<std::shared_ptr<Tensor>>> inputs;
+        std::vector<std::future<ForwardResult>> futures;
+        for (uint32_t i = 0; i < 8; ++i) {
+            const std::vector<std::shared_ptr<Tensor>> batch = random_inputs(2);
+            inputs.push_back(batch);
+            futures.push_back(graph.forward_async(batch));
+        }
+        for (uint32_t i = 0; i < 8; ++i) {
+            const ForwardResult result = futures.at(i).get();
+            ASSERT_EQ(result.status, EInferStatus::EIS_InferSuccess);
+            const auto &outputs = result.outputs;
+            const auto expected = graph.forward(inputs.at(i), false);
+            ASSERT_EQ(outputs.size(), 2);
+            for (uint32_t b = 0; b < 2; ++b) {
+                ASSERT_TRUE(tensor_is_same(outputs.at(b), expected.at(b)));
+            }
+        }
+        ASSERT_EQ(graph.pending_requests(), 0);
+    }
+}
+
+TEST(test_async_forward, cancel) {
+    RuntimeGraph graph("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    std::shared_ptr<Tensor> input = std::make_shared<Tensor>(3, 16, 16);
+    input->rand();
+
+    // 提交前已经取消的请求不会执行
+    std::shared_ptr<CancellationToken> token = std::make_shared<CancellationToken>();
+    token->cancel();
+    std::promise<EInferStatus> status_promise;
+    graph.forward_async({input}, [&status_promise](EInferStatus status, std::vector<std::shared_ptr<Tensor>> outputs) {
+        EXPECT_TRUE(outputs.empty());
+        status_promise.set_value(status);
+    }, token);
+    ASSERT_EQ(status_promise.get_future().get(), EInferStatus::EIS_InferCancelled);
+    const ForwardResult cancelled = graph.forward_async({input}, token).get();
+    ASSERT_EQ(cancelled.status, EInferStatus::EIS_InferCancelled);
+    ASSERT_TRUE(cancelled.outputs.empty());
+
+    // 没有取消的请求正常返回
+    const ForwardResult result = graph.forward_async({input}, std::make_shared<CancellationToken>()).get();
+    ASSERT_EQ(result.status, EInferStatus::EIS_InferSuccess);
+    const auto &outputs = result.outputs;
+    ASSERT_EQ(outputs.size(), 1);
+    ASSERT_TRUE(tensor_is_same(outputs.front(), graph.forward({input}, false).front()));
+}
+
+TEST(test_async_forward, bounded_queue) {
+    RuntimeGraph graph("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin");
+    graph.set_num_threads(4);
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    graph.set_max_pending_requests(2);
+
+    std::shared_ptr<Tensor> input = std::make_shared<Tensor>(3, 16, 16);
+    input->rand();
+    const uint32_t request_count = 12;
+    std::atomic<uint32_t> finished(0);
+    std::atomic<uint32_t> max_pending(0);
+    for (uint32_t i = 0; i < request_count; ++i) {
+        // 提交的请求超过上限时阻塞，直到前面的请求完成
+        graph.forward_async({input}, [&](EInferStatus status, std::vector<std::shared_ptr<Tensor>> outputs) {
+            EXPECT_EQ(status, EInferStatus::EIS_InferSuccess);
+            EXPECT_EQ(outputs.size(), 1);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            finished.fetch_add(1);
+        });
+        uint32_t pending = graph.pending_requests();
+        uint32_t current = max_pending.load();
+        while (pending > current && !max_pending.compare_exchange_weak(current, pending)) {
+        }
+    }
+    // 调用回调之前请求已经不再计入，等待所有回调执行完毕
+    while (finished.load() < request_count) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(graph.pending_requests(), 0);
+    ASSERT_LE(max_pending.load(), 2);
+}
+
+TEST(test_async_forward, resubmit_in_callback) {
+    // 请求达到上限时，回调中再次提交请求不会等待自己占用的名额
+    for (uint32_t num_threads: {1u, 3u}) {
+        RuntimeGraph graph("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin");
+        graph.set_num_threads(num_threads);
+        graph.build("pnnx_input_0", "pnnx_output_0");
+        graph.set_max_pending_requests(1);
+
+        std::shared_ptr<Tensor> input = std::make_shared<Tensor>(3, 16, 16);
+        input->rand();
+        const uint32_t request_count = 8;
+        std::atomic<uint32_t> finished(0);
+        std::promise<void> done;
+        ForwardCallback callback = [&](EInferStatus status, std::vector<std::shared_ptr<Tensor>> outputs) {
+            EXPECT_EQ(status, EInferStatus::EIS_InferSuccess);
+            EXPECT_EQ(outputs.size(), 1);
+            if (finished.fetch_add(1) + 1 < request_count) {
+                graph.forward_async({input}, callback);
+            } else {
+                done.set_value();
+            }
+        };
+        graph.forward_async({input}, callback);
+        ASSERT_EQ(done.get_future().wait_for(std::chrono::seconds(10)), std::future_status::ready);
+        ASSERT_EQ(finished.load(), request_count);
+    }
+}
@@ -0,0 +1,86 @@
+//
+// Created by xyzzzh on 2024/4/29.
+//
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "runtime/DynamicBatcher.hpp"
+
+TEST(test_batcher, full_batches) {
+    RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    graph.set_max_batch_size(4);
+    graph.build("pnnx_input_0", "pnnx_output_0");
+
+    RuntimeGraph single_graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    single_graph.set_max_batch_size(1);
+    single_graph.build("pnnx_input_0", "pnnx_output_0");
+
+    std::vector<std::shared_ptr<Tensor>> inputs;
+    std::vector<std::future<std::shared_ptr<Tensor>>> futures;
+    // 等待时间足够长，8个请求正好凑成两个完整的batch
+    BatcherConfig config;
+    config.max_delay = std::chrono::seconds(10);
+    DynamicBatcher batcher(graph, config);
+    ASSERT_EQ(batcher.config().max_batch_size, 4);
+    for (uint32_t i = 0; i < 8; ++i) {
+        std::shared_ptr<Tensor> input = std::make_shared<Tensor>(3, 16, 16);
+        input->rand();
+        inputs.push_back(input);
+        futures.push_back(batcher.submit(input));
+    }
+    for (uint32_t i = 0; i < 8; ++i) {
+        const std::shared_ptr<Tensor> output = futures.at(i).get();
+        const auto expected = single_graph.forward({inputs.at(i)}, false);
+        ASSERT_TRUE(tensor_is_same(output, expected.front()));
+    }
+    const BatcherMetrics metrics = batcher.metrics();
+    ASSERT_EQ(metrics.request_count, 8);
+    ASSERT_EQ(metrics.batch_count, 2);
+    ASSERT_EQ(metrics.queue_depth, 0);
+    ASSERT_GE(metrics.max_queue_depth, 4);
+    ASSERT_EQ(metrics.average_batch_size(), 4.);
+}
+
+TEST(test_batcher, concurrent_submit) {
+    RuntimeGraph graph("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin");
+    graph.set_max_batch_size(8);
+    graph.build("pnnx_input_0", "pnnx_output_0");
+
+    BatcherConfig config;
+    config.max_delay = std::chrono::microseconds(500);
+    config.num_workers = 2;
+    DynamicBatcher batcher(graph, config);
+
+    // 多个线程提交单个输入，超时后不满的batch也会执行，形状不同的请求分到不同的batch中
+    const uint32_t thread_count = 6;
+    const uint32_t request_count = 20;
+    std::vector<std::thread> threads;
+    std::vector<uint8_t> results(thread_count, 0);
+    for (uint32_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t]() {
+            bool same = true;
+            for (uint32_t i = 0; i < request_count; ++i) {
+                std::shared_ptr<Tensor> input = std::make_shared<Tensor>(3, 16, 8 + 8 * (i % 2));
+                input->rand();
+                input->transform([](float value) { return value - 0.5f; });
+                const std::shared_ptr<Tensor> output = batcher.submit(input).get();
+                same = same && output->shapes() == input->shapes();
+                for (uint32_t j = 0; same && j < input->size(); ++j) {
+                    const float relu = std::max(input->index(j), 0.f);
+                    same = std::abs(output->index(j) - relu - 1.f / (1.f + std::exp(-relu))) < 1e-5f;
+                }
+            }
+            results.at(t) = same;
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    for (uint32_t t = 0; t < thread_count; ++t) {
+        ASSERT_TRUE(results.at(t)) << "thread " << t;
+    }
+    const BatcherMetrics metrics = batcher.metrics();
+    ASSERT_EQ(metrics.request_count, thread_count * request_count);
+    ASSERT_LE(metrics.batch_count, metrics.request_count);
+    ASSERT_LE(metrics.max_queue_depth, thread_count);
+}
@@ -1,12 +1,14 @@
 //
 // Created by xyzzzh on 2024/4/4.
 //
+#include <cstring>
 #include <gtest/gtest.h>
 #include <glog/logging.h>
 #include "Common.hpp"
 #include "runtime/RuntimeParameter.hpp"
 #include "layer/abstract/LayerRegisterer.hpp"
 #include "layer/deatil/ConvLayer.hpp"
+#include "layer/deatil/PadLayer.hpp"
 
 
 TEST(test_registry, create_layer_convforward) {
@@ -49,4 +51,93 @@ TEST(test_registry, create_layer_convforward) {
     conv_layer.set_weights(weights);
     conv_layer.forward(inputs, outputs);
     outputs.at(0)->show();
-}
\ No newline at end of file
+}
+
+TEST(test_registry, conv_fused_padding) {
+    // 显式填充后卷积与把填充合并到卷积中的结果一致
+    const uint32_t in_channel = 3;
+    const uint32_t kernel_count = 4;
+    std::shared_ptr<Tensor> input = std::make_shared<Tensor>(in_channel, 9, 7);
+    input->rand();
+    std::vector<std::shared_ptr<Tensor>> weights;
+    for (uint32_t i = 0; i < kernel_count; ++i) {
+        std::shared_ptr<Tensor> kernel = std::make_shared<Tensor>(in_channel, 3, 3);
+        kernel->rand();
+        weights.push_back(kernel);
+    }
+
+    PaddingDesc padding;
+    padding.top = 2;
+    padding.bottom = 1;
+    padding.left = 0;
+    padding.right = 3;
+
+    PadLayer pad_layer(padding);
+    std::vector<std::shared_ptr<Tensor>> inputs{input};
+    std::vector<std::shared_ptr<Tensor>> padded(1);
+    ASSERT_EQ(pad_layer.forward(inputs, padded), EInferStatus::EIS_InferSuccess);
+    ASSERT_TRUE(tensor_is_same(padded.at(0), tensor_padding(input, {2, 1, 0, 3}, 0.f)));
+
+    ConvLayer conv_layer(kernel_count, in_channel, 3, 3, 1, 1, 2, 1, 1, false);
+    conv_layer.set_weights(weights);
+    std::vector<std::shared_ptr<Tensor>> outputs1(1);
+    ASSERT_EQ(conv_layer.forward(padded, outputs1), EInferStatus::EIS_InferSuccess);
+
+    ConvLayer fused_layer(kernel_count, in_channel, 3, 3, 1, 1, 2, 1, 1, false);
+    fused_layer.set_weights(weights);
+    ASSERT_TRUE(pad_layer.fold_padding_into(fused_layer));
+    ASSERT_EQ(pad_layer.forward(inputs, padded), EInferStatus::EIS_InferSuccess);
+    ASSERT_EQ(padded.at(0), input);
+    std::vector<std::shared_ptr<Tensor>> outputs2(1);
+    ASSERT_EQ(fused_layer.forward(padded, outputs2), EInferStatus::EIS_InferSuccess);
+
+    ASSERT_EQ(outputs1.at(0)->shapes(), outputs2.at(0)->shapes());
+    ASSERT_TRUE(arma::approx_equal(outputs1.at(0)->data(), outputs2.at(0)->data(), "absdiff", 1e-4f));
+}
+
+TEST(test_registry, conv_weight_span) {
+    // 从未对齐的权重视图直接加载与按数组加载的结果一致，权重张量引用IM2COL排布
+    const uint32_t in_channel = 4;
+    const uint32_t kernel_count = 6;
+    const uint32_t groups = 2;
+    const uint32_t weight_size = kernel_count * (in_channel / groups) * 3 * 2;
+    std::vector<float> weight_values(weight_size);
+    std::vector<float> bias_values(kernel_count);
+    for (uint32_t i = 0; i < weight_size; ++i) {
+        weight_values.at(i) = float(i % 7) - 3.f;
+    }
+    for (uint32_t i = 0; i < kernel_count; ++i) {
+        bias_values.at(i) = float(i) * 0.5f;
+    }
+    std::vector<char> buffer(1 + (weight_size + kernel_count) * sizeof(float));
+    std::memcpy(buffer.data() + 1, weight_values.data(), weight_size * sizeof(float));
+    std::memcpy(buffer.data() + 1 + weight_size * sizeof(float), bias_values.data(), kernel_count * sizeof(float));
+
+    ConvLayer conv_layer(kernel_count, in_channel, 3, 2, 1, 0, 1, 1, groups);
+    conv_layer.set_weights(weight_values);
+    conv_layer.set_bias(bias_values);
+
+    ConvLayer span_layer(kernel_count, in_channel, 3, 2, 1, 0, 1, 1, groups);
+    span_layer.set_weights(WeightSpan{buffer.data() + 1, weight_size * sizeof(float)});
+    span_layer.set_bias(WeightSpan{buffer.data() + 1 + weight_size * sizeof(float), kernel_count * sizeof(float)});
+    for (uint32_t k = 0; k < kernel_count; ++k) {
+        ASSERT_TRUE(tensor_is_same(conv_layer.weights().at(k), span_layer.weights().at(k)));
+        ASSERT_TRUE(tensor_is_same(conv_layer.bias().at(k), span_layer.bias().at(k)));
+    }
+
+    std::shared_ptr<Tensor> input = std::make_shared<Tensor>(in_channel, 5, 6);
+    input->rand();
+    std::vector<std::shared_ptr<Tensor>> inputs{input};
+    std::vector<std::shared_ptr<Tensor>> outputs1(1);
+    std::vector<std::shared_ptr<Tensor>> outputs2(1);
+    ASSERT_EQ(conv_layer.forward(inputs, outputs1), EInferStatus::EIS_InferSuccess);
+    ASSERT_EQ(span_layer.forward(inputs, outputs2), EInferStatus::EIS_InferSuccess);
+    ASSERT_TRUE(arma::approx_equal(outputs1.at(0)->data(), outputs2.at(0)->data(), "absdiff", 1e-5f));
+
+    // 之后修改权重张量会直接反映到计算中
+    span_layer.weights().front()->fill(0.f);
+    ASSERT_EQ(span_layer.forward(inputs, outputs2), EInferStatus::EIS_InferSuccess);
+    ASSERT_TRUE(arma::approx_equal(outputs2.at(0)->data().slice(0),
+                                   arma::fmat(outputs2.at(0)->rows(), outputs2.at(0)->cols()).fill(bias_values.at(0)),
+                                   "absdiff", 1e-5f));
+}
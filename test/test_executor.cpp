@@ -0,0 +1,176 @@
+//
+// Created by xyzzzh on 2024/4/25.
+//
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "runtime/RuntimeGraph.hpp"
+#include "runtime/ThreadPool.hpp"
+#include "TestUtils.hpp"
+
+TEST(test_executor, thread_pool) {
+    ThreadPool pool(4);
+    ASSERT_EQ(pool.size(), 4);
+    // 任务中继续提交任务，提交的任务会被其他线程窃取
+    const uint32_t task_count = 1000;
+    std::atomic<uint32_t> finished(0);
+    std::function<void(uint32_t)> task = [&](uint32_t depth) {
+        if (depth < 9) {
+            pool.submit([&task, depth]() { task(depth + 1); });
+        }
+        if (finished.fetch_add(1) + 1 == task_count) {
+            pool.notify_all();
+        }
+    };
+    for (uint32_t i = 0; i < task_count / 10; ++i) {
+        pool.submit([&task]() { task(0); });
+    }
+    pool.run_until([&finished]() { return finished.load() == task_count; });
+    ASSERT_EQ(finished.load(), task_count);
+}
+
+TEST(test_executor, parallel_for) {
+    ThreadPool pool(3);
+    // 每个下标恰好执行一次，返回时所有下标都已完成
+    std::vector<uint32_t> visits(1000, 0);
+    pool.parallel_for(visits.size(), [&visits](uint32_t i) { visits.at(i) += i; });
+    for (uint32_t i = 0; i < visits.size(); ++i) {
+        ASSERT_EQ(visits.at(i), i);
+    }
+    pool.parallel_for(0, [](uint32_t) { FAIL(); });
+}
+
+static std::vector<std::shared_ptr<Tensor>> graph_forward(const std::string &model, uint32_t num_threads,
+                                                          const std::vector<std::shared_ptr<Tensor>> &inputs) {
+    RuntimeGraph graph("model_file/" + model + ".pnnx.param", "model_file/" + model + ".pnnx.bin");
+    graph.set_num_threads(num_threads);
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    std::vector<std::shared_ptr<Tensor>> outputs;
+    for (uint32_t round = 0; round < 3; ++round) {
+        outputs = graph.forward(inputs, false);
+    }
+    // 输出在内存池之外，graph析构后仍然有效
+    return outputs;
+}
+
+TEST(test_executor, parallel_forward) {
+    for (const auto &[model, batch_size]: std::vector<std::pair<std::string, uint32_t>>{{"simple_ops",  1},
+                                                                                       {"simple_ops2", 2}}) {
+        std::vector<std::shared_ptr<Tensor>> inputs;
+        for (uint32_t i = 0; i < batch_size; ++i) {
+            std::shared_ptr<Tensor> input = std::make_shared<Tensor>(3, 16, 16);
+            input->rand();
+            input->transform([](float value) { return value - 0.5f; });
+            inputs.push_back(input);
+        }
+        const auto expected = graph_forward(model, 1, inputs);
+        const auto outputs = graph_forward(model, 4, inputs);
+        ASSERT_EQ(outputs.size(), expected.size());
+        for (uint32_t i = 0; i < outputs.size(); ++i) {
+            ASSERT_TRUE(tensor_is_same(outputs.at(i), expected.at(i))) << model;
+        }
+    }
+}
+
+TEST(test_executor, plan_shares_operands) {
+    RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    // 执行计划中后继的输入操作数直接使用前驱的输出张量，不再单独分配
+    for (const auto &op: graph.get_topo_queues()) {
+        for (const auto &[_, next_op]: op->m_output_operators) {
+            const auto &operand = next_op->m_input_operands.at(op->m_name);
+            if (op->m_type == "pnnx.Input") {
+                for (const auto &tensor: operand->m_data) {
+                    ASSERT_EQ(tensor, nullptr);
+                }
+            } else {
+                ASSERT_EQ(operand->m_data, op->m_output_operands->m_data);
+            }
+        }
+    }
+
+    // 输入改变时每次forward的结果都来自新的输入
+    std::vector<std::shared_ptr<Tensor>> outputs1;
+    std::vector<std::shared_ptr<Tensor>> outputs2;
+    for (uint32_t round = 0; round < 2; ++round) {
+        std::vector<std::shared_ptr<Tensor>> inputs;
+        for (uint32_t i = 0; i < 2; ++i) {
+            std::shared_ptr<Tensor> input = std::make_shared<Tensor>(3, 16, 16);
+            input->fill(float(round + 1));
+            inputs.push_back(input);
+        }
+        const auto outputs = graph.forward(inputs, false);
+        auto &result = round == 0 ? outputs1 : outputs2;
+        for (const auto &output: outputs) {
+            result.push_back(output->clone());
+        }
+    }
+    ASSERT_EQ(outputs1.size(), 2);
+    ASSERT_FALSE(tensor_is_same(outputs1.front(), outputs2.front()));
+    ASSERT_TRUE(tensor_is_same(outputs1.front(), outputs1.back()));
+}
+
+TEST(test_executor, concurrent_contexts) {
+    for (uint32_t num_threads: {1u, 3u}) {
+        RuntimeGraph graph("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin");
+        graph.set_num_threads(num_threads);
+        graph.build("pnnx_input_0", "pnnx_output_0");
+
+        // 先用计算图内部的上下文计算每个请求的期望结果
+        const uint32_t request_count = 8;
+        std::vector<std::shared_ptr<Tensor>> inputs;
+        std::vector<std::shared_ptr<Tensor>> expected;
+        for (uint32_t i = 0; i < request_count; ++i) {
+            std::shared_ptr<Tensor> input = std::make_shared<Tensor>(3, 16, 16);
+            input->rand();
+            input->transform([](float value) { return value - 0.5f; });
+            inputs.push_back(input);
+            expected.push_back(graph.forward({input}, false).front()->clone());
+        }
+
+        // 每个线程使用自己的上下文同时对同一个计算图执行forward
+        std::vector<std::thread> threads;
+        std::vector<uint8_t> results(request_count, 0);
+        for (uint32_t i = 0; i < request_count; ++i) {
+            threads.emplace_back([&, i]() {
+                std::shared_ptr<ExecutionContext> context = graph.create_context();
+                bool same = context->activation_memory_size() == graph.activation_memory_size();
+                for (uint32_t round = 0; round < 20; ++round) {
+                    const auto outputs = graph.forward(*context, {inputs.at(i)});
+                    same = same && outputs.size() == 1 && tensor_is_same(outputs.front(), expected.at(i));
+                }
+                results.at(i) = same;
+            });
+        }
+        for (auto &thread: threads) {
+            thread.join();
+        }
+        for (uint32_t i = 0; i < request_count; ++i) {
+            ASSERT_TRUE(results.at(i)) << "request " << i << " with " << num_threads << " threads";
+        }
+    }
+}
+
+TEST(test_executor, dynamic_batch) {
+    // 模型中的batch为2，按最大batch为4构建后可以接受1到4之间的任意batch
+    RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    graph.set_max_batch_size(4);
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_EQ(graph.max_batch_size(), 4);
+
+    RuntimeGraph single_graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    single_graph.set_max_batch_size(1);
+    single_graph.build("pnnx_input_0", "pnnx_output_0");
+
+    std::shared_ptr<ExecutionContext> context = graph.create_context();
+    for (uint32_t batch_size: {1u, 3u, 4u, 2u, 4u}) {
+        const auto inputs = random_inputs(batch_size);
+        const auto outputs = graph.forward(*context, inputs);
+        ASSERT_EQ(context->batch_size(), batch_size);
+        ASSERT_EQ(outputs.size(), batch_size);
+        for (uint32_t i = 0; i < batch_size; ++i) {
+            const auto expected = single_graph.forward({inputs.at(i)}, false);
+            ASSERT_TRUE(tensor_is_same(outputs.at(i), expected.front()));
+        }
+    }
+}
@@ -144,7 +144,7 @@ TEST(test_ir, pnnx_graph_all) {
         for (const auto &[name, attribute_] : operator_->m_attribute) {
             LOG(INFO) << name << " type: " << int(attribute_->m_type)
                       << " shape: " << shape_str(attribute_->m_shapes);
-            const auto &weight_data = attribute_->m_weight_data;
+            const auto &weight_data = attribute_->weight_span();
             ASSERT_EQ(weight_data.empty(), false); // 判断权重是否为空
         }
         LOG(INFO) << "inputs: ";
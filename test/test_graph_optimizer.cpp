@@ -0,0 +1,118 @@
+//
+// Created by xyzzzh on 2024/5/2.
+//
+
+#include <filesystem>
+#include <fstream>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "runtime/RuntimeGraph.hpp"
+#include "runtime/store_zip.hpp"
+
+// const_relu只依赖常量，op_b与op_a相同，dead_0和dead_1不能到达输出
+static void write_model(const std::string &param_path, const std::string &bin_path, std::vector<float> &constant) {
+    std::ofstream param(param_path);
+    param << "7767517\n"
+             "9 8\n"
+             "pnnx.Input pnnx_input_0 0 1 0 #0=(1,2,4,4)f32\n"
+             "pnnx.Attribute const_0 0 1 1 @data=(1,2,4,4)f32 #1=(1,2,4,4)f32\n"
+             "nn.ReLU const_relu 1 1 1 2 #1=(1,2,4,4)f32 #2=(1,2,4,4)f32\n"
+             "nn.Sigmoid op_a 1 1 0 3 #0=(1,2,4,4)f32 #3=(1,2,4,4)f32\n"
+             "nn.Sigmoid op_b 1 1 0 4 #0=(1,2,4,4)f32 #4=(1,2,4,4)f32\n"
+             "pnnx.Expression expr_0 3 1 3 4 2 5 expr=add(add(@0,@1),@2) "
+             "#3=(1,2,4,4)f32 #4=(1,2,4,4)f32 #2=(1,2,4,4)f32 #5=(1,2,4,4)f32\n"
+             "nn.ReLU dead_0 1 1 0 6 #0=(1,2,4,4)f32 #6=(1,2,4,4)f32\n"
+             "nn.Sigmoid dead_1 1 1 6 7 #6=(1,2,4,4)f32 #7=(1,2,4,4)f32\n"
+             "pnnx.Output pnnx_output_0 1 0 5 #5=(1,2,4,4)f32\n";
+    param.close();
+
+    constant.resize(2 * 4 * 4);
+    for (uint32_t i = 0; i < constant.size(); ++i) {
+        constant.at(i) = float(i) - 10.f;
+    }
+    pnnx::StoreZipWriter writer;
+    ASSERT_EQ(writer.open(bin_path), 0);
+    writer.write_file("const_0.data", reinterpret_cast<const char *>(constant.data()), constant.size() * sizeof(float));
+    writer.close();
+}
+
+TEST(test_graph_optimizer, fold_eliminate_merge) {
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+    const std::string param_path = (dir / "graph_optimizer.pnnx.param").string();
+    const std::string bin_path = (dir / "graph_optimizer.pnnx.bin").string();
+    std::vector<float> constant;
+    write_model(param_path, bin_path, constant);
+
+    RuntimeGraph graph(param_path, bin_path);
+    graph.set_max_batch_size(2);
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    const GraphOptimizeStats &stats = graph.optimize_stats();
+    ASSERT_EQ(stats.folded_operators, 1);
+    ASSERT_EQ(stats.eliminated_operators, 3);
+    ASSERT_EQ(stats.merged_operators, 1);
+    std::vector<std::string> names;
+    for (const auto &op: graph.operators()) {
+        names.push_back(op->m_name);
+    }
+    ASSERT_EQ(names, std::vector<std::string>({"pnnx_input_0", "const_relu", "op_a", "expr_0", "pnnx_output_0"}));
+    ASSERT_EQ(graph.get_topo_queues().size(), 5);
+    ASSERT_EQ(graph.operators().at(1)->m_type, "pnnx.Attribute");
+
+    // 不优化的计算图执行所有的算子，结果与优化后相同
+    RuntimeGraph reference(param_path, bin_path);
+    reference.set_max_batch_size(2);
+    reference.set_graph_optimization(false);
+    reference.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_EQ(reference.get_topo_queues().size(), 9);
+
+    for (uint32_t round = 0; round < 2; ++round) {
+        std::vector<std::shared_ptr<Tensor>> inputs;
+        for (uint32_t b = 0; b < 2; ++b) {
+            std::shared_ptr<Tensor> input = std::make_shared<Tensor>(2, 4, 4);
+            input->rand();
+            inputs.push_back(input);
+        }
+        const auto outputs = graph.forward(inputs, false);
+        const auto expected = reference.forward(inputs, false);
+        ASSERT_EQ(outputs.size(), 2);
+        for (uint32_t b = 0; b < 2; ++b) {
+            ASSERT_TRUE(tensor_is_same(outputs.at(b), expected.at(b)));
+            const std::vector<float> input_values = inputs.at(b)->values(true);
+            const std::vector<float> output_values = outputs.at(b)->values(true);
+            for (uint32_t i = 0; i < constant.size(); ++i) {
+                const float sigmoid = 1.f / (1.f + std::exp(-input_values.at(i)));
+                ASSERT_NEAR(output_values.at(i), 2.f * sigmoid + std::max(constant.at(i), 0.f), 1e-5f);
+            }
+        }
+    }
+
+    // 导出的原生格式模型保存折叠后的常量，加载后不再重复优化
+    const std::string native_path = (dir / "graph_optimizer.infer").string();
+    ASSERT_TRUE(graph.export_model(native_path));
+    RuntimeGraph native_graph("", native_path);
+    native_graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_EQ(native_graph.get_topo_queues().size(), 5);
+    std::vector<std::shared_ptr<Tensor>> inputs;
+    for (uint32_t b = 0; b < 2; ++b) {
+        std::shared_ptr<Tensor> input = std::make_shared<Tensor>(2, 4, 4);
+        input->rand();
+        inputs.push_back(input);
+    }
+    const auto outputs = native_graph.forward(inputs, false);
+    const auto expected = reference.forward(inputs, false);
+    for (uint32_t b = 0; b < 2; ++b) {
+        ASSERT_TRUE(tensor_is_same(outputs.at(b), expected.at(b)));
+    }
+    std::filesystem::remove(native_path);
+    std::filesystem::remove(param_path);
+    std::filesystem::remove(bin_path);
+}
+
+TEST(test_graph_optimizer, unchanged_model) {
+    // 没有可优化算子的模型保持不变
+    RuntimeGraph graph("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    const GraphOptimizeStats &stats = graph.optimize_stats();
+    ASSERT_EQ(stats.folded_operators + stats.eliminated_operators + stats.merged_operators, 0);
+    ASSERT_EQ(graph.operators().size(), 7);
+}
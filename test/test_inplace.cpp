@@ -0,0 +1,95 @@
+//
+// Created by xyzzzh on 2024/4/24.
+//
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "runtime/RuntimeGraph.hpp"
+#include "layer/deatil/ReluLayer.hpp"
+#include "layer/deatil/SigmoidLayer.hpp"
+#include "layer/deatil/ExpressionLayer.hpp"
+
+static std::shared_ptr<Tensor> random_tensor(uint32_t channels, uint32_t rows, uint32_t cols) {
+    std::shared_ptr<Tensor> tensor = std::make_shared<Tensor>(channels, rows, cols);
+    tensor->rand();
+    // rand生成[0, 1)的值，平移后正负值都有
+    tensor->transform([](float value) { return value - 0.5f; });
+    return tensor;
+}
+
+TEST(test_inplace, relu_sigmoid) {
+    std::shared_ptr<Tensor> input = random_tensor(3, 7, 9);
+    const std::vector<float> values = input->values(false);
+
+    ReluLayer relu_layer;
+    std::vector<std::shared_ptr<Tensor>> inputs{input};
+    std::vector<std::shared_ptr<Tensor>> outputs{input};
+    ASSERT_EQ(relu_layer.forward(inputs, outputs), EInferStatus::EIS_InferSuccess);
+    ASSERT_EQ(outputs.front(), input);
+    for (uint32_t i = 0; i < values.size(); ++i) {
+        ASSERT_EQ(input->index(i), std::max(values.at(i), 0.f));
+    }
+
+    SigmoidLayer sigmoid_layer;
+    ASSERT_EQ(sigmoid_layer.forward(inputs, outputs), EInferStatus::EIS_InferSuccess);
+    ASSERT_EQ(outputs.front(), input);
+    for (uint32_t i = 0; i < values.size(); ++i) {
+        ASSERT_NEAR(input->index(i), 1.f / (1.f + std::exp(-std::max(values.at(i), 0.f))), 1e-5f);
+    }
+}
+
+TEST(test_inplace, expression) {
+    const uint32_t batch_size = 2;
+    std::vector<std::shared_ptr<Tensor>> inputs;
+    for (uint32_t i = 0; i < batch_size * 3; ++i) {
+        inputs.push_back(random_tensor(2, 5, 6));
+    }
+    std::vector<std::vector<float>> values;
+    for (const auto &input: inputs) {
+        values.push_back(input->values(false));
+    }
+
+    // 输出复用第1个操作数的存储
+    ExpressionLayer layer("add(mul(@0,@1),@2)");
+    std::vector<std::shared_ptr<Tensor>> outputs{inputs.at(batch_size), inputs.at(batch_size + 1)};
+    ASSERT_EQ(layer.forward(inputs, outputs), EInferStatus::EIS_InferSuccess);
+    for (uint32_t i = 0; i < batch_size; ++i) {
+        ASSERT_EQ(outputs.at(i), inputs.at(batch_size + i));
+        for (uint32_t j = 0; j < outputs.at(i)->size(); ++j) {
+            const float expected = values.at(i).at(j) * values.at(batch_size + i).at(j) +
+                                   values.at(batch_size * 2 + i).at(j);
+            ASSERT_FLOAT_EQ(outputs.at(i)->index(j), expected);
+        }
+    }
+}
+
+TEST(test_inplace, graph_forward) {
+    // op3和表达式的输入只有它们一个使用者，可以原地计算
+    // op1的输入是计算图的输入，op4和op5的输入同时被两个算子使用，不能原地计算
+    RuntimeGraph graph("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    std::map<std::string, int32_t> aliased_inputs;
+    for (const auto &op: graph.get_topo_queues()) {
+        if (op->m_layer != nullptr) {
+            aliased_inputs.insert({op->m_name, op->m_layer->aliased_input()});
+        }
+    }
+    ASSERT_EQ(aliased_inputs.at("op1"), -1);
+    ASSERT_EQ(aliased_inputs.at("op3"), 0);
+    ASSERT_EQ(aliased_inputs.at("op4"), -1);
+    ASSERT_EQ(aliased_inputs.at("op5"), -1);
+    ASSERT_EQ(aliased_inputs.at("pnnx_expr_0"), 0);
+
+    std::shared_ptr<Tensor> input = random_tensor(3, 16, 16);
+    const std::vector<float> values = input->values(false);
+    for (uint32_t round = 0; round < 2; ++round) {
+        const std::vector<std::shared_ptr<Tensor>> outputs = graph.forward({input}, false);
+        ASSERT_EQ(outputs.size(), 1);
+        // 计算图的输入不能被改写
+        ASSERT_EQ(input->values(false), values);
+        for (uint32_t i = 0; i < values.size(); ++i) {
+            const float relu = std::max(values.at(i), 0.f);
+            ASSERT_NEAR(outputs.front()->index(i), relu + 1.f / (1.f + std::exp(-relu)), 1e-5f);
+        }
+    }
+}
@@ -0,0 +1,131 @@
+//
+// Created by xyzzzh on 2024/5/9.
+//
+
+#include <filesystem>
+#include <thread>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "runtime/RuntimeGraph.hpp"
+#include "layer/abstract/Layer.hpp"
+#include "TestUtils.hpp"
+
+// 计算图中尚未写入权重的层数量
+static uint32_t pending_layer_count(const RuntimeGraph &graph) {
+    uint32_t count = 0;
+    for (const auto &op: graph.get_topo_queues()) {
+        if (op->m_layer != nullptr && !op->m_layer->weights_materialized()) {
+            count += 1;
+        }
+    }
+    return count;
+}
+
+TEST(test_lazy_weights, forward) {
+    // build之后带参数的层都没有写入权重，第一次forward之后全部写入，结果与立即加载的相同
+    RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_EQ(pending_layer_count(graph), 0);
+
+    RuntimeGraph lazy_graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    lazy_graph.set_lazy_weights(true);
+    lazy_graph.set_weight_prefetch(1);
+    lazy_graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_TRUE(lazy_graph.lazy_weights());
+    ASSERT_GT(pending_layer_count(lazy_graph), 0);
+    ASSERT_EQ(lazy_graph.activation_memory_size(), graph.activation_memory_size());
+
+    const auto inputs = random_inputs(2);
+    const auto outputs = graph.forward(inputs, false);
+    const auto lazy_outputs = lazy_graph.forward(inputs, false);
+    ASSERT_EQ(pending_layer_count(lazy_graph), 0);
+    ASSERT_EQ(outputs.size(), lazy_outputs.size());
+    for (uint32_t i = 0; i < outputs.size(); ++i) {
+        ASSERT_TRUE(arma::approx_equal(outputs.at(i)->data(), lazy_outputs.at(i)->data(), "absdiff", 0.f));
+    }
+}
+
+TEST(test_lazy_weights, concurrent_forward) {
+    // 多个上下文同时第一次forward时每个层只写入一次
+    RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    RuntimeGraph lazy_graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    lazy_graph.set_lazy_weights(true);
+    lazy_graph.set_num_threads(2);
+    lazy_graph.build("pnnx_input_0", "pnnx_output_0");
+
+    const auto inputs = random_inputs(1);
+    const auto outputs = graph.forward(inputs, false);
+    std::vector<std::vector<std::shared_ptr<Tensor>>> lazy_outputs(4);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < lazy_outputs.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            const std::shared_ptr<ExecutionContext> context = lazy_graph.create_context();
+            const auto results = lazy_graph.forward(*context, inputs);
+            for (const auto &result: results) {
+                lazy_outputs.at(i).push_back(std::make_shared<Tensor>(*result));
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    ASSERT_EQ(pending_layer_count(lazy_graph), 0);
+    for (const auto &results: lazy_outputs) {
+        ASSERT_EQ(results.size(), outputs.size());
+        ASSERT_TRUE(arma::approx_equal(outputs.front()->data(), results.front()->data(), "absdiff", 0.f));
+    }
+}
+
+TEST(test_lazy_weights, export_model) {
+    // 导出时先写入所有层的权重，导出的模型按计算时的布局保存
+    const std::string path = (std::filesystem::temp_directory_path() / "test_lazy_linear.infer").string();
+    RuntimeGraph lazy_graph("model_file/test_linear.pnnx.param", "model_file/test_linear.pnnx.bin");
+    lazy_graph.set_lazy_weights(true);
+    lazy_graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_EQ(pending_layer_count(lazy_graph), 1);
+    ASSERT_TRUE(lazy_graph.export_model(path));
+    ASSERT_EQ(pending_layer_count(lazy_graph), 0);
+
+    RuntimeGraph native_graph("", path);
+    native_graph.set_lazy_weights(true);
+    native_graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_EQ(pending_layer_count(native_graph), 1);
+    const auto inputs = random_inputs(1, 1, 1, 32);
+    const auto outputs = lazy_graph.forward(inputs, false);
+    const auto native_outputs = native_graph.forward(inputs, false);
+    ASSERT_TRUE(arma::approx_equal(outputs.front()->data(), native_outputs.front()->data(), "absdiff", 0.f));
+    std::filesystem::remove(path);
+}
+
+TEST(test_lazy_weights, plan_cache) {
+    // 冷启动时权重还没有写入，缓存中保存属性原来的数据，之后立即加载或者延迟加载都得到相同的结果
+    const std::filesystem::path cache_dir = std::filesystem::temp_directory_path() / "infer_lazy_plan_cache";
+    std::filesystem::remove_all(cache_dir);
+    RuntimeGraph lazy_graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    lazy_graph.set_lazy_weights(true);
+    lazy_graph.set_plan_cache_dir(cache_dir.string());
+    lazy_graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_FALSE(lazy_graph.plan_cache_hit());
+    ASSERT_GT(pending_layer_count(lazy_graph), 0);
+
+    RuntimeGraph cached_graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    cached_graph.set_plan_cache_dir(cache_dir.string());
+    cached_graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_TRUE(cached_graph.plan_cache_hit());
+
+    RuntimeGraph cached_lazy_graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    cached_lazy_graph.set_lazy_weights(true);
+    cached_lazy_graph.set_plan_cache_dir(cache_dir.string());
+    cached_lazy_graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_TRUE(cached_lazy_graph.plan_cache_hit());
+    ASSERT_GT(pending_layer_count(cached_lazy_graph), 0);
+
+    const auto inputs = random_inputs(1);
+    const auto outputs = lazy_graph.forward(inputs, false);
+    const auto cached_outputs = cached_graph.forward(inputs, false);
+    const auto cached_lazy_outputs = cached_lazy_graph.forward(inputs, false);
+    ASSERT_TRUE(arma::approx_equal(outputs.front()->data(), cached_outputs.front()->data(), "absdiff", 0.f));
+    ASSERT_TRUE(arma::approx_equal(outputs.front()->data(), cached_lazy_outputs.front()->data(), "absdiff", 0.f));
+    std::filesystem::remove_all(cache_dir);
+}
@@ -7,6 +7,7 @@
 #include "runtime/RuntimeParameter.hpp"
 #include "layer/abstract/LayerRegisterer.hpp"
 #include "layer/deatil/MaxPoolingLayer.hpp"
+#include "layer/deatil/PadLayer.hpp"
 
 TEST(test_maxpooling, create_layer_poolingforward) {
     std::shared_ptr<RuntimeOperator> op = std::make_shared<RuntimeOperator>();
@@ -60,4 +61,35 @@ TEST(test_maxpooling, create_layer_poolingforward_1) {
 
     ASSERT_EQ(outputs.size(), 1);
     outputs.front()->show();
-}
\ No newline at end of file
+}
+
+TEST(test_maxpooling, fused_padding) {
+    // 显式常数填充后池化与把填充合并到池化中的结果一致
+    std::shared_ptr<Tensor> input = std::make_shared<Tensor>(2, 8, 11);
+    input->rand();
+    std::vector<std::shared_ptr<Tensor>> inputs{input};
+
+    PaddingDesc padding;
+    padding.top = 1;
+    padding.bottom = 2;
+    padding.left = 3;
+    padding.right = 1;
+    padding.value = 0.5f;
+    PadLayer pad_layer(padding);
+    std::vector<std::shared_ptr<Tensor>> padded(1);
+    ASSERT_EQ(pad_layer.forward(inputs, padded), EInferStatus::EIS_InferSuccess);
+
+    MaxPoolingLayer pooling_layer(0, 0, 3, 3, 2, 2);
+    std::vector<std::shared_ptr<Tensor>> outputs1(1);
+    ASSERT_EQ(pooling_layer.forward(padded, outputs1), EInferStatus::EIS_InferSuccess);
+
+    // 自身带有填充的池化不能合并不同填充值的显式填充
+    MaxPoolingLayer padded_pooling_layer(1, 1, 3, 3, 2, 2);
+    ASSERT_FALSE(padded_pooling_layer.fuse_padding(padding));
+
+    MaxPoolingLayer fused_layer(0, 0, 3, 3, 2, 2);
+    ASSERT_TRUE(pad_layer.fold_padding_into(fused_layer));
+    std::vector<std::shared_ptr<Tensor>> outputs2(1);
+    ASSERT_EQ(fused_layer.forward(inputs, outputs2), EInferStatus::EIS_InferSuccess);
+    ASSERT_TRUE(tensor_is_same(outputs1.at(0), outputs2.at(0)));
+}
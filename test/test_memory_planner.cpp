@@ -0,0 +1,108 @@
+//
+// Created by xyzzzh on 2024/4/23.
+//
+
+#include <random>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "runtime/MemoryPlanner.hpp"
+#include "runtime/RuntimeGraph.hpp"
+#include "layer/abstract/Layer.hpp"
+#include "TestUtils.hpp"
+
+// 检查存活区间重叠的块在内存中没有重叠
+static void check_blocks(const std::vector<MemoryBlock> &blocks, size_t arena_size) {
+    for (uint32_t i = 0; i < blocks.size(); ++i) {
+        const MemoryBlock &a = blocks.at(i);
+        ASSERT_LE(a.offset + a.size, arena_size);
+        for (uint32_t j = i + 1; j < blocks.size(); ++j) {
+            const MemoryBlock &b = blocks.at(j);
+            const bool live_overlap = a.first_use <= b.last_use && b.first_use <= a.last_use;
+            const bool memory_overlap = a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+            ASSERT_FALSE(live_overlap && memory_overlap) << i << " and " << j;
+        }
+    }
+}
+
+TEST(test_memory_planner, chain) {
+    // 链式结构中每个输出只和下一个算子的输出同时存活
+    std::vector<MemoryBlock> blocks{{100, 0, 1}, {200, 1, 2}, {50, 2, 3}, {300, 3, 4}};
+    const size_t arena_size = plan_memory_blocks(blocks, 1);
+    check_blocks(blocks, arena_size);
+    ASSERT_EQ(arena_size, 350);
+}
+
+TEST(test_memory_planner, alignment) {
+    std::vector<MemoryBlock> blocks{{10, 0, 1}, {10, 1, 2}};
+    const size_t arena_size = plan_memory_blocks(blocks, 16);
+    check_blocks(blocks, arena_size);
+    ASSERT_EQ(arena_size, 32);
+    for (const auto &block: blocks) {
+        ASSERT_EQ(block.offset % 16, 0);
+    }
+}
+
+TEST(test_memory_planner, random_intervals) {
+    std::mt19937 engine(42);
+    std::uniform_int_distribution<uint32_t> size_dist(1, 1000);
+    std::uniform_int_distribution<uint32_t> time_dist(0, 50);
+    for (uint32_t round = 0; round < 20; ++round) {
+        std::vector<MemoryBlock> blocks(40);
+        for (auto &block: blocks) {
+            block.size = size_dist(engine);
+            block.first_use = time_dist(engine);
+            block.last_use = block.first_use + time_dist(engine) % 8;
+        }
+        const size_t arena_size = plan_memory_blocks(blocks, 1);
+        check_blocks(blocks, arena_size);
+
+        // 内存池不小于任意时刻同时存活的块大小之和
+        for (uint32_t t = 0; t < 60; ++t) {
+            size_t live_size = 0;
+            for (const auto &block: blocks) {
+                if (block.first_use <= t && t <= block.last_use) {
+                    live_size += block.size;
+                }
+            }
+            ASSERT_GE(arena_size, live_size);
+        }
+    }
+}
+
+TEST(test_memory_planner, graph_forward) {
+    const std::string &param_path = "model_file/simple_ops2.pnnx.param";
+    const std::string &bin_path = "model_file/simple_ops2.pnnx.bin";
+    RuntimeGraph graph(param_path, bin_path);
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_GT(graph.activation_memory_size(), 0);
+
+    const uint32_t batch_size = 2;
+    const auto inputs = random_inputs(batch_size);
+    const std::vector<std::shared_ptr<Tensor>> outputs = graph.forward(inputs, false);
+
+    // 逐层使用独立的输出张量计算，结果应与共享内存池时一致
+    std::vector<std::shared_ptr<Tensor>> expected = inputs;
+    for (const auto &op: graph.get_topo_queues()) {
+        if (op->m_layer == nullptr) {
+            continue;
+        }
+        std::vector<std::shared_ptr<Tensor>> layer_outputs(batch_size);
+        ASSERT_EQ(op->m_layer->forward(expected, layer_outputs), EInferStatus::EIS_InferSuccess);
+        expected = layer_outputs;
+    }
+    ASSERT_EQ(outputs.size(), batch_size);
+    for (uint32_t i = 0; i < batch_size; ++i) {
+        ASSERT_TRUE(tensor_is_same(outputs.at(i), expected.at(i)));
+    }
+}
+
+TEST(test_memory_planner, conflict_function) {
+    // 0和1、1和2同时存活，0和2可以共享内存
+    std::vector<MemoryBlock> blocks{{100, 0, 0}, {50, 0, 0}, {80, 0, 0}};
+    const auto conflict = [](uint32_t a, uint32_t b) {
+        return std::max(a, b) - std::min(a, b) == 1;
+    };
+    const size_t arena_size = plan_memory_blocks(blocks, conflict, 1);
+    ASSERT_EQ(arena_size, 150);
+    ASSERT_EQ(blocks.at(0).offset, blocks.at(2).offset);
+}
@@ -0,0 +1,143 @@
+//
+// Created by xyzzzh on 2024/5/5.
+//
+
+#include <filesystem>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "runtime/RuntimeGraph.hpp"
+#include "runtime/ModelFormat.hpp"
+#include "TestUtils.hpp"
+
+TEST(test_model_format, export_and_load) {
+    // 导出的原生格式模型不需要结构文件，计算结果与pnnx模型相同
+    const std::string path = (std::filesystem::temp_directory_path() / "simple_ops2.infer").string();
+    RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_TRUE(graph.export_model(path));
+    ASSERT_TRUE(is_native_model(path));
+    ASSERT_FALSE(is_native_model("model_file/simple_ops2.pnnx.bin"));
+
+    RuntimeGraph native_graph("", path);
+    ASSERT_TRUE(native_graph.init());
+    ASSERT_EQ(native_graph.operators().size(), graph.operators().size());
+    uint32_t packed_count = 0;
+    for (const auto &op: native_graph.operators()) {
+        for (const auto &[name, attribute]: op->m_attribute) {
+            // 权重引用映射中按64字节对齐的数据，已经是层计算时的布局
+            ASSERT_NE(attribute->m_mapping, nullptr);
+            ASSERT_EQ(reinterpret_cast<uintptr_t>(attribute->m_mapped_data) % 64, 0);
+            packed_count += attribute->m_packed;
+        }
+    }
+    ASSERT_EQ(packed_count, 6);
+    native_graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_EQ(native_graph.get_topo_queues().size(), graph.get_topo_queues().size());
+
+    const auto inputs = random_inputs(2);
+    const auto outputs = graph.forward(inputs, false);
+    const auto native_outputs = native_graph.forward(inputs, false);
+    ASSERT_EQ(outputs.size(), native_outputs.size());
+    for (uint32_t i = 0; i < outputs.size(); ++i) {
+        ASSERT_EQ(outputs.at(i)->shapes(), native_outputs.at(i)->shapes());
+        ASSERT_TRUE(arma::approx_equal(outputs.at(i)->data(), native_outputs.at(i)->data(), "absdiff", 0.f));
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(test_model_format, linear) {
+    // 全连接层的权重按列主序保存，加载后与原模型相同
+    const std::string path = (std::filesystem::temp_directory_path() / "test_linear.infer").string();
+    RuntimeGraph graph("model_file/test_linear.pnnx.param", "model_file/test_linear.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_TRUE(graph.export_model(path));
+
+    RuntimeGraph native_graph("", path);
+    native_graph.build("pnnx_input_0", "pnnx_output_0");
+    std::vector<std::shared_ptr<Tensor>> inputs{std::make_shared<Tensor>(1, 1, 32)};
+    inputs.front()->rand();
+    const auto outputs = graph.forward(inputs, false);
+    const auto native_outputs = native_graph.forward(inputs, false);
+    ASSERT_TRUE(arma::approx_equal(outputs.front()->data(), native_outputs.front()->data(), "absdiff", 0.f));
+    std::filesystem::remove(path);
+}
+
+TEST(test_model_format, broken_file) {
+    // 截断的文件不能加载
+    const std::string path = (std::filesystem::temp_directory_path() / "broken.infer").string();
+    RuntimeGraph graph("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_TRUE(graph.export_model(path));
+    const auto size = std::filesystem::file_size(path);
+    std::filesystem::resize_file(path, size / 2);
+
+    RuntimeGraph native_graph("", path);
+    ASSERT_FALSE(native_graph.init());
+    std::filesystem::remove(path);
+}
+
+TEST(test_model_format, plan_cache) {
+    // 第一次build写入缓存，再次build时直接加载优化后的算子和执行计划，结果相同
+    const std::filesystem::path cache_dir = std::filesystem::temp_directory_path() / "infer_plan_cache";
+    std::filesystem::remove_all(cache_dir);
+    RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    graph.set_plan_cache_dir(cache_dir.string());
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_FALSE(graph.plan_cache_hit());
+    uint32_t cache_count = 0;
+    for (const auto &entry: std::filesystem::directory_iterator(cache_dir)) {
+        ASSERT_EQ(entry.path().extension(), ".infer");
+        cache_count += 1;
+    }
+    ASSERT_EQ(cache_count, 1);
+
+    RuntimeGraph cached_graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    cached_graph.set_plan_cache_dir(cache_dir.string());
+    cached_graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_TRUE(cached_graph.plan_cache_hit());
+    ASSERT_EQ(cached_graph.activation_memory_size(), graph.activation_memory_size());
+    ASSERT_EQ(cached_graph.get_topo_queues().size(), graph.get_topo_queues().size());
+    for (uint32_t i = 0; i < graph.get_topo_queues().size(); ++i) {
+        ASSERT_EQ(cached_graph.get_topo_queues().at(i)->m_name, graph.get_topo_queues().at(i)->m_name);
+    }
+
+    const auto inputs = random_inputs(2);
+    const auto outputs = graph.forward(inputs, false);
+    const auto cached_outputs = cached_graph.forward(inputs, false);
+    ASSERT_EQ(outputs.size(), cached_outputs.size());
+    for (uint32_t i = 0; i < outputs.size(); ++i) {
+        ASSERT_TRUE(arma::approx_equal(outputs.at(i)->data(), cached_outputs.at(i)->data(), "absdiff", 0.f));
+    }
+
+    // build选项不同时使用另一个缓存
+    RuntimeGraph batch_graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    batch_graph.set_plan_cache_dir(cache_dir.string());
+    batch_graph.set_max_batch_size(4);
+    batch_graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_FALSE(batch_graph.plan_cache_hit());
+    cache_count = std::distance(std::filesystem::directory_iterator(cache_dir), std::filesystem::directory_iterator());
+    ASSERT_EQ(cache_count, 2);
+    std::filesystem::remove_all(cache_dir);
+}
+
+TEST(test_model_format, broken_plan_cache) {
+    // 损坏的缓存被忽略，重新构建后覆盖
+    const std::filesystem::path cache_dir = std::filesystem::temp_directory_path() / "infer_broken_plan_cache";
+    std::filesystem::remove_all(cache_dir);
+    RuntimeGraph graph("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin");
+    graph.set_plan_cache_dir(cache_dir.string());
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    const std::filesystem::path path = std::filesystem::directory_iterator(cache_dir)->path();
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+
+    RuntimeGraph broken_graph("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin");
+    broken_graph.set_plan_cache_dir(cache_dir.string());
+    broken_graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_FALSE(broken_graph.plan_cache_hit());
+
+    RuntimeGraph cached_graph("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin");
+    cached_graph.set_plan_cache_dir(cache_dir.string());
+    cached_graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_TRUE(cached_graph.plan_cache_hit());
+    std::filesystem::remove_all(cache_dir);
+}
@@ -0,0 +1,186 @@
+//
+// Created by xyzzzh on 2024/5/7.
+//
+
+#include <atomic>
+#include <filesystem>
+#include <thread>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "runtime/ModelRegistry.hpp"
+#include "TestUtils.hpp"
+
+TEST(test_model_registry, share_graph) {
+    // 同一个模型的实例共享计算图，激活内存各自独立
+    ModelRegistry registry;
+    const auto first = registry.acquire("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin",
+                                        "pnnx_input_0", "pnnx_output_0");
+    const auto second = registry.acquire("./model_file/../model_file/simple_ops2.pnnx.param",
+                                         "model_file/simple_ops2.pnnx.bin", "pnnx_input_0", "pnnx_output_0");
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    ASSERT_EQ(first->key(), second->key());
+    ASSERT_EQ(first->graph(), second->graph());
+    ASSERT_EQ(registry.model_count(), 1);
+    ASSERT_EQ(registry.references(first->key()), 2);
+    ASSERT_GT(first->activation_memory_size(), 0);
+
+    RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    const auto inputs = random_inputs(2);
+    const auto other_inputs = random_inputs(2);
+    const auto outputs = graph.forward(inputs, false);
+    const auto first_outputs = first->forward(inputs);
+    // 另一个实例的forward不会覆盖第一个实例的输出
+    second->forward(other_inputs);
+    ASSERT_EQ(outputs.size(), first_outputs.size());
+    for (uint32_t i = 0; i < outputs.size(); ++i) {
+        ASSERT_TRUE(arma::approx_equal(outputs.at(i)->data(), first_outputs.at(i)->data(), "absdiff", 0.f));
+    }
+}
+
+TEST(test_model_registry, content_hash) {
+    // 内容相同的文件合并为同一个模型，build选项不同时分开
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / "infer_registry";
+    std::filesystem::create_directories(dir);
+    std::filesystem::copy_file("model_file/simple_ops.pnnx.param", dir / "copy.param",
+                               std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::copy_file("model_file/simple_ops.pnnx.bin", dir / "copy.bin",
+                               std::filesystem::copy_options::overwrite_existing);
+
+    ModelRegistry registry;
+    const auto model = registry.acquire("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin",
+                                        "pnnx_input_0", "pnnx_output_0");
+    const auto copy = registry.acquire((dir / "copy.param").string(), (dir / "copy.bin").string(),
+                                       "pnnx_input_0", "pnnx_output_0");
+    const auto batch = registry.acquire("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin",
+                                        "pnnx_input_0", "pnnx_output_0", 4);
+    ASSERT_EQ(model->graph(), copy->graph());
+    ASSERT_NE(model->key(), batch->key());
+    ASSERT_EQ(batch->graph()->max_batch_size(), 4);
+    ASSERT_EQ(registry.model_count(), 2);
+    ASSERT_EQ(registry.acquire("model_file/not_exists.param", "model_file/not_exists.bin",
+                               "pnnx_input_0", "pnnx_output_0"), nullptr);
+    std::filesystem::remove_all(dir);
+}
+
+TEST(test_model_registry, unload) {
+    // 卸载后已经分发的实例仍然可用，再次获取时重新加载
+    ModelRegistry registry;
+    std::shared_ptr<ModelInstance> model = registry.acquire("model_file/simple_ops.pnnx.param",
+                                                            "model_file/simple_ops.pnnx.bin",
+                                                            "pnnx_input_0", "pnnx_output_0");
+    const std::string key = model->key();
+    ASSERT_EQ(registry.unload_unused(), 0);
+    ASSERT_TRUE(registry.unload(key));
+    ASSERT_FALSE(registry.unload(key));
+    ASSERT_EQ(registry.references(key), 0);
+    ASSERT_FALSE(model->forward(random_inputs(1)).empty());
+
+    const auto reloaded = registry.acquire("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin",
+                                           "pnnx_input_0", "pnnx_output_0");
+    ASSERT_EQ(reloaded->key(), key);
+    ASSERT_NE(reloaded->graph(), model->graph());
+    model.reset();
+    ASSERT_EQ(registry.unload_unused(), 0);
+    ASSERT_EQ(registry.references(key), 1);
+}
+
+TEST(test_model_registry, concurrent_acquire) {
+    // 多个线程同时获取同一个模型时只build一次
+    ModelRegistry registry;
+    std::vector<std::shared_ptr<ModelInstance>> models(4);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < models.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            models.at(i) = registry.acquire("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin",
+                                            "pnnx_input_0", "pnnx_output_0");
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    for (const auto &model: models) {
+        ASSERT_NE(model, nullptr);
+        ASSERT_EQ(model->graph(), models.front()->graph());
+    }
+    ASSERT_EQ(registry.references(models.front()->key()), 4);
+    models.clear();
+    ASSERT_EQ(registry.unload_unused(), 1);
+    ASSERT_EQ(registry.model_count(), 0);
+}
+
+TEST(test_model_registry, hot_reload) {
+    // 重新加载期间forward不停顿，替换之后实例使用新版本，注册表按新的键索引
+    ModelRegistry registry;
+    const auto model = registry.acquire("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin",
+                                        "pnnx_input_0", "pnnx_output_0", 2);
+    const std::string old_key = model->key();
+    const auto serving = registry.acquire("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin",
+                                          "pnnx_input_0", "pnnx_output_0", 2);
+    std::atomic<bool> stop = false;
+    std::atomic<uint32_t> forward_count = 0;
+    std::thread worker([&]() {
+        while (!stop) {
+            ASSERT_EQ(serving->forward(random_inputs(1)).size(), 1);
+            forward_count += 1;
+        }
+    });
+
+    std::future<ReloadResult> future = registry.reload(old_key, "model_file/simple_ops2.pnnx.param",
+                                                       "model_file/simple_ops2.pnnx.bin");
+    const ReloadResult result = future.get();
+    const uint32_t count_after_reload = forward_count;
+    while (forward_count < count_after_reload + 2) {
+        std::this_thread::yield();
+    }
+    stop = true;
+    worker.join();
+
+    ASSERT_TRUE(result.success);
+    ASSERT_EQ(result.version, 2);
+    ASSERT_NE(result.key, old_key);
+    ASSERT_GT(result.build_ms, 0.);
+    ASSERT_EQ(model->version(), 2);
+    ASSERT_EQ(model->key(), result.key);
+    ASSERT_EQ(registry.references(old_key), 0);
+    ASSERT_EQ(registry.references(result.key), 2);
+    ASSERT_EQ(model->graph()->max_batch_size(), 2);
+
+    // 新版本的输出与直接build的模型相同
+    RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    graph.set_max_batch_size(2);
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    const auto inputs = random_inputs(1);
+    const auto outputs = graph.forward(inputs, false);
+    const auto reloaded_outputs = model->forward(inputs);
+    ASSERT_EQ(outputs.front()->shapes(), reloaded_outputs.front()->shapes());
+    ASSERT_TRUE(arma::approx_equal(outputs.front()->data(), reloaded_outputs.front()->data(), "absdiff", 0.f));
+}
+
+TEST(test_model_registry, reload_drain) {
+    // 旧版本被持有期间不释放，最后一个使用者释放后才得到重新加载的结果
+    ModelRegistry registry;
+    const auto model = registry.acquire("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin",
+                                        "pnnx_input_0", "pnnx_output_0");
+    std::shared_ptr<const RuntimeGraph> old_graph = model->graph();
+    std::future<ReloadResult> future = registry.reload(model->key(), "model_file/simple_ops.pnnx.param",
+                                                       "model_file/simple_ops.pnnx.bin");
+    while (model->version() != 2) {
+        std::this_thread::yield();
+    }
+    ASSERT_EQ(future.wait_for(std::chrono::milliseconds(20)), std::future_status::timeout);
+    ASSERT_NE(model->graph(), old_graph);
+    old_graph.reset();
+    const ReloadResult result = future.get();
+    ASSERT_TRUE(result.success);
+    ASSERT_EQ(result.key, model->key());
+    ASSERT_GT(result.drain_ms, 0.);
+
+    // 不存在的模型和无法读取的文件不会替换当前版本
+    ASSERT_FALSE(registry.reload("not_exists", "model_file/simple_ops.pnnx.param",
+                                 "model_file/simple_ops.pnnx.bin").get().success);
+    ASSERT_FALSE(registry.reload(model->key(), "model_file/not_exists.param",
+                                 "model_file/not_exists.bin").get().success);
+    ASSERT_EQ(model->version(), 2);
+}
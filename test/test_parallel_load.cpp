@@ -0,0 +1,86 @@
+//
+// Created by xyzzzh on 2024/5/4.
+//
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "runtime/RuntimeGraph.hpp"
+#include "layer/abstract/ParamLayer.hpp"
+#include "TestUtils.hpp"
+
+// 比较两个算子创建的层以及层中的权重和偏移
+static void expect_same_layer(const std::shared_ptr<RuntimeOperator> &lhs, const std::shared_ptr<RuntimeOperator> &rhs) {
+    ASSERT_EQ(lhs->m_name, rhs->m_name);
+    ASSERT_EQ(lhs->m_type, rhs->m_type);
+    ASSERT_EQ(lhs->m_layer == nullptr, rhs->m_layer == nullptr);
+    if (lhs->m_layer == nullptr) {
+        return;
+    }
+    ASSERT_EQ(lhs->m_layer->layer_name(), rhs->m_layer->layer_name());
+    // 只有带参数的层持有权重
+    const auto lhs_layer = std::dynamic_pointer_cast<ParamLayer>(lhs->m_layer);
+    const auto rhs_layer = std::dynamic_pointer_cast<ParamLayer>(rhs->m_layer);
+    ASSERT_EQ(lhs_layer == nullptr, rhs_layer == nullptr);
+    if (lhs_layer == nullptr) {
+        return;
+    }
+    const auto &lhs_weights = lhs_layer->weights();
+    const auto &rhs_weights = rhs_layer->weights();
+    ASSERT_EQ(lhs_weights.size(), rhs_weights.size());
+    for (uint32_t i = 0; i < lhs_weights.size(); ++i) {
+        ASSERT_TRUE(arma::approx_equal(lhs_weights.at(i)->data(), rhs_weights.at(i)->data(), "absdiff", 0.f));
+    }
+    const auto &lhs_bias = lhs_layer->bias();
+    const auto &rhs_bias = rhs_layer->bias();
+    ASSERT_EQ(lhs_bias.size(), rhs_bias.size());
+    for (uint32_t i = 0; i < lhs_bias.size(); ++i) {
+        ASSERT_TRUE(arma::approx_equal(lhs_bias.at(i)->data(), rhs_bias.at(i)->data(), "absdiff", 0.f));
+    }
+}
+
+TEST(test_parallel_load, same_as_serial) {
+    // 并行加载得到的算子顺序、拓扑序和层的权重与串行加载完全相同
+    for (const std::string &model: {"simple_ops", "simple_ops2", "test_linear"}) {
+        const std::string param_path = "model_file/" + model + ".pnnx.param";
+        const std::string bin_path = "model_file/" + model + ".pnnx.bin";
+        RuntimeGraph serial_graph(param_path, bin_path);
+        serial_graph.set_load_threads(1);
+        serial_graph.build("pnnx_input_0", "pnnx_output_0");
+
+        RuntimeGraph parallel_graph(param_path, bin_path);
+        parallel_graph.set_load_threads(4);
+        ASSERT_EQ(parallel_graph.load_threads(), 4);
+        parallel_graph.build("pnnx_input_0", "pnnx_output_0");
+
+        const auto &serial_operators = serial_graph.operators();
+        const auto &parallel_operators = parallel_graph.operators();
+        ASSERT_EQ(serial_operators.size(), parallel_operators.size());
+        for (uint32_t i = 0; i < serial_operators.size(); ++i) {
+            expect_same_layer(serial_operators.at(i), parallel_operators.at(i));
+        }
+        const auto &serial_topo = serial_graph.get_topo_queues();
+        const auto &parallel_topo = parallel_graph.get_topo_queues();
+        ASSERT_EQ(serial_topo.size(), parallel_topo.size());
+        for (uint32_t i = 0; i < serial_topo.size(); ++i) {
+            ASSERT_EQ(serial_topo.at(i)->m_name, parallel_topo.at(i)->m_name);
+        }
+    }
+}
+
+TEST(test_parallel_load, forward) {
+    // 并行加载的计算图与串行加载的计算图输出相同
+    RuntimeGraph serial_graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    serial_graph.set_load_threads(1);
+    serial_graph.build("pnnx_input_0", "pnnx_output_0");
+    RuntimeGraph parallel_graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    parallel_graph.set_load_threads(0);
+    parallel_graph.build("pnnx_input_0", "pnnx_output_0");
+
+    const auto inputs = random_inputs(2);
+    const auto serial_outputs = serial_graph.forward(inputs, false);
+    const auto parallel_outputs = parallel_graph.forward(inputs, false);
+    ASSERT_EQ(serial_outputs.size(), parallel_outputs.size());
+    for (uint32_t i = 0; i < serial_outputs.size(); ++i) {
+        ASSERT_TRUE(arma::approx_equal(serial_outputs.at(i)->data(), parallel_outputs.at(i)->data(), "absdiff", 0.f));
+    }
+}
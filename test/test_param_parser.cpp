@@ -0,0 +1,111 @@
+//
+// Created by xyzzzh on 2024/5/8.
+//
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "runtime/ir.h"
+
+TEST(test_param_parser, parameters) {
+    // 参数值的类型按第一个字符和是否包含小数点、指数判断
+    ASSERT_EQ(pnnx::Parameter::parse_from_string("None").type, 0);
+    ASSERT_EQ(pnnx::Parameter::parse_from_string("()").type, 0);
+    ASSERT_TRUE(pnnx::Parameter::parse_from_string("True").b);
+    ASSERT_FALSE(pnnx::Parameter::parse_from_string("False").b);
+    ASSERT_EQ(pnnx::Parameter::parse_from_string("-12").i, -12);
+    ASSERT_FLOAT_EQ(pnnx::Parameter::parse_from_string("1e-05").f, 1e-5f);
+    ASSERT_FLOAT_EQ(pnnx::Parameter::parse_from_string("-2.5").f, -2.5f);
+    ASSERT_EQ(pnnx::Parameter::parse_from_string("zeros").s, "zeros");
+    ASSERT_EQ(pnnx::Parameter::parse_from_string("-inf").s, "-inf");
+
+    const pnnx::Parameter ints = pnnx::Parameter::parse_from_string("(3,-1,224)");
+    ASSERT_EQ(ints.type, 5);
+    ASSERT_EQ(ints.ai, std::vector<int>({3, -1, 224}));
+    const pnnx::Parameter floats = pnnx::Parameter::parse_from_string("[0.5,2e+01]");
+    ASSERT_EQ(floats.type, 6);
+    ASSERT_EQ(floats.af, std::vector<float>({0.5f, 20.f}));
+    const pnnx::Parameter strings = pnnx::Parameter::parse_from_string("(add(@0,@1),x)");
+    ASSERT_EQ(strings.type, 7);
+    ASSERT_EQ(strings.as, std::vector<std::string>({"add(@0", "@1)", "x"}));
+}
+
+TEST(test_param_parser, parse_resnet) {
+    // 没有权重文件时只解析结构，输入和输出操作数按名称连接
+    std::ifstream file("model_file/resnet18_batch1.pnnx.param");
+    std::stringstream text;
+    text << file.rdbuf();
+    pnnx::Graph graph;
+    ASSERT_EQ(graph.parse(text.str()), 0);
+    ASSERT_EQ(graph.ops.size(), 51);
+    ASSERT_EQ(graph.operands.size(), 50);
+    for (const pnnx::Operand *operand: graph.operands) {
+        ASSERT_NE(operand->producer, nullptr);
+        ASSERT_FALSE(operand->shape.empty());
+    }
+    ASSERT_EQ(graph.operands.front()->shape, std::vector<int>({1, 3, 224, 224}));
+    ASSERT_EQ(graph.operands.front()->type, 1);
+
+    const pnnx::Operator *conv = graph.ops.at(1);
+    ASSERT_EQ(conv->type, "nn.Conv2d");
+    ASSERT_EQ(conv->name, "convbn2d_0");
+    ASSERT_EQ(conv->inputs.front(), graph.operands.front());
+    ASSERT_EQ(conv->params.at("kernel_size").ai, std::vector<int>({7, 7}));
+    ASSERT_EQ(conv->params.at("padding_mode").s, "zeros");
+    ASSERT_TRUE(conv->params.at("bias").b);
+    ASSERT_TRUE(conv->attrs.empty());
+
+    pnnx::Graph broken_graph;
+    ASSERT_NE(broken_graph.parse("7767517\n2 1\npnnx.Input input 0 1 0\n"), 0);
+    ASSERT_NE(broken_graph.parse("7767517\n1 1\nnn.ReLU relu 1 1 missing 1\n"), 0);
+}
+
+TEST(test_param_parser, save_and_load) {
+    // 保存后重新加载得到相同的计算图
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+    const std::string param_path = (dir / "test_param_parser.pnnx.param").string();
+    const std::string bin_path = (dir / "test_param_parser.pnnx.bin").string();
+    pnnx::Graph graph;
+    ASSERT_EQ(graph.load("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin"), 0);
+    ASSERT_EQ(graph.save(param_path, bin_path), 0);
+    pnnx::Graph loaded;
+    ASSERT_EQ(loaded.load(param_path, bin_path), 0);
+
+    ASSERT_EQ(graph.ops.size(), loaded.ops.size());
+    ASSERT_EQ(graph.operands.size(), loaded.operands.size());
+    for (uint32_t i = 0; i < graph.operands.size(); ++i) {
+        ASSERT_EQ(graph.operands.at(i)->name, loaded.operands.at(i)->name);
+        ASSERT_EQ(graph.operands.at(i)->shape, loaded.operands.at(i)->shape);
+        ASSERT_EQ(graph.operands.at(i)->type, loaded.operands.at(i)->type);
+    }
+    for (uint32_t i = 0; i < graph.ops.size(); ++i) {
+        const pnnx::Operator *op = graph.ops.at(i);
+        const pnnx::Operator *loaded_op = loaded.ops.at(i);
+        ASSERT_EQ(op->type, loaded_op->type);
+        ASSERT_EQ(op->name, loaded_op->name);
+        ASSERT_EQ(op->inputs.size(), loaded_op->inputs.size());
+        ASSERT_EQ(op->inputnames, loaded_op->inputnames);
+        ASSERT_EQ(op->params.size(), loaded_op->params.size());
+        for (const auto &[key, param]: op->params) {
+            const pnnx::Parameter &loaded_param = loaded_op->params.at(key);
+            ASSERT_EQ(param.type, loaded_param.type);
+            ASSERT_EQ(param.b, loaded_param.b);
+            ASSERT_EQ(param.i, loaded_param.i);
+            ASSERT_EQ(param.s, loaded_param.s);
+            ASSERT_EQ(param.ai, loaded_param.ai);
+            ASSERT_EQ(param.as, loaded_param.as);
+        }
+        ASSERT_EQ(op->attrs.size(), loaded_op->attrs.size());
+        for (const auto &[key, attr]: op->attrs) {
+            const pnnx::Attribute &loaded_attr = loaded_op->attrs.at(key);
+            ASSERT_EQ(attr.shape, loaded_attr.shape);
+            ASSERT_EQ(attr.byte_size(), loaded_attr.byte_size());
+            ASSERT_EQ(std::memcmp(attr.bytes(), loaded_attr.bytes(), attr.byte_size()), 0);
+        }
+    }
+    std::filesystem::remove(param_path);
+    std::filesystem::remove(bin_path);
+}
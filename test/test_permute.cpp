@@ -0,0 +1,105 @@
+//
+// Created by xyzzzh on 2024/4/21.
+//
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "data/TensorND.hpp"
+#include "data/TensorPermute.hpp"
+#include "layer/deatil/PermuteLayer.hpp"
+
+TEST(test_permute, transpose_2d) {
+    // 覆盖8x8对齐、块边界和不足8的剩余部分
+    for (uint32_t rows: {1u, 7u, 8u, 33u, 70u}) {
+        for (uint32_t cols: {1u, 9u, 16u, 45u}) {
+            std::vector<float> src(rows * cols);
+            for (uint32_t i = 0; i < src.size(); ++i) {
+                src.at(i) = float(i);
+            }
+            std::vector<float> dst(rows * cols, -1.f);
+            transpose_2d(src.data(), cols, dst.data(), rows, rows, cols);
+            for (uint32_t r = 0; r < rows; ++r) {
+                for (uint32_t c = 0; c < cols; ++c) {
+                    ASSERT_EQ(dst.at(c * rows + r), src.at(r * cols + c));
+                }
+            }
+        }
+    }
+}
+
+TEST(test_permute, permute_4d) {
+    TensorND t(std::vector<uint32_t>{3, 17, 5, 12});
+    for (uint32_t i = 0; i < t.size(); ++i) {
+        t.raw_ptr()[i] = float(i);
+    }
+    for (const auto &dims: std::vector<std::vector<uint32_t>>{{0, 2, 1, 3},
+                                                              {0, 1, 3, 2},
+                                                              {3, 2, 1, 0},
+                                                              {2, 0, 3, 1}}) {
+        const TensorND p = t.permute(dims).contiguous();
+        ASSERT_TRUE(p.is_contiguous());
+        for (uint32_t a = 0; a < 3; ++a) {
+            for (uint32_t b = 0; b < 17; ++b) {
+                for (uint32_t c = 0; c < 5; ++c) {
+                    for (uint32_t d = 0; d < 12; ++d) {
+                        const std::vector<uint32_t> index{a, b, c, d};
+                        const std::vector<uint32_t> permuted{index[dims[0]], index[dims[1]],
+                                                             index[dims[2]], index[dims[3]]};
+                        ASSERT_EQ(p.at(permuted), t.at(index));
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST(test_permute, tensor_row_major) {
+    Tensor tensor(3, 19, 10);
+    std::vector<float> values(tensor.size());
+    for (uint32_t i = 0; i < values.size(); ++i) {
+        values.at(i) = float(i);
+    }
+    tensor.fill(values, true);
+    for (uint32_t c = 0; c < 3; ++c) {
+        for (uint32_t r = 0; r < 19; ++r) {
+            for (uint32_t w = 0; w < 10; ++w) {
+                ASSERT_EQ(tensor.at(c, r, w), values.at(c * 190 + r * 10 + w));
+            }
+        }
+    }
+    ASSERT_EQ(tensor.values(true), values);
+
+    tensor.reshape({5, 6, 19}, true);
+    ASSERT_EQ(tensor.values(true), values);
+}
+
+TEST(test_permute, permute_layer) {
+    PermuteLayer permute_layer({1, 2, 0});
+    std::shared_ptr<Tensor> input = std::make_shared<Tensor>(4, 9, 11);
+    input->rand();
+    std::vector<std::shared_ptr<Tensor>> inputs{input};
+    std::vector<std::shared_ptr<Tensor>> outputs{std::make_shared<Tensor>(9, 11, 4)};
+    ASSERT_EQ(permute_layer.forward(inputs, outputs), EInferStatus::EIS_InferSuccess);
+    const std::shared_ptr<Tensor> &output = outputs.front();
+    ASSERT_EQ(output->shapes(), (std::vector<uint32_t>{9, 11, 4}));
+    for (uint32_t c = 0; c < 4; ++c) {
+        for (uint32_t r = 0; r < 9; ++r) {
+            for (uint32_t w = 0; w < 11; ++w) {
+                ASSERT_EQ(output->at(r, w, c), input->at(c, r, w));
+            }
+        }
+    }
+}
+
+TEST(test_permute, view_layer) {
+    ViewLayer view_layer({6, -1});
+    std::shared_ptr<Tensor> input = std::make_shared<Tensor>(2, 3, 4);
+    input->rand();
+    std::vector<std::shared_ptr<Tensor>> inputs{input};
+    std::vector<std::shared_ptr<Tensor>> outputs{std::make_shared<Tensor>(1, 6, 4)};
+    ASSERT_EQ(view_layer.forward(inputs, outputs), EInferStatus::EIS_InferSuccess);
+    const std::shared_ptr<Tensor> &output = outputs.front();
+    ASSERT_EQ(output->rows(), 6);
+    ASSERT_EQ(output->cols(), 4);
+    ASSERT_EQ(output->values(true), input->values(true));
+}
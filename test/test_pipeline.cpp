@@ -0,0 +1,98 @@
+//
+// Created by xyzzzh on 2024/5/1.
+//
+
+#include <ctime>
+#include <thread>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "runtime/PipelineExecutor.hpp"
+#include "TestUtils.hpp"
+
+TEST(test_pipeline, stages) {
+    RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+
+    PipelineConfig config;
+    config.num_stages = 3;
+    PipelineExecutor pipeline(graph, config, random_inputs(2));
+    ASSERT_EQ(pipeline.stage_count(), 3);
+    ASSERT_EQ(pipeline.stage_costs().size(), 3);
+    // 各段在拓扑序中首尾相接，覆盖所有的步骤
+    uint32_t begin = 0;
+    for (const auto &[first, second]: pipeline.stage_ranges()) {
+        ASSERT_EQ(first, begin);
+        ASSERT_LT(first, second);
+        begin = second;
+    }
+    ASSERT_EQ(begin, graph.get_topo_queues().size());
+
+    // 在不同的线程中送入和取出，结果按送入的顺序返回
+    const uint32_t request_count = 10;
+    std::vector<std::vector<std::shared_ptr<Tensor>>> inputs;
+    for (uint32_t i = 0; i < request_count; ++i) {
+        inputs.push_back(random_inputs(2));
+    }
+    std::thread producer([&]() {
+        for (const auto &input: inputs) {
+            pipeline.push(input);
+        }
+    });
+    for (uint32_t i = 0; i < request_count; ++i) {
+        const auto outputs = pipeline.pop();
+        const auto expected = graph.forward(inputs.at(i), false);
+        ASSERT_EQ(outputs.size(), 2);
+        for (uint32_t b = 0; b < 2; ++b) {
+            ASSERT_TRUE(tensor_is_same(outputs.at(b), expected.at(b)));
+        }
+    }
+    producer.join();
+}
+
+TEST(test_pipeline, pinned_stages) {
+    RuntimeGraph graph("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+
+    // 段数超过步骤数量时按步骤数量
+    PipelineConfig config;
+    config.num_stages = 64;
+    config.queue_capacity = 1;
+    config.core_groups.assign(64, {0});
+    PipelineExecutor pipeline(graph, config, random_inputs(1));
+    ASSERT_EQ(pipeline.stage_count(), graph.get_topo_queues().size());
+
+    for (uint32_t i = 0; i < 6; ++i) {
+        const auto inputs = random_inputs(1);
+        pipeline.push(inputs);
+        const auto outputs = pipeline.pop();
+        ASSERT_EQ(outputs.size(), 1);
+        ASSERT_TRUE(tensor_is_same(outputs.front(), graph.forward(inputs, false).front()));
+    }
+}
+
+TEST(test_pipeline, idle_blocks) {
+    RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+
+    PipelineConfig config;
+    config.num_stages = 3;
+    PipelineExecutor pipeline(graph, config, random_inputs(1));
+
+    // 空闲的段阻塞等待，不会一直占用CPU
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const std::clock_t cpu_start = std::clock();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    const double cpu_seconds = double(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+    ASSERT_LT(cpu_seconds, 0.1);
+
+    // 阻塞中的pop在输入送入之后被唤醒
+    const auto inputs = random_inputs(1);
+    std::thread producer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        pipeline.push(inputs);
+    });
+    const auto outputs = pipeline.pop();
+    producer.join();
+    ASSERT_EQ(outputs.size(), 1);
+    ASSERT_TRUE(tensor_is_same(outputs.front(), graph.forward(inputs, false).front()));
+}
@@ -0,0 +1,213 @@
+//
+// Created by xyzzzh on 2024/4/28.
+//
+
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "runtime/RuntimeGraph.hpp"
+#include "runtime/store_zip.hpp"
+#include "layer/deatil/ConvLayer.hpp"
+#include "layer/deatil/ExpressionLayer.hpp"
+#include "layer/deatil/FlattenLayer.hpp"
+#include "layer/deatil/LinearLayer.hpp"
+#include "layer/deatil/MaxPoolingLayer.hpp"
+#include "layer/deatil/PermuteLayer.hpp"
+#include "TestUtils.hpp"
+
+TEST(test_shape_inference, layers) {
+    std::vector<uint32_t> shapes;
+    ConvLayer conv_layer(4, 3, 3, 3, 1, 1, 2, 2, 1, false);
+    ASSERT_TRUE(conv_layer.infer_output_shapes({{3, 20, 24}}, shapes));
+    ASSERT_EQ(shapes, (std::vector<uint32_t>{4, 10, 12}));
+    // 输入通道数与卷积核不匹配
+    ASSERT_FALSE(conv_layer.infer_output_shapes({{5, 20, 24}}, shapes));
+
+    MaxPoolingLayer max_layer(0, 0, 2, 2, 2, 2);
+    ASSERT_TRUE(max_layer.infer_output_shapes({{4, 10, 12}}, shapes));
+    ASSERT_EQ(shapes, (std::vector<uint32_t>{4, 5, 6}));
+
+    FlattenLayer flatten_layer(1, -1);
+    ASSERT_TRUE(flatten_layer.infer_output_shapes({{4, 5, 6}}, shapes));
+    ASSERT_EQ(shapes, (std::vector<uint32_t>{120}));
+    FlattenLayer flatten_layer2(2, 3);
+    ASSERT_TRUE(flatten_layer2.infer_output_shapes({{4, 5, 6}}, shapes));
+    ASSERT_EQ(shapes, (std::vector<uint32_t>{4, 30}));
+
+    LinearLayer linear_layer(120, 10, true);
+    ASSERT_TRUE(linear_layer.infer_output_shapes({{120}}, shapes));
+    ASSERT_EQ(shapes, (std::vector<uint32_t>{10}));
+    ASSERT_FALSE(linear_layer.infer_output_shapes({{100}}, shapes));
+
+    ExpressionLayer expression_layer("add(@0,@1)");
+    ASSERT_TRUE(expression_layer.infer_output_shapes({{3, 1, 5}, {4, 1}}, shapes));
+    ASSERT_EQ(shapes, (std::vector<uint32_t>{3, 4, 5}));
+    ASSERT_FALSE(expression_layer.infer_output_shapes({{3, 2, 5}, {4, 1}}, shapes));
+
+    ViewLayer view_layer({-1, 6});
+    ASSERT_TRUE(view_layer.infer_output_shapes({{4, 5, 6}}, shapes));
+    ASSERT_EQ(shapes, (std::vector<uint32_t>{20, 6}));
+
+    PermuteLayer permute_layer({1, 2, 0});
+    ASSERT_TRUE(permute_layer.infer_output_shapes({{4, 5, 6}}, shapes));
+    ASSERT_EQ(shapes, (std::vector<uint32_t>{5, 6, 4}));
+}
+
+// 逐层调用卷积层计算期望结果
+static std::vector<std::shared_ptr<Tensor>> layer_forward(const RuntimeGraph &graph,
+                                                          std::vector<std::shared_ptr<Tensor>> inputs) {
+    for (const auto &op: graph.get_topo_queues()) {
+        if (op->m_layer == nullptr) {
+            continue;
+        }
+        std::vector<std::shared_ptr<Tensor>> outputs(inputs.size());
+        EXPECT_EQ(op->m_layer->forward(inputs, outputs), EInferStatus::EIS_InferSuccess);
+        inputs = outputs;
+    }
+    return inputs;
+}
+
+TEST(test_shape_inference, conv_graph) {
+    // 模型中记录的输入为2x3x16x16
+    RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    ASSERT_EQ(graph.cached_plan_count(), 1);
+    const size_t default_memory_size = graph.activation_memory_size();
+
+    for (const auto &[rows, cols]: std::vector<std::pair<uint32_t, uint32_t>>{{20, 24}, {16, 16}, {7, 5}, {20, 24}}) {
+        for (uint32_t batch_size: {2u, 1u}) {
+            const auto inputs = random_inputs(batch_size, 3, rows, cols);
+            const auto outputs = graph.forward(inputs, false);
+            const auto expected = layer_forward(graph, inputs);
+            ASSERT_EQ(outputs.size(), batch_size);
+            for (uint32_t i = 0; i < batch_size; ++i) {
+                ASSERT_EQ(outputs.at(i)->shapes(), (std::vector<uint32_t>{128, rows, cols}));
+                ASSERT_TRUE(tensor_is_same(outputs.at(i), expected.at(i)));
+            }
+        }
+    }
+    // 每种输入形状只规划一次，模型中的形状使用build时的计划
+    ASSERT_EQ(graph.cached_plan_count(), 3);
+    ASSERT_EQ(graph.activation_memory_size(), default_memory_size);
+}
+
+TEST(test_shape_inference, inplace_graph) {
+    // relu和sigmoid的结果相加，relu和表达式在模型中的形状下原地计算
+    for (uint32_t num_threads: {1u, 3u}) {
+        RuntimeGraph graph("model_file/simple_ops.pnnx.param", "model_file/simple_ops.pnnx.bin");
+        graph.set_num_threads(num_threads);
+        graph.build("pnnx_input_0", "pnnx_output_0");
+        std::shared_ptr<ExecutionContext> context = graph.create_context();
+        const size_t default_memory_size = context->activation_memory_size();
+
+        for (const auto &[rows, cols]: std::vector<std::pair<uint32_t, uint32_t>>{{9, 7}, {32, 40}, {16, 16}}) {
+            std::shared_ptr<Tensor> input = std::make_shared<Tensor>(3, rows, cols);
+            input->rand();
+            input->transform([](float value) { return value - 0.5f; });
+            const std::shared_ptr<Tensor> input_copy = input->clone();
+
+            const auto outputs = graph.forward(*context, {input});
+            ASSERT_EQ(outputs.size(), 1);
+            const auto &output = outputs.front();
+            ASSERT_EQ(output->shapes(), input->shapes());
+            // 计算图的输入不会被原地改写
+            ASSERT_TRUE(tensor_is_same(input, input_copy));
+            for (uint32_t i = 0; i < input->size(); ++i) {
+                const float relu = std::max(input->index(i), 0.f);
+                ASSERT_NEAR(output->index(i), relu + 1.f / (1.f + std::exp(-relu)), 1e-5f);
+            }
+        }
+        // 内存池按最大的输入形状分配，回到较小的形状时继续使用
+        ASSERT_GT(context->activation_memory_size(), default_memory_size);
+    }
+}
+
+// 写入conv1 -> 填充 -> conv2 -> conv3的模型，explicit_pad为false时填充直接写在conv2的参数中
+static void write_pad_conv_model(const std::string &param_path, const std::string &bin_path, bool explicit_pad) {
+    std::ofstream param(param_path);
+    const std::string conv_params = "bias=True dilation=(1,1) groups=1 in_channels=4 kernel_size=(3,3) out_channels=4 ";
+    param << "7767517\n";
+    param << (explicit_pad ? "6 5\n" : "5 4\n");
+    param << "pnnx.Input pnnx_input_0 0 1 0 #0=(1,3,8,8)f32\n";
+    param << "nn.Conv2d conv1 1 1 0 1 bias=True dilation=(1,1) groups=1 in_channels=3 kernel_size=(3,3) "
+             "out_channels=4 padding=(1,1) padding_mode=zeros stride=(1,1) @bias=(4)f32 @weight=(4,3,3,3)f32 "
+             "#0=(1,3,8,8)f32 #1=(1,4,8,8)f32\n";
+    if (explicit_pad) {
+        param << "nn.ZeroPad2d pad 1 1 1 2 padding=(1,1,1,1) #1=(1,4,8,8)f32 #2=(1,4,10,10)f32\n";
+        param << "nn.Conv2d conv2 1 1 2 3 " << conv_params << "padding=(0,0) padding_mode=zeros stride=(1,1) "
+              << "@bias=(4)f32 @weight=(4,4,3,3)f32 #2=(1,4,10,10)f32 #3=(1,4,8,8)f32\n";
+    } else {
+        param << "nn.Conv2d conv2 1 1 1 3 " << conv_params << "padding=(1,1) padding_mode=zeros stride=(1,1) "
+              << "@bias=(4)f32 @weight=(4,4,3,3)f32 #1=(1,4,8,8)f32 #3=(1,4,8,8)f32\n";
+    }
+    param << "nn.Conv2d conv3 1 1 3 4 " << conv_params << "padding=(1,1) padding_mode=zeros stride=(1,1) "
+          << "@bias=(4)f32 @weight=(4,4,3,3)f32 #3=(1,4,8,8)f32 #4=(1,4,8,8)f32\n";
+    param << "pnnx.Output pnnx_output_0 1 0 4 #4=(1,4,8,8)f32\n";
+    param.close();
+
+    pnnx::StoreZipWriter writer;
+    ASSERT_EQ(writer.open(bin_path), 0);
+    for (const auto &[name, size]: std::vector<std::pair<std::string, uint32_t>>{
+            {"conv1.bias",   4}, {"conv1.weight", 4 * 3 * 3 * 3},
+            {"conv2.bias",   4}, {"conv2.weight", 4 * 4 * 3 * 3},
+            {"conv3.bias",   4}, {"conv3.weight", 4 * 4 * 3 * 3}}) {
+        std::vector<float> values(size);
+        for (uint32_t i = 0; i < size; ++i) {
+            values.at(i) = std::sin(float(i + name.size()));
+        }
+        ASSERT_EQ(writer.write_file(name, reinterpret_cast<const char *>(values.data()), size * sizeof(float)), 0);
+    }
+    writer.close();
+}
+
+// 两个张量的存储是否有重叠
+static bool tensor_overlaps(const std::shared_ptr<Tensor> &lhs, const std::shared_ptr<Tensor> &rhs) {
+    const float *lhs_begin = lhs->raw_ptr();
+    const float *rhs_begin = rhs->raw_ptr();
+    return lhs_begin < rhs_begin + rhs->size() && rhs_begin < lhs_begin + lhs->size();
+}
+
+TEST(test_shape_inference, folded_padding_graph) {
+    // 填充算子折叠到卷积之后只传递输入，执行计划中填充的输出与输入共享存储
+    // 卷积直接读取前驱的存储，输出不能与这段存储重叠
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+    const std::string pad_param = (dir / "pad_conv.pnnx.param").string();
+    const std::string pad_bin = (dir / "pad_conv.pnnx.bin").string();
+    const std::string ref_param = (dir / "pad_conv_ref.pnnx.param").string();
+    const std::string ref_bin = (dir / "pad_conv_ref.pnnx.bin").string();
+    write_pad_conv_model(pad_param, pad_bin, true);
+    write_pad_conv_model(ref_param, ref_bin, false);
+
+    RuntimeGraph graph(pad_param, pad_bin);
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    RuntimeGraph reference(ref_param, ref_bin);
+    reference.build("pnnx_input_0", "pnnx_output_0");
+    for (const auto &op: graph.get_topo_queues()) {
+        if (op->m_name == "pad") {
+            ASSERT_EQ(op->m_layer->aliased_input(), 0);
+        }
+    }
+    // 填充不再单独占用内存池
+    ASSERT_EQ(graph.activation_memory_size(), reference.activation_memory_size());
+
+    const auto inputs = random_inputs(1, 3, 8, 8);
+    const auto outputs = graph.forward(inputs, false);
+    const auto expected = reference.forward(inputs, false);
+    ASSERT_EQ(outputs.size(), 1);
+    ASSERT_TRUE(arma::approx_equal(outputs.front()->data(), expected.front()->data(), "absdiff", 1e-4f));
+
+    std::map<std::string, std::shared_ptr<Tensor>> step_outputs;
+    for (const auto &op: graph.get_topo_queues()) {
+        if (op->m_output_operands != nullptr && !op->m_output_operands->m_data.empty()) {
+            step_outputs[op->m_name] = op->m_output_operands->m_data.front();
+        }
+    }
+    ASSERT_FALSE(tensor_overlaps(step_outputs.at("conv1"), step_outputs.at("conv2")));
+    ASSERT_FALSE(tensor_overlaps(step_outputs.at("conv2"), step_outputs.at("conv3")));
+
+    for (const auto &path: {pad_param, pad_bin, ref_param, ref_bin}) {
+        std::filesystem::remove(path);
+    }
+}
@@ -0,0 +1,169 @@
+//
+// Created by xyzzzh on 2024/5/3.
+//
+
+#include <cstring>
+#include <filesystem>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "runtime/ir.h"
+#include "runtime/store_zip.hpp"
+#include "runtime/RuntimeGraph.hpp"
+#include "TestUtils.hpp"
+
+TEST(test_store_zip, mapped_span) {
+    const std::string path = (std::filesystem::temp_directory_path() / "test_store_zip.bin").string();
+    std::vector<float> first(100);
+    std::vector<char> second(7, 'x');
+    for (uint32_t i = 0; i < first.size(); ++i) {
+        first.at(i) = float(i) * 0.5f;
+    }
+    pnnx::StoreZipWriter writer;
+    ASSERT_EQ(writer.open(path), 0);
+    writer.write_file("first", reinterpret_cast<const char *>(first.data()), first.size() * sizeof(float));
+    writer.write_file("second", second.data(), second.size());
+    writer.close();
+
+    std::shared_ptr<const char> mapping;
+    pnnx::StoreZipSpan span;
+    {
+        pnnx::StoreZipReader reader;
+        ASSERT_EQ(reader.open(path), 0);
+        ASSERT_EQ(reader.get_file_size("first"), first.size() * sizeof(float));
+        pnnx::StoreZipSpan second_span;
+        ASSERT_EQ(reader.get_file_span("second", second_span), 0);
+        ASSERT_EQ(std::string(second_span.data, second_span.size), std::string(second.begin(), second.end()));
+        ASSERT_NE(reader.get_file_span("third", second_span), 0);
+
+        // read_file与span中的数据相同
+        std::vector<float> copied(first.size());
+        ASSERT_EQ(reader.read_file("first", reinterpret_cast<char *>(copied.data())), 0);
+        ASSERT_EQ(copied, first);
+        ASSERT_EQ(reader.get_file_span("first", span), 0);
+        mapping = reader.mapping();
+    }
+    // 读取器关闭后，持有映射的span仍然有效
+    ASSERT_NE(mapping, nullptr);
+    ASSERT_EQ(span.size, first.size() * sizeof(float));
+    ASSERT_EQ(std::memcmp(span.data, first.data(), span.size), 0);
+    mapping.reset();
+    std::filesystem::remove(path);
+}
+
+TEST(test_store_zip, graph_attributes) {
+    // 加载模型时权重引用映射的文件，不再复制
+    pnnx::Graph graph;
+    ASSERT_EQ(graph.load("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin"), 0);
+    pnnx::StoreZipReader reader;
+    ASSERT_EQ(reader.open("model_file/simple_ops2.pnnx.bin"), 0);
+    uint32_t attribute_count = 0;
+    for (const pnnx::Operator *op: graph.ops) {
+        for (const auto &[name, attr]: op->attrs) {
+            ASSERT_TRUE(attr.data.empty());
+            ASSERT_NE(attr.mapping, nullptr);
+            const std::string filename = op->name + "." + name;
+            std::vector<char> expected(reader.get_file_size(filename));
+            ASSERT_EQ(reader.read_file(filename, expected.data()), 0);
+            ASSERT_EQ(attr.byte_size(), expected.size());
+            ASSERT_EQ(std::memcmp(attr.bytes(), expected.data(), expected.size()), 0);
+            attribute_count += 1;
+        }
+    }
+    ASSERT_EQ(attribute_count, 6);
+}
+
+TEST(test_store_zip, runtime_attributes) {
+    // 运行时属性引用映射的权重，创建层之后释放对映射的引用
+    RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    ASSERT_TRUE(graph.init());
+    std::vector<std::shared_ptr<RuntimeAttribute>> attributes;
+    for (const auto &op: graph.operators()) {
+        for (const auto &[name, attribute]: op->m_attribute) {
+            ASSERT_TRUE(attribute->m_weight_data.empty());
+            ASSERT_NE(attribute->m_mapping, nullptr);
+            ASSERT_FALSE(attribute->weight_span().empty());
+            attributes.push_back(attribute);
+        }
+    }
+    ASSERT_EQ(attributes.size(), 6);
+
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    for (const auto &attribute: attributes) {
+        ASSERT_EQ(attribute->m_mapping, nullptr);
+        ASSERT_TRUE(attribute->weight_span().empty());
+    }
+}
+
+TEST(test_store_zip, deflate) {
+    // 压缩的文件解压到调用者的缓冲区中，没有span
+    const std::string path = (std::filesystem::temp_directory_path() / "test_store_zip_deflate.bin").string();
+    std::vector<float> values(4096);
+    for (uint32_t i = 0; i < values.size(); ++i) {
+        values.at(i) = float(i % 17);
+    }
+    pnnx::StoreZipWriter writer;
+    ASSERT_EQ(writer.open(path), 0);
+    ASSERT_EQ(writer.write_file("values", reinterpret_cast<const char *>(values.data()),
+                                values.size() * sizeof(float), pnnx::STORE_ZIP_DEFLATE), 0);
+    ASSERT_EQ(writer.write_file("stored", "abc", 3), 0);
+    writer.close();
+    ASSERT_LT(std::filesystem::file_size(path), values.size() * sizeof(float) / 4);
+
+    pnnx::StoreZipReader reader;
+    ASSERT_EQ(reader.open(path), 0);
+    ASSERT_TRUE(reader.is_compressed("values"));
+    ASSERT_FALSE(reader.is_compressed("stored"));
+    ASSERT_EQ(reader.get_file_size("values"), values.size() * sizeof(float));
+    pnnx::StoreZipSpan span;
+    ASSERT_NE(reader.get_file_span("values", span), 0);
+
+    std::vector<float> decompressed(values.size());
+    std::vector<char> stored(3);
+    ASSERT_EQ(reader.read_files({"values", "stored"}, {reinterpret_cast<char *>(decompressed.data()), stored.data()}),
+              0);
+    ASSERT_EQ(decompressed, values);
+    ASSERT_EQ(std::string(stored.begin(), stored.end()), "abc");
+    reader.close();
+    std::filesystem::remove(path);
+}
+
+TEST(test_store_zip, compressed_model) {
+    // 权重压缩保存的模型与原模型的计算结果相同
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+    const std::string bin_path = (dir / "simple_ops2_deflate.pnnx.bin").string();
+    {
+        pnnx::Graph graph;
+        ASSERT_EQ(graph.load("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin"), 0);
+        pnnx::StoreZipWriter writer;
+        ASSERT_EQ(writer.open(bin_path), 0);
+        for (const pnnx::Operator *op: graph.ops) {
+            for (const auto &[name, attr]: op->attrs) {
+                ASSERT_EQ(writer.write_file(op->name + "." + name, attr.bytes(), attr.byte_size(),
+                                            pnnx::STORE_ZIP_DEFLATE), 0);
+            }
+        }
+        writer.close();
+    }
+
+    RuntimeGraph graph("model_file/simple_ops2.pnnx.param", "model_file/simple_ops2.pnnx.bin");
+    graph.build("pnnx_input_0", "pnnx_output_0");
+    RuntimeGraph compressed_graph("model_file/simple_ops2.pnnx.param", bin_path);
+    compressed_graph.build("pnnx_input_0", "pnnx_output_0");
+
+    const auto inputs = random_inputs(2);
+    const auto outputs = graph.forward(inputs, false);
+    const auto compressed_outputs = compressed_graph.forward(inputs, false);
+    ASSERT_EQ(outputs.size(), compressed_outputs.size());
+    for (uint32_t i = 0; i < outputs.size(); ++i) {
+        ASSERT_TRUE(arma::approx_equal(outputs.at(i)->data(), compressed_outputs.at(i)->data(), "absdiff", 0.f));
+    }
+
+    // 损坏的压缩数据不能加载
+    std::fstream file(bin_path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(200);
+    file.write("broken", 6);
+    file.close();
+    pnnx::Graph broken_graph;
+    ASSERT_NE(broken_graph.load("model_file/simple_ops2.pnnx.param", bin_path), 0);
+    std::filesystem::remove(bin_path);
+}
@@ -467,6 +467,85 @@ TEST(test_tensor, add6) {
     }
 }
 
+TEST(test_tensor, add_broadcast_row_col) {
+
+    const auto &f1 = std::make_shared<Tensor>(2, 3, 1);
+    const auto &f2 = std::make_shared<Tensor>(2, 1, 4);
+    for (uint32_t c = 0; c < 2; ++c) {
+        for (uint32_t r = 0; r < 3; ++r) {
+            f1->at(c, r, 0) = float(c * 10 + r);
+        }
+        for (uint32_t w = 0; w < 4; ++w) {
+            f2->at(c, 0, w) = float(w * 100);
+        }
+    }
+
+    const auto &f3 = tensor_add(f1, f2);
+    ASSERT_EQ(f3->channels(), 2);
+    ASSERT_EQ(f3->rows(), 3);
+    ASSERT_EQ(f3->cols(), 4);
+    for (uint32_t c = 0; c < 2; ++c) {
+        for (uint32_t r = 0; r < 3; ++r) {
+            for (uint32_t w = 0; w < 4; ++w) {
+                ASSERT_EQ(f3->at(c, r, w), float(c * 10 + r + w * 100));
+            }
+        }
+    }
+}
+
+TEST(test_tensor, mul_broadcast_channel) {
+
+    const auto &f1 = std::make_shared<Tensor>(1, 4, 5);
+    f1->rand();
+    const auto &f2 = std::make_shared<Tensor>(3, 4, 5);
+    f2->rand();
+
+    const auto &f3 = std::make_shared<Tensor>(3, 4, 5);
+    tensor_multiply(f1, f2, f3);
+    for (uint32_t c = 0; c < 3; ++c) {
+        for (uint32_t r = 0; r < 4; ++r) {
+            for (uint32_t w = 0; w < 5; ++w) {
+                ASSERT_EQ(f3->at(c, r, w), f1->at(0, r, w) * f2->at(c, r, w));
+            }
+        }
+    }
+}
+
+TEST(test_tensor, mul_broadcast_inplace) {
+
+    const auto &f1 = std::make_shared<Tensor>(3, 4, 5);
+    f1->fill(3.f);
+    const auto &f2 = std::make_shared<Tensor>(3, 1, 1);
+    for (uint32_t c = 0; c < 3; ++c) {
+        f2->index(c) = float(c);
+    }
+
+    tensor_multiply(f1, f2, f1);
+    for (uint32_t c = 0; c < 3; ++c) {
+        for (uint32_t j = 0; j < f1->slice(c).size(); ++j) {
+            ASSERT_EQ(f1->slice(c).at(j), 3.f * float(c));
+        }
+    }
+}
+
+TEST(test_tensor, tensor_broadcast3) {
+
+    const std::shared_ptr<Tensor> &tensor1 = tensor_create({3, 1, 8});
+    tensor1->rand();
+    const std::shared_ptr<Tensor> &tensor2 = tensor_create({1, 6, 1});
+
+    const auto &[tensor11, tensor21] = tensor_broadcast(tensor1, tensor2);
+    ASSERT_EQ(tensor11->shapes(), std::vector<uint32_t>({3, 6, 8}));
+    ASSERT_EQ(tensor21->shapes(), std::vector<uint32_t>({3, 6, 8}));
+    for (uint32_t c = 0; c < 3; ++c) {
+        for (uint32_t r = 0; r < 6; ++r) {
+            for (uint32_t w = 0; w < 8; ++w) {
+                ASSERT_EQ(tensor11->at(c, r, w), tensor1->at(c, 0, w));
+            }
+        }
+    }
+}
+
 TEST(test_tensor, shapes) {
 
     Tensor f3(2, 3, 4);
@@ -0,0 +1,129 @@
+//
+// Created by xyzzzh on 2024/4/20.
+//
+
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include "data/TensorND.hpp"
+#include "Utils.hpp"
+
+static TensorND make_arange(const std::vector<uint32_t> &shapes) {
+    TensorND tensor(shapes);
+    float *ptr = tensor.raw_ptr();
+    for (uint32_t i = 0; i < tensor.size(); ++i) {
+        ptr[i] = float(i);
+    }
+    return tensor;
+}
+
+TEST(test_tensor_nd, init) {
+    TensorND t(std::vector<uint32_t>{2, 3, 4, 5, 6});
+    ASSERT_EQ(t.dims(), 5);
+    ASSERT_EQ(t.size(), 720);
+    ASSERT_TRUE(t.is_contiguous());
+    ASSERT_TRUE(t.is_owner());
+    ASSERT_EQ(t.strides(), (std::vector<uint32_t>{360, 120, 30, 6, 1}));
+}
+
+TEST(test_tensor_nd, view_share_data) {
+    TensorND t = make_arange({2, 3, 4});
+    TensorND v = t.view({6, -1});
+    ASSERT_EQ(v.shapes(), (std::vector<uint32_t>{6, 4}));
+    ASSERT_EQ(v.raw_ptr(), t.raw_ptr());
+    v.at({5, 3}) = -1.f;
+    ASSERT_EQ(t.at({1, 2, 3}), -1.f);
+}
+
+TEST(test_tensor_nd, permute) {
+    TensorND t = make_arange({2, 3, 4});
+    TensorND p = t.permute({2, 0, 1});
+    ASSERT_EQ(p.shapes(), (std::vector<uint32_t>{4, 2, 3}));
+    ASSERT_FALSE(p.is_contiguous());
+    for (uint32_t i = 0; i < 2; ++i) {
+        for (uint32_t j = 0; j < 3; ++j) {
+            for (uint32_t k = 0; k < 4; ++k) {
+                ASSERT_EQ(p.at({k, i, j}), t.at({i, j, k}));
+            }
+        }
+    }
+    TensorND c = p.contiguous();
+    ASSERT_TRUE(c.is_contiguous());
+    const std::vector<float> values = c.values();
+    ASSERT_EQ(values.at(0), 0.f);
+    ASSERT_EQ(values.at(1), 4.f);
+    ASSERT_EQ(values.at(3), 12.f);
+}
+
+TEST(test_tensor_nd, slice_select) {
+    TensorND t = make_arange({4, 6});
+    TensorND s = t.slice(1, 1, 6, 2);
+    ASSERT_EQ(s.shapes(), (std::vector<uint32_t>{4, 3}));
+    ASSERT_EQ(s.at({2, 1}), 15.f);
+
+    TensorND row = t.select(0, 3);
+    ASSERT_EQ(row.dims(), 1);
+    ASSERT_EQ(row.values(), (std::vector<float>{18, 19, 20, 21, 22, 23}));
+}
+
+TEST(test_tensor_nd, expand) {
+    TensorND t = make_arange({3, 1});
+    TensorND e = t.expand({3, 4});
+    ASSERT_EQ(e.strides().at(1), 0);
+    ASSERT_EQ(e.at({2, 3}), 2.f);
+}
+
+TEST(test_tensor_nd, concat) {
+    TensorND a = make_arange({2, 2, 3});
+    TensorND b = make_arange({2, 1, 3});
+    TensorND output(std::vector<uint32_t>{2, 3, 3});
+    tensor_concat({a, b}, 1, output);
+    for (uint32_t i = 0; i < 2; ++i) {
+        for (uint32_t k = 0; k < 3; ++k) {
+            ASSERT_EQ(output.at({i, 0, k}), a.at({i, 0, k}));
+            ASSERT_EQ(output.at({i, 1, k}), a.at({i, 1, k}));
+            ASSERT_EQ(output.at({i, 2, k}), b.at({i, 0, k}));
+        }
+    }
+}
+
+TEST(test_tensor_nd, from_tensor) {
+    Tensor tensor(2, 3, 4);
+    std::vector<float> values(24);
+    for (uint32_t i = 0; i < 24; ++i) {
+        values.at(i) = float(i);
+    }
+    tensor.fill(values, true);
+
+    TensorND view = TensorND::from_tensor(tensor);
+    ASSERT_EQ(view.shapes(), (std::vector<uint32_t>{2, 3, 4}));
+    ASSERT_EQ(view.values(), values);
+
+    view.at({1, 2, 3}) = -1.f;
+    ASSERT_EQ(tensor.at(1, 2, 3), -1.f);
+}
+
+TEST(test_tensor_nd, to_tensor_rank5) {
+    TensorND t = make_arange({2, 3, 2, 4, 5});
+    std::shared_ptr<Tensor> tensor = t.to_tensor();
+    ASSERT_EQ(tensor->channels(), 12);
+    ASSERT_EQ(tensor->rows(), 4);
+    ASSERT_EQ(tensor->cols(), 5);
+    ASSERT_EQ(tensor->raw_shapes(), (std::vector<uint32_t>{2, 3, 2, 4, 5}));
+    ASSERT_EQ(tensor->values(true), t.values());
+
+    TensorND back = TensorND::from_tensor(*tensor);
+    ASSERT_EQ(back.shapes(), t.shapes());
+    ASSERT_EQ(back.values(), t.values());
+}
+
+TEST(test_tensor_nd, tensor_create_rank5) {
+    std::shared_ptr<Tensor> tensor = tensor_create(std::vector<uint32_t>{2, 3, 4, 5, 6});
+    ASSERT_EQ(tensor->channels(), 24);
+    ASSERT_EQ(tensor->rows(), 5);
+    ASSERT_EQ(tensor->cols(), 6);
+    ASSERT_EQ(tensor->raw_shapes().size(), 5);
+
+    tensor->reshape({6, 4, 30});
+    ASSERT_EQ(tensor->channels(), 6);
+    ASSERT_EQ(tensor->raw_shapes(), (std::vector<uint32_t>{6, 4, 30}));
+}